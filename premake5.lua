@@ -51,6 +51,11 @@ project "Enigma"
 
 	dependson "Enigma-shaders"
 
+	-- also compiles out the validation layers and the CPU profiler, see Profiler.h
+	filter "configurations:Release"
+		defines { "NDEBUG" }
+	filter {}
+
 	postbuildcommands { 
 		"{COPY} \"$(SolutionDir)assimp-vc143-mt.dll\" \"$(OutDir)\"",
 
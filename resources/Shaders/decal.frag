@@ -0,0 +1,31 @@
+#version 450
+
+// Darkens the albedo where the surface the g-buffer saw is inside the decal's sphere. Without blending the
+// alpha can't fade the edge, the mark is cut at a smaller radius instead
+
+layout(location = 0) flat in vec4 decal;
+layout(location = 0) out vec4 albedo;
+
+layout(set = 0, binding = 2) uniform sampler2D positionTexture;
+
+layout(push_constant) uniform Push
+{
+	uint blend;
+} push;
+
+const vec3 markColour = vec3(0.02, 0.02, 0.02);
+
+void main()
+{
+	vec3 position = texelFetch(positionTexture, ivec2(gl_FragCoord.xy), 0).xyz;
+
+	float distanceToCentre = length(position - decal.xyz) / decal.w;
+	if (distanceToCentre > 1.0)
+		discard;
+
+	float alpha = 1.0 - smoothstep(0.4, 1.0, distanceToCentre);
+	if (push.blend == 0 && alpha < 0.5)
+		discard;
+
+	albedo = vec4(markColour, alpha);
+}
@@ -0,0 +1,40 @@
+#version 450
+
+// Box around a decal, built from gl_VertexIndex so the draw needs no vertex buffer. Every instance is one decal
+// of the ring, the fragment shader gets the decal itself and decides which pixels it covers
+
+layout(set = 0, binding = 0) uniform SceneUniform
+{
+	mat4 model;
+	mat4 view;
+	mat4 projection;
+
+	float fov;
+	float nearPlane;
+	float farPlane;
+} ubo;
+
+// xyz centre, w radius
+layout(std430, set = 0, binding = 1) readonly buffer Decals { vec4 decals[]; };
+
+layout(location = 0) flat out vec4 decal;
+
+// corner bits are x, y, z, faces wind counter clockwise seen from outside
+const int indices[36] = int[36](
+	1, 3, 7, 1, 7, 5,
+	0, 4, 6, 0, 6, 2,
+	2, 6, 7, 2, 7, 3,
+	0, 1, 5, 0, 5, 4,
+	4, 5, 7, 4, 7, 6,
+	0, 2, 3, 0, 3, 1
+);
+
+void main()
+{
+	decal = decals[gl_InstanceIndex];
+
+	int corner = indices[gl_VertexIndex];
+	vec3 offset = vec3(corner & 1, (corner >> 1) & 1, (corner >> 2) & 1) * 2.0 - 1.0;
+
+	gl_Position = ubo.projection * ubo.view * vec4(decal.xyz + offset * decal.w, 1.0);
+}
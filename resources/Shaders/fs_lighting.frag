@@ -46,16 +46,14 @@ layout(set = 0, binding = 7) uniform Debug
 	float maxDistance;
 }debugRenderer;
 
-// reconstruct positions using depth returns view space position
-vec3 depthToPosition()
-{
-	float depth = texture(depthTex, uv).x;
-	vec4 clipspace = vec4(uv * 2.0 - 1.0, depth, 1.0);
-	vec4 viewspace = inverse(ubo.projection) * clipspace;
-	vec4 worldSpacePos = inverse(ubo.view) * viewspace;
-
-	return worldSpacePos.xyz /= worldSpacePos.w;
-}
+// Chosen when the pipeline is created, see LightingPermutation. Branches on them are resolved by the compiler
+// so a permutation only carries the features it was built with
+// 0 - shaded, 1 - shadow map, 2 - linear depth
+layout(constant_id = 0) const int DEBUG_VIEW = 0;
+layout(constant_id = 1) const bool SSR_ENABLED = true;
+layout(constant_id = 2) const int SSR_STEP_COUNT = 0;
+// 0 - single tap, 1 - 16 tap poisson PCF
+layout(constant_id = 3) const int SHADOW_FILTER = 0;
 
 vec2 POISSON32[] = vec2[32](
 	vec2(0.2981409,0.0490049), vec2(0.1629048,-0.1408463), vec2(0.1691782,-0.3703386),
@@ -72,84 +70,13 @@ vec2 POISSON32[] = vec2[32](
 );
 
 
-//
-//vec3 test_shadow(vec3 WorldPosition)
-//{
-//	vec4 fragPosLightSpace = LightUBO.LightSpaceMatrix * vec4(WorldPosition.xyz, 1.0);
-//	vec4 projCoords = fragPosLightSpace / fragPosLightSpace.w;
-//
-//	projCoords.xy = projCoords.xy * 0.5 + 0.5;
-//
-//	float closestDepth = texture(shadowMap, projCoords.xy).r;
-//	vec3 color = texture(albedo, uv).xyz;
-//
-//	vec3 result = color * closestDepth;
-//
-//	return result;
-//}
-
-bool check(vec2 projectCoords)
-{
-    if(abs(projectCoords.x) > 0.0 && abs(projectCoords.x) < 1.0  
-    && abs(projectCoords.y) > 0.0 && abs(projectCoords.y) < 1.0)
-    {
-        // we're in screen-space
-        return true;
-    }
-    // coordinate is outside of screen-space
-    return false;
-}
-
 float LinearizeDepth(float d)
 {
 	return (2.0 * ubo.nearPlane) / (ubo.farPlane + ubo.nearPlane - d * (ubo.farPlane - ubo.nearPlane));
 }
 
-
-// @LightDirection: World position fragment to light position 
-float screen_space_shadows(vec3 LightDirection)
-{
-	uint  max_steps = debugRenderer.stepCount; // 32
-	float max_dist = debugRenderer.maxDistance; // 0.5
-	float thickness = 0.05; // 0.05
-	float step_length = debugRenderer.thickness; // 0.25
-
-	vec3 ray_pos = (ubo.view * vec4(texture(gBuffPosition, uv).xyz, 1.0)).xyz;
-	vec3 ray_dir = normalize((ubo.view * vec4(LightDirection, 1.0)).xyz);
-
-	vec3 ray_step = ray_dir * step_length;
-
-	float occlusion = 0.0;
-	vec2 ray_uv = vec2(0.0);
-
-	for(uint i = 0; i < max_steps; i++)
-	{
-		// step the ray
-		ray_pos += ray_step;
-		vec4 vpPos = ubo.projection * vec4(ray_pos, 1.0);
-		vec2 ray_uv = vpPos.xy / vpPos.w;
-		ray_uv = ray_uv * 0.5 + 0.5;
-
-		float ray_depth = vpPos.z / vpPos.w;
-		float depth = LinearizeDepth(texture(depthTex, ray_uv).r);
-
-		bool can_camera_see_ray = (ray_depth - depth > 0) && ray_depth - depth < thickness;
-		
-		if(can_camera_see_ray)
-		{
-			occlusion = 1.0;
-			break;
-		}
-	}
-
-	return 1.0 - occlusion;
-}
-
-
 vec4 screen_space_reflections()
 {
-	//float max_distance = debugRenderer.maxDistance;
-	int step_count = debugRenderer.stepCount;
 	float step_size = debugRenderer.maxDistance;
 	float thickness = debugRenderer.thickness;
 	
@@ -164,7 +91,8 @@ vec4 screen_space_reflections()
 	
 	vec4 project_coords;
 	vec3 ray_position = ray_start.xyz += ray_step;
-	for(int i = 0; i < step_count; i++)
+	// a constant trip count, the compiler can unroll the march or drop it when there are no steps
+	for(int i = 0; i < SSR_STEP_COUNT; i++)
 	{
 		project_coords = ubo.projection * ubo.view * vec4(ray_position, 1.0);
 		project_coords.xy /= project_coords.w;
@@ -177,10 +105,7 @@ vec4 screen_space_reflections()
 
 		if((ray_depth - depth > 0) && ray_depth - depth < thickness)
 		{
-			//float a = 0.3 * pow(min(1.0, (step_size * step_count / 2) / length(project_coords.xyz)), 2.0);
-			//return (1.0 - a) + vec4(texture(albedo, project_coords.xy).xyz, 1.0) * a;
 			return texture(albedo, project_coords.xy);
-			break;
 		}
 
 		ray_position.xyz += ray_step;
@@ -189,49 +114,6 @@ vec4 screen_space_reflections()
 	return vec4(0);
 }
 
-#define PI 3.14159265359
-
-vec3 fresnel_schlick_approx(float cos_theta, vec3 F0)
-{
-	return F0 + (1.0 - F0) * pow(clamp(1.0 - cos_theta, 0.0, 1.0), 5.0);
-}
-
-float normal_distribution(vec3 normal, vec3 halfVec, float r)
-{
-	float a = r * r;
-	float a2 = a * a;
-	float n_dot_h = max(dot(normal, halfVec), 0.0);
-	float n_dot_h2 = n_dot_h * n_dot_h;
-
-	float num = a2;
-	float denom = (n_dot_h2 * (a2 - 1.0) + 1.0);
-	denom = PI * denom * denom;
-
-	return num / denom;
-}
-
-float geometry_schlick(float n_dot_v, float r)
-{
-	float roughness = (r + 1.0);
-	float k = (roughness * roughness) / 8.0; // for non-IBL
-
-	float num = n_dot_v;
-	float denom = n_dot_v * (1.0 - k) + k;
-
-	return num / denom;
-}
-
-float geometry_smith(vec3 N, vec3 V, vec3 L, float k)
-{
-	float n_dot_v = max(dot(N, V), 0.0);
-	float n_dot_l = max(dot(N, L), 0.0);
-	
-	float ggx2 = geometry_schlick(n_dot_v, k);
-	float ggx1 = geometry_schlick(n_dot_l, k);
-
-	return ggx1 * ggx2;
-}
-
 float PCF(vec3 WorldPosition)
 {
 	vec4 fragPosLightSpace = LightUBO.LightSpaceMatrix * vec4(WorldPosition.xyz, 1.0);
@@ -273,6 +155,20 @@ float Shadow(vec3 WorldPosition)
 }
 
 void main() {
+   if(DEBUG_VIEW == 1)
+   {
+	   float x = texture(shadowMap, uv).x;
+	   outColor = vec4(vec3(x), 1.0);
+	   return;
+   }
+
+   if(DEBUG_VIEW == 2)
+   {
+	   float sampleDepth = texture(depthTex, uv).x;
+	   float depthVpos = LinearizeDepth(sampleDepth);
+	   outColor = vec4(vec3(depthVpos), 1.0);
+	   return;
+   }
    
    // Make light position, color and direction uniforms
    vec4 lightColour = LightUBO.lightColour;
@@ -296,33 +192,15 @@ void main() {
    float VdotR = pow(max(dot(view_dir, reflect_dir), 0.0), 32);
    vec3 specular = specular_amount * VdotR * lightColour.xyz;
 
-   //float sss = screen_space_shadows(lightDir);
-   vec4 ref = screen_space_reflections();
-
-   float shadow = Shadow(WorldPos);
+   float shadow = SHADOW_FILTER == 1 ? 1.0 - PCF(WorldPos) : Shadow(WorldPos);
    vec3 shade = (ambient + (1.0 - shadow) * (diffuse + specular)) * color.xyz; // should be object colour
    
-   float reflectivity = 0.5;
-   shade = mix(shade, ref.xyz, reflectivity);
-
-   if(debugRenderer.debugRenderTarget == 1)
+   if(SSR_ENABLED)
    {
-	   float x = texture(shadowMap, uv).x;
-       outColor = vec4(vec3(x), 1.0);
+	   vec4 ref = screen_space_reflections();
+	   float reflectivity = 0.5;
+	   shade = mix(shade, ref.xyz, reflectivity);
    }
 
-   else if(debugRenderer.debugRenderTarget == 2)
-   {
-   	  float sampleDepth = texture(depthTex, uv).x;
-	  float depthVpos = LinearizeDepth(sampleDepth);
-	  vec3 normal = normalize(texture(gBuffNormal, uv).xyz);
-	  outColor = vec4(vec3(depthVpos), 1.0);
-   }
-   else 
-   {
-	   float sampleDepth = texture(depthTex, uv).x;
-	   float depthVpos = LinearizeDepth(sampleDepth);
-	   outColor = vec4(vec3(shade), 1.0);
-   }
+   outColor = vec4(vec3(shade), 1.0);
 }
-
@@ -1,4 +1,5 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
 
 layout(location = 0) in vec3 color;
 layout(location = 1) in vec2 uv;
@@ -20,13 +21,21 @@ layout(set = 0, binding = 0) uniform SceneUniform
 	float farPlane;
 } ubo;
 
-layout(set = 1, binding = 0) uniform sampler2D textures[40];
-layout(set = 1, binding = 1) uniform sampler2D metallic[40];
+layout(set = 1, binding = 0) uniform sampler2D textures[];
+
+// TextureCache's material table, indexed by material ID
+struct Material
+{
+	int diffuse;
+	int metallic;
+};
+
+layout(std430, set = 1, binding = 1) readonly buffer Materials { Material materials[]; };
 
 layout(push_constant) uniform Push
 {
 	mat4 model;
-	int textureIndex;
+	int materialID;
     bool isTextured;
 } push;
 
@@ -39,6 +48,6 @@ void main() {
    
    gPosition = vec4(WorldPosition.xyz, 1.0);
    gNormal = normalize(vec4(WorldNormal, 1.0));
-   albedo = vec4(vec3(texture(textures[push.textureIndex], uv).xyz), 1.0);
+   albedo = vec4(vec3(texture(textures[materials[push.materialID].diffuse], uv).xyz), 1.0);
 }
 
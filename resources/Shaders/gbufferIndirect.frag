@@ -0,0 +1,31 @@
+#version 450
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(location = 0) in vec3 color;
+layout(location = 1) in vec2 uv;
+layout(location = 2) in vec3 WorldNormal;
+layout(location = 3) in vec4 WorldPosition;
+layout(location = 4) flat in int materialID;
+
+layout(location = 0) out vec4 gPosition;
+layout(location = 1) out vec4 gNormal;
+layout(location = 2) out vec4 albedo;
+
+layout(set = 1, binding = 0) uniform sampler2D textures[];
+
+// TextureCache's material table, indexed by material ID
+struct Material
+{
+	int diffuse;
+	int metallic;
+};
+
+layout(std430, set = 1, binding = 1) readonly buffer Materials { Material materials[]; };
+
+// gbuffer.frag with the material ID from vertexIndirect.vert, it differs between the draws of one indirect call
+void main() {
+
+   gPosition = vec4(WorldPosition.xyz, 1.0);
+   gNormal = normalize(vec4(WorldNormal, 1.0));
+   albedo = vec4(vec3(texture(textures[nonuniformEXT(materials[materialID].diffuse)], uv).xyz), 1.0);
+}
@@ -0,0 +1,64 @@
+#version 450
+
+// vertex.vert for draws written by cull.comp, the model matrix and material come from the draw instead of a push constant
+
+layout(set = 0, binding = 0) uniform SceneUniform
+{
+	mat4 model;
+	mat4 view;
+	mat4 projection;
+
+	float fov;
+	float nearPlane;
+	float farPlane;
+} ubo;
+
+struct Instance
+{
+	mat4 model;
+};
+
+struct Mesh
+{
+	uint firstIndex;
+	uint indexCount;
+	int vertexOffset;
+	uint materialID;
+	vec3 aabbMin;
+	uint textured;
+	vec3 aabbMax;
+	uint padding;
+};
+
+struct Draw
+{
+	uint instance;
+	uint mesh;
+};
+
+layout(std430, set = 2, binding = 0) readonly buffer Instances { Instance instances[]; };
+layout(std430, set = 2, binding = 1) readonly buffer Draws { Draw draws[]; };
+layout(std430, set = 2, binding = 2) readonly buffer Meshes { Mesh meshes[]; };
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 normal;
+layout(location = 2) in vec2 tex;
+layout(location = 3) in vec3 color;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 uv;
+layout(location = 2) out vec3 WorldNormal;
+layout(location = 3) out vec4 WorldPosition;
+layout(location = 4) flat out int materialID;
+void main()
+{
+	Draw draw = draws[gl_InstanceIndex];
+	mat4 model = instances[draw.instance].model;
+
+	materialID = int(meshes[draw.mesh].materialID);
+	WorldNormal = normal;
+	fragColor = color;
+	uv = tex;
+	WorldPosition = model * vec4(position, 1.0);
+	gl_Position = ubo.projection * ubo.view * WorldPosition;
+}
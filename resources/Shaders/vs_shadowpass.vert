@@ -11,7 +11,7 @@ layout(set = 0, binding = 0) uniform LightingUniform
 layout(push_constant) uniform Push
 {
 	mat4 model;
-	int textureIndex;
+	int materialID;
     bool isTextured;
 } push;
 
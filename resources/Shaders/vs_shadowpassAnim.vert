@@ -11,7 +11,7 @@ layout(set = 0, binding = 0) uniform LightingUniform
 layout(push_constant) uniform Push
 {
 	mat4 model;
-	int textureIndex;
+	int materialID;
     bool isTextured;
 } push;
 
@@ -27,7 +27,7 @@ layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 uv;
 layout(location = 2) out vec3 WorldNormal;
 
-layout(set = 2, binding = 0) uniform UBOBones { mat4 boneMatrices[300]; };
+layout(set = 1, binding = 0) uniform UBOBones { mat4 boneMatrices[300]; };
 
 void main()
 {
@@ -0,0 +1,36 @@
+#version 450
+
+// vs_shadowpass.vert for draws written by cull.comp
+
+layout(set = 0, binding = 0) uniform LightingUniform
+{
+	vec4 lightPos;
+	vec4 lightDir;
+	vec4 lightColour;
+	mat4 LightSpaceMatrix;
+}LightUBO;
+
+struct Instance
+{
+	mat4 model;
+};
+
+struct Draw
+{
+	uint instance;
+	uint mesh;
+};
+
+layout(std430, set = 1, binding = 0) readonly buffer Instances { Instance instances[]; };
+layout(std430, set = 1, binding = 1) readonly buffer Draws { Draw draws[]; };
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 normal;
+layout(location = 2) in vec2 tex;
+layout(location = 3) in vec3 color;
+
+void main()
+{
+	mat4 model = instances[draws[gl_InstanceIndex].instance].model;
+	gl_Position = LightUBO.LightSpaceMatrix * model * vec4(position, 1.0f);
+}
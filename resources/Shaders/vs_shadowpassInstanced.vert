@@ -0,0 +1,30 @@
+#version 450
+
+// vs_shadowpass.vert for the render queue's instanced draws, the model matrix comes from the instance buffer
+
+layout(set = 0, binding = 0) uniform LightingUniform
+{
+	vec4 lightPos;
+	vec4 lightDir;
+	vec4 lightColour;
+	mat4 LightSpaceMatrix;
+}LightUBO;
+
+layout(push_constant) uniform Push
+{
+	mat4 model;
+	int materialID;
+    bool isTextured;
+} push;
+
+layout(std430, set = 1, binding = 0) readonly buffer Instances { mat4 instances[]; };
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 normal;
+layout(location = 2) in vec2 tex;
+layout(location = 3) in vec3 color;
+
+void main()
+{
+	gl_Position = LightUBO.LightSpaceMatrix * instances[gl_InstanceIndex] * vec4(position, 1.0f);
+}
@@ -0,0 +1,416 @@
+#include "BVH.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <iostream>
+
+namespace Enigma
+{
+	namespace
+	{
+		// leaves hold up to one group of boxes for RayBoxes8
+		constexpr int LeafWidth = 8;
+
+		int Groups(int count)
+		{
+			return (count + LeafWidth - 1) / LeafWidth;
+		}
+
+		float SurfaceArea(const AABB& box)
+		{
+			const glm::vec3 d = box.max - box.min;
+			return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+		}
+
+		void Grow(AABB& box, const AABB& other)
+		{
+			box.min = glm::min(box.min, other.min);
+			box.max = glm::max(box.max, other.max);
+		}
+
+		glm::vec3 Centroid(const AABB& box)
+		{
+			return (box.min + box.max) * 0.5f;
+		}
+
+		bool BoundsOverlap(const AABB& a, const AABB& b)
+		{
+			return a.max.x >= b.min.x && a.min.x <= b.max.x &&
+				a.max.y >= b.min.y && a.min.y <= b.max.y &&
+				a.max.z >= b.min.z && a.min.z <= b.max.z;
+		}
+
+		// slab test, tEntry is where the ray enters the box clamped to the start of the ray
+		bool RayBounds(const AABB& box, const glm::vec3& origin, const glm::vec3& invDirection, float maxDistance, float& tEntry)
+		{
+			const glm::vec3 t0 = (box.min - origin) * invDirection;
+			const glm::vec3 t1 = (box.max - origin) * invDirection;
+			const glm::vec3 tNear = glm::min(t0, t1);
+			const glm::vec3 tFar = glm::max(t0, t1);
+			const float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+			const float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+			tEntry = enter;
+			return enter <= exit;
+		}
+	}
+
+	AABB TransformAABB(const AABB& box, const glm::mat4& transform)
+	{
+		const glm::vec3 centre = glm::vec3(transform * glm::vec4(Centroid(box), 1.0f));
+		const glm::vec3 extents = (box.max - box.min) * 0.5f;
+
+		glm::mat3 absolute;
+		for (int c = 0; c < 3; c++)
+			for (int r = 0; r < 3; r++)
+				absolute[c][r] = std::abs(transform[c][r]);
+
+		const glm::vec3 newExtents = absolute * extents;
+		return { centre - newExtents, centre + newExtents };
+	}
+
+	glm::vec3 InverseDirection(const glm::vec3& direction)
+	{
+		glm::vec3 inverse;
+		for (int i = 0; i < 3; i++)
+			inverse[i] = 1.0f / (direction[i] != 0.0f ? direction[i] : 1e-30f);
+		return inverse;
+	}
+
+	void BVH::Build(const std::vector<Model*>& models)
+	{
+		nodes.clear();
+		primitives.clear();
+		indices.clear();
+
+		for (auto* model : models)
+		{
+			if (!model->collidable)
+				continue;
+
+			const uint32_t layer = model->player ? COLLISION_PLAYER : model->enemy ? COLLISION_ENEMY : COLLISION_STATIC;
+			const glm::mat4 transform = model->GetModelMatrix();
+			for (int i = 0; i < static_cast<int>(model->meshes.size()); i++)
+			{
+				const AABB& local = model->meshes[i].meshAABB;
+				if (local.min.x > local.max.x)
+					continue;
+
+				primitives.push_back({ model, i, layer, model->player || model->enemy, TransformAABB(local, transform) });
+			}
+		}
+
+		if (primitives.empty())
+			return;
+
+		indices.resize(primitives.size());
+		for (int i = 0; i < static_cast<int>(indices.size()); i++)
+			indices[i] = i;
+
+		nodes.reserve(primitives.size() * 2);
+		nodes.push_back({ AABB{}, 0, static_cast<int>(primitives.size()) });
+		UpdateLeafBounds(0);
+		Subdivide(0, 0);
+
+		leafBoxes.Resize(static_cast<int>(indices.size()));
+		for (int i = 0; i < static_cast<int>(indices.size()); i++)
+			leafBoxes.Set(i, primitives[indices[i]].bounds);
+
+		std::cout << "[ENIGMA]: Built collision BVH with " << primitives.size() << " primitives and " << nodes.size() << " nodes" << std::endl;
+	}
+
+	void BVH::UpdateLeafBounds(int node)
+	{
+		Node& n = nodes[node];
+		n.bounds = AABB{};
+		for (int i = n.first; i < n.first + n.count; i++)
+			Grow(n.bounds, primitives[indices[i]].bounds);
+	}
+
+	void BVH::Subdivide(int node, int depth)
+	{
+		constexpr int binCount = 12;
+		constexpr int maxDepth = 32;
+
+		const int first = nodes[node].first;
+		const int count = nodes[node].count;
+		if (count <= LeafWidth || depth >= maxDepth)
+			return;
+
+		glm::vec3 centroidMin = glm::vec3(FLT_MAX);
+		glm::vec3 centroidMax = glm::vec3(-FLT_MAX);
+		for (int i = first; i < first + count; i++)
+		{
+			const glm::vec3 c = Centroid(primitives[indices[i]].bounds);
+			centroidMin = glm::min(centroidMin, c);
+			centroidMax = glm::max(centroidMax, c);
+		}
+
+		// binned surface area heuristic, try every bin boundary on every axis
+		float bestCost = FLT_MAX;
+		int bestAxis = -1;
+		float bestSplit = 0.0f;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			const float extent = centroidMax[axis] - centroidMin[axis];
+			if (extent <= 1e-6f)
+				continue;
+
+			AABB binBounds[binCount];
+			int binCounts[binCount] = {};
+			const float scale = binCount / extent;
+			for (int i = first; i < first + count; i++)
+			{
+				const AABB& bounds = primitives[indices[i]].bounds;
+				const int bin = std::min(binCount - 1, static_cast<int>((Centroid(bounds)[axis] - centroidMin[axis]) * scale));
+				binCounts[bin]++;
+				Grow(binBounds[bin], bounds);
+			}
+
+			float leftArea[binCount - 1];
+			int leftCount[binCount - 1];
+			AABB left;
+			int leftSum = 0;
+			for (int i = 0; i < binCount - 1; i++)
+			{
+				leftSum += binCounts[i];
+				Grow(left, binBounds[i]);
+				leftCount[i] = leftSum;
+				leftArea[i] = leftSum > 0 ? SurfaceArea(left) : 0.0f;
+			}
+
+			AABB right;
+			int rightSum = 0;
+			for (int i = binCount - 1; i > 0; i--)
+			{
+				rightSum += binCounts[i];
+				Grow(right, binBounds[i]);
+				if (leftCount[i - 1] == 0 || rightSum == 0)
+					continue;
+
+				// a leaf costs one slab test per group of eight boxes, not one per box
+				const float cost = Groups(leftCount[i - 1]) * leftArea[i - 1] + Groups(rightSum) * SurfaceArea(right);
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = centroidMin[axis] + i / scale;
+				}
+			}
+		}
+
+		// splitting has to be cheaper than testing every primitive in this node
+		if (bestAxis == -1 || bestCost >= Groups(count) * SurfaceArea(nodes[node].bounds))
+			return;
+
+		const auto middle = std::partition(indices.begin() + first, indices.begin() + first + count, [&](int index) {
+			return Centroid(primitives[index].bounds)[bestAxis] < bestSplit;
+		});
+		const int leftCount = static_cast<int>(middle - indices.begin()) - first;
+		if (leftCount == 0 || leftCount == count)
+			return;
+
+		const int leftChild = static_cast<int>(nodes.size());
+		nodes.push_back({ AABB{}, first, leftCount });
+		nodes.push_back({ AABB{}, first + leftCount, count - leftCount });
+		nodes[node].first = leftChild;
+		nodes[node].count = 0;
+
+		UpdateLeafBounds(leftChild);
+		UpdateLeafBounds(leftChild + 1);
+		Subdivide(leftChild, depth + 1);
+		Subdivide(leftChild + 1, depth + 1);
+	}
+
+	void BVH::Refit()
+	{
+		if (nodes.empty())
+			return;
+
+		// primitives of the same model are next to each other so the matrix is only built once per model
+		Model* model = nullptr;
+		glm::mat4 transform = glm::mat4(1.0f);
+		for (auto& primitive : primitives)
+		{
+			if (!primitive.dynamic)
+				continue;
+
+			if (primitive.model != model)
+			{
+				model = primitive.model;
+				transform = model->GetModelMatrix();
+			}
+			primitive.bounds = TransformAABB(model->meshes[primitive.mesh].meshAABB, transform);
+		}
+
+		for (int i = 0; i < static_cast<int>(indices.size()); i++)
+		{
+			if (primitives[indices[i]].dynamic)
+				leafBoxes.Set(i, primitives[indices[i]].bounds);
+		}
+
+		// children are always created after their parent so walking backwards updates them first
+		for (int i = static_cast<int>(nodes.size()) - 1; i >= 0; i--)
+		{
+			Node& node = nodes[i];
+			if (node.count > 0)
+			{
+				UpdateLeafBounds(i);
+			}
+			else
+			{
+				node.bounds = nodes[node.first].bounds;
+				Grow(node.bounds, nodes[node.first + 1].bounds);
+			}
+		}
+	}
+
+	bool BVH::Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, uint32_t mask, BVHHit& hit) const
+	{
+		return Raycast(origin, direction, maxDistance, mask, hit, nullptr);
+	}
+
+	bool BVH::Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, uint32_t mask, BVHHit& hit,
+		const std::function<bool(const BVHPrimitive& primitive, float maxDistance, float& t)>& narrow) const
+	{
+		if (nodes.empty())
+			return false;
+
+		const glm::vec3 invDirection = InverseDirection(direction);
+		float closest = maxDistance;
+		bool found = false;
+
+		int stack[64];
+		int stackSize = 0;
+		stack[stackSize++] = 0;
+
+		while (stackSize > 0)
+		{
+			const Node& node = nodes[stack[--stackSize]];
+			float tNode;
+			if (!RayBounds(node.bounds, origin, invDirection, closest, tNode))
+				continue;
+
+			if (node.count > 0)
+			{
+				for (int group = node.first; group < node.first + node.count; group += LeafWidth)
+				{
+					const int groupCount = std::min(LeafWidth, node.first + node.count - group);
+					float tEntry[LeafWidth];
+					const uint32_t hits = RayBoxes8(leafBoxes, group, groupCount, origin, invDirection, closest, tEntry);
+					for (int lane = 0; lane < groupCount; lane++)
+					{
+						// closest can shrink part way through the group so the entry distance is checked again
+						const BVHPrimitive& primitive = primitives[indices[group + lane]];
+						float t = tEntry[lane];
+						if (!(hits & (1u << lane)) || !(primitive.layer & mask) || t > closest)
+							continue;
+
+						if (!narrow || narrow(primitive, closest, t))
+						{
+							closest = t;
+							hit = { primitive.model, primitive.mesh, t, indices[group + lane] };
+							found = true;
+						}
+					}
+				}
+				continue;
+			}
+
+			// visit the nearer child first so closest shrinks as early as possible
+			float tLeft;
+			float tRight;
+			const bool hitLeft = RayBounds(nodes[node.first].bounds, origin, invDirection, closest, tLeft);
+			const bool hitRight = RayBounds(nodes[node.first + 1].bounds, origin, invDirection, closest, tRight);
+			if (hitLeft && hitRight)
+			{
+				const bool leftFirst = tLeft <= tRight;
+				stack[stackSize++] = leftFirst ? node.first + 1 : node.first;
+				stack[stackSize++] = leftFirst ? node.first : node.first + 1;
+			}
+			else if (hitLeft)
+			{
+				stack[stackSize++] = node.first;
+			}
+			else if (hitRight)
+			{
+				stack[stackSize++] = node.first + 1;
+			}
+		}
+
+		return found;
+	}
+
+	bool BVH::SegmentBlocked(const glm::vec3& start, const glm::vec3& end, uint32_t mask) const
+	{
+		const glm::vec3 segment = end - start;
+		const float length = glm::length(segment);
+		if (length < 1e-6f)
+			return false;
+
+		BVHHit hit;
+		return Raycast(start, segment / length, length, mask, hit);
+	}
+
+	void BVH::Overlap(const AABB& box, uint32_t mask, std::vector<BVHHit>& results) const
+	{
+		if (nodes.empty())
+			return;
+
+		int stack[64];
+		int stackSize = 0;
+		stack[stackSize++] = 0;
+
+		while (stackSize > 0)
+		{
+			const Node& node = nodes[stack[--stackSize]];
+			if (!BoundsOverlap(node.bounds, box))
+				continue;
+
+			if (node.count > 0)
+			{
+				for (int i = node.first; i < node.first + node.count; i++)
+				{
+					const BVHPrimitive& primitive = primitives[indices[i]];
+					if ((primitive.layer & mask) && BoundsOverlap(primitive.bounds, box))
+						results.push_back({ primitive.model, primitive.mesh, 0.0f, indices[i] });
+				}
+				continue;
+			}
+
+			stack[stackSize++] = node.first;
+			stack[stackSize++] = node.first + 1;
+		}
+	}
+
+	bool BVH::Overlaps(const AABB& box, uint32_t mask) const
+	{
+		if (nodes.empty())
+			return false;
+
+		int stack[64];
+		int stackSize = 0;
+		stack[stackSize++] = 0;
+
+		while (stackSize > 0)
+		{
+			const Node& node = nodes[stack[--stackSize]];
+			if (!BoundsOverlap(node.bounds, box))
+				continue;
+
+			if (node.count > 0)
+			{
+				for (int i = node.first; i < node.first + node.count; i++)
+				{
+					const BVHPrimitive& primitive = primitives[indices[i]];
+					if ((primitive.layer & mask) && BoundsOverlap(primitive.bounds, box))
+						return true;
+				}
+				continue;
+			}
+
+			stack[stackSize++] = node.first;
+			stack[stackSize++] = node.first + 1;
+		}
+		return false;
+	}
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include <glm/glm.hpp>
+#include "../Graphics/Model.h"
+#include "BoxBatch.h"
+
+namespace Enigma
+{
+	// Layers a primitive can be on, queries take a mask of the layers they want to hit
+	enum CollisionLayer : uint32_t
+	{
+		COLLISION_STATIC = 1 << 0,
+		COLLISION_PLAYER = 1 << 1,
+		COLLISION_ENEMY = 1 << 2,
+		COLLISION_PROJECTILE = 1 << 3,
+		COLLISION_ALL = 0xFFFFFFFF
+	};
+
+	// World space bounds of a box after transform, handles rotation by transforming the extents
+	AABB TransformAABB(const AABB& box, const glm::mat4& transform);
+
+	// 1 / direction for slab tests. Zero components become a huge finite value, infinity would turn into NaN for a ray
+	// starting exactly on a slab plane and the box would be missed
+	glm::vec3 InverseDirection(const glm::vec3& direction);
+
+	struct BVHPrimitive
+	{
+		Model* model;
+		int mesh;
+		uint32_t layer;
+		bool dynamic;
+		AABB bounds;
+	};
+
+	struct BVHHit
+	{
+		Model* model = nullptr;
+		int mesh = -1;
+		float t = 0.0f;
+		int primitive = -1;   // index into GetPrimitives()
+	};
+
+	// Bounding volume hierarchy over the world space bounds of every mesh in the world. Built with the surface
+	// area heuristic when the level loads, dynamic models (player and enemies) are refit each tick instead of
+	// rebuilding the tree
+	class BVH
+	{
+	public:
+		void Build(const std::vector<Model*>& models);
+		// Recompute the bounds of the dynamic primitives from their model's current transform
+		void Refit();
+
+		// Closest primitive hit by the ray within maxDistance, direction has to be normalized
+		bool Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, uint32_t mask, BVHHit& hit) const;
+		// Same traversal but every primitive whose bounds the ray enters is handed to narrow, which returns true and
+		// the exact distance when the ray really hits it closer than maxDistance
+		bool Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, uint32_t mask, BVHHit& hit,
+			const std::function<bool(const BVHPrimitive& primitive, float maxDistance, float& t)>& narrow) const;
+		// True if anything blocks the segment from start to end
+		bool SegmentBlocked(const glm::vec3& start, const glm::vec3& end, uint32_t mask) const;
+		// Appends every primitive whose bounds overlap the box
+		void Overlap(const AABB& box, uint32_t mask, std::vector<BVHHit>& results) const;
+		bool Overlaps(const AABB& box, uint32_t mask) const;
+
+		const std::vector<BVHPrimitive>& GetPrimitives() const { return primitives; }
+
+	private:
+		struct Node
+		{
+			AABB bounds;
+			int first;   // interior: index of the left child, the right child follows it. leaf: first entry of indices
+			int count;   // number of primitives, 0 for interior nodes
+		};
+
+		void Subdivide(int node, int depth);
+		void UpdateLeafBounds(int node);
+
+	private:
+		std::vector<Node> nodes;
+		std::vector<BVHPrimitive> primitives;
+		std::vector<int> indices;
+		// primitive bounds in leaf order so a leaf is tested eight boxes at a time
+		BoxBatch leafBoxes;
+	};
+}
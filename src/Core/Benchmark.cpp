@@ -0,0 +1,602 @@
+#include "Benchmark.h"
+#include "Navmesh.h"
+#include "NavHierarchy.h"
+#include "SpatialHash.h"
+#include "NavAgent.h"
+#include "JobSystem.h"
+#include "TriangleBVH.h"
+#include "BoxBatch.h"
+#include "BVH.h"
+#include "SweepAndPrune.h"
+#include "../Graphics/Physics.h"
+#include <chrono>
+#include <random>
+#include <iostream>
+#include <iomanip>
+#include <cmath>
+#include <cfloat>
+
+namespace Enigma::Benchmark
+{
+	namespace
+	{
+		using Clock = std::chrono::high_resolution_clock;
+
+		double MillisecondsSince(Clock::time_point start)
+		{
+			return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+		}
+
+		// One square polygon per open cell, roughly a fifth of the cells are blocked
+		void GenerateGrid(Navmesh& mesh, int size, float blockedChance, uint32_t seed)
+		{
+			std::mt19937 rng(seed);
+			std::uniform_real_distribution<float> chance(0.0f, 1.0f);
+
+			mesh.Clear();
+			for (int z = 0; z < size; z++)
+			{
+				for (int x = 0; x < size; x++)
+				{
+					if (chance(rng) < blockedChance)
+						continue;
+
+					const float fx = static_cast<float>(x);
+					const float fz = static_cast<float>(z);
+					mesh.AddPolygon({
+						glm::vec3(fx, 0.0f, fz),
+						glm::vec3(fx + 1.0f, 0.0f, fz),
+						glm::vec3(fx + 1.0f, 0.0f, fz + 1.0f),
+						glm::vec3(fx, 0.0f, fz + 1.0f)
+					});
+				}
+			}
+			mesh.LinkPortals();
+		}
+
+		// Bumpy terrain of size x size quads, two triangles each
+		void GenerateTerrain(int size, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+		{
+			vertices.clear();
+			indices.clear();
+			for (int z = 0; z <= size; z++)
+			{
+				for (int x = 0; x <= size; x++)
+				{
+					Vertex vertex{};
+					vertex.pos = glm::vec3(static_cast<float>(x), std::sin(x * 0.31f) * std::cos(z * 0.17f) * 4.0f, static_cast<float>(z));
+					vertices.push_back(vertex);
+				}
+			}
+			for (int z = 0; z < size; z++)
+			{
+				for (int x = 0; x < size; x++)
+				{
+					const uint32_t i = z * (size + 1) + x;
+					indices.insert(indices.end(), { i, i + 1, i + size + 2, i, i + size + 2, i + size + 1 });
+				}
+			}
+		}
+
+		// Moller-Trumbore against every triangle, the reference the BVH is checked against
+		bool BruteForceRaycast(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, const glm::vec3& origin, const glm::vec3& direction, float maxDistance, float& t)
+		{
+			bool found = false;
+			t = maxDistance;
+			for (size_t i = 0; i < indices.size(); i += 3)
+			{
+				const glm::vec3 v0 = vertices[indices[i]].pos;
+				const glm::vec3 e1 = vertices[indices[i + 1]].pos - v0;
+				const glm::vec3 e2 = vertices[indices[i + 2]].pos - v0;
+				const glm::vec3 p = glm::cross(direction, e2);
+				const float det = glm::dot(e1, p);
+				if (std::abs(det) < 1e-12f)
+					continue;
+
+				const float invDet = 1.0f / det;
+				const glm::vec3 s = origin - v0;
+				const float u = glm::dot(s, p) * invDet;
+				if (u < 0.0f || u > 1.0f)
+					continue;
+
+				const glm::vec3 q = glm::cross(s, e1);
+				const float v = glm::dot(direction, q) * invDet;
+				if (v < 0.0f || u + v > 1.0f)
+					continue;
+
+				const float distance = glm::dot(e2, q) * invDet;
+				if (distance > 0.0f && distance < t)
+				{
+					t = distance;
+					found = true;
+				}
+			}
+			return found;
+		}
+	}
+
+	void Pathfinding()
+	{
+		const int gridSizes[] = { 128, 256, 512 };
+		const float clusterSize = 16.0f;
+		const int queries = 100;
+
+		for (int size : gridSizes)
+		{
+			Navmesh mesh;
+			NavHierarchy hierarchy;
+
+			auto start = Clock::now();
+			GenerateGrid(mesh, size, 0.2f, 1234u);
+			const double generateTime = MillisecondsSince(start);
+
+			start = Clock::now();
+			hierarchy.Build(mesh, clusterSize);
+			const double buildTime = MillisecondsSince(start);
+
+			// long routes from the left edge of the map to the right edge
+			std::mt19937 rng(42u);
+			std::uniform_int_distribution<int> edgeBand(0, size / 10);
+			std::uniform_int_distribution<int> row(0, size - 1);
+
+			double flatTime = 0.0;
+			double routeTime = 0.0;
+			double refineTime = 0.0;
+			int solved = 0;
+
+			std::vector<int> corridor;
+			std::vector<glm::vec3> corners;
+			NavRoute route;
+
+			for (int q = 0; q < queries; q++)
+			{
+				const glm::vec3 from = glm::vec3(edgeBand(rng) + 0.5f, 0.0f, row(rng) + 0.5f);
+				const glm::vec3 to = glm::vec3(size - 1 - edgeBand(rng) + 0.5f, 0.0f, row(rng) + 0.5f);
+				const int fromPolygon = hierarchy.FindPolygon(from);
+				const int toPolygon = hierarchy.FindPolygon(to);
+				if (!mesh.Contains(fromPolygon, from) || !mesh.Contains(toPolygon, to))
+					continue;
+
+				start = Clock::now();
+				const bool flatFound = mesh.FindCorridor(fromPolygon, toPolygon, from, to, corridor);
+				if (flatFound)
+				{
+					corners.clear();
+					mesh.StringPull(from, to, corridor, corners);
+				}
+				const double flat = MillisecondsSince(start);
+
+				// the hierarchical query only pays for the abstract search and the first segment,
+				// the rest is refined as the agent walks
+				start = Clock::now();
+				const bool routeFound = hierarchy.FindRoute(fromPolygon, from, toPolygon, to, route);
+				const double abstract = MillisecondsSince(start);
+
+				start = Clock::now();
+				if (routeFound)
+					hierarchy.RefineNext(route, corners);
+				const double refine = MillisecondsSince(start);
+
+				if (flatFound != routeFound)
+					std::cout << "[ENIGMA BENCHMARK]: flat and hierarchical search disagree on query " << q << std::endl;
+
+				if (flatFound && routeFound)
+				{
+					flatTime += flat;
+					routeTime += abstract;
+					refineTime += refine;
+					solved++;
+				}
+			}
+
+			if (solved == 0)
+			{
+				std::cout << "[ENIGMA BENCHMARK]: grid " << size << " had no solvable queries" << std::endl;
+				continue;
+			}
+
+			const double flatAverage = flatTime / solved;
+			const double hierarchicalAverage = (routeTime + refineTime) / solved;
+			std::cout << std::fixed << std::setprecision(3)
+				<< "[ENIGMA BENCHMARK]: grid " << size << "x" << size << " (" << mesh.polygons.size() << " polygons, "
+				<< hierarchy.GetClusterCount() << " clusters, " << hierarchy.GetNodes().size() << " nodes)\n"
+				<< "    generate " << generateTime << " ms, hierarchy build " << buildTime << " ms\n"
+				<< "    flat A* + funnel      " << flatAverage << " ms/query\n"
+				<< "    HPA* route + segment  " << hierarchicalAverage << " ms/query (route " << routeTime / solved
+				<< ", first segment " << refineTime / solved << ")\n"
+				<< "    speedup " << flatAverage / hierarchicalAverage << "x over " << solved << " queries" << std::endl;
+		}
+	}
+
+	void Crowd()
+	{
+		const int crowdSizes[] = { 100, 500, 1000, 5000 };
+		const float radius = 8.0f;
+		const int maxNeighbours = 8;
+		const int ticks = 20;
+
+		for (int size : crowdSizes)
+		{
+			// agents spread over an area that grows with the crowd so the density stays the same
+			std::mt19937 rng(7u);
+			const float extent = std::sqrt(static_cast<float>(size)) * 6.0f;
+			std::uniform_real_distribution<float> coord(0.0f, extent);
+			std::vector<glm::vec3> positions(size);
+			for (auto& position : positions)
+				position = glm::vec3(coord(rng), 0.0f, coord(rng));
+
+			SpatialHash hash;
+			int neighbours[maxNeighbours];
+			size_t found = 0;
+
+			auto start = Clock::now();
+			for (int t = 0; t < ticks; t++)
+			{
+				hash.Build(positions);
+				for (int i = 0; i < size; i++)
+					found += hash.Query(positions[i], radius, i, neighbours, maxNeighbours);
+			}
+			const double hashTime = MillisecondsSince(start) / ticks;
+
+			start = Clock::now();
+			for (int t = 0; t < ticks; t++)
+			{
+				for (int i = 0; i < size; i++)
+				{
+					int count = 0;
+					for (int j = 0; j < size && count < maxNeighbours; j++)
+					{
+						const glm::vec3 offset = positions[j] - positions[i];
+						if (j != i && offset.x * offset.x + offset.z * offset.z <= radius * radius)
+							neighbours[count++] = j;
+					}
+					found += count;
+				}
+			}
+			const double bruteTime = MillisecondsSince(start) / ticks;
+
+			std::cout << std::fixed << std::setprecision(3)
+				<< "[ENIGMA BENCHMARK]: crowd of " << size << ": spatial hash " << hashTime << " ms/tick, brute force "
+				<< bruteTime << " ms/tick (" << found << " neighbours found)" << std::endl;
+		}
+	}
+
+	void AITick()
+	{
+		const int gridSize = 256;
+		const int agentCount = 1000;
+		const int ticks = 10;
+		const unsigned threadCounts[] = { 1, 2, 4, 8, 16 };
+
+		Navmesh mesh;
+		NavHierarchy hierarchy;
+		GenerateGrid(mesh, gridSize, 0.2f, 1234u);
+		hierarchy.Build(mesh, 16.0f);
+
+		// agents start on random open cells and chase a target which moves across the map every tick,
+		// so most of them replan on most ticks
+		std::vector<glm::vec3> spawns;
+		std::mt19937 rng(99u);
+		std::uniform_int_distribution<int> cell(0, gridSize - 1);
+		while (spawns.size() < agentCount)
+		{
+			const glm::vec3 spawn = glm::vec3(cell(rng) + 0.5f, 0.0f, cell(rng) + 0.5f);
+			if (mesh.Contains(hierarchy.FindPolygon(spawn), spawn))
+				spawns.push_back(spawn);
+		}
+
+		double baseline = 0.0;
+		std::vector<glm::vec3> baselinePositions;
+
+		for (unsigned threads : threadCounts)
+		{
+			JobSystem jobs;
+			jobs.Start(threads - 1);
+
+			std::vector<NavAgent> agents(agentCount, NavAgent(mesh, hierarchy));
+			std::vector<glm::vec3> positions = spawns;
+			std::vector<glm::vec3> velocities(agentCount);
+			SpatialHash crowd;
+
+			const auto start = Clock::now();
+			for (int t = 0; t < ticks; t++)
+			{
+				const glm::vec3 target = glm::vec3(gridSize * 0.5f, 0.0f, 8.0f + t * 7.0f);
+
+				// snapshot
+				crowd.Build(positions);
+
+				// plan
+				jobs.ParallelFor(agentCount, 4, [&](int begin, int end) {
+					for (int i = begin; i < end; i++)
+						agents[i].Plan(positions[i], target);
+				});
+
+				// steer
+				jobs.ParallelFor(agentCount, 16, [&](int begin, int end) {
+					for (int i = begin; i < end; i++)
+						velocities[i] = agents[i].Steer(positions[i], crowd, i);
+				});
+
+				// apply
+				for (int i = 0; i < agentCount; i++)
+					positions[i] += velocities[i] * 0.2f;
+			}
+			const double tickTime = MillisecondsSince(start) / ticks;
+
+			// every thread count has to land the agents in exactly the same place
+			bool deterministic = true;
+			if (baselinePositions.empty())
+			{
+				baseline = tickTime;
+				baselinePositions = positions;
+			}
+			else
+			{
+				deterministic = positions == baselinePositions;
+			}
+
+			std::cout << std::fixed << std::setprecision(3)
+				<< "[ENIGMA BENCHMARK]: AI tick, " << agentCount << " agents, " << threads << " thread(s): "
+				<< tickTime << " ms/tick, " << baseline / tickTime << "x" << (deterministic ? "" : " RESULTS DIFFER") << std::endl;
+		}
+	}
+
+	void Hitscan()
+	{
+		const int terrainSizes[] = { 64, 256 };
+		const int rayCount = 20000;
+		const int bruteForceRays = 200;
+
+		for (int size : terrainSizes)
+		{
+			std::vector<Vertex> vertices;
+			std::vector<uint32_t> indices;
+			GenerateTerrain(size, vertices, indices);
+
+			TriangleBVH bvh;
+			auto start = Clock::now();
+			bvh.Build(vertices, indices);
+			const double buildTime = MillisecondsSince(start);
+
+			// shots from above the terrain at random targets on it, like aiming at the ground from head height
+			std::mt19937 rng(99u);
+			std::uniform_real_distribution<float> coord(0.0f, static_cast<float>(size));
+			std::vector<glm::vec3> origins(rayCount);
+			std::vector<glm::vec3> directions(rayCount);
+			for (int i = 0; i < rayCount; i++)
+			{
+				origins[i] = glm::vec3(coord(rng), 20.0f, coord(rng));
+				directions[i] = glm::normalize(glm::vec3(coord(rng), 0.0f, coord(rng)) - origins[i]);
+			}
+
+			int hits = 0;
+			start = Clock::now();
+			for (int i = 0; i < rayCount; i++)
+			{
+				TriangleHit hit;
+				hits += bvh.Raycast(origins[i], directions[i], 1000.0f, hit) ? 1 : 0;
+			}
+			const double bvhTime = MillisecondsSince(start) * 1000.0 / rayCount;
+
+			int mismatches = 0;
+			start = Clock::now();
+			for (int i = 0; i < bruteForceRays; i++)
+			{
+				float expected;
+				const bool bruteHit = BruteForceRaycast(vertices, indices, origins[i], directions[i], 1000.0f, expected);
+				TriangleHit hit;
+				const bool bvhHit = bvh.Raycast(origins[i], directions[i], 1000.0f, hit);
+				if (bruteHit != bvhHit || (bruteHit && std::abs(hit.t - expected) > 1e-3f * expected))
+					mismatches++;
+			}
+			const double bruteTime = MillisecondsSince(start) * 1000.0 / bruteForceRays;
+
+			// rays straight down through shared vertices and edges, a watertight test never lets one slip through
+			int leaks = 0;
+			int edgeRays = 0;
+			for (int z = 1; z < size; z += 3)
+			{
+				for (int x = 1; x < size; x += 3)
+				{
+					const glm::vec3 points[] = {
+						glm::vec3(static_cast<float>(x), 20.0f, static_cast<float>(z)),
+						glm::vec3(x + 0.5f, 20.0f, static_cast<float>(z)),
+						glm::vec3(x + 0.5f, 20.0f, z + 0.5f)
+					};
+					for (const auto& point : points)
+					{
+						TriangleHit hit;
+						leaks += bvh.Raycast(point, glm::vec3(0.0f, -1.0f, 0.0f), 1000.0f, hit) ? 0 : 1;
+						edgeRays++;
+					}
+				}
+			}
+
+			std::cout << std::fixed << std::setprecision(3)
+				<< "[ENIGMA BENCHMARK]: hitscan on " << bvh.GetTriangleCount() << " triangles, build " << buildTime << " ms\n"
+				<< "    triangle BVH " << bvhTime << " us/ray (" << hits << "/" << rayCount << " hit)\n"
+				<< "    brute force  " << bruteTime << " us/ray, " << mismatches << " of " << bruteForceRays << " rays disagree\n"
+				<< "    " << leaks << " of " << edgeRays << " rays through shared vertices and edges leaked" << std::endl;
+		}
+	}
+
+	void RayBoxes()
+	{
+		const int boxCount = 4096;
+		const int rayCount = 2000;
+
+		// obstacle sized boxes scattered over a level, rays between random points like line of sight checks
+		std::mt19937 rng(5u);
+		std::uniform_real_distribution<float> coord(-500.0f, 500.0f);
+		std::uniform_real_distribution<float> size(1.0f, 20.0f);
+		std::vector<AABB> boxes(boxCount);
+		BoxBatch batch;
+		for (auto& box : boxes)
+		{
+			box.min = glm::vec3(coord(rng), 0.0f, coord(rng));
+			box.max = box.min + glm::vec3(size(rng), size(rng), size(rng));
+			batch.Add(box);
+		}
+
+		std::vector<Physics::Ray> rays(rayCount);
+		for (auto& ray : rays)
+		{
+			ray.origin = glm::vec3(coord(rng), 5.0f, coord(rng));
+			ray.direction = glm::normalize(glm::vec3(coord(rng), 5.0f, coord(rng)) - ray.origin);
+		}
+
+		// one box at a time with the branches and divides of the existing test
+		size_t referenceHits = 0;
+		auto start = Clock::now();
+		for (const auto& ray : rays)
+		{
+			for (const auto& box : boxes)
+				referenceHits += Physics::RayIntersectAABB(ray, box) ? 1 : 0;
+		}
+		const double referenceTime = MillisecondsSince(start);
+
+		std::cout << std::fixed << std::setprecision(3)
+			<< "[ENIGMA BENCHMARK]: " << rayCount << " rays against " << boxCount << " boxes\n"
+			<< "    one box at a time " << referenceTime << " ms, " << (static_cast<double>(rayCount) * boxCount) / (referenceTime * 1000.0)
+			<< " Mboxes/s" << std::endl;
+
+		std::vector<uint8_t> hits(boxCount);
+		const SIMDPath paths[] = { SIMDPath::Scalar, SIMDPath::SSE, SIMDPath::AVX2 };
+		for (SIMDPath path : paths)
+		{
+			if (static_cast<int>(path) > static_cast<int>(BestSIMDPath()))
+				continue;
+
+			size_t batchHits = 0;
+			start = Clock::now();
+			for (const auto& ray : rays)
+				batchHits += RayBoxes(batch, ray.origin, InverseDirection(ray.direction), FLT_MAX, hits.data(), path);
+			const double batchTime = MillisecondsSince(start);
+
+			std::cout << "    batch " << std::setw(6) << GetSIMDPathName(path) << "      " << batchTime << " ms, "
+				<< (static_cast<double>(rayCount) * boxCount) / (batchTime * 1000.0) << " Mboxes/s, "
+				<< referenceTime / batchTime << "x" << (batchHits == referenceHits ? "" : " HITS DIFFER") << std::endl;
+		}
+	}
+
+	void Broadphase()
+	{
+		const int enemyCount = 300;
+		const int projectileCount = 500;
+		const int staticCount = 50;
+		const int frameCount = 120;
+		const float halfSize = 400.0f;
+
+		struct Body
+		{
+			glm::vec3 position;
+			glm::vec3 velocity;
+			glm::vec3 extent;
+			uint32_t layer;
+			uint32_t mask;
+		};
+
+		// enemies walk slowly, projectiles cross the level in a couple of seconds, obstacles stand still
+		std::mt19937 rng(9u);
+		std::uniform_real_distribution<float> coord(-halfSize, halfSize);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		std::vector<Body> bodies;
+		for (int i = 0; i < enemyCount; i++)
+			bodies.push_back({ glm::vec3(coord(rng), 2.5f, coord(rng)), glm::vec3(unit(rng), 0.0f, unit(rng)) * 0.2f, glm::vec3(1.5f, 2.5f, 1.5f),
+				COLLISION_ENEMY, COLLISION_PLAYER | COLLISION_PROJECTILE | COLLISION_STATIC });
+		for (int i = 0; i < projectileCount; i++)
+			bodies.push_back({ glm::vec3(coord(rng), 2.5f, coord(rng)), glm::normalize(glm::vec3(unit(rng), 0.0f, unit(rng))) * 4.0f, glm::vec3(0.2f),
+				COLLISION_PROJECTILE, COLLISION_ENEMY | COLLISION_STATIC });
+		for (int i = 0; i < staticCount; i++)
+			bodies.push_back({ glm::vec3(coord(rng), 5.0f, coord(rng)), glm::vec3(0.0f), glm::vec3(10.0f, 5.0f, 10.0f),
+				COLLISION_STATIC, COLLISION_ENEMY | COLLISION_PROJECTILE });
+
+		auto bounds = [](const Body& body) { return AABB{ body.position - body.extent, body.position + body.extent }; };
+		auto step = [&](std::vector<Body>& moving) {
+			for (auto& body : moving)
+			{
+				body.position += body.velocity;
+				// wrap around so the density stays the same for every frame
+				for (int axis : { 0, 2 })
+				{
+					if (body.position[axis] > halfSize)
+						body.position[axis] -= 2.0f * halfSize;
+					else if (body.position[axis] < -halfSize)
+						body.position[axis] += 2.0f * halfSize;
+				}
+			}
+		};
+
+		// every pair tested every frame
+		std::vector<Body> reference = bodies;
+		std::vector<size_t> referencePairs;
+		auto start = Clock::now();
+		for (int frame = 0; frame < frameCount; frame++)
+		{
+			step(reference);
+			size_t pairCount = 0;
+			for (size_t a = 0; a < reference.size(); a++)
+			{
+				const AABB boxA = bounds(reference[a]);
+				for (size_t b = a + 1; b < reference.size(); b++)
+				{
+					if (!(reference[a].layer & reference[b].mask) || !(reference[b].layer & reference[a].mask))
+						continue;
+					const AABB boxB = bounds(reference[b]);
+					if (glm::all(glm::lessThanEqual(boxA.min, boxB.max)) && glm::all(glm::lessThanEqual(boxB.min, boxA.max)))
+						pairCount++;
+				}
+			}
+			referencePairs.push_back(pairCount);
+		}
+		const double referenceTime = MillisecondsSince(start);
+
+		SweepAndPrune sap;
+		std::vector<int> proxies;
+		for (int i = 0; i < static_cast<int>(bodies.size()); i++)
+			proxies.push_back(sap.Add(bounds(bodies[i]), bodies[i].layer, bodies[i].mask, i));
+
+		size_t mismatches = 0;
+		size_t totalPairs = 0;
+		size_t totalSwaps = 0;
+		start = Clock::now();
+		for (int frame = 0; frame < frameCount; frame++)
+		{
+			step(bodies);
+			for (int i = 0; i < static_cast<int>(bodies.size()); i++)
+				sap.Update(proxies[i], bounds(bodies[i]));
+			const size_t pairCount = sap.FindPairs().size();
+			totalPairs += pairCount;
+			totalSwaps += sap.GetLastSwapCount();
+			mismatches += pairCount != referencePairs[frame] ? 1 : 0;
+		}
+		const double sapTime = MillisecondsSince(start);
+
+		std::cout << std::fixed << std::setprecision(3)
+			<< "[ENIGMA BENCHMARK]: " << enemyCount << " enemies, " << projectileCount << " projectiles, " << staticCount << " obstacles, " << frameCount << " frames\n"
+			<< "    all pairs       " << referenceTime / frameCount << " ms/frame\n"
+			<< "    sweep and prune " << sapTime / frameCount << " ms/frame, " << referenceTime / sapTime << "x, "
+			<< totalPairs / frameCount << " pairs/frame, " << totalSwaps / frameCount << " swaps/frame, "
+			<< mismatches << " frames with different pairs" << std::endl;
+	}
+
+	bool Run(const std::string& name)
+	{
+		if (name == "pathfinding")
+			Pathfinding();
+		else if (name == "crowd")
+			Crowd();
+		else if (name == "ai")
+			AITick();
+		else if (name == "hitscan")
+			Hitscan();
+		else if (name == "raybox")
+			RayBoxes();
+		else if (name == "broadphase")
+			Broadphase();
+		else
+			return false;
+		return true;
+	}
+}
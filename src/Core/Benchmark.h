@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+
+// Standalone benchmarks which run without a window or Vulkan device.
+// Started from the command line e.g. "Enigma.exe --bench pathfinding"
+namespace Enigma::Benchmark
+{
+	// Flat A* against HPA* for long routes on generated grid navmeshes
+	void Pathfinding();
+
+	// Spatial hash rebuild and neighbour queries against a brute force search for large crowds
+	void Crowd();
+
+	// Phased AI tick (snapshot, plan, steer, apply) over the job system with 1 to 16 threads
+	void AITick();
+
+	// Triangle BVH raycasts against brute force on generated terrain, plus rays through shared edges
+	void Hitscan();
+
+	// Batched SoA ray/box slab test on every SIMD path against testing one box at a time
+	void RayBoxes();
+
+	// Sweep and prune pair finding for moving enemies and projectiles against testing every pair
+	void Broadphase();
+
+	// Runs the benchmark with the given name, returns false if there is no benchmark with that name
+	bool Run(const std::string& name);
+}
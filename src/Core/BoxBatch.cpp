@@ -0,0 +1,270 @@
+#include "BoxBatch.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+#define ENIGMA_BOX_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+// MSVC compiles AVX intrinsics in any function, the path is only taken when the CPU supports it
+#define ENIGMA_TARGET_AVX2
+#else
+#define ENIGMA_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ENIGMA_BOX_SSE 1
+#endif
+
+namespace Enigma
+{
+	namespace
+	{
+		constexpr int GroupWidth = 8;
+
+		bool CpuHasAVX2()
+		{
+#if defined(ENIGMA_BOX_X86) && defined(_MSC_VER)
+			int info[4];
+			__cpuid(info, 0);
+			if (info[0] < 7)
+				return false;
+
+			__cpuid(info, 1);
+			const bool osxsave = (info[2] & (1 << 27)) != 0;
+			__cpuidex(info, 7, 0);
+			const bool avx2 = (info[1] & (1 << 5)) != 0;
+			// the OS also has to save the upper halves of the registers on a context switch
+			return osxsave && avx2 && (_xgetbv(0) & 6) == 6;
+#elif defined(ENIGMA_BOX_X86)
+			return __builtin_cpu_supports("avx2");
+#else
+			return false;
+#endif
+		}
+
+		// Byte per lane for every 8 bit hit mask, lets a whole group of results be written with one copy
+		const std::array<uint64_t, 256>& MaskBytes()
+		{
+			static const std::array<uint64_t, 256> table = [] {
+				std::array<uint64_t, 256> bytes{};
+				for (int mask = 0; mask < 256; mask++)
+					for (int lane = 0; lane < GroupWidth; lane++)
+						if (mask & (1 << lane))
+							bytes[mask] |= uint64_t(1) << (lane * 8);
+				return bytes;
+			}();
+			return table;
+		}
+
+		int WriteHits(uint32_t mask, int first, int count, uint8_t* hits)
+		{
+			const uint64_t bytes = MaskBytes()[mask];
+			if (count == GroupWidth)
+				std::memcpy(hits + first, &bytes, sizeof(bytes));
+			else
+				std::memcpy(hits + first, &bytes, count);
+
+			int hitCount = 0;
+			for (; mask; mask &= mask - 1)
+				hitCount++;
+			return hitCount;
+		}
+
+		uint32_t RayBoxesScalar(const BoxBatch& boxes, int first, int count, const glm::vec3& origin, const glm::vec3& invDirection, float maxDistance, float* tEntry)
+		{
+			uint32_t mask = 0;
+			for (int i = 0; i < count; i++)
+			{
+				float tNear = 0.0f;
+				float tFar = maxDistance;
+				for (int axis = 0; axis < 3; axis++)
+				{
+					const float t0 = (boxes.min[axis][first + i] - origin[axis]) * invDirection[axis];
+					const float t1 = (boxes.max[axis][first + i] - origin[axis]) * invDirection[axis];
+					tNear = std::max(tNear, std::min(t0, t1));
+					tFar = std::min(tFar, std::max(t0, t1));
+				}
+				tEntry[i] = tNear;
+				if (tNear <= tFar)
+					mask |= 1u << i;
+			}
+			return mask;
+		}
+
+#if defined(ENIGMA_BOX_SSE)
+		uint32_t RayBoxesSSE(const BoxBatch& boxes, int first, const glm::vec3& origin, const glm::vec3& invDirection, float maxDistance, float* tEntry)
+		{
+			uint32_t mask = 0;
+			// two groups of four make up the eight boxes
+			for (int half = 0; half < 2; half++)
+			{
+				const int offset = first + half * 4;
+				__m128 tNear = _mm_setzero_ps();
+				__m128 tFar = _mm_set1_ps(maxDistance);
+				for (int axis = 0; axis < 3; axis++)
+				{
+					const __m128 o = _mm_set1_ps(origin[axis]);
+					const __m128 inverse = _mm_set1_ps(invDirection[axis]);
+					const __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&boxes.min[axis][offset]), o), inverse);
+					const __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&boxes.max[axis][offset]), o), inverse);
+					tNear = _mm_max_ps(tNear, _mm_min_ps(t0, t1));
+					tFar = _mm_min_ps(tFar, _mm_max_ps(t0, t1));
+				}
+				_mm_storeu_ps(tEntry + half * 4, tNear);
+				mask |= static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(tNear, tFar))) << (half * 4);
+			}
+			return mask;
+		}
+#endif
+
+#if defined(ENIGMA_BOX_X86)
+		ENIGMA_TARGET_AVX2 uint32_t RayBoxesAVX2(const BoxBatch& boxes, int first, const glm::vec3& origin, const glm::vec3& invDirection, float maxDistance, float* tEntry)
+		{
+			__m256 tNear = _mm256_setzero_ps();
+			__m256 tFar = _mm256_set1_ps(maxDistance);
+			for (int axis = 0; axis < 3; axis++)
+			{
+				const __m256 o = _mm256_set1_ps(origin[axis]);
+				const __m256 inverse = _mm256_set1_ps(invDirection[axis]);
+				const __m256 t0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(&boxes.min[axis][first]), o), inverse);
+				const __m256 t1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(&boxes.max[axis][first]), o), inverse);
+				tNear = _mm256_max_ps(tNear, _mm256_min_ps(t0, t1));
+				tFar = _mm256_min_ps(tFar, _mm256_max_ps(t0, t1));
+			}
+			_mm256_storeu_ps(tEntry, tNear);
+			return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(tNear, tFar, _CMP_LE_OQ)));
+		}
+
+		// the whole batch in one function so the ray stays in registers across every group
+		ENIGMA_TARGET_AVX2 int RayBoxesAllAVX2(const BoxBatch& boxes, const glm::vec3& origin, const glm::vec3& invDirection, float maxDistance, uint8_t* hits)
+		{
+			__m256 o[3];
+			__m256 inverse[3];
+			for (int axis = 0; axis < 3; axis++)
+			{
+				o[axis] = _mm256_set1_ps(origin[axis]);
+				inverse[axis] = _mm256_set1_ps(invDirection[axis]);
+			}
+			const __m256 farLimit = _mm256_set1_ps(maxDistance);
+
+			int hitCount = 0;
+			for (int first = 0; first < boxes.Size(); first += GroupWidth)
+			{
+				__m256 tNear = _mm256_setzero_ps();
+				__m256 tFar = farLimit;
+				for (int axis = 0; axis < 3; axis++)
+				{
+					const __m256 t0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(&boxes.min[axis][first]), o[axis]), inverse[axis]);
+					const __m256 t1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(&boxes.max[axis][first]), o[axis]), inverse[axis]);
+					tNear = _mm256_max_ps(tNear, _mm256_min_ps(t0, t1));
+					tFar = _mm256_min_ps(tFar, _mm256_max_ps(t0, t1));
+				}
+				const int count = std::min(GroupWidth, boxes.Size() - first);
+				const uint32_t mask = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(tNear, tFar, _CMP_LE_OQ))) & ((1u << count) - 1u);
+				hitCount += WriteHits(mask, first, count, hits);
+			}
+			return hitCount;
+		}
+#endif
+	}
+
+	SIMDPath BestSIMDPath()
+	{
+		static const SIMDPath best = [] {
+			if (CpuHasAVX2())
+				return SIMDPath::AVX2;
+#if defined(ENIGMA_BOX_SSE)
+			return SIMDPath::SSE;
+#else
+			return SIMDPath::Scalar;
+#endif
+		}();
+		return best;
+	}
+
+	const char* GetSIMDPathName(SIMDPath path)
+	{
+		switch (path)
+		{
+		case SIMDPath::AVX2: return "AVX2";
+		case SIMDPath::SSE: return "SSE";
+		default: return "scalar";
+		}
+	}
+
+	void BoxBatch::Clear()
+	{
+		Resize(0);
+	}
+
+	void BoxBatch::Resize(int newCount)
+	{
+		count = newCount;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			min[axis].resize(count + GroupWidth, 0.0f);
+			max[axis].resize(count + GroupWidth, 0.0f);
+		}
+	}
+
+	void BoxBatch::Add(const AABB& box)
+	{
+		Resize(count + 1);
+		Set(count - 1, box);
+	}
+
+	void BoxBatch::Set(int index, const AABB& box)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			min[axis][index] = box.min[axis];
+			max[axis][index] = box.max[axis];
+		}
+	}
+
+	AABB BoxBatch::Get(int index) const
+	{
+		return { glm::vec3(min[0][index], min[1][index], min[2][index]), glm::vec3(max[0][index], max[1][index], max[2][index]) };
+	}
+
+	uint32_t RayBoxes8(const BoxBatch& boxes, int first, int count, const glm::vec3& origin, const glm::vec3& invDirection, float maxDistance, float* tEntry, SIMDPath path)
+	{
+		// lanes past count read the padding or the next boxes, their bits are dropped
+		const uint32_t valid = (1u << count) - 1u;
+		switch (path)
+		{
+#if defined(ENIGMA_BOX_X86)
+		case SIMDPath::AVX2:
+			return RayBoxesAVX2(boxes, first, origin, invDirection, maxDistance, tEntry) & valid;
+#endif
+#if defined(ENIGMA_BOX_SSE)
+		case SIMDPath::SSE:
+			return RayBoxesSSE(boxes, first, origin, invDirection, maxDistance, tEntry) & valid;
+#endif
+		default:
+			return RayBoxesScalar(boxes, first, count, origin, invDirection, maxDistance, tEntry);
+		}
+	}
+
+	int RayBoxes(const BoxBatch& boxes, const glm::vec3& origin, const glm::vec3& invDirection, float maxDistance, uint8_t* hits, SIMDPath path)
+	{
+#if defined(ENIGMA_BOX_X86)
+		if (path == SIMDPath::AVX2)
+			return RayBoxesAllAVX2(boxes, origin, invDirection, maxDistance, hits);
+#endif
+
+		int hitCount = 0;
+		float tEntry[GroupWidth];
+		for (int first = 0; first < boxes.Size(); first += GroupWidth)
+		{
+			const int count = std::min(GroupWidth, boxes.Size() - first);
+			const uint32_t mask = RayBoxes8(boxes, first, count, origin, invDirection, maxDistance, tEntry, path);
+			hitCount += WriteHits(mask, first, count, hits);
+		}
+		return hitCount;
+	}
+}
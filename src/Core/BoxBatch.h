@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "../Graphics/Model.h"
+
+namespace Enigma
+{
+	enum class SIMDPath
+	{
+		Scalar,
+		SSE,
+		AVX2
+	};
+
+	// Widest path the CPU running the engine supports, checked once
+	SIMDPath BestSIMDPath();
+	const char* GetSIMDPathName(SIMDPath path);
+
+	// Boxes stored one component per array so eight of them load into a register at once. The arrays are padded past
+	// the last box so a group of eight can always be loaded. Padding lanes hold zero size boxes at the origin, or older
+	// boxes after a shrink, and a ray can hit them. Only the valid mask of RayBoxes8 and RayBoxes drops their bits
+	class BoxBatch
+	{
+	public:
+		void Clear();
+		void Resize(int count);
+		void Add(const AABB& box);
+		void Set(int index, const AABB& box);
+		AABB Get(int index) const;
+		int Size() const { return count; }
+
+		// component arrays, [0] = x, [1] = y, [2] = z
+		std::vector<float> min[3];
+		std::vector<float> max[3];
+
+	private:
+		int count = 0;
+	};
+
+	// Slab test of one ray against boxes [first, first + count), count at most 8. Returns a bit per box the ray enters
+	// before maxDistance and writes where it enters to tEntry[i - first], tEntry has to hold 8 floats.
+	// invDirection comes from InverseDirection
+	uint32_t RayBoxes8(const BoxBatch& boxes, int first, int count, const glm::vec3& origin, const glm::vec3& invDirection,
+		float maxDistance, float* tEntry, SIMDPath path = BestSIMDPath());
+
+	// Every box in the batch, hits[i] is set to 1 for boxes the ray enters and 0 otherwise. Returns the number hit
+	int RayBoxes(const BoxBatch& boxes, const glm::vec3& origin, const glm::vec3& invDirection, float maxDistance,
+		uint8_t* hits, SIMDPath path = BestSIMDPath());
+}
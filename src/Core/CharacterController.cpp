@@ -0,0 +1,103 @@
+#include "CharacterController.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace Enigma
+{
+	namespace
+	{
+		// Sweeps a point along displacement against an obstacle grown by the character's box. Returns the fraction of
+		// the move made before touching it and the face that was hit, obstacles the point starts inside are ignored
+		// so a character that is already overlapping something can always move out of it
+		bool SweepPoint(const glm::vec3& position, const glm::vec3& displacement, const AABB& obstacle, float& fraction, glm::vec3& normal)
+		{
+			float tEnter = -FLT_MAX;
+			float tExit = FLT_MAX;
+			int enterAxis = -1;
+
+			for (int axis = 0; axis < 3; axis++)
+			{
+				if (displacement[axis] == 0.0f)
+				{
+					// not moving on this axis, it only blocks if the point is already between the faces
+					if (position[axis] <= obstacle.min[axis] || position[axis] >= obstacle.max[axis])
+						return false;
+					continue;
+				}
+
+				const float inverse = 1.0f / displacement[axis];
+				float t0 = (obstacle.min[axis] - position[axis]) * inverse;
+				float t1 = (obstacle.max[axis] - position[axis]) * inverse;
+				if (t0 > t1)
+					std::swap(t0, t1);
+
+				if (t0 > tEnter)
+				{
+					tEnter = t0;
+					enterAxis = axis;
+				}
+				tExit = std::min(tExit, t1);
+			}
+
+			if (enterAxis == -1 || tEnter < 0.0f || tEnter > 1.0f || tEnter >= tExit)
+				return false;
+
+			fraction = tEnter;
+			normal = glm::vec3(0.0f);
+			normal[enterAxis] = displacement[enterAxis] > 0.0f ? -1.0f : 1.0f;
+			return true;
+		}
+	}
+
+	glm::vec3 CharacterController::Move(const BVH& collision, const AABB& box, const glm::vec3& position, const glm::vec3& displacement, uint32_t mask)
+	{
+		glm::vec3 current = position;
+		glm::vec3 remaining = displacement;
+
+		for (int iteration = 0; iteration < maxIterations; iteration++)
+		{
+			if (glm::dot(remaining, remaining) < 1e-10f)
+				break;
+
+			// only the boxes the swept character could touch, so the cost depends on what is nearby rather than
+			// on the size of the level
+			const glm::vec3 target = current + remaining;
+			const AABB sweep = { glm::min(current, target) + box.min, glm::max(current, target) + box.max };
+			contacts.clear();
+			collision.Overlap(sweep, mask, contacts);
+
+			float closest = 1.0f;
+			glm::vec3 closestNormal = glm::vec3(0.0f);
+			bool blocked = false;
+			for (const auto& contact : contacts)
+			{
+				// grow the obstacle by the character's box so the character can be swept as a point
+				const AABB& bounds = collision.GetPrimitives()[contact.primitive].bounds;
+				const AABB grown = { bounds.min - box.max, bounds.max - box.min };
+
+				float fraction;
+				glm::vec3 normal;
+				if (SweepPoint(current, remaining, grown, fraction, normal) && fraction < closest)
+				{
+					closest = fraction;
+					closestNormal = normal;
+					blocked = true;
+				}
+			}
+
+			if (!blocked)
+			{
+				current = target;
+				break;
+			}
+
+			// stop at the surface, then slide whatever is left of the move along it
+			current += remaining * closest + closestNormal * skin;
+			remaining *= (1.0f - closest);
+			remaining -= closestNormal * glm::dot(remaining, closestNormal);
+		}
+
+		return current;
+	}
+}
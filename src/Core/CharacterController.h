@@ -0,0 +1,26 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "BVH.h"
+
+namespace Enigma
+{
+	// Moves a box through the level without passing through anything. The move is swept against the boxes the
+	// collision BVH finds around it, on contact the box stops at the surface and the rest of the move slides along it
+	class CharacterController
+	{
+	public:
+		// @box - bounds of the character relative to its position
+		// Returns where the character ends up after trying to move by displacement
+		glm::vec3 Move(const BVH& collision, const AABB& box, const glm::vec3& position, const glm::vec3& displacement, uint32_t mask = COLLISION_STATIC);
+
+		// Each contact uses up one iteration, a corner takes two so this leaves room for a third surface
+		int maxIterations = 4;
+		// Distance kept from a surface so the next sweep doesn't start touching it
+		float skin = 0.01f;
+
+	private:
+		std::vector<BVHHit> contacts;
+	};
+}
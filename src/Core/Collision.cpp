@@ -2,16 +2,16 @@
 #include "Collision.h"
 
 namespace Enigma {
-    bool CollisionDetector::CheckCollision(Model& character, std::vector<Model>& environment) {
-        for (auto& object : environment) {
-            if (AABBvsAABB(character, object)) {
+    bool CollisionDetector::CheckCollision(const Model& character, const std::vector<Model*>& environment) {
+        for (const Model* object : environment) {
+            if (AABBvsAABB(character, *object)) {
                 return true; // ײ
             }
         }
         return false; // δײ
     }
 
-    bool CollisionDetector::AABBvsAABB(Model& obj1, Model& obj2) {
+    bool CollisionDetector::AABBvsAABB(const Model& obj1, const Model& obj2) {
         // ModelзȡAABBС(min)(max)
         auto obj1Min = obj1.GetAABBMin();
         auto obj1Max = obj1.GetAABBMax();
@@ -25,15 +25,15 @@ namespace Enigma {
     class CollisionDetector {
     public:
         // ɫ뻷֮ײ
-        static bool CheckCollision(Model& character, std::vector<Model>& environment);
+        static bool CheckCollision(const Model& character, const std::vector<Model*>& environment);
         // ӵɫײ
-        static bool CheckBulletCollision(Model& bullet, Model& character) {
+        static bool CheckBulletCollision(const Model& bullet, const Model& character) {
             return AABBvsAABB(bullet, character);
         };
         collisionData RayIntersectsAABB(const Ray& ray, const AABB& aabb);
 
     private:
         // AABB֮ײ
-        static bool AABBvsAABB(Model& obj1, Model& obj2);
+        static bool AABBvsAABB(const Model& obj1, const Model& obj2);
     };
 }
\ No newline at end of file
@@ -0,0 +1,68 @@
+#include "FrameSnapshot.h"
+#include <algorithm>
+#include <glm/gtc/matrix_transform.hpp>
+
+namespace Enigma
+{
+	glm::mat4 FrameSnapshot::GetTransform(Model* model) const
+	{
+		if (model->snapshotIndex == -1 || model->snapshotIndex >= static_cast<int>(models.size()))
+			return model->GetModelMatrix();
+
+		// only translation is blended, headings snap when they change and a blended rotation matrix would shear
+		const ModelSnapshot& pose = models[model->snapshotIndex];
+		glm::mat4 transform = pose.current;
+		transform[3] = glm::mix(pose.previous[3], pose.current[3], alpha);
+		return transform;
+	}
+
+	glm::mat4 FrameSnapshot::GetOffset(const Model* model) const
+	{
+		const ModelSnapshot& pose = models[model->snapshotIndex];
+		return glm::translate(glm::mat4(1.0f), (glm::vec3(pose.previous[3]) - glm::vec3(pose.current[3])) * (1.0f - alpha));
+	}
+
+	glm::vec3 FrameSnapshot::GetPlayerPosition() const
+	{
+		return glm::mix(playerPrevious, playerPosition, alpha);
+	}
+
+	bool FrameSnapshot::IsSkinned(const Model* model) const
+	{
+		if (model->m_animations.empty() || model->snapshotIndex == -1 || model->snapshotIndex >= static_cast<int>(models.size()))
+			return false;
+		const ModelSnapshot& pose = models[model->snapshotIndex];
+		return !pose.dead && !pose.palette.empty();
+	}
+
+	void SnapshotBuffer::Publish()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		// the renderer never saw the last one, keep its one-off events so they aren't lost
+		FrameSnapshot& skipped = slots[readySlot];
+		if (fresh)
+			slots[writeSlot].impacts.insert(slots[writeSlot].impacts.begin(), skipped.impacts.begin(), skipped.impacts.end());
+
+		std::swap(writeSlot, readySlot);
+		fresh = true;
+
+		// the copy handed back for writing still holds models from an older tick, they are overwritten next tick
+		slots[writeSlot].impacts.clear();
+	}
+
+	FrameSnapshot& SnapshotBuffer::Acquire(double now)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (fresh)
+			{
+				std::swap(readSlot, readySlot);
+				fresh = false;
+			}
+		}
+
+		FrameSnapshot& snapshot = slots[readSlot];
+		snapshot.alpha = static_cast<float>(std::clamp((now - snapshot.time) / snapshot.step, 0.0, 1.0));
+		return snapshot;
+	}
+}
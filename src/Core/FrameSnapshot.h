@@ -0,0 +1,72 @@
+#pragma once
+
+#include <array>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "../Graphics/Model.h"
+
+namespace Enigma
+{
+	// Pose of one model the simulation moves, copied out at the end of a tick so the renderer never reads the model
+	struct ModelSnapshot
+	{
+		// model matrix at the start of the last tick and at its end
+		glm::mat4 previous = glm::mat4(1.0f);
+		glm::mat4 current = glm::mat4(1.0f);
+		bool dead = false;
+		// skinned models only, node global matrices indexed by Node::index and the bone palette
+		std::vector<glm::mat4> nodeMatrices;
+		std::vector<glm::mat4> palette;
+	};
+
+	// Everything the render thread needs from one simulation step
+	struct FrameSnapshot
+	{
+		// indexed by Model::snapshotIndex
+		std::vector<ModelSnapshot> models;
+		glm::vec3 playerPrevious = glm::vec3(0.0f);
+		glm::vec3 playerPosition = glm::vec3(0.0f);
+		// where shots landed since the last snapshot the renderer took
+		std::vector<glm::vec3> impacts;
+
+		// time the snapshot was published and the length of a tick, the renderer blends between previous and
+		// current by how far into the next tick it is
+		double time = 0.0;
+		double step = 1.0 / 60.0;
+		float alpha = 1.0f;
+		uint64_t tick = 0;
+
+		// Transform to draw the model with, models the simulation doesn't move are read directly
+		glm::mat4 GetTransform(Model* model) const;
+		// Translation added on top of a skinned model's node matrices
+		glm::mat4 GetOffset(const Model* model) const;
+		glm::vec3 GetPlayerPosition() const;
+		// True if the model should go through the skinned pipeline
+		bool IsSkinned(const Model* model) const;
+		const ModelSnapshot& Get(const Model* model) const { return models[model->snapshotIndex]; }
+	};
+
+	// Hands snapshots from the simulation thread to the render thread. The simulation writes one copy while the
+	// renderer reads another, a third holds the newest finished snapshot so neither side waits for the other
+	class SnapshotBuffer
+	{
+	public:
+		// Simulation thread: the copy to fill, stays the same until Publish
+		FrameSnapshot& BeginWrite() { return slots[writeSlot]; }
+		// Simulation thread: makes the written copy the newest one
+		void Publish();
+
+		// Render thread: newest published copy, valid until the next Acquire. Sets alpha from now
+		FrameSnapshot& Acquire(double now);
+
+	private:
+		std::array<FrameSnapshot, 3> slots;
+		int writeSlot = 0;
+		int readySlot = 1;
+		int readSlot = 2;
+		bool fresh = false;
+		std::mutex mutex;
+	};
+}
@@ -0,0 +1,250 @@
+#include "Hitscan.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace Enigma
+{
+	namespace
+	{
+		void FindMeshNodes(const Node* node, std::vector<const Node*>& meshNodes)
+		{
+			for (int mesh : node->meshIndices)
+			{
+				if (mesh >= 0 && mesh < static_cast<int>(meshNodes.size()))
+					meshNodes[mesh] = node;
+			}
+			for (auto& child : node->children)
+				FindMeshNodes(child.get(), meshNodes);
+		}
+
+		// Every vertex goes to the bone with the largest weight on it, each bone with enough vertices gets a capsule
+		// along the longest side of their bounds that is wide enough to hold all of them
+		void BuildCapsules(int meshIndex, const Mesh& mesh, std::vector<BoneCapsule>& capsules)
+		{
+			const size_t minVertices = 8;
+
+			std::vector<std::vector<glm::vec3>> bones;
+			for (const auto& vertex : mesh.vertices)
+			{
+				int bone = -1;
+				float weight = 0.0f;
+				for (int k = 0; k < MAX_BONES_PER_VERTEX; k++)
+				{
+					if (vertex.weights[k] > weight)
+					{
+						weight = vertex.weights[k];
+						bone = static_cast<int>(vertex.boneIDs[k]);
+					}
+				}
+				if (bone == -1)
+					continue;
+
+				if (bone >= static_cast<int>(bones.size()))
+					bones.resize(bone + 1);
+				bones[bone].push_back(vertex.pos);
+			}
+
+			for (int bone = 0; bone < static_cast<int>(bones.size()); bone++)
+			{
+				const auto& points = bones[bone];
+				if (points.size() < minVertices)
+					continue;
+
+				glm::vec3 min = points[0];
+				glm::vec3 max = points[0];
+				for (const auto& p : points)
+				{
+					min = glm::min(min, p);
+					max = glm::max(max, p);
+				}
+
+				const glm::vec3 extent = max - min;
+				const int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+				const glm::vec3 centre = (min + max) * 0.5f;
+				glm::vec3 axisDirection = glm::vec3(0.0f);
+				axisDirection[axis] = 1.0f;
+
+				float radius = 0.0f;
+				for (const auto& p : points)
+				{
+					glm::vec3 offset = p - centre;
+					offset[axis] = 0.0f;
+					radius = std::max(radius, glm::length(offset));
+				}
+
+				// pull the ends in by the radius so the round caps don't reach past the last vertices
+				const float halfLength = extent[axis] * 0.5f;
+				const float inset = std::min(radius, halfLength);
+				capsules.push_back({ meshIndex, bone, centre - axisDirection * (halfLength - inset), centre + axisDirection * (halfLength - inset), radius });
+			}
+		}
+
+		// Distance along a normalized ray to the first point on the capsule, negative when it misses
+		float RayCapsule(const glm::vec3& origin, const glm::vec3& direction, const glm::vec3& a, const glm::vec3& b, float radius)
+		{
+			const glm::vec3 ba = b - a;
+			const glm::vec3 oa = origin - a;
+			const float baba = glm::dot(ba, ba);
+			const float bard = glm::dot(ba, direction);
+			const float baoa = glm::dot(ba, oa);
+			const float rdoa = glm::dot(direction, oa);
+			const float oaoa = glm::dot(oa, oa);
+
+			// infinite cylinder around the axis first
+			const float qa = baba - bard * bard;
+			float qb = baba * rdoa - baoa * bard;
+			float qc = baba * oaoa - baoa * baoa - radius * radius * baba;
+			float h = qb * qb - qa * qc;
+			if (h < 0.0f)
+				return -1.0f;
+
+			// a ray along the axis can only enter through a cap, pick the end the origin is beyond
+			float y = baoa;
+			if (qa > 1e-8f)
+			{
+				const float t = (-qb - std::sqrt(h)) / qa;
+				y = baoa + t * bard;
+				if (y > 0.0f && y < baba)
+					return t;
+			}
+
+			// then the sphere at the end the cylinder hit was past
+			const glm::vec3 oc = (y <= 0.0f) ? oa : origin - b;
+			qb = glm::dot(direction, oc);
+			qc = glm::dot(oc, oc) - radius * radius;
+			h = qb * qb - qc;
+			if (h <= 0.0f)
+				return -1.0f;
+			return -qb - std::sqrt(h);
+		}
+	}
+
+	void Hitscan::Build(const std::vector<Model*>& models)
+	{
+		shapes.clear();
+
+		size_t triangles = 0;
+		size_t capsules = 0;
+		for (auto* model : models)
+		{
+			// the same models the collision BVH skips
+			if (!model->collidable)
+				continue;
+
+			ModelShapes& shape = shapes[model];
+			shape.meshes.resize(model->meshes.size());
+			for (int i = 0; i < static_cast<int>(model->meshes.size()); i++)
+			{
+				shape.meshes[i].Build(model->meshes[i].vertices, model->meshes[i].indices);
+				triangles += shape.meshes[i].GetTriangleCount();
+			}
+
+			if (!model->m_animations.empty())
+			{
+				shape.meshNodes.assign(model->meshes.size(), &model->rootNode);
+				FindMeshNodes(&model->rootNode, shape.meshNodes);
+				for (int i = 0; i < static_cast<int>(model->meshes.size()); i++)
+					BuildCapsules(i, model->meshes[i], shape.capsules);
+				capsules += shape.capsules.size();
+			}
+		}
+
+		std::cout << "[ENIGMA]: Built hitscan shapes, " << triangles << " triangles and " << capsules << " bone capsules" << std::endl;
+	}
+
+	const std::vector<BoneCapsule>* Hitscan::GetCapsules(const Model* model) const
+	{
+		auto it = shapes.find(model);
+		return it == shapes.end() ? nullptr : &it->second.capsules;
+	}
+
+	bool Hitscan::Raycast(const BVH& collision, const glm::vec3& origin, const glm::vec3& direction, float maxDistance, uint32_t mask, HitscanHit& hit) const
+	{
+		HitscanHit closest;
+		BVHHit broad;
+		const bool found = collision.Raycast(origin, direction, maxDistance, mask, broad, [&](const BVHPrimitive& primitive, float maxT, float& t) {
+			auto it = shapes.find(primitive.model);
+			if (it == shapes.end())
+				return false;
+
+			// a living animated model is drawn skinned, a dead one falls back to the static draw
+			Model* model = primitive.model;
+			const bool animated = !model->m_animations.empty() && !model->dead && !it->second.capsules.empty();
+
+			HitscanHit candidate;
+			const bool hitMesh = animated
+				? RaycastCapsules(model, it->second, primitive.mesh, origin, direction, maxT, candidate)
+				: RaycastTriangles(model, it->second, primitive.mesh, origin, direction, maxT, candidate);
+			if (!hitMesh)
+				return false;
+
+			t = candidate.t;
+			closest = candidate;
+			return true;
+		});
+
+		if (!found)
+			return false;
+
+		hit = closest;
+		hit.point = origin + direction * hit.t;
+		return true;
+	}
+
+	bool Hitscan::RaycastTriangles(Model* model, const ModelShapes& shape, int mesh, const glm::vec3& origin, const glm::vec3& direction, float maxDistance, HitscanHit& hit) const
+	{
+		const TriangleBVH& triangles = shape.meshes[mesh];
+		if (triangles.Empty())
+			return false;
+
+		// the direction isn't renormalized after the transform so t is still a world space distance
+		const glm::mat4 toMesh = glm::inverse(model->GetModelMatrix());
+		const glm::vec3 meshOrigin = glm::vec3(toMesh * glm::vec4(origin, 1.0f));
+		const glm::vec3 meshDirection = glm::mat3(toMesh) * direction;
+
+		TriangleHit triangle;
+		if (!triangles.Raycast(meshOrigin, meshDirection, maxDistance, triangle))
+			return false;
+
+		hit.model = model;
+		hit.mesh = mesh;
+		hit.triangle = triangle.triangle;
+		hit.bone = -1;
+		hit.t = triangle.t;
+		return true;
+	}
+
+	bool Hitscan::RaycastCapsules(Model* model, const ModelShapes& shape, int mesh, const glm::vec3& origin, const glm::vec3& direction, float maxDistance, HitscanHit& hit) const
+	{
+		const auto& palette = model->GetBoneTransforms();
+		const glm::mat4& nodeMatrix = shape.meshNodes[mesh]->globalMatrix;
+
+		bool found = false;
+		float closest = maxDistance;
+		for (const auto& capsule : shape.capsules)
+		{
+			if (capsule.mesh != mesh || capsule.bone >= static_cast<int>(palette.size()))
+				continue;
+
+			// same transform as the skinning shader, node matrix times the bone's palette entry
+			const glm::mat4 transform = nodeMatrix * palette[capsule.bone];
+			const glm::vec3 a = glm::vec3(transform * glm::vec4(capsule.a, 1.0f));
+			const glm::vec3 b = glm::vec3(transform * glm::vec4(capsule.b, 1.0f));
+			const float scale = std::max(glm::length(glm::vec3(transform[0])), std::max(glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2]))));
+
+			const float t = RayCapsule(origin, direction, a, b, capsule.radius * scale);
+			if (t > 0.0f && t < closest)
+			{
+				closest = t;
+				hit.model = model;
+				hit.mesh = mesh;
+				hit.triangle = -1;
+				hit.bone = capsule.bone;
+				hit.t = t;
+				found = true;
+			}
+		}
+		return found;
+	}
+}
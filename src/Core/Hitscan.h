@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <glm/glm.hpp>
+#include "BVH.h"
+#include "TriangleBVH.h"
+
+namespace Enigma
+{
+	struct HitscanHit
+	{
+		Model* model = nullptr;
+		int mesh = -1;
+		int triangle = -1;   // -1 when a bone capsule was hit
+		int bone = -1;       // -1 when a triangle was hit
+		float t = 0.0f;
+		glm::vec3 point = glm::vec3(0.0f);
+	};
+
+	// Capsule around the vertices a bone moves the most, in the bind pose of the mesh
+	struct BoneCapsule
+	{
+		int mesh;
+		int bone;
+		glm::vec3 a;
+		glm::vec3 b;
+		float radius;
+	};
+
+	// Exact ray tests for shooting. The collision BVH finds the meshes a ray could hit, then static meshes are tested
+	// triangle by triangle and animated models against capsules moved by the current bone palette
+	class Hitscan
+	{
+	public:
+		void Build(const std::vector<Model*>& models);
+
+		// Closest triangle or bone capsule along the ray, direction has to be normalized
+		bool Raycast(const BVH& collision, const glm::vec3& origin, const glm::vec3& direction, float maxDistance, uint32_t mask, HitscanHit& hit) const;
+
+		const std::vector<BoneCapsule>* GetCapsules(const Model* model) const;
+
+	private:
+		struct ModelShapes
+		{
+			std::vector<TriangleBVH> meshes;
+			std::vector<BoneCapsule> capsules;
+			// node each mesh hangs off, an animated mesh is drawn with the node's global matrix
+			std::vector<const Node*> meshNodes;
+		};
+
+		bool RaycastTriangles(Model* model, const ModelShapes& shapes, int mesh, const glm::vec3& origin, const glm::vec3& direction, float maxDistance, HitscanHit& hit) const;
+		bool RaycastCapsules(Model* model, const ModelShapes& shapes, int mesh, const glm::vec3& origin, const glm::vec3& direction, float maxDistance, HitscanHit& hit) const;
+
+	private:
+		std::unordered_map<const Model*, ModelShapes> shapes;
+	};
+}
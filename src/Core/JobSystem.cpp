@@ -0,0 +1,107 @@
+#include "JobSystem.h"
+#include "Profiler.h"
+#include <algorithm>
+
+namespace Enigma
+{
+	namespace
+	{
+		thread_local unsigned threadIndex = 0;
+	}
+
+	JobSystem::~JobSystem()
+	{
+		Stop();
+	}
+
+	void JobSystem::Start(unsigned workerCount)
+	{
+		Stop();
+		quit = false;
+		for (unsigned i = 0; i < workerCount; i++)
+			workers.emplace_back(&JobSystem::WorkerLoop, this, i + 1);
+	}
+
+	void JobSystem::Stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			quit = true;
+		}
+		wake.notify_all();
+
+		for (auto& worker : workers)
+			worker.join();
+		workers.clear();
+	}
+
+	void JobSystem::ParallelFor(int count, int grain, const std::function<void(int, int)>& job)
+	{
+		if (count <= 0)
+			return;
+
+		grain = std::max(grain, 1);
+		if (workers.empty() || count <= grain)
+		{
+			job(0, count);
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			currentJob = &job;
+			jobCount = count;
+			jobGrain = grain;
+			nextIndex = 0;
+			busyWorkers = static_cast<unsigned>(workers.size());
+			generation++;
+		}
+		wake.notify_all();
+
+		RunChunks();
+
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [this] { return busyWorkers == 0; });
+		currentJob = nullptr;
+	}
+
+	void JobSystem::RunChunks()
+	{
+		const auto& job = *currentJob;
+		while (true)
+		{
+			const int begin = nextIndex.fetch_add(jobGrain);
+			if (begin >= jobCount)
+				break;
+			job(begin, std::min(begin + jobGrain, jobCount));
+		}
+	}
+
+	unsigned JobSystem::GetThreadIndex()
+	{
+		return threadIndex;
+	}
+
+	void JobSystem::WorkerLoop(unsigned index)
+	{
+		threadIndex = index;
+		ENIGMA_PROFILE_THREAD("job worker");
+		uint64_t seen = 0;
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [&] { return quit || generation != seen; });
+				if (quit)
+					return;
+				seen = generation;
+			}
+
+			RunChunks();
+
+			std::lock_guard<std::mutex> lock(mutex);
+			if (--busyWorkers == 0)
+				done.notify_one();
+		}
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+
+namespace Enigma
+{
+	// Fixed pool of worker threads for data parallel loops. The calling thread joins in on the work and
+	// ParallelFor only returns once every chunk has finished, so phases run one after another
+	class JobSystem
+	{
+	public:
+		JobSystem() = default;
+		~JobSystem();
+
+		JobSystem(const JobSystem&) = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+
+		// workerCount threads are created in addition to the calling thread
+		void Start(unsigned workerCount);
+		void Stop();
+		unsigned GetThreadCount() const { return static_cast<unsigned>(workers.size()) + 1; }
+		// Index of the thread running the current chunk, 0 for the thread that called ParallelFor and 1 to
+		// GetThreadCount() - 1 for workers. Lets jobs pick per-thread resources without locking
+		static unsigned GetThreadIndex();
+
+		// Splits [0, count) into chunks of grain items and calls job(begin, end) for each chunk
+		void ParallelFor(int count, int grain, const std::function<void(int, int)>& job);
+
+	private:
+		void WorkerLoop(unsigned index);
+		void RunChunks();
+
+	private:
+		std::vector<std::thread> workers;
+		std::mutex mutex;
+		std::condition_variable wake;
+		std::condition_variable done;
+
+		const std::function<void(int, int)>* currentJob = nullptr;
+		int jobCount = 0;
+		int jobGrain = 1;
+		std::atomic<int> nextIndex = 0;
+		unsigned busyWorkers = 0;
+		uint64_t generation = 0;
+		bool quit = false;
+	};
+}
@@ -0,0 +1,123 @@
+#include "NavAgent.h"
+
+namespace Enigma
+{
+	NavAgent::NavAgent(const Navmesh& mesh, const NavHierarchy& hierarchy) : mesh{ &mesh }, hierarchy{ &hierarchy }
+	{
+	}
+
+	void NavAgent::Plan(const glm::vec3& position, const glm::vec3& target, bool visible)
+	{
+		if (visible)
+		{
+			path = { position, target };
+			route.Clear();
+			lastTarget = target;
+			currentNode = 1;
+			direct = true;
+			return;
+		}
+
+		//a straight path stops being valid as soon as the target is out of sight
+		const float repathDistance = 1.f;
+		if (!direct && !path.empty() && glm::length(target - lastTarget) <= repathDistance)
+			return;
+		direct = false;
+
+		if (hierarchy->Built())
+		{
+			path.clear();
+			if (hierarchy->FindRoute(position, target, route))
+				hierarchy->RefineNext(route, path);
+		}
+		else
+		{
+			mesh->FindPath(position, target, path);
+		}
+
+		lastTarget = target;
+		//the first corner is the agent's own position on the navmesh
+		currentNode = 1;
+	}
+
+	glm::vec3 NavAgent::Steer(const glm::vec3& position, const SpatialHash& crowd, int crowdIndex)
+	{
+		glm::vec3 direction = glm::vec3(0.f);
+
+		if (currentNode < path.size())
+		{
+			//get direction from the agent to the next corner, agents stay at their own height
+			direction = path[currentNode] - position;
+			direction.y = 0.f;
+			float distFromCurrentNode = glm::length(direction);
+
+			//if the agent is close to a corner move on to the next one
+			if (distFromCurrentNode < 0.5f && currentNode < path.size() - 1)
+			{
+				currentNode++;
+				direction = path[currentNode] - position;
+				direction.y = 0.f;
+				distFromCurrentNode = glm::length(direction);
+			}
+
+			//at the end of this segment, refine the next one of the route if there is one
+			if (distFromCurrentNode < 1.f && currentNode == path.size() - 1 && hierarchy->RefineNext(route, path))
+				currentNode = 1;
+
+			//stop following the path when close to the end of it
+			if (distFromCurrentNode < 1.f)
+			{
+				direction = glm::vec3(0.f);
+			}
+			else
+			{
+				direction = direction / distFromCurrentNode;
+
+				//the path is straight between corners so the facing only changes at a corner
+				if (glm::dot(direction, heading) < 0.999f)
+				{
+					heading = direction;
+					turned = true;
+				}
+			}
+		}
+
+		//blend the path direction with a push away from nearby agents so they don't stack up
+		glm::vec3 velocity = direction + Separation(position, crowd, crowdIndex);
+		const float speed = glm::length(velocity);
+		if (speed < 0.01f)
+			return glm::vec3(0.f);
+		if (speed > 1.f)
+			velocity = velocity / speed;
+		return velocity;
+	}
+
+	glm::vec3 NavAgent::Separation(const glm::vec3& position, const SpatialHash& crowd, int crowdIndex) const
+	{
+		//only the closest few neighbours matter, Query keeps the nearest maxNeighbours so the cost per agent is bounded
+		const float radius = 8.f;
+		const int maxNeighbours = 8;
+		int neighbours[maxNeighbours];
+		const int count = crowd.Query(position, radius, crowdIndex, neighbours, maxNeighbours);
+
+		glm::vec3 push = glm::vec3(0.f);
+		for (int i = 0; i < count; i++)
+		{
+			glm::vec3 offset = position - crowd.GetPosition(neighbours[i]);
+			offset.y = 0.f;
+			float distance = glm::length(offset);
+			//agents exactly on top of each other split apart using their index so the result is deterministic
+			if (distance < 0.001f)
+			{
+				offset = glm::vec3(crowdIndex < neighbours[i] ? 1.f : -1.f, 0.f, 0.f);
+				distance = 0.001f;
+			}
+			else
+			{
+				offset = offset / distance;
+			}
+			push += offset * (1.f - distance / radius);
+		}
+		return push;
+	}
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "Navmesh.h"
+#include "NavHierarchy.h"
+#include "SpatialHash.h"
+
+namespace Enigma
+{
+	// Path following state for one agent. Plan and Steer only read shared data (the navmesh and the crowd
+	// snapshot) and write to this agent, so every agent can be updated on a different thread
+	class NavAgent
+	{
+	public:
+		NavAgent(const Navmesh& mesh = navmesh, const NavHierarchy& hierarchy = navHierarchy);
+
+		// Plans a new path when the target has moved away from the position the last path was planned to.
+		// A visible target is walked to in a straight line without searching the navmesh
+		void Plan(const glm::vec3& position, const glm::vec3& target, bool visible = false);
+		// Direction to walk this tick from the path and the push away from nearby agents, length <= 1
+		glm::vec3 Steer(const glm::vec3& position, const SpatialHash& crowd, int crowdIndex);
+
+		// Facing direction from the path, turned is set whenever it changes so the rotation can be rebuilt
+		glm::vec3 GetHeading() const { return heading; }
+		bool turned = false;
+
+	private:
+		glm::vec3 Separation(const glm::vec3& position, const SpatialHash& crowd, int crowdIndex) const;
+
+	private:
+		const Navmesh* mesh;
+		const NavHierarchy* hierarchy;
+
+		//smoothed corners from the navmesh, currentNode is the corner being walked towards
+		//with a navmesh hierarchy the corners only cover the current segment of route
+		size_t currentNode = 0;
+		std::vector<glm::vec3> path;
+		NavRoute route;
+		glm::vec3 lastTarget = glm::vec3(0.f);
+		bool direct = false;
+		glm::vec3 heading = glm::vec3(0.f);
+	};
+}
@@ -0,0 +1,403 @@
+#include "NavHierarchy.h"
+#include <queue>
+#include <map>
+#include <algorithm>
+#include <cfloat>
+#include <iostream>
+
+namespace Enigma
+{
+	namespace
+	{
+		using QueueEntry = std::pair<float, int>;
+		using OpenList = std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>>;
+
+		struct Crossing
+		{
+			int from;
+			int to;
+			glm::vec3 a;
+			glm::vec3 b;
+		};
+
+		bool Touching(const Crossing& c0, const Crossing& c1)
+		{
+			constexpr float tolerance = 0.01f;
+			return glm::distance(c0.a, c1.a) < tolerance || glm::distance(c0.a, c1.b) < tolerance ||
+				glm::distance(c0.b, c1.a) < tolerance || glm::distance(c0.b, c1.b) < tolerance;
+		}
+	}
+
+	void NavHierarchy::Clear()
+	{
+		mesh = nullptr;
+		clustersX = 0;
+		clustersZ = 0;
+		polygonCluster.clear();
+		localIndex.clear();
+		clusterPolygons.clear();
+		clusterNodes.clear();
+		nodeSlot.clear();
+		nodes.clear();
+	}
+
+	int NavHierarchy::ClusterAt(const glm::vec3& point) const
+	{
+		const int x = glm::clamp(static_cast<int>((point.x - origin.x) / clusterSize), 0, clustersX - 1);
+		const int z = glm::clamp(static_cast<int>((point.z - origin.y) / clusterSize), 0, clustersZ - 1);
+		return x + z * clustersX;
+	}
+
+	void NavHierarchy::Build(const Navmesh& navmesh, float size)
+	{
+		Clear();
+		if (navmesh.Empty())
+			return;
+
+		mesh = &navmesh;
+		clusterSize = size;
+
+		// polygons belong to the cluster their centre falls in
+		glm::vec2 boundsMin = glm::vec2(FLT_MAX);
+		glm::vec2 boundsMax = glm::vec2(-FLT_MAX);
+		for (const auto& polygon : navmesh.polygons)
+		{
+			boundsMin = glm::min(boundsMin, glm::vec2(polygon.centre.x, polygon.centre.z));
+			boundsMax = glm::max(boundsMax, glm::vec2(polygon.centre.x, polygon.centre.z));
+		}
+
+		origin = boundsMin;
+		clustersX = static_cast<int>((boundsMax.x - boundsMin.x) / clusterSize) + 1;
+		clustersZ = static_cast<int>((boundsMax.y - boundsMin.y) / clusterSize) + 1;
+		clusterPolygons.resize(clustersX * clustersZ);
+		clusterNodes.resize(clustersX * clustersZ);
+
+		const int polygonCount = static_cast<int>(navmesh.polygons.size());
+		polygonCluster.resize(polygonCount);
+		localIndex.resize(polygonCount);
+		for (int p = 0; p < polygonCount; p++)
+		{
+			const int cluster = ClusterAt(navmesh.polygons[p].centre);
+			polygonCluster[p] = cluster;
+			localIndex[p] = static_cast<int>(clusterPolygons[cluster].size());
+			clusterPolygons[cluster].push_back(p);
+		}
+
+		// gather the portals which cross a cluster border, grouped by the pair of clusters they join
+		std::map<std::pair<int, int>, std::vector<Crossing>> borders;
+		for (int p = 0; p < polygonCount; p++)
+		{
+			for (const auto& portal : navmesh.polygons[p].portals)
+			{
+				const int from = polygonCluster[p];
+				const int to = polygonCluster[portal.neighbour];
+				if (from < to)
+					borders[{ from, to }].push_back({ p, portal.neighbour, portal.a, portal.b });
+			}
+		}
+
+		auto addNode = [&](int polygon, const glm::vec3& position) {
+			NavNode node;
+			node.polygon = polygon;
+			node.cluster = polygonCluster[polygon];
+			node.position = position;
+			nodeSlot.push_back(static_cast<int>(clusterNodes[node.cluster].size()));
+			clusterNodes[node.cluster].push_back(static_cast<int>(nodes.size()));
+			nodes.push_back(std::move(node));
+			return static_cast<int>(nodes.size()) - 1;
+		};
+
+		for (auto& [clusters, crossings] : borders)
+		{
+			// order the crossings along the border so neighbouring portals can be merged into a single entrance
+			glm::vec3 lo = glm::vec3(FLT_MAX);
+			glm::vec3 hi = glm::vec3(-FLT_MAX);
+			for (const auto& crossing : crossings)
+			{
+				lo = glm::min(lo, (crossing.a + crossing.b) * 0.5f);
+				hi = glm::max(hi, (crossing.a + crossing.b) * 0.5f);
+			}
+			const int axis = (hi.x - lo.x) > (hi.z - lo.z) ? 0 : 2;
+			std::sort(crossings.begin(), crossings.end(), [axis](const Crossing& c0, const Crossing& c1) {
+				return (c0.a[axis] + c0.b[axis]) < (c1.a[axis] + c1.b[axis]);
+			});
+
+			// one entrance per run of touching portals, placed on the middle portal of the run
+			size_t runStart = 0;
+			for (size_t i = 1; i <= crossings.size(); i++)
+			{
+				if (i < crossings.size() && Touching(crossings[i - 1], crossings[i]))
+					continue;
+
+				const Crossing& crossing = crossings[(runStart + i - 1) / 2];
+				const glm::vec3 midpoint = (crossing.a + crossing.b) * 0.5f;
+				const int n0 = addNode(crossing.from, midpoint);
+				const int n1 = addNode(crossing.to, midpoint);
+				nodes[n0].links.push_back({ n1, 0.0f });
+				nodes[n1].links.push_back({ n0, 0.0f });
+				runStart = i;
+			}
+		}
+
+		// precompute the cost between every pair of entrances inside each cluster
+		std::vector<float> costs;
+		for (int cluster = 0; cluster < static_cast<int>(clusterNodes.size()); cluster++)
+		{
+			const auto& entrances = clusterNodes[cluster];
+			for (size_t i = 0; i < entrances.size(); i++)
+			{
+				NavNode& node = nodes[entrances[i]];
+				CostsToEntrances(cluster, node.polygon, node.position, costs);
+				for (size_t j = 0; j < entrances.size(); j++)
+				{
+					if (j != i && costs[j] < FLT_MAX)
+						node.links.push_back({ entrances[j], costs[j] });
+				}
+			}
+		}
+
+		std::cout << "[ENIGMA]: Built navmesh hierarchy with " << clusterPolygons.size() << " clusters and " << nodes.size() << " entrance nodes" << std::endl;
+	}
+
+	int NavHierarchy::FindPolygon(const glm::vec3& point) const
+	{
+		// a polygon can stick out of the cluster its centre is in so the neighbouring clusters are checked too
+		const int cx = ClusterAt(point) % clustersX;
+		const int cz = ClusterAt(point) / clustersX;
+		for (int z = std::max(cz - 1, 0); z <= std::min(cz + 1, clustersZ - 1); z++)
+		{
+			for (int x = std::max(cx - 1, 0); x <= std::min(cx + 1, clustersX - 1); x++)
+			{
+				for (int polygon : clusterPolygons[x + z * clustersX])
+				{
+					if (mesh->Contains(polygon, point))
+						return polygon;
+				}
+			}
+		}
+		return mesh->FindPolygon(point);
+	}
+
+	void NavHierarchy::ClusterSearch(int cluster, int startPolygon, const glm::vec3& start, int targetPolygon,
+		std::vector<float>& cost, std::vector<int>& parent, std::vector<glm::vec3>& entry) const
+	{
+		const auto& polygons = clusterPolygons[cluster];
+		cost.assign(polygons.size(), FLT_MAX);
+		parent.assign(polygons.size(), -1);
+		entry.assign(polygons.size(), glm::vec3(0.0f));
+		std::vector<bool> closed(polygons.size(), false);
+
+		OpenList open;
+		const int first = localIndex[startPolygon];
+		cost[first] = 0.0f;
+		entry[first] = start;
+		open.push({ 0.0f, first });
+
+		while (!open.empty())
+		{
+			const int current = open.top().second;
+			open.pop();
+
+			if (closed[current])
+				continue;
+			closed[current] = true;
+
+			if (polygons[current] == targetPolygon)
+				break;
+
+			for (const auto& portal : mesh->polygons[polygons[current]].portals)
+			{
+				if (polygonCluster[portal.neighbour] != cluster)
+					continue;
+
+				const int neighbour = localIndex[portal.neighbour];
+				if (closed[neighbour])
+					continue;
+
+				const glm::vec3 midpoint = (portal.a + portal.b) * 0.5f;
+				const float newCost = cost[current] + glm::distance(entry[current], midpoint);
+				if (newCost < cost[neighbour])
+				{
+					cost[neighbour] = newCost;
+					parent[neighbour] = current;
+					entry[neighbour] = midpoint;
+					open.push({ newCost, neighbour });
+				}
+			}
+		}
+	}
+
+	void NavHierarchy::CostsToEntrances(int cluster, int polygon, const glm::vec3& point, std::vector<float>& costs) const
+	{
+		std::vector<float> cost;
+		std::vector<int> parent;
+		std::vector<glm::vec3> entry;
+		ClusterSearch(cluster, polygon, point, -1, cost, parent, entry);
+
+		const auto& entrances = clusterNodes[cluster];
+		costs.assign(entrances.size(), FLT_MAX);
+		for (size_t i = 0; i < entrances.size(); i++)
+		{
+			const NavNode& node = nodes[entrances[i]];
+			const int local = localIndex[node.polygon];
+			if (cost[local] < FLT_MAX)
+				costs[i] = cost[local] + glm::distance(entry[local], node.position);
+		}
+	}
+
+	bool NavHierarchy::FindRoute(const glm::vec3& start, const glm::vec3& end, NavRoute& route) const
+	{
+		route.Clear();
+		if (!Built())
+			return false;
+
+		const int startPolygon = FindPolygon(start);
+		const int endPolygon = FindPolygon(end);
+		return FindRoute(startPolygon, mesh->ClosestPoint(startPolygon, start), endPolygon, mesh->ClosestPoint(endPolygon, end), route);
+	}
+
+	bool NavHierarchy::FindRoute(int startPolygon, const glm::vec3& start, int endPolygon, const glm::vec3& end, NavRoute& route) const
+	{
+		route.Clear();
+		if (!Built() || startPolygon < 0 || endPolygon < 0)
+			return false;
+
+		const int startCluster = polygonCluster[startPolygon];
+		const int endCluster = polygonCluster[endPolygon];
+
+		// short routes inside one cluster skip the abstract graph completely
+		if (startCluster == endCluster)
+		{
+			std::vector<float> cost;
+			std::vector<int> parent;
+			std::vector<glm::vec3> entry;
+			ClusterSearch(startCluster, startPolygon, start, endPolygon, cost, parent, entry);
+			if (cost[localIndex[endPolygon]] < FLT_MAX)
+			{
+				route.waypoints.push_back({ startPolygon, startCluster, start });
+				route.waypoints.push_back({ endPolygon, endCluster, end });
+				return true;
+			}
+		}
+
+		// the start and end are linked into the abstract graph as two temporary nodes
+		std::vector<float> startCosts;
+		std::vector<float> endCosts;
+		CostsToEntrances(startCluster, startPolygon, start, startCosts);
+		CostsToEntrances(endCluster, endPolygon, end, endCosts);
+
+		const int startNode = static_cast<int>(nodes.size());
+		const int endNode = startNode + 1;
+		std::vector<float> cost(nodes.size() + 2, FLT_MAX);
+		std::vector<int> parent(nodes.size() + 2, -1);
+		std::vector<bool> closed(nodes.size() + 2, false);
+
+		auto position = [&](int node) {
+			if (node == startNode)
+				return start;
+			if (node == endNode)
+				return end;
+			return nodes[node].position;
+		};
+
+		OpenList open;
+		cost[startNode] = 0.0f;
+		open.push({ glm::distance(start, end), startNode });
+
+		while (!open.empty())
+		{
+			const int current = open.top().second;
+			open.pop();
+
+			if (closed[current])
+				continue;
+			closed[current] = true;
+
+			if (current == endNode)
+				break;
+
+			auto relax = [&](int node, float linkCost) {
+				if (closed[node])
+					return;
+				const float newCost = cost[current] + linkCost;
+				if (newCost < cost[node])
+				{
+					cost[node] = newCost;
+					parent[node] = current;
+					open.push({ newCost + glm::distance(position(node), end), node });
+				}
+			};
+
+			if (current == startNode)
+			{
+				for (size_t i = 0; i < clusterNodes[startCluster].size(); i++)
+				{
+					if (startCosts[i] < FLT_MAX)
+						relax(clusterNodes[startCluster][i], startCosts[i]);
+				}
+				continue;
+			}
+
+			for (const auto& link : nodes[current].links)
+				relax(link.node, link.cost);
+
+			if (nodes[current].cluster == endCluster && endCosts[nodeSlot[current]] < FLT_MAX)
+				relax(endNode, endCosts[nodeSlot[current]]);
+		}
+
+		if (!closed[endNode])
+			return false;
+
+		std::vector<int> path;
+		for (int node = endNode; node != -1; node = parent[node])
+			path.push_back(node);
+		std::reverse(path.begin(), path.end());
+
+		for (int node : path)
+		{
+			if (node == startNode)
+				route.waypoints.push_back({ startPolygon, startCluster, start });
+			else if (node == endNode)
+				route.waypoints.push_back({ endPolygon, endCluster, end });
+			else
+				route.waypoints.push_back({ nodes[node].polygon, nodes[node].cluster, nodes[node].position });
+		}
+		return true;
+	}
+
+	bool NavHierarchy::RefineNext(NavRoute& route, std::vector<glm::vec3>& corners) const
+	{
+		if (!Built())
+			return false;
+
+		// consecutive waypoints in different clusters are the two sides of an entrance, nothing to walk
+		const auto& waypoints = route.waypoints;
+		while (route.next + 1 < waypoints.size() && waypoints[route.next].cluster != waypoints[route.next + 1].cluster)
+			route.next++;
+
+		if (route.next + 1 >= waypoints.size())
+			return false;
+
+		const NavWaypoint& from = waypoints[route.next];
+		const NavWaypoint& to = waypoints[route.next + 1];
+
+		std::vector<float> cost;
+		std::vector<int> parent;
+		std::vector<glm::vec3> entry;
+		ClusterSearch(from.cluster, from.polygon, from.position, to.polygon, cost, parent, entry);
+
+		const int target = localIndex[to.polygon];
+		if (cost[target] == FLT_MAX)
+			return false;
+
+		std::vector<int> corridor;
+		for (int local = target; local != -1; local = parent[local])
+			corridor.push_back(clusterPolygons[from.cluster][local]);
+		std::reverse(corridor.begin(), corridor.end());
+
+		corners.clear();
+		mesh->StringPull(from.position, to.position, corridor, corners);
+		route.next++;
+		return true;
+	}
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "Navmesh.h"
+
+namespace Enigma
+{
+	struct NavLink
+	{
+		int node;
+		float cost;
+	};
+
+	// Abstract node placed on a portal between two clusters, one node exists on each side of the portal
+	struct NavNode
+	{
+		int polygon;
+		int cluster;
+		glm::vec3 position;
+		std::vector<NavLink> links;
+	};
+
+	struct NavWaypoint
+	{
+		int polygon;
+		int cluster;
+		glm::vec3 position;
+	};
+
+	// Result of an abstract search. Each pair of waypoints in the same cluster is a segment
+	// which is only turned into corners when the agent gets to it
+	struct NavRoute
+	{
+		std::vector<NavWaypoint> waypoints;
+		size_t next = 0;
+
+		void Clear() { waypoints.clear(); next = 0; }
+	};
+
+	// HPA* over the polygon navmesh. The polygons are grouped into square clusters, each run of portals
+	// crossing a cluster border becomes an entrance and the costs between entrances inside a cluster are
+	// precomputed when the hierarchy is built
+	class NavHierarchy
+	{
+	public:
+		void Build(const Navmesh& navmesh, float clusterSize);
+		void Clear();
+		bool Built() const { return mesh != nullptr; }
+
+		// Cluster accelerated version of Navmesh::FindPolygon
+		int FindPolygon(const glm::vec3& point) const;
+
+		// Search the abstract graph between the two points, no corners are generated yet
+		bool FindRoute(const glm::vec3& start, const glm::vec3& end, NavRoute& route) const;
+		bool FindRoute(int startPolygon, const glm::vec3& start, int endPolygon, const glm::vec3& end, NavRoute& route) const;
+		// Refine the next segment of the route into smoothed corners, returns false when the route is finished
+		bool RefineNext(NavRoute& route, std::vector<glm::vec3>& corners) const;
+
+		const std::vector<NavNode>& GetNodes() const { return nodes; }
+		int GetClusterCount() const { return static_cast<int>(clusterPolygons.size()); }
+
+	private:
+		int ClusterAt(const glm::vec3& point) const;
+		// Dijkstra restricted to one cluster using cluster local indices, stops early once target is reached
+		void ClusterSearch(int cluster, int startPolygon, const glm::vec3& start, int targetPolygon,
+			std::vector<float>& cost, std::vector<int>& parent, std::vector<glm::vec3>& entry) const;
+		// cost of walking from start to every entrance of the cluster, indexed like clusterNodes
+		void CostsToEntrances(int cluster, int polygon, const glm::vec3& point, std::vector<float>& costs) const;
+
+	private:
+		const Navmesh* mesh = nullptr;
+		float clusterSize = 0.0f;
+		glm::vec2 origin = glm::vec2(0.0f);
+		int clustersX = 0;
+		int clustersZ = 0;
+
+		std::vector<int> polygonCluster;
+		std::vector<int> localIndex;
+		std::vector<std::vector<int>> clusterPolygons;
+		std::vector<std::vector<int>> clusterNodes;
+		std::vector<int> nodeSlot; // index of each node in its cluster's entry of clusterNodes
+		std::vector<NavNode> nodes;
+	};
+
+	inline NavHierarchy navHierarchy;
+}
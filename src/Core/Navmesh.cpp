@@ -0,0 +1,501 @@
+#include "Navmesh.h"
+#include "../Graphics/Model.h"
+#include "Error.h"
+#include <queue>
+#include <algorithm>
+#include <cfloat>
+
+namespace Enigma
+{
+	namespace
+	{
+		// twice the signed area of the triangle abc on the xz plane, > 0 when c is to the right of a->b
+		float TriArea2(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+		{
+			const float ax = b.x - a.x;
+			const float az = b.z - a.z;
+			const float bx = c.x - a.x;
+			const float bz = c.z - a.z;
+			return bx * az - ax * bz;
+		}
+
+		bool ApproxEqual(const glm::vec3& a, const glm::vec3& b)
+		{
+			const glm::vec3 d = a - b;
+			return glm::dot(d, d) < 1e-6f;
+		}
+
+		float DistanceXZ(const glm::vec3& a, const glm::vec3& b)
+		{
+			return glm::length(glm::vec2(a.x - b.x, a.z - b.z));
+		}
+
+		bool ContainsXZ(const NavPolygon& polygon, const glm::vec3& point)
+		{
+			// convex so the point must be on the same side of every edge, winding does not matter
+			bool positive = false;
+			bool negative = false;
+			const size_t count = polygon.vertices.size();
+			for (size_t i = 0; i < count; i++)
+			{
+				const float area = TriArea2(polygon.vertices[i], polygon.vertices[(i + 1) % count], point);
+				positive |= area > 1e-5f;
+				negative |= area < -1e-5f;
+				if (positive && negative)
+					return false;
+			}
+			return true;
+		}
+
+		glm::vec3 ClosestPointOnSegmentXZ(const glm::vec3& a, const glm::vec3& b, const glm::vec3& p)
+		{
+			const glm::vec2 ab = glm::vec2(b.x - a.x, b.z - a.z);
+			const glm::vec2 ap = glm::vec2(p.x - a.x, p.z - a.z);
+			const float len2 = glm::dot(ab, ab);
+			const float t = len2 > 0.0f ? glm::clamp(glm::dot(ap, ab) / len2, 0.0f, 1.0f) : 0.0f;
+			return glm::mix(a, b, t);
+		}
+
+		void RemoveDuplicates(std::vector<float>& values)
+		{
+			std::sort(values.begin(), values.end());
+			values.erase(std::unique(values.begin(), values.end(), [](float a, float b) { return std::abs(a - b) < 1e-3f; }), values.end());
+		}
+	}
+
+	void Navmesh::AddPolygon(const std::vector<glm::vec3>& vertices)
+	{
+		if (vertices.size() < 3)
+			return;
+
+		NavPolygon polygon;
+		polygon.vertices = vertices;
+		polygon.centre = glm::vec3(0.0f);
+		polygon.min = glm::vec3(FLT_MAX);
+		polygon.max = glm::vec3(-FLT_MAX);
+		for (const auto& v : vertices)
+		{
+			polygon.centre += v;
+			polygon.min = glm::min(polygon.min, v);
+			polygon.max = glm::max(polygon.max, v);
+		}
+		polygon.centre /= static_cast<float>(vertices.size());
+
+		polygons.push_back(std::move(polygon));
+	}
+
+	void Navmesh::LinkPortals()
+	{
+		// any two edges which lie on the same line and overlap become a portal. This handles
+		// exactly shared edges as well as the T-junctions produced by the baked rectangles
+		constexpr float lineTolerance = 0.01f;
+		constexpr float stepHeight = 1.0f;
+
+		for (auto& polygon : polygons)
+			polygon.portals.clear();
+
+		// sweep along x so only polygons with overlapping bounds are compared, large generated
+		// meshes would otherwise be quadratic
+		std::vector<int> order(polygons.size());
+		for (int i = 0; i < static_cast<int>(order.size()); i++)
+			order[i] = i;
+		std::sort(order.begin(), order.end(), [&](int a, int b) { return polygons[a].min.x < polygons[b].min.x; });
+
+		for (size_t oi = 0; oi < order.size(); oi++)
+		{
+			const int i = order[oi];
+			for (size_t oj = oi + 1; oj < order.size(); oj++)
+			{
+				const int j = order[oj];
+				if (polygons[j].min.x > polygons[i].max.x + lineTolerance)
+					break;
+				if (polygons[j].min.z > polygons[i].max.z + lineTolerance || polygons[j].max.z < polygons[i].min.z - lineTolerance)
+					continue;
+
+				const auto& p0 = polygons[i].vertices;
+				const auto& p1 = polygons[j].vertices;
+
+				for (size_t e0 = 0; e0 < p0.size(); e0++)
+				{
+					const glm::vec3& a = p0[e0];
+					const glm::vec3& b = p0[(e0 + 1) % p0.size()];
+					const glm::vec2 dir = glm::vec2(b.x - a.x, b.z - a.z);
+					const float len = glm::length(dir);
+					if (len < lineTolerance)
+						continue;
+
+					for (size_t e1 = 0; e1 < p1.size(); e1++)
+					{
+						const glm::vec3& c = p1[e1];
+						const glm::vec3& d = p1[(e1 + 1) % p1.size()];
+
+						if (std::abs((c.y + d.y) - (a.y + b.y)) * 0.5f > stepHeight)
+							continue;
+
+						// distance of c and d from the line through a and b
+						if (std::abs(TriArea2(a, b, c)) / len > lineTolerance || std::abs(TriArea2(a, b, d)) / len > lineTolerance)
+							continue;
+
+						const float tc = glm::dot(glm::vec2(c.x - a.x, c.z - a.z), dir) / (len * len);
+						const float td = glm::dot(glm::vec2(d.x - a.x, d.z - a.z), dir) / (len * len);
+						const float lo = std::max(0.0f, std::min(tc, td));
+						const float hi = std::min(1.0f, std::max(tc, td));
+						if ((hi - lo) * len < lineTolerance)
+							continue;
+
+						const glm::vec3 pa = glm::mix(a, b, lo);
+						const glm::vec3 pb = glm::mix(a, b, hi);
+						polygons[i].portals.push_back({ j, pa, pb });
+						polygons[j].portals.push_back({ i, pb, pa });
+					}
+				}
+			}
+		}
+	}
+
+	void Navmesh::Bake(const Model* level, float agentRadius)
+	{
+		Clear();
+
+		const Mesh* floor = nullptr;
+		for (const auto& mesh : level->meshes)
+		{
+			if (mesh.meshName == "Floor")
+			{
+				floor = &mesh;
+				break;
+			}
+		}
+
+		if (floor == nullptr)
+		{
+			ENIGMA_ERROR("Navmesh bake failed: level has no Floor mesh");
+			return;
+		}
+
+		const float floorY = floor->meshAABB.max.y;
+		const glm::vec2 floorMin = glm::vec2(floor->meshAABB.min.x, floor->meshAABB.min.z);
+		const glm::vec2 floorMax = glm::vec2(floor->meshAABB.max.x, floor->meshAABB.max.z);
+
+		// footprint of every obstacle grown by the agent radius so the polygons keep the agent clear of walls
+		std::vector<AABB> obstacles;
+		std::vector<float> xs = { floorMin.x, floorMax.x };
+		std::vector<float> zs = { floorMin.y, floorMax.y };
+		for (const auto& mesh : level->meshes)
+		{
+			if (&mesh == floor || mesh.meshName == "Navmesh")
+				continue;
+
+			AABB box = mesh.meshAABB;
+			if (box.min.x > box.max.x || box.max.y < floorY)
+				continue;
+
+			box.min -= glm::vec3(agentRadius, 0.0f, agentRadius);
+			box.max += glm::vec3(agentRadius, 0.0f, agentRadius);
+			obstacles.push_back(box);
+
+			xs.push_back(glm::clamp(box.min.x, floorMin.x, floorMax.x));
+			xs.push_back(glm::clamp(box.max.x, floorMin.x, floorMax.x));
+			zs.push_back(glm::clamp(box.min.z, floorMin.y, floorMax.y));
+			zs.push_back(glm::clamp(box.max.z, floorMin.y, floorMax.y));
+		}
+
+		RemoveDuplicates(xs);
+		RemoveDuplicates(zs);
+
+		// the obstacle edges split the floor into a grid of cells which are either fully walkable or fully blocked
+		const int nx = static_cast<int>(xs.size()) - 1;
+		const int nz = static_cast<int>(zs.size()) - 1;
+		std::vector<bool> walkable(nx * nz, true);
+		std::vector<bool> used(nx * nz, false);
+
+		for (int j = 0; j < nz; j++)
+		{
+			for (int i = 0; i < nx; i++)
+			{
+				const float cx = (xs[i] + xs[i + 1]) * 0.5f;
+				const float cz = (zs[j] + zs[j + 1]) * 0.5f;
+				for (const auto& box : obstacles)
+				{
+					if (cx > box.min.x && cx < box.max.x && cz > box.min.z && cz < box.max.z)
+					{
+						walkable[i + j * nx] = false;
+						break;
+					}
+				}
+			}
+		}
+
+		// greedily merge walkable cells into rectangles, first along x then along z
+		auto isFree = [&](int i, int j) { return walkable[i + j * nx] && !used[i + j * nx]; };
+		for (int j = 0; j < nz; j++)
+		{
+			for (int i = 0; i < nx; i++)
+			{
+				if (!isFree(i, j))
+					continue;
+
+				int i1 = i;
+				while (i1 + 1 < nx && isFree(i1 + 1, j))
+					i1++;
+
+				int j1 = j;
+				while (j1 + 1 < nz)
+				{
+					bool rowFree = true;
+					for (int k = i; k <= i1 && rowFree; k++)
+						rowFree = isFree(k, j1 + 1);
+					if (!rowFree)
+						break;
+					j1++;
+				}
+
+				for (int z = j; z <= j1; z++)
+					for (int x = i; x <= i1; x++)
+						used[x + z * nx] = true;
+
+				AddPolygon({
+					glm::vec3(xs[i], floorY, zs[j]),
+					glm::vec3(xs[i1 + 1], floorY, zs[j]),
+					glm::vec3(xs[i1 + 1], floorY, zs[j1 + 1]),
+					glm::vec3(xs[i], floorY, zs[j1 + 1])
+				});
+			}
+		}
+
+		LinkPortals();
+		std::cout << "[ENIGMA]: Baked navmesh with " << polygons.size() << " polygons" << std::endl;
+	}
+
+	int Navmesh::FindPolygon(const glm::vec3& point) const
+	{
+		int closest = -1;
+		float closestDistance = FLT_MAX;
+		for (int i = 0; i < static_cast<int>(polygons.size()); i++)
+		{
+			if (ContainsXZ(polygons[i], point))
+				return i;
+
+			const float distance = DistanceXZ(ClosestPoint(i, point), point);
+			if (distance < closestDistance)
+			{
+				closestDistance = distance;
+				closest = i;
+			}
+		}
+		return closest;
+	}
+
+	bool Navmesh::Contains(int polygon, const glm::vec3& point) const
+	{
+		return ContainsXZ(polygons[polygon], point);
+	}
+
+	glm::vec3 Navmesh::ClosestPoint(int polygon, const glm::vec3& point) const
+	{
+		const NavPolygon& poly = polygons[polygon];
+		if (ContainsXZ(poly, point))
+			return glm::vec3(point.x, poly.centre.y, point.z);
+
+		glm::vec3 closest = poly.centre;
+		float closestDistance = FLT_MAX;
+		for (size_t i = 0; i < poly.vertices.size(); i++)
+		{
+			const glm::vec3 p = ClosestPointOnSegmentXZ(poly.vertices[i], poly.vertices[(i + 1) % poly.vertices.size()], point);
+			const float distance = DistanceXZ(p, point);
+			if (distance < closestDistance)
+			{
+				closestDistance = distance;
+				closest = p;
+			}
+		}
+		return closest;
+	}
+
+	bool Navmesh::FindPath(const glm::vec3& start, const glm::vec3& end, std::vector<glm::vec3>& path) const
+	{
+		path.clear();
+		if (polygons.empty())
+			return false;
+
+		const int startPolygon = FindPolygon(start);
+		const int endPolygon = FindPolygon(end);
+		const glm::vec3 startPoint = ClosestPoint(startPolygon, start);
+		const glm::vec3 endPoint = ClosestPoint(endPolygon, end);
+
+		if (startPolygon == endPolygon)
+		{
+			path.push_back(startPoint);
+			path.push_back(endPoint);
+			return true;
+		}
+
+		std::vector<int> corridor;
+		if (!FindCorridor(startPolygon, endPolygon, startPoint, endPoint, corridor))
+			return false;
+
+		StringPull(startPoint, endPoint, corridor, path);
+		return true;
+	}
+
+	bool Navmesh::FindCorridor(int startPolygon, int endPolygon, const glm::vec3& start, const glm::vec3& end, std::vector<int>& corridor) const
+	{
+		// A* where each polygon is entered through the midpoint of a portal, the cost is the distance
+		// walked between those midpoints and the heuristic is the straight line distance to the end
+		const size_t count = polygons.size();
+		std::vector<float> cost(count, FLT_MAX);
+		std::vector<int> parent(count, -1);
+		std::vector<glm::vec3> entry(count);
+		std::vector<bool> closed(count, false);
+
+		using QueueEntry = std::pair<float, int>;
+		std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>> open;
+
+		cost[startPolygon] = 0.0f;
+		entry[startPolygon] = start;
+		open.push({ glm::distance(start, end), startPolygon });
+
+		while (!open.empty())
+		{
+			const int current = open.top().second;
+			open.pop();
+
+			if (closed[current])
+				continue;
+			closed[current] = true;
+
+			if (current == endPolygon)
+				break;
+
+			for (const auto& portal : polygons[current].portals)
+			{
+				if (closed[portal.neighbour])
+					continue;
+
+				const glm::vec3 midpoint = (portal.a + portal.b) * 0.5f;
+				const float newCost = cost[current] + glm::distance(entry[current], midpoint);
+				if (newCost < cost[portal.neighbour])
+				{
+					cost[portal.neighbour] = newCost;
+					parent[portal.neighbour] = current;
+					entry[portal.neighbour] = midpoint;
+					open.push({ newCost + glm::distance(midpoint, end), portal.neighbour });
+				}
+			}
+		}
+
+		if (!closed[endPolygon])
+			return false;
+
+		corridor.clear();
+		for (int polygon = endPolygon; polygon != -1; polygon = parent[polygon])
+			corridor.push_back(polygon);
+		std::reverse(corridor.begin(), corridor.end());
+		return true;
+	}
+
+	void Navmesh::StringPull(const glm::vec3& start, const glm::vec3& end, const std::vector<int>& corridor, std::vector<glm::vec3>& path) const
+	{
+		// build the portal list for the corridor with the start and end as degenerate portals
+		std::vector<glm::vec3> lefts;
+		std::vector<glm::vec3> rights;
+		lefts.push_back(start);
+		rights.push_back(start);
+
+		for (size_t i = 0; i + 1 < corridor.size(); i++)
+		{
+			const NavPolygon& polygon = polygons[corridor[i]];
+			for (const auto& portal : polygon.portals)
+			{
+				if (portal.neighbour != corridor[i + 1])
+					continue;
+
+				// the centre is inside the convex polygon so it tells us which end of the portal is on which side
+				if (TriArea2(polygon.centre, portal.a, portal.b) > 0.0f)
+				{
+					lefts.push_back(portal.a);
+					rights.push_back(portal.b);
+				}
+				else
+				{
+					lefts.push_back(portal.b);
+					rights.push_back(portal.a);
+				}
+				break;
+			}
+		}
+
+		lefts.push_back(end);
+		rights.push_back(end);
+
+		// simple stupid funnel algorithm, the funnel is tightened portal by portal and a corner is
+		// emitted each time one side crosses over the other
+		glm::vec3 apex = start;
+		glm::vec3 left = lefts[0];
+		glm::vec3 right = rights[0];
+		size_t apexIndex = 0;
+		size_t leftIndex = 0;
+		size_t rightIndex = 0;
+
+		path.push_back(apex);
+
+		for (size_t i = 1; i < lefts.size(); i++)
+		{
+			const glm::vec3& newLeft = lefts[i];
+			const glm::vec3& newRight = rights[i];
+
+			// tighten the right side
+			if (TriArea2(apex, right, newRight) <= 0.0f)
+			{
+				if (ApproxEqual(apex, right) || TriArea2(apex, left, newRight) > 0.0f)
+				{
+					right = newRight;
+					rightIndex = i;
+				}
+				else
+				{
+					// right crossed over left, the left point is a corner
+					apex = left;
+					apexIndex = leftIndex;
+					if (!ApproxEqual(path.back(), apex))
+						path.push_back(apex);
+
+					left = apex;
+					right = apex;
+					leftIndex = apexIndex;
+					rightIndex = apexIndex;
+					i = apexIndex;
+					continue;
+				}
+			}
+
+			// tighten the left side
+			if (TriArea2(apex, left, newLeft) >= 0.0f)
+			{
+				if (ApproxEqual(apex, left) || TriArea2(apex, right, newLeft) < 0.0f)
+				{
+					left = newLeft;
+					leftIndex = i;
+				}
+				else
+				{
+					// left crossed over right, the right point is a corner
+					apex = right;
+					apexIndex = rightIndex;
+					if (!ApproxEqual(path.back(), apex))
+						path.push_back(apex);
+
+					left = apex;
+					right = apex;
+					leftIndex = apexIndex;
+					rightIndex = apexIndex;
+					i = apexIndex;
+					continue;
+				}
+			}
+		}
+
+		if (!ApproxEqual(path.back(), end))
+			path.push_back(end);
+	}
+}
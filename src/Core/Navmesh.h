@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vector>
+#include <glm/glm.hpp>
+
+namespace Enigma
+{
+	class Model;
+
+	// Shared edge between two polygons. a/b are stored in the winding of the owning polygon,
+	// left/right are worked out per query from the direction of travel
+	struct NavPortal
+	{
+		int neighbour;
+		glm::vec3 a;
+		glm::vec3 b;
+	};
+
+	// Convex polygon on the walkable surface, only the xz plane is used for containment tests
+	struct NavPolygon
+	{
+		std::vector<glm::vec3> vertices;
+		std::vector<NavPortal> portals;
+		glm::vec3 centre;
+		glm::vec3 min;
+		glm::vec3 max;
+	};
+
+	class Navmesh
+	{
+	public:
+		// Polygons authored in the level file (a "Navmesh" shape with faces)
+		void AddPolygon(const std::vector<glm::vec3>& vertices);
+		// Find the shared edges between all polygons, must be called once all polygons are added
+		void LinkPortals();
+		// Bake walkable rectangles from the "Floor" mesh minus the footprint of every other mesh in the level
+		void Bake(const Model* level, float agentRadius);
+		void Clear() { polygons.clear(); }
+		bool Empty() const { return polygons.empty(); }
+
+		// Returns the polygon containing the point or the closest one if the point is off the mesh, -1 if empty
+		int FindPolygon(const glm::vec3& point) const;
+		bool Contains(int polygon, const glm::vec3& point) const;
+		glm::vec3 ClosestPoint(int polygon, const glm::vec3& point) const;
+
+		// A* over the polygons followed by funnel smoothing. path receives the corner points from start to end
+		bool FindPath(const glm::vec3& start, const glm::vec3& end, std::vector<glm::vec3>& path) const;
+
+		// The two halves of FindPath, exposed for the hierarchical search and the benchmarks
+		bool FindCorridor(int startPolygon, int endPolygon, const glm::vec3& start, const glm::vec3& end, std::vector<int>& corridor) const;
+		void StringPull(const glm::vec3& start, const glm::vec3& end, const std::vector<int>& corridor, std::vector<glm::vec3>& path) const;
+
+		std::vector<NavPolygon> polygons;
+	};
+
+	inline Navmesh navmesh;
+}
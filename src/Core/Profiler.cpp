@@ -0,0 +1,237 @@
+#include "Profiler.h"
+
+#if defined(ENIGMA_PROFILING)
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+
+namespace Enigma::Profiler
+{
+	namespace
+	{
+		// per thread, a power of two so the write index wraps with a mask
+		constexpr uint32_t ringCapacity = 1 << 14;
+		constexpr uint32_t maxThreads = 64;
+		// about five seconds at 60Hz, what a trace covers
+		constexpr size_t keptFrames = 300;
+
+		using Clock = std::chrono::steady_clock;
+		const Clock::time_point epoch = Clock::now();
+
+		uint64_t Now()
+		{
+			return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - epoch).count());
+		}
+
+		// single producer, single consumer. The owning thread only ever advances written and EndFrame only ever
+		// advances read, an event is dropped rather than overwriting one EndFrame hasn't copied yet
+		struct ThreadRing
+		{
+			std::vector<Event> events = std::vector<Event>(ringCapacity);
+			std::atomic<uint64_t> written = 0;
+			std::atomic<uint64_t> read = 0;
+			std::atomic<uint64_t> dropped = 0;
+			std::atomic<const char*> name = nullptr;
+			uint32_t thread = 0;
+			// only touched by the owning thread
+			uint16_t depth = 0;
+		};
+
+		// rings are never freed, a thread that has exited may still have events left to drain
+		std::atomic<ThreadRing*> rings[maxThreads] = {};
+		std::atomic<uint32_t> ringCount = 0;
+		thread_local ThreadRing* localRing = nullptr;
+
+		// only the thread calling EndFrame touches these
+		std::deque<Frame> frames;
+		uint64_t frameIndex = 0;
+		uint64_t frameStart = 0;
+
+		ThreadRing* GetRing()
+		{
+			if (localRing != nullptr)
+				return localRing;
+
+			const uint32_t thread = ringCount.fetch_add(1);
+			if (thread >= maxThreads)
+				return nullptr;
+
+			localRing = new ThreadRing();
+			localRing->thread = thread;
+			rings[thread].store(localRing, std::memory_order_release);
+			return localRing;
+		}
+
+		void Push(ThreadRing& ring, const Event& event)
+		{
+			const uint64_t written = ring.written.load(std::memory_order_relaxed);
+			if (written - ring.read.load(std::memory_order_acquire) >= ringCapacity)
+			{
+				ring.dropped.fetch_add(1, std::memory_order_relaxed);
+				return;
+			}
+
+			ring.events[written & (ringCapacity - 1)] = event;
+			ring.written.store(written + 1, std::memory_order_release);
+		}
+	}
+
+	Zone::Zone(const char* name) : m_name{ name }, m_start{ Now() }
+	{
+		if (ThreadRing* ring = GetRing())
+			ring->depth++;
+	}
+
+	Zone::~Zone()
+	{
+		ThreadRing* ring = GetRing();
+		if (ring == nullptr)
+			return;
+
+		ring->depth--;
+
+		Event event;
+		event.name = m_name;
+		event.start = m_start;
+		event.end = Now();
+		event.thread = ring->thread;
+		event.depth = ring->depth;
+		Push(*ring, event);
+	}
+
+	void Counter(const char* name, double value)
+	{
+		ThreadRing* ring = GetRing();
+		if (ring == nullptr)
+			return;
+
+		Event event;
+		event.name = name;
+		event.start = Now();
+		event.end = event.start;
+		event.value = value;
+		event.thread = ring->thread;
+		event.depth = ring->depth;
+		event.counter = true;
+		Push(*ring, event);
+	}
+
+	void SetThreadName(const char* name)
+	{
+		if (ThreadRing* ring = GetRing())
+			ring->name.store(name, std::memory_order_release);
+	}
+
+	void EndFrame()
+	{
+		Frame frame;
+		frame.index = frameIndex++;
+		frame.start = frameStart;
+		frame.end = Now();
+		frameStart = frame.end;
+
+		const uint32_t count = std::min(ringCount.load(std::memory_order_acquire), maxThreads);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			ThreadRing* ring = rings[i].load(std::memory_order_acquire);
+			if (ring == nullptr)
+				continue;
+
+			const uint64_t written = ring->written.load(std::memory_order_acquire);
+			for (uint64_t read = ring->read.load(std::memory_order_relaxed); read < written; read++)
+				frame.events.push_back(ring->events[read & (ringCapacity - 1)]);
+			ring->read.store(written, std::memory_order_release);
+		}
+
+		std::sort(frame.events.begin(), frame.events.end(), [](const Event& a, const Event& b) {
+			if (a.thread != b.thread)
+				return a.thread < b.thread;
+			if (a.start != b.start)
+				return a.start < b.start;
+			return a.depth < b.depth;
+		});
+
+		frames.push_back(std::move(frame));
+		if (frames.size() > keptFrames)
+			frames.pop_front();
+	}
+
+	const Frame& GetLastFrame()
+	{
+		static const Frame empty;
+		return frames.empty() ? empty : frames.back();
+	}
+
+	const char* GetThreadName(uint32_t thread)
+	{
+		ThreadRing* ring = thread < maxThreads ? rings[thread].load(std::memory_order_acquire) : nullptr;
+		const char* name = ring != nullptr ? ring->name.load(std::memory_order_acquire) : nullptr;
+		return name != nullptr ? name : "thread";
+	}
+
+	uint64_t GetDroppedCount()
+	{
+		uint64_t dropped = 0;
+		const uint32_t count = std::min(ringCount.load(std::memory_order_acquire), maxThreads);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			if (ThreadRing* ring = rings[i].load(std::memory_order_acquire))
+				dropped += ring->dropped.load(std::memory_order_relaxed);
+		}
+		return dropped;
+	}
+
+	bool WriteChromeTrace(const std::string& path)
+	{
+		std::ofstream file(path);
+		if (!file.is_open())
+			return false;
+
+		// timestamps are in microseconds
+		file.setf(std::ios::fixed);
+		file.precision(3);
+		file << "{\"traceEvents\":[\n";
+
+		bool first = true;
+		const auto separator = [&]() {
+			if (!first)
+				file << ",\n";
+			first = false;
+		};
+
+		const uint32_t count = std::min(ringCount.load(std::memory_order_acquire), maxThreads);
+		for (uint32_t thread = 0; thread < count; thread++)
+		{
+			separator();
+			file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << thread << ",\"args\":{\"name\":\"" << GetThreadName(thread) << "\"}}";
+		}
+
+		for (const auto& frame : frames)
+		{
+			for (const auto& event : frame.events)
+			{
+				separator();
+				if (event.counter)
+				{
+					file << "{\"name\":\"" << event.name << "\",\"ph\":\"C\",\"ts\":" << event.start / 1000.0 << ",\"pid\":0,\"tid\":" << event.thread
+						<< ",\"args\":{\"value\":" << event.value << "}}";
+				}
+				else
+				{
+					file << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"ts\":" << event.start / 1000.0 << ",\"dur\":" << (event.end - event.start) / 1000.0
+						<< ",\"pid\":0,\"tid\":" << event.thread << "}";
+				}
+			}
+		}
+
+		file << "\n]}\n";
+		std::cout << "[ENIGMA]: Wrote CPU trace of " << frames.size() << " frames to " << path << std::endl;
+		return true;
+	}
+}
+
+#endif
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Zones and counters are only compiled into debug builds, in release the macros expand to nothing
+#if !defined(NDEBUG)
+#define ENIGMA_PROFILING
+#endif
+
+// CPU time of named scopes on every thread. Each thread records into a ring of its own, the thread that calls
+// EndFrame drains every ring once per frame without taking a lock. Names are string literals, only the pointer
+// is kept. Frames are grouped by when EndFrame is called, a zone belongs to the frame it ended in
+namespace Enigma::Profiler
+{
+	struct Event
+	{
+		const char* name = nullptr;
+		// nanoseconds since the profiler started, a counter only uses start
+		uint64_t start = 0;
+		uint64_t end = 0;
+		double value = 0.0;
+		uint32_t thread = 0;
+		// zones open on the thread when this one started
+		uint16_t depth = 0;
+		bool counter = false;
+	};
+
+	struct Frame
+	{
+		uint64_t index = 0;
+		uint64_t start = 0;
+		uint64_t end = 0;
+		// sorted by thread, then start, parents before their children
+		std::vector<Event> events;
+	};
+
+#if defined(ENIGMA_PROFILING)
+	// Records the time from construction to destruction on the calling thread
+	class Zone
+	{
+	public:
+		explicit Zone(const char* name);
+		~Zone();
+
+		Zone(const Zone&) = delete;
+		Zone& operator=(const Zone&) = delete;
+
+	private:
+		const char* m_name;
+		uint64_t m_start;
+	};
+
+	void Counter(const char* name, double value);
+	// Name the calling thread goes by in the trace, call before it records anything
+	void SetThreadName(const char* name);
+
+	// Collects what every thread recorded since the last call, once per frame from the thread that draws the UI
+	void EndFrame();
+	// The frame collected by the last EndFrame, only for the thread calling EndFrame
+	const Frame& GetLastFrame();
+	const char* GetThreadName(uint32_t thread);
+	// Events lost because a thread's ring was full when it recorded them
+	uint64_t GetDroppedCount();
+
+	// The frames still kept as Chrome trace event JSON, opens in chrome://tracing or Perfetto
+	bool WriteChromeTrace(const std::string& path);
+#endif
+}
+
+#if defined(ENIGMA_PROFILING)
+#define ENIGMA_PROFILE_CONCAT_INNER(a, b) a##b
+#define ENIGMA_PROFILE_CONCAT(a, b) ENIGMA_PROFILE_CONCAT_INNER(a, b)
+#define ENIGMA_PROFILE_ZONE(name) ::Enigma::Profiler::Zone ENIGMA_PROFILE_CONCAT(profileZone, __LINE__){ name }
+#define ENIGMA_PROFILE_COUNTER(name, value) ::Enigma::Profiler::Counter(name, static_cast<double>(value))
+#define ENIGMA_PROFILE_THREAD(name) ::Enigma::Profiler::SetThreadName(name)
+#define ENIGMA_PROFILE_FRAME() ::Enigma::Profiler::EndFrame()
+#else
+#define ENIGMA_PROFILE_ZONE(name)
+#define ENIGMA_PROFILE_COUNTER(name, value)
+#define ENIGMA_PROFILE_THREAD(name)
+#define ENIGMA_PROFILE_FRAME()
+#endif
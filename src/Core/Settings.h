@@ -15,8 +15,16 @@ namespace Enigma
 {
 	inline bool isDebug = true;
 	inline bool enablePlayerCamera = false;
-	inline std::vector<Model*> tempModels;
-	inline bool renderTemp = true;
+	// shot impacts, see DecalPass
+	inline bool drawDecals = true;
+	// static models are culled on the GPU and drawn with indirect draws, see GPUScene
+	inline bool gpuDrivenRendering = true;
+	inline bool occlusionCulling = true;
+	inline bool drawAABBs = true;
+	// lighting features, each combination is its own specialization of fs_lighting.frag, see LightingPermutation
+	inline bool screenSpaceReflections = true;
+	// 0 - single tap, 1 - poisson PCF
+	inline int shadowFilter = 0;
 
 	inline float translationAmplitude = 1.0f; // Adjust as needed
 	inline float translationFrequency = 1.0f; // Adjust as needed
@@ -0,0 +1,108 @@
+#include "SpatialHash.h"
+#include <algorithm>
+#include <cmath>
+
+namespace Enigma
+{
+	namespace
+	{
+		// on the xz plane, like the grid
+		float DistanceSq(const glm::vec3& a, const glm::vec3& b)
+		{
+			const glm::vec2 offset = glm::vec2(b.x - a.x, b.z - a.z);
+			return glm::dot(offset, offset);
+		}
+	}
+
+	SpatialHash::SpatialHash(float cellSize) : cellSize{ cellSize }
+	{
+	}
+
+	glm::ivec2 SpatialHash::CellOf(const glm::vec3& position) const
+	{
+		return glm::ivec2(static_cast<int>(std::floor(position.x / cellSize)), static_cast<int>(std::floor(position.z / cellSize)));
+	}
+
+	uint32_t SpatialHash::Bucket(const glm::ivec2& cell) const
+	{
+		// large primes to spread neighbouring cells over the table
+		return (static_cast<uint32_t>(cell.x) * 73856093u ^ static_cast<uint32_t>(cell.y) * 19349663u) & bucketMask;
+	}
+
+	void SpatialHash::Build(const std::vector<glm::vec3>& positions)
+	{
+		points = positions;
+
+		// twice as many buckets as points keeps collisions low, always a power of two so the hash can be masked
+		uint32_t bucketCount = 64;
+		while (bucketCount < points.size() * 2)
+			bucketCount <<= 1;
+		bucketMask = bucketCount - 1;
+
+		bucketStart.assign(bucketCount + 1, 0);
+		for (const auto& point : points)
+			bucketStart[Bucket(CellOf(point)) + 1]++;
+
+		for (uint32_t i = 0; i < bucketCount; i++)
+			bucketStart[i + 1] += bucketStart[i];
+
+		entries.resize(points.size());
+		std::vector<uint32_t> next(bucketStart.begin(), bucketStart.end() - 1);
+		for (int i = 0; i < static_cast<int>(points.size()); i++)
+			entries[next[Bucket(CellOf(points[i]))]++] = i;
+	}
+
+	int SpatialHash::Query(const glm::vec3& position, float radius, int ignore, int* results, int maxResults) const
+	{
+		if (points.empty() || maxResults <= 0)
+			return 0;
+
+		const glm::ivec2 lo = CellOf(position - glm::vec3(radius));
+		const glm::ivec2 hi = CellOf(position + glm::vec3(radius));
+		const float radiusSq = radius * radius;
+		int count = 0;
+
+		for (int z = lo.y; z <= hi.y; z++)
+		{
+			for (int x = lo.x; x <= hi.x; x++)
+			{
+				const glm::ivec2 cell = glm::ivec2(x, z);
+				const uint32_t bucket = Bucket(cell);
+				for (uint32_t e = bucketStart[bucket]; e < bucketStart[bucket + 1]; e++)
+				{
+					const int index = entries[e];
+					// different cells can share a bucket, only take points from the cell being visited
+					if (index == ignore || CellOf(points[index]) != cell)
+						continue;
+
+					const float distanceSq = DistanceSq(position, points[index]);
+					if (distanceSq > radiusSq)
+						continue;
+
+					if (count < maxResults)
+					{
+						results[count++] = index;
+						continue;
+					}
+
+					// full, the farthest kept point makes way for a closer one. maxResults is small, a scan is cheaper
+					// than keeping the results ordered
+					int farthest = 0;
+					float farthestSq = DistanceSq(position, points[results[0]]);
+					for (int r = 1; r < count; r++)
+					{
+						const float resultSq = DistanceSq(position, points[results[r]]);
+						if (resultSq > farthestSq)
+						{
+							farthest = r;
+							farthestSq = resultSq;
+						}
+					}
+					if (distanceSq < farthestSq)
+						results[farthest] = index;
+				}
+			}
+		}
+		return count;
+	}
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+
+namespace Enigma
+{
+	// Uniform grid on the xz plane hashed into a fixed number of buckets. Rebuilt from scratch every tick
+	// with a counting sort so the cost is linear in the number of points, nothing is kept between ticks
+	class SpatialHash
+	{
+	public:
+		explicit SpatialHash(float cellSize = 8.0f);
+
+		void Build(const std::vector<glm::vec3>& positions);
+
+		// Writes the indices of the maxResults points nearest to position within radius into results, in no
+		// particular order, skipping the point at index ignore. Returns how many were written
+		int Query(const glm::vec3& position, float radius, int ignore, int* results, int maxResults) const;
+
+		const glm::vec3& GetPosition(int index) const { return points[index]; }
+		size_t Size() const { return points.size(); }
+
+	private:
+		glm::ivec2 CellOf(const glm::vec3& position) const;
+		uint32_t Bucket(const glm::ivec2& cell) const;
+
+	private:
+		float cellSize;
+		uint32_t bucketMask = 0;
+		std::vector<uint32_t> bucketStart; // prefix sum of the bucket sizes, one extra entry at the end
+		std::vector<int> entries;          // point indices sorted by bucket
+		std::vector<glm::vec3> points;
+	};
+}
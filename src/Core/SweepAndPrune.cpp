@@ -0,0 +1,127 @@
+#include "SweepAndPrune.h"
+#include <algorithm>
+
+namespace Enigma
+{
+	bool SweepAndPrune::Before(const Endpoint& a, const Endpoint& b) const
+	{
+		// on a tie the min end goes first so bodies that only touch still count as overlapping
+		if (a.value != b.value)
+			return a.value < b.value;
+		return (a.data & 1u) < (b.data & 1u);
+	}
+
+	int SweepAndPrune::Add(const AABB& bounds, uint32_t layer, uint32_t mask, int user)
+	{
+		int proxy;
+		if (!freeProxies.empty())
+		{
+			proxy = freeProxies.back();
+			freeProxies.pop_back();
+		}
+		else
+		{
+			proxy = static_cast<int>(proxies.size());
+			proxies.emplace_back();
+		}
+		proxies[proxy] = { bounds, layer, mask, user, true };
+
+		// new ends go straight into their sorted place, the array stays sorted between frames
+		const Endpoint ends[] = {
+			{ bounds.min[axis], static_cast<uint32_t>(proxy) << 1 },
+			{ bounds.max[axis], (static_cast<uint32_t>(proxy) << 1) | 1u }
+		};
+		for (const auto& end : ends)
+		{
+			auto position = std::upper_bound(endpoints.begin(), endpoints.end(), end, [this](const Endpoint& a, const Endpoint& b) { return Before(a, b); });
+			endpoints.insert(position, end);
+		}
+		return proxy;
+	}
+
+	void SweepAndPrune::Remove(int proxy)
+	{
+		proxies[proxy].alive = false;
+		freeProxies.push_back(proxy);
+		endpoints.erase(std::remove_if(endpoints.begin(), endpoints.end(), [proxy](const Endpoint& end) {
+			return static_cast<int>(end.data >> 1) == proxy;
+		}), endpoints.end());
+	}
+
+	void SweepAndPrune::Update(int proxy, const AABB& bounds)
+	{
+		proxies[proxy].bounds = bounds;
+	}
+
+	void SweepAndPrune::Clear()
+	{
+		proxies.clear();
+		freeProxies.clear();
+		endpoints.clear();
+		pairs.clear();
+	}
+
+	const std::vector<std::pair<int, int>>& SweepAndPrune::FindPairs()
+	{
+		// refresh the ends from the current bounds, then insertion sort. The order from last frame is almost right
+		// so each end only moves past the few ends of bodies it crossed since then
+		for (auto& end : endpoints)
+		{
+			const Proxy& proxy = proxies[end.data >> 1];
+			end.value = (end.data & 1u) ? proxy.bounds.max[axis] : proxy.bounds.min[axis];
+		}
+
+		lastSwaps = 0;
+		for (size_t i = 1; i < endpoints.size(); i++)
+		{
+			const Endpoint end = endpoints[i];
+			size_t j = i;
+			while (j > 0 && Before(end, endpoints[j - 1]))
+			{
+				endpoints[j] = endpoints[j - 1];
+				j--;
+				lastSwaps++;
+			}
+			endpoints[j] = end;
+		}
+
+		// sweep: a body is active between its min and max end, everything it meets while active overlaps it on the axis
+		const int other0 = (axis + 1) % 3;
+		const int other1 = (axis + 2) % 3;
+		pairs.clear();
+		active.clear();
+		activeSlot.resize(proxies.size());
+		for (const auto& end : endpoints)
+		{
+			const int index = static_cast<int>(end.data >> 1);
+			if (end.data & 1u)
+			{
+				// swap remove from the active list
+				const int slot = activeSlot[index];
+				active[slot] = active.back();
+				activeSlot[active[slot]] = slot;
+				active.pop_back();
+				continue;
+			}
+
+			const Proxy& proxy = proxies[index];
+			for (int otherIndex : active)
+			{
+				const Proxy& other = proxies[otherIndex];
+				if (!(proxy.layer & other.mask) || !(other.layer & proxy.mask))
+					continue;
+
+				if (proxy.bounds.max[other0] < other.bounds.min[other0] || proxy.bounds.min[other0] > other.bounds.max[other0] ||
+					proxy.bounds.max[other1] < other.bounds.min[other1] || proxy.bounds.min[other1] > other.bounds.max[other1])
+					continue;
+
+				pairs.emplace_back(other.user, proxy.user);
+			}
+
+			activeSlot[index] = static_cast<int>(active.size());
+			active.push_back(index);
+		}
+
+		return pairs;
+	}
+}
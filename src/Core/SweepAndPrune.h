@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <glm/glm.hpp>
+#include "../Graphics/Model.h"
+
+namespace Enigma
+{
+	// Broadphase for moving bodies. The start and end of every body's bounds along one axis are kept in a sorted
+	// array between frames, bodies only move a little each frame so re-sorting with insertion sort is close to linear.
+	// One sweep over the sorted ends then finds every overlapping pair without testing bodies that are apart on the axis
+	class SweepAndPrune
+	{
+	public:
+		SweepAndPrune(int axis = 0) : axis{ axis } {}
+
+		// @layer - bits saying what the body is
+		// @mask - layers the body wants pairs with, a pair is only reported if each body's layer is in the other's mask
+		// @user - returned with the pairs, e.g. an index into the caller's own list of bodies
+		// Returns the proxy used to update or remove the body
+		int Add(const AABB& bounds, uint32_t layer, uint32_t mask, int user);
+		void Remove(int proxy);
+		void Update(int proxy, const AABB& bounds);
+		void Clear();
+
+		// Re-sorts the ends and returns the pairs of overlapping bodies as user values, valid until the next call
+		const std::vector<std::pair<int, int>>& FindPairs();
+
+		int GetUser(int proxy) const { return proxies[proxy].user; }
+		int GetProxyCount() const { return static_cast<int>(proxies.size()) - static_cast<int>(freeProxies.size()); }
+		// Swaps the last sort needed, close to the number of bodies that passed each other on the axis
+		size_t GetLastSwapCount() const { return lastSwaps; }
+
+	private:
+		struct Proxy
+		{
+			AABB bounds;
+			uint32_t layer;
+			uint32_t mask;
+			int user;
+			bool alive;
+		};
+
+		// one end of a body on the axis, data is the proxy index shifted up with the low bit set for the max end
+		struct Endpoint
+		{
+			float value;
+			uint32_t data;
+		};
+
+		bool Before(const Endpoint& a, const Endpoint& b) const;
+
+	private:
+		int axis;
+		std::vector<Proxy> proxies;
+		std::vector<int> freeProxies;
+		std::vector<Endpoint> endpoints;
+
+		// scratch for the sweep
+		std::vector<int> active;
+		std::vector<int> activeSlot;
+		std::vector<std::pair<int, int>> pairs;
+		size_t lastSwaps = 0;
+	};
+}
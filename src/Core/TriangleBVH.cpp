@@ -0,0 +1,386 @@
+#include "TriangleBVH.h"
+#include "BVH.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ENIGMA_TRIANGLE_SSE 1
+#include <emmintrin.h>
+#endif
+
+namespace Enigma
+{
+	namespace
+	{
+		constexpr int PacketWidth = 4;
+
+		float SurfaceArea(const glm::vec3& min, const glm::vec3& max)
+		{
+			const glm::vec3 d = max - min;
+			return 2.0f * (d.x * d.y + d.y * d.z + d.z * d.x);
+		}
+
+		bool RayBounds(const glm::vec3& min, const glm::vec3& max, const glm::vec3& origin, const glm::vec3& invDirection, float maxDistance, float& tEntry)
+		{
+			const glm::vec3 t0 = (min - origin) * invDirection;
+			const glm::vec3 t1 = (max - origin) * invDirection;
+			const glm::vec3 tNear = glm::min(t0, t1);
+			const glm::vec3 tFar = glm::max(t0, t1);
+			const float enter = std::max(std::max(tNear.x, tNear.y), std::max(tNear.z, 0.0f));
+			const float exit = std::min(std::min(tFar.x, tFar.y), std::min(tFar.z, maxDistance));
+			tEntry = enter;
+			return enter <= exit;
+		}
+
+		// Per ray setup of the watertight ray/triangle test (Woop, Benthin and Wald 2013). Triangles are sheared into
+		// a space where the ray runs down the z axis, the edge tests then only depend on the two vertices of an edge so
+		// neighbouring triangles agree exactly on their shared edge and a ray can't slip through the gap between them
+		struct WatertightRay
+		{
+			int kx, ky, kz;
+			float sx, sy, sz;
+			glm::vec3 origin;
+		};
+
+		WatertightRay SetupRay(const glm::vec3& origin, const glm::vec3& direction)
+		{
+			WatertightRay ray;
+			const glm::vec3 a = glm::abs(direction);
+			ray.kz = a.x > a.y ? (a.x > a.z ? 0 : 2) : (a.y > a.z ? 1 : 2);
+			ray.kx = (ray.kz + 1) % 3;
+			ray.ky = (ray.kx + 1) % 3;
+			// keep the winding the same when looking down the negative axis
+			if (direction[ray.kz] < 0.0f)
+				std::swap(ray.kx, ray.ky);
+
+			ray.sx = direction[ray.kx] / direction[ray.kz];
+			ray.sy = direction[ray.ky] / direction[ray.kz];
+			ray.sz = 1.0f / direction[ray.kz];
+			ray.origin = origin;
+			return ray;
+		}
+	}
+
+	void TriangleBVH::Build(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
+	{
+		nodes.clear();
+		packets.clear();
+		triangleCount = indices.size() / 3;
+		if (triangleCount == 0)
+			return;
+
+		std::vector<BuildTriangle> triangles(triangleCount);
+		for (size_t i = 0; i < triangleCount; i++)
+		{
+			BuildTriangle& triangle = triangles[i];
+			for (int k = 0; k < 3; k++)
+				triangle.corners[k] = vertices[indices[i * 3 + k]].pos;
+
+			triangle.min = glm::min(triangle.corners[0], glm::min(triangle.corners[1], triangle.corners[2]));
+			triangle.max = glm::max(triangle.corners[0], glm::max(triangle.corners[1], triangle.corners[2]));
+			triangle.centroid = (triangle.corners[0] + triangle.corners[1] + triangle.corners[2]) / 3.0f;
+			triangle.index = static_cast<int>(i);
+		}
+
+		nodes.reserve(triangleCount / 2 + 1);
+		packets.reserve(triangleCount / 2 + 1);
+		nodes.push_back({});
+		Subdivide(0, triangles, 0, static_cast<int>(triangleCount), 0);
+	}
+
+	void TriangleBVH::Subdivide(int node, std::vector<BuildTriangle>& triangles, int first, int count, int depth)
+	{
+		constexpr int binCount = 12;
+		// past this depth the split is forced down the middle so the traversal stack can't overflow
+		constexpr int maxSAHDepth = 48;
+
+		glm::vec3 boundsMin = glm::vec3(FLT_MAX);
+		glm::vec3 boundsMax = glm::vec3(-FLT_MAX);
+		glm::vec3 centroidMin = glm::vec3(FLT_MAX);
+		glm::vec3 centroidMax = glm::vec3(-FLT_MAX);
+		for (int i = first; i < first + count; i++)
+		{
+			boundsMin = glm::min(boundsMin, triangles[i].min);
+			boundsMax = glm::max(boundsMax, triangles[i].max);
+			centroidMin = glm::min(centroidMin, triangles[i].centroid);
+			centroidMax = glm::max(centroidMax, triangles[i].centroid);
+		}
+		nodes[node].min = boundsMin;
+		nodes[node].max = boundsMax;
+
+		if (count <= PacketWidth)
+		{
+			MakeLeaf(node, triangles, first, count);
+			return;
+		}
+
+		// a leaf is one packet so the node is always split, SAH only picks where
+		float bestCost = FLT_MAX;
+		int bestAxis = -1;
+		float bestSplit = 0.0f;
+		for (int axis = 0; axis < 3 && depth < maxSAHDepth; axis++)
+		{
+			const float extent = centroidMax[axis] - centroidMin[axis];
+			if (extent <= 1e-6f)
+				continue;
+
+			glm::vec3 binMin[binCount];
+			glm::vec3 binMax[binCount];
+			int binCounts[binCount] = {};
+			for (int i = 0; i < binCount; i++)
+			{
+				binMin[i] = glm::vec3(FLT_MAX);
+				binMax[i] = glm::vec3(-FLT_MAX);
+			}
+
+			const float scale = binCount / extent;
+			for (int i = first; i < first + count; i++)
+			{
+				const int bin = std::min(binCount - 1, static_cast<int>((triangles[i].centroid[axis] - centroidMin[axis]) * scale));
+				binCounts[bin]++;
+				binMin[bin] = glm::min(binMin[bin], triangles[i].min);
+				binMax[bin] = glm::max(binMax[bin], triangles[i].max);
+			}
+
+			float leftArea[binCount - 1];
+			int leftCount[binCount - 1];
+			glm::vec3 leftMin = glm::vec3(FLT_MAX);
+			glm::vec3 leftMax = glm::vec3(-FLT_MAX);
+			int leftSum = 0;
+			for (int i = 0; i < binCount - 1; i++)
+			{
+				leftSum += binCounts[i];
+				leftMin = glm::min(leftMin, binMin[i]);
+				leftMax = glm::max(leftMax, binMax[i]);
+				leftCount[i] = leftSum;
+				leftArea[i] = leftSum > 0 ? SurfaceArea(leftMin, leftMax) : 0.0f;
+			}
+
+			glm::vec3 rightMin = glm::vec3(FLT_MAX);
+			glm::vec3 rightMax = glm::vec3(-FLT_MAX);
+			int rightSum = 0;
+			for (int i = binCount - 1; i > 0; i--)
+			{
+				rightSum += binCounts[i];
+				rightMin = glm::min(rightMin, binMin[i]);
+				rightMax = glm::max(rightMax, binMax[i]);
+				if (leftCount[i - 1] == 0 || rightSum == 0)
+					continue;
+
+				// cost in packets rather than triangles, a half empty packet costs as much as a full one
+				const int leftPackets = (leftCount[i - 1] + PacketWidth - 1) / PacketWidth;
+				const int rightPackets = (rightSum + PacketWidth - 1) / PacketWidth;
+				const float cost = leftPackets * leftArea[i - 1] + rightPackets * SurfaceArea(rightMin, rightMax);
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = centroidMin[axis] + i / scale;
+				}
+			}
+		}
+
+		int leftCount = count / 2;
+		if (bestAxis != -1)
+		{
+			const auto middle = std::partition(triangles.begin() + first, triangles.begin() + first + count, [&](const BuildTriangle& triangle) {
+				return triangle.centroid[bestAxis] < bestSplit;
+			});
+			leftCount = static_cast<int>(middle - triangles.begin()) - first;
+			if (leftCount == 0 || leftCount == count)
+				leftCount = count / 2;
+		}
+
+		const int leftChild = static_cast<int>(nodes.size());
+		nodes.push_back({});
+		nodes.push_back({});
+		nodes[node].first = leftChild;
+		nodes[node].count = 0;
+
+		Subdivide(leftChild, triangles, first, leftCount, depth + 1);
+		Subdivide(leftChild + 1, triangles, first + leftCount, count - leftCount, depth + 1);
+	}
+
+	void TriangleBVH::MakeLeaf(int node, const std::vector<BuildTriangle>& triangles, int first, int count)
+	{
+		TrianglePacket packet = {};
+		for (int lane = 0; lane < PacketWidth; lane++)
+		{
+			packet.triangle[lane] = -1;
+			if (lane >= count)
+				continue;
+
+			const BuildTriangle& triangle = triangles[first + lane];
+			packet.triangle[lane] = triangle.index;
+			for (int vertex = 0; vertex < 3; vertex++)
+				for (int axis = 0; axis < 3; axis++)
+					packet.v[vertex][axis][lane] = triangle.corners[vertex][axis];
+		}
+
+		nodes[node].first = static_cast<int>(packets.size());
+		nodes[node].count = count;
+		packets.push_back(packet);
+	}
+
+	namespace
+	{
+		// Tests the ray against the four triangles of a packet, returns the lane of the closest hit nearer than
+		// closest or -1. Lanes holding a degenerate triangle have a zero determinant and never hit
+		template<typename Packet>
+		int IntersectPacket(const Packet& packet, const WatertightRay& ray, float closest, float& t)
+		{
+#if defined(ENIGMA_TRIANGLE_SSE)
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 ox = _mm_set1_ps(ray.origin[ray.kx]);
+			const __m128 oy = _mm_set1_ps(ray.origin[ray.ky]);
+			const __m128 oz = _mm_set1_ps(ray.origin[ray.kz]);
+			const __m128 sx = _mm_set1_ps(ray.sx);
+			const __m128 sy = _mm_set1_ps(ray.sy);
+			const __m128 sz = _mm_set1_ps(ray.sz);
+
+			// vertices relative to the ray origin, sheared so the ray is the z axis
+			__m128 az = _mm_sub_ps(_mm_load_ps(packet.v[0][ray.kz]), oz);
+			__m128 bz = _mm_sub_ps(_mm_load_ps(packet.v[1][ray.kz]), oz);
+			__m128 cz = _mm_sub_ps(_mm_load_ps(packet.v[2][ray.kz]), oz);
+			const __m128 ax = _mm_sub_ps(_mm_sub_ps(_mm_load_ps(packet.v[0][ray.kx]), ox), _mm_mul_ps(sx, az));
+			const __m128 ay = _mm_sub_ps(_mm_sub_ps(_mm_load_ps(packet.v[0][ray.ky]), oy), _mm_mul_ps(sy, az));
+			const __m128 bx = _mm_sub_ps(_mm_sub_ps(_mm_load_ps(packet.v[1][ray.kx]), ox), _mm_mul_ps(sx, bz));
+			const __m128 by = _mm_sub_ps(_mm_sub_ps(_mm_load_ps(packet.v[1][ray.ky]), oy), _mm_mul_ps(sy, bz));
+			const __m128 cx = _mm_sub_ps(_mm_sub_ps(_mm_load_ps(packet.v[2][ray.kx]), ox), _mm_mul_ps(sx, cz));
+			const __m128 cy = _mm_sub_ps(_mm_sub_ps(_mm_load_ps(packet.v[2][ray.ky]), oy), _mm_mul_ps(sy, cz));
+
+			// scaled barycentrics, a hit needs all three on the same side of zero
+			const __m128 u = _mm_sub_ps(_mm_mul_ps(cx, by), _mm_mul_ps(cy, bx));
+			const __m128 v = _mm_sub_ps(_mm_mul_ps(ax, cy), _mm_mul_ps(ay, cx));
+			const __m128 w = _mm_sub_ps(_mm_mul_ps(bx, ay), _mm_mul_ps(by, ax));
+			const __m128 anyNegative = _mm_or_ps(_mm_or_ps(_mm_cmplt_ps(u, zero), _mm_cmplt_ps(v, zero)), _mm_cmplt_ps(w, zero));
+			const __m128 anyPositive = _mm_or_ps(_mm_or_ps(_mm_cmpgt_ps(u, zero), _mm_cmpgt_ps(v, zero)), _mm_cmpgt_ps(w, zero));
+			const __m128 det = _mm_add_ps(u, _mm_add_ps(v, w));
+			__m128 valid = _mm_andnot_ps(_mm_and_ps(anyNegative, anyPositive), _mm_cmpneq_ps(det, zero));
+
+			// distance scaled by the determinant, compared without dividing by flipping both to the sign of det
+			az = _mm_mul_ps(sz, az);
+			bz = _mm_mul_ps(sz, bz);
+			cz = _mm_mul_ps(sz, cz);
+			const __m128 scaledT = _mm_add_ps(_mm_mul_ps(u, az), _mm_add_ps(_mm_mul_ps(v, bz), _mm_mul_ps(w, cz)));
+			const __m128 detSign = _mm_and_ps(det, _mm_set1_ps(-0.0f));
+			const __m128 signedT = _mm_xor_ps(scaledT, detSign);
+			const __m128 absDet = _mm_xor_ps(det, detSign);
+			valid = _mm_and_ps(valid, _mm_cmpgt_ps(signedT, zero));
+			valid = _mm_and_ps(valid, _mm_cmplt_ps(signedT, _mm_mul_ps(_mm_set1_ps(closest), absDet)));
+
+			int mask = _mm_movemask_ps(valid);
+			if (mask == 0)
+				return -1;
+
+			alignas(16) float distances[4];
+			_mm_store_ps(distances, _mm_div_ps(scaledT, det));
+			int lane = -1;
+			for (int i = 0; i < 4; i++)
+			{
+				if ((mask & (1 << i)) && distances[i] < closest)
+				{
+					closest = distances[i];
+					lane = i;
+				}
+			}
+			t = closest;
+			return lane;
+#else
+			int lane = -1;
+			for (int i = 0; i < 4; i++)
+			{
+				const float az = packet.v[0][ray.kz][i] - ray.origin[ray.kz];
+				const float bz = packet.v[1][ray.kz][i] - ray.origin[ray.kz];
+				const float cz = packet.v[2][ray.kz][i] - ray.origin[ray.kz];
+				const float ax = packet.v[0][ray.kx][i] - ray.origin[ray.kx] - ray.sx * az;
+				const float ay = packet.v[0][ray.ky][i] - ray.origin[ray.ky] - ray.sy * az;
+				const float bx = packet.v[1][ray.kx][i] - ray.origin[ray.kx] - ray.sx * bz;
+				const float by = packet.v[1][ray.ky][i] - ray.origin[ray.ky] - ray.sy * bz;
+				const float cx = packet.v[2][ray.kx][i] - ray.origin[ray.kx] - ray.sx * cz;
+				const float cy = packet.v[2][ray.ky][i] - ray.origin[ray.ky] - ray.sy * cz;
+
+				const float u = cx * by - cy * bx;
+				const float v = ax * cy - ay * cx;
+				const float w = bx * ay - by * ax;
+				if ((u < 0.0f || v < 0.0f || w < 0.0f) && (u > 0.0f || v > 0.0f || w > 0.0f))
+					continue;
+
+				const float det = u + v + w;
+				if (det == 0.0f)
+					continue;
+
+				const float distance = (u * ray.sz * az + v * ray.sz * bz + w * ray.sz * cz) / det;
+				if (distance > 0.0f && distance < closest)
+				{
+					closest = distance;
+					lane = i;
+				}
+			}
+			t = closest;
+			return lane;
+#endif
+		}
+	}
+
+	bool TriangleBVH::Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, TriangleHit& hit) const
+	{
+		if (nodes.empty())
+			return false;
+
+		const WatertightRay ray = SetupRay(origin, direction);
+		const glm::vec3 invDirection = InverseDirection(direction);
+		float closest = maxDistance;
+		bool found = false;
+
+		int stack[128];
+		int stackSize = 0;
+		stack[stackSize++] = 0;
+
+		while (stackSize > 0)
+		{
+			const Node& node = nodes[stack[--stackSize]];
+			float tNode;
+			if (!RayBounds(node.min, node.max, origin, invDirection, closest, tNode))
+				continue;
+
+			if (node.count > 0)
+			{
+				const TrianglePacket& packet = packets[node.first];
+				float t;
+				const int lane = IntersectPacket(packet, ray, closest, t);
+				if (lane != -1)
+				{
+					closest = t;
+					hit = { packet.triangle[lane], t };
+					found = true;
+				}
+				continue;
+			}
+
+			// nearer child first so closest shrinks before the far side is visited
+			float tLeft;
+			float tRight;
+			const bool hitLeft = RayBounds(nodes[node.first].min, nodes[node.first].max, origin, invDirection, closest, tLeft);
+			const bool hitRight = RayBounds(nodes[node.first + 1].min, nodes[node.first + 1].max, origin, invDirection, closest, tRight);
+			if (hitLeft && hitRight)
+			{
+				const bool leftFirst = tLeft <= tRight;
+				stack[stackSize++] = leftFirst ? node.first + 1 : node.first;
+				stack[stackSize++] = leftFirst ? node.first : node.first + 1;
+			}
+			else if (hitLeft)
+			{
+				stack[stackSize++] = node.first;
+			}
+			else if (hitRight)
+			{
+				stack[stackSize++] = node.first + 1;
+			}
+		}
+
+		return found;
+	}
+}
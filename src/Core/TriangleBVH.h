@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "../Graphics/Model.h"
+
+namespace Enigma
+{
+	struct TriangleHit
+	{
+		int triangle = -1;
+		float t = 0.0f;
+	};
+
+	// Bounding volume hierarchy over the triangles of one mesh in the mesh's own vertex space. Every leaf holds up to
+	// four triangles stored lane by lane so one ray is tested against all of them at once with SSE
+	class TriangleBVH
+	{
+	public:
+		void Build(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+
+		// Closest triangle hit within maxDistance. direction doesn't have to be normalized, t is measured in multiples
+		// of it so a ray transformed into mesh space gives the same t as in world space
+		bool Raycast(const glm::vec3& origin, const glm::vec3& direction, float maxDistance, TriangleHit& hit) const;
+
+		bool Empty() const { return nodes.empty(); }
+		size_t GetTriangleCount() const { return triangleCount; }
+
+	private:
+		struct Node
+		{
+			glm::vec3 min;
+			int first;   // interior: index of the left child, the right child follows it. leaf: index of the packet
+			glm::vec3 max;
+			int count;   // number of triangles in the packet, 0 for interior nodes
+		};
+
+		// v[vertex][axis][lane], unused lanes are degenerate triangles that can never be hit
+		struct TrianglePacket
+		{
+			alignas(16) float v[3][3][4];
+			int triangle[4];
+		};
+
+		// Scratch data for one build, every triangle's corners, bounds and centroid
+		struct BuildTriangle
+		{
+			glm::vec3 corners[3];
+			glm::vec3 min;
+			glm::vec3 max;
+			glm::vec3 centroid;
+			int index;
+		};
+
+		void Subdivide(int node, std::vector<BuildTriangle>& triangles, int first, int count, int depth);
+		void MakeLeaf(int node, const std::vector<BuildTriangle>& triangles, int first, int count);
+
+	private:
+		std::vector<Node> nodes;
+		std::vector<TrianglePacket> packets;
+		size_t triangleCount = 0;
+	};
+}
@@ -2,7 +2,11 @@
 #include <cassert>
 #include <algorithm>
 #include <unordered_set>
+#include <utility>
 #include "../Graphics/Common.h"
+#include "../Graphics/VulkanBuffer.h"
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
 
 namespace
 {
@@ -20,7 +24,7 @@ namespace
 	std::vector<VkImage> GetSwapchainImages(VkDevice device, VkSwapchainKHR swapchain);
 	std::vector<VkImageView> CreateSwapchainImageViews(VkDevice device, VkFormat format, const std::vector<VkImage>& images);
 	std::vector<VkFramebuffer> CreateSwapchainFramebuffers(VkDevice device, std::vector<VkImageView>& swapchainImageViews, Enigma::Image& depth, VkRenderPass renderPass, VkExtent2D extent);
-	VkRenderPass CreateSwapchainRenderPass(VkDevice device, VkFormat format);
+	VkRenderPass CreateSwapchainRenderPass(VkDevice device, VkFormat format, VkImageLayout finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
 
 	std::optional<uint32_t> FindQueueFamilyIndex(VkPhysicalDevice pDevice, VkSurfaceKHR surface, VkQueueFlagBits flags);
 }
@@ -42,6 +46,9 @@ namespace Enigma
 		for (const auto& view : swapchainImageViews)
 			vkDestroyImageView(context.device, view, nullptr);
 
+		for (size_t i = 0; i < offscreenAllocations.size(); i++)
+			vmaDestroyImage(context.allocator.allocator, swapchainImages[i], offscreenAllocations[i]);
+
 		if (renderPass != VK_NULL_HANDLE)
 			vkDestroyRenderPass(context.device, renderPass, nullptr);
 
@@ -105,6 +112,88 @@ namespace Enigma
 		windowContext.m_lastMousePosY = windowContext.swapchainExtent.height / 2.0f;
 	}
 
+	void MakeHeadlessWindow(VulkanWindow& windowContext, VulkanContext& context, Camera* camera, uint32_t width, uint32_t height)
+	{
+		windowContext.camera = camera;
+		windowContext.headless = true;
+		// the frame is copied out rather than presented
+		windowContext.presentLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+		// the same format a swapchain gets, so every pipeline is built exactly as it is with a window
+		windowContext.swapchainFormat = VK_FORMAT_B8G8R8A8_UNORM;
+		windowContext.swapchainExtent = VkExtent2D{ width, height };
+
+		// double buffered like the swapchain, there is no surface to ask for an image count
+		Enigma::MAX_FRAMES_IN_FLIGHT = 2;
+
+		Enigma::depth = Enigma::CreateImageTexture2D(context, width, height, VK_FORMAT_D32_SFLOAT, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_IMAGE_ASPECT_DEPTH_BIT);
+
+		for (int i = 0; i < Enigma::MAX_FRAMES_IN_FLIGHT; i++)
+		{
+			Image image = Enigma::CreateImageTexture2D(context, width, height, windowContext.swapchainFormat, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_IMAGE_ASPECT_COLOR_BIT);
+			windowContext.swapchainImages.push_back(std::exchange(image.image, VK_NULL_HANDLE));
+			windowContext.swapchainImageViews.push_back(std::exchange(image.imageView, VK_NULL_HANDLE));
+			windowContext.offscreenAllocations.push_back(std::exchange(image.allocation, VK_NULL_HANDLE));
+		}
+
+		windowContext.renderPass = CreateSwapchainRenderPass(context.device, windowContext.swapchainFormat, windowContext.presentLayout);
+		windowContext.swapchainFramebuffers = CreateSwapchainFramebuffers(context.device, windowContext.swapchainImageViews, Enigma::depth, windowContext.renderPass, windowContext.swapchainExtent);
+
+		windowContext.m_lastMousePosX = width / 2.0f;
+		windowContext.m_lastMousePosY = height / 2.0f;
+	}
+
+	bool SaveOffscreenImage(const VulkanContext& context, const VulkanWindow& window, uint32_t imageIndex, const std::string& path)
+	{
+		const uint32_t width = window.swapchainExtent.width;
+		const uint32_t height = window.swapchainExtent.height;
+		const VkDeviceSize size = VkDeviceSize(width) * height * 4;
+
+		Buffer readback = CreateBuffer(context.allocator, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT);
+
+		CommandPool pool = CreateCommandPool(context.device, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, context.graphicsFamilyIndex);
+		VkCommandBuffer cmd = AllocateCommandBuffer(context, pool.handle);
+		BeginCommandBuffer(cmd);
+
+		// the frame left the image in presentLayout, the copy waits on its last write
+		ImageBarrier(cmd, window.swapchainImages[imageIndex], VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT, window.presentLayout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+		VkBufferImageCopy copy{};
+		copy.imageSubresource = VkImageSubresourceLayers{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+		copy.imageExtent = VkExtent3D{ width, height, 1 };
+		vkCmdCopyImageToBuffer(cmd, window.swapchainImages[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback.buffer, 1, &copy);
+
+		VkBufferMemoryBarrier hostBarrier{ VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
+		hostBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+		hostBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		hostBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		hostBarrier.buffer = readback.buffer;
+		hostBarrier.size = VK_WHOLE_SIZE;
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &hostBarrier, 0, nullptr);
+
+		EndAndSubmitCommandBuffer(context, cmd);
+
+		void* data = nullptr;
+		ENIGMA_VK_CHECK(vmaMapMemory(context.allocator.allocator, readback.allocation, &data), "Failed to map offscreen readback buffer");
+		vmaInvalidateAllocation(context.allocator.allocator, readback.allocation, 0, VK_WHOLE_SIZE);
+
+		// BGRA to the RGBA a PNG is written from, every pixel is opaque
+		std::vector<uint8_t> pixels(static_cast<size_t>(size));
+		const uint8_t* source = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < pixels.size(); i += 4)
+		{
+			pixels[i + 0] = source[i + 2];
+			pixels[i + 1] = source[i + 1];
+			pixels[i + 2] = source[i + 0];
+			pixels[i + 3] = 255;
+		}
+		vmaUnmapMemory(context.allocator.allocator, readback.allocation);
+
+		return stbi_write_png(path.c_str(), static_cast<int>(width), static_cast<int>(height), 4, pixels.data(), static_cast<int>(width) * 4) != 0;
+	}
+
 	void TearDownSwapchain(const VulkanContext& context, VulkanWindow& window)
 	{
 		vkDeviceWaitIdle(context.device);
@@ -126,7 +215,6 @@ namespace Enigma
 
 	void RecreateSwapchain(const VulkanContext& context, VulkanWindow& window)
 	{
-		VkExtent2D previousExtent = window.swapchainExtent;
 		VkSwapchainKHR oldSwapchain = window.swapchain;
 		try
 		{
@@ -359,7 +447,7 @@ namespace
 		return framebuffers;
 	}
 
-	VkRenderPass CreateSwapchainRenderPass(VkDevice device, VkFormat format)
+	VkRenderPass CreateSwapchainRenderPass(VkDevice device, VkFormat format, VkImageLayout finalLayout)
 	{
 		VkAttachmentDescription attachment{};
 		attachment.format = format;
@@ -369,7 +457,7 @@ namespace
 		attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE; // not using stencil, use don't care
 		attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE; // not using stencil, use don't care
 		attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED; // layout of the resource as it enters render pass
-		attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR; // layout of resource at the end of the render pass
+		attachment.finalLayout = finalLayout; // layout of resource at the end of the render pass
 
 		// we need depth attachment, leaving it for now
 		//VkAttachmentDescription depthAttachment{};
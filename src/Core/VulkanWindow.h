@@ -40,7 +40,7 @@ namespace Enigma
 
 				if (GLFW_KEY_B == key && action == GLFW_PRESS)
 				{
-					Enigma::renderTemp = !Enigma::renderTemp;
+					Enigma::drawDecals = !Enigma::drawDecals;
 				}
 
 				if (glfwGetKey(windowClass->window, GLFW_KEY_P) == GLFW_PRESS)
@@ -101,6 +101,13 @@ namespace Enigma
 			VkExtent2D swapchainExtent{};
 			bool hasResized = false;
 
+			// no window or swapchain, offscreen images stand in for the swapchain images and are never presented.
+			// The window owns them, their memory is kept here
+			bool headless = false;
+			std::vector<VmaAllocation> offscreenAllocations;
+			// layout the swapchain images are left in by the last pass of the frame
+			VkImageLayout presentLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
 			double m_lastMousePosX;
 			double m_lastMousePosY;
 
@@ -110,6 +117,10 @@ namespace Enigma
 
 	VulkanWindow PrepareWindow(uint32_t width, uint32_t height, VulkanContext& context);
 	void MakeVulkanWindow(VulkanWindow& windowContext, VulkanContext& context, Camera* camera);
+	// Offscreen images of the given size in place of a surface and swapchain, the context needs no surface either
+	void MakeHeadlessWindow(VulkanWindow& windowContext, VulkanContext& context, Camera* camera, uint32_t width, uint32_t height);
+	// Writes an offscreen image to a PNG, call once the frame that rendered it has finished. False if it can't be written
+	bool SaveOffscreenImage(const VulkanContext& context, const VulkanWindow& window, uint32_t imageIndex, const std::string& path);
 	void RecreateSwapchain(const VulkanContext& context, VulkanWindow& window);
 	void TearDownSwapchain(const VulkanContext& context, VulkanWindow& window);
 }
\ No newline at end of file
@@ -5,6 +5,16 @@
 #include "../Graphics/Player.h"
 #include "../Graphics/Light.h"
 #include "../Graphics/Common.h"
+#include "SpatialHash.h"
+#include "JobSystem.h"
+#include "BVH.h"
+#include "Hitscan.h"
+#include "SweepAndPrune.h"
+#include "FrameSnapshot.h"
+#include "Profiler.h"
+#include <mutex>
+#include <optional>
+#include <utility>
 
 namespace Enigma
 {
@@ -17,8 +27,40 @@ namespace Enigma
 		std::vector<Enemy*> Enemies;
 		std::vector<Character*> Characters;
 		Player* player;
+		//positions of the living enemies, rebuilt every tick for neighbour queries
+		SpatialHash Crowd;
+		std::vector<glm::vec3> crowdPositions;
+		std::vector<int> crowdIndices;
+		//worker threads for the AI tick
+		JobSystem Jobs;
+		//bounds of every mesh for shooting, player collision and enemy line of sight
+		BVH CollisionBVH;
+		//triangles and bone capsules for exact hits on the meshes CollisionBVH finds
+		Hitscan HitTest;
+		//bounds of the player and enemies sorted along x, finds who is touching whom without testing every pair
+		SweepAndPrune Broadphase;
+		std::vector<int> broadphaseProxies;
+		//enemy index for each BVH primitive, -1 for the player
+		std::vector<int> broadphaseOwners;
+		//models the simulation moves, drawn from snapshots so the render thread never reads them directly
+		std::vector<Model*> SnapshotModels;
+		SnapshotBuffer Snapshots;
+		//newest input from the render thread
+		PlayerInput playerInput;
+		std::mutex inputMutex;
+		//UI edits to what the simulation moves, applied at the start of the next tick. Also under inputMutex
+		struct ModelEdit {
+			Model* model;
+			std::optional<glm::vec3> translation;
+			std::optional<glm::vec3> scale;
+		};
+		std::vector<ModelEdit> modelEdits;
+		std::optional<glm::vec3> playerPositionEdit;
 
-		void ManageAIs(std::vector<Character*> characters, Model* obj, Player* player, std::vector<Enemy*> Enemies, Time* timer) {
+		//one fixed simulation tick, timer->fixedDelta seconds long
+		void ManageAIs(Player* player, Time* timer) {
+			ENIGMA_PROFILE_ZONE("World::ManageAIs");
+			//gather: apply damage and deaths, then snapshot where every living enemy is this tick
 			for (int i = 0; i < Enemies.size(); i++) {
 				if (Enemies[i]->model->hit) {
 					Enemies[i]->health -= 20.f;
@@ -26,14 +68,37 @@ namespace Enigma
 					if (Enemies[i]->health < 0.f && !Enemies[i]->dead) {
 						Enemies[i]->dead = true;
 						Enemies[i]->model->dead = true;
-						Enemies[i]->deathTime = timer->current;
+						Enemies[i]->deathTime = timer->simTime;
 					}
 				}
-				Enemies[i]->ManageAI(characters, obj, player);
 			}
+			buildCrowd();
+			glm::vec3 target = player->GetPosition();
+
+			//plan and steer only read the snapshot and write to their own enemy so they run as parallel jobs,
+			//the result doesn't depend on which thread handles which enemy
+			const int grain = 4;
+			Jobs.ParallelFor(Enemies.size(), grain, [&](int begin, int end) {
+				ENIGMA_PROFILE_ZONE("planPath");
+				for (int i = begin; i < end; i++) {
+					if (crowdIndices[i] != -1) {
+						Enemies[i]->planPath(target, CollisionBVH);
+					}
+				}
+			});
+			Jobs.ParallelFor(Enemies.size(), grain, [&](int begin, int end) {
+				ENIGMA_PROFILE_ZONE("moveInDirection");
+				for (int i = begin; i < end; i++) {
+					if (crowdIndices[i] != -1) {
+						Enemies[i]->moveInDirection(Crowd, crowdIndices[i]);
+					}
+				}
+			});
+
+			//apply: respawns, death poses and movement are written back to the models on this thread
 			for (int i = 0; i < Enemies.size(); i++) {
 				if (Enemies[i]->health < 0.f) {
-					if (timer->current - Enemies[i]->deathTime > 10) {
+					if (timer->simTime - Enemies[i]->deathTime > 10) {
 						Enemies[i]->setRotationZ(0);
 						Enemies[i]->setTranslation(glm::vec3(60.f, 0.1f, 0.f));
 						Enemies[i]->setScale(glm::vec3(20.f));
@@ -50,34 +115,202 @@ namespace Enigma
 						Enemies[i]->setRotationMatrix(rm);
 					}
 				}
-				else {
-					Enemies[i]->moveInDirection();
+				else if (crowdIndices[i] != -1 && !Enemies[i]->touchingPlayer) {
+					Enemies[i]->applyMovement(static_cast<float>(timer->fixedDelta));
+				}
+			}
+
+			//enemies and the player have moved, the level didn't so the tree is refit rather than rebuilt
+			{
+				ENIGMA_PROFILE_ZONE("World::refit");
+				CollisionBVH.Refit();
+				updateBroadphase();
+			}
+		}
+
+		void updateBroadphase() {
+			const auto& primitives = CollisionBVH.GetPrimitives();
+			for (int i = 0; i < broadphaseProxies.size(); i++) {
+				Broadphase.Update(broadphaseProxies[i], primitives[Broadphase.GetUser(broadphaseProxies[i])].bounds);
+			}
+
+			for (auto* enemy : Enemies) {
+				enemy->touchingPlayer = false;
+			}
+			//the layer masks only let enemy vs player pairs through, so one side of every pair is the player
+			for (const auto& pair : Broadphase.FindPairs()) {
+				int enemy = std::max(broadphaseOwners[pair.first], broadphaseOwners[pair.second]);
+				if (enemy != -1 && !Enemies[enemy]->dead) {
+					Enemies[enemy]->touchingPlayer = true;
+				}
+			}
+		}
+
+		//render thread, once per frame
+		void setPlayerInput(const PlayerInput& input) {
+			std::lock_guard<std::mutex> lock(inputMutex);
+			playerInput = input;
+		}
+
+		//render thread, only for models in SnapshotModels, the render thread owns the rest
+		void editModel(const ModelEdit& edit) {
+			std::lock_guard<std::mutex> lock(inputMutex);
+			modelEdits.push_back(edit);
+		}
+
+		//render thread
+		void editPlayerPosition(glm::vec3 position) {
+			std::lock_guard<std::mutex> lock(inputMutex);
+			playerPositionEdit = position;
+		}
+
+		//simulation thread, one fixed tick of everything that moves
+		void tick(Time* timer) {
+			ENIGMA_PROFILE_ZONE("World::tick");
+			PlayerInput input;
+			std::vector<ModelEdit> edits;
+			std::optional<glm::vec3> playerPosition;
+			{
+				std::lock_guard<std::mutex> lock(inputMutex);
+				input = playerInput;
+				edits.swap(modelEdits);
+				playerPosition = std::exchange(playerPositionEdit, std::nullopt);
+			}
+
+			//in the order they were made, a later edit of the same model wins
+			for (const auto& edit : edits) {
+				if (edit.translation) {
+					edit.model->setTranslation(*edit.translation);
+				}
+				if (edit.scale) {
+					edit.model->setScale(*edit.scale);
+				}
+			}
+			if (playerPosition) {
+				player->SetPosition(*playerPosition);
+			}
+
+			//where everything starts the tick, the renderer blends from here to where it ends
+			FrameSnapshot& snapshot = Snapshots.BeginWrite();
+			snapshot.models.resize(SnapshotModels.size());
+			for (int i = 0; i < SnapshotModels.size(); i++) {
+				snapshot.models[i].previous = SnapshotModels[i]->GetModelMatrix();
+			}
+
+			//poses first so shots this tick hit the bones where they are drawn
+			{
+				ENIGMA_PROFILE_ZONE("updateAnimation2");
+				for (auto* enemy : Enemies) {
+					if (!enemy->model->m_animations.empty() && !enemy->dead) {
+						enemy->model->updateAnimation2(timer->simTime, 0);
+						enemy->model->UpdatePose();
+					}
+				}
+			}
+			if (input.active) {
+				player->Simulate(input, CollisionBVH, HitTest, static_cast<float>(timer->fixedDelta));
+			}
+			ManageAIs(player, timer);
+		}
+
+		//simulation thread, copies out what the renderer needs once the ticks for this frame are done
+		void publishSnapshot(Time* timer) {
+			FrameSnapshot& snapshot = Snapshots.BeginWrite();
+			snapshot.models.resize(SnapshotModels.size());
+			for (int i = 0; i < SnapshotModels.size(); i++) {
+				Model* model = SnapshotModels[i];
+				ModelSnapshot& pose = snapshot.models[i];
+				pose.current = model->GetModelMatrix();
+				pose.dead = model->dead;
+				if (!model->m_animations.empty()) {
+					model->CopyPose(pose.nodeMatrices);
+					pose.palette = model->GetBoneTransforms();
+				}
+			}
+			snapshot.playerPrevious = player->GetPreviousPosition();
+			snapshot.playerPosition = player->GetPosition();
+			snapshot.impacts.insert(snapshot.impacts.end(), player->impacts.begin(), player->impacts.end());
+			player->impacts.clear();
+			snapshot.step = timer->fixedDelta;
+			snapshot.tick = static_cast<uint64_t>(timer->simTime / timer->fixedDelta + 0.5);
+			snapshot.time = GetTime();
+			Snapshots.Publish();
+		}
+
+		//the player and enemies move, everything else is left to the render thread
+		void buildSnapshotModels() {
+			SnapshotModels.clear();
+			for (auto* model : Meshes) {
+				if (model->player || model->enemy) {
+					model->snapshotIndex = SnapshotModels.size();
+					SnapshotModels.push_back(model);
+					//a first pose so the first snapshot has one
+					if (!model->m_animations.empty()) {
+						model->UpdatePose();
+					}
 				}
-				float distanceFromPlayer = vec3Length(Enemies[i]->getTranslation() - player->GetPosition());
-				if (distanceFromPlayer < 2.f) {
-					//player->SetHealth(player->GetPosition() - 0.05);
+			}
+		}
+
+		void buildCrowd() {
+			crowdPositions.clear();
+			crowdIndices.assign(Enemies.size(), -1);
+			for (int i = 0; i < Enemies.size(); i++) {
+				if (!Enemies[i]->dead) {
+					crowdIndices[i] = crowdPositions.size();
+					crowdPositions.push_back(Enemies[i]->getTranslation());
 				}
 			}
+			Crowd.Build(crowdPositions);
 		}
 
-		void addMeshesToWorld(Player* p, std::vector<Enemy*> enemies) {
+		void addMeshesToWorld(Player* p, const std::vector<Enemy*>& enemies) {
 			this->Meshes.push_back(p->m_Model);
 			for (int i = 0; i < enemies.size(); i++) {
 				this->Meshes.push_back(enemies[i]->model);
 			}
 		}
 
-		void addCharactersToWorld(Player* p, std::vector<Enemy*> enemies) {
+		void addCharactersToWorld(Player* p, const std::vector<Enemy*>& enemies) {
 			//this->Characters.push_back(p);
 			for (int i = 0; i < enemies.size(); i++) {
 				this->Characters.push_back(enemies[i]);
 			}
 		}
 
-		void addCharctersToNavmesh(std::vector<Character*> characters) {
-			for (int i = 0; i < characters.size(); i++) {
-				this->Enemies[0]->addToNavmesh(characters[i], this->Meshes[0]);
+		void buildCollisionBVH() {
+			CollisionBVH.Build(Meshes);
+			HitTest.Build(Meshes);
+
+			//only the characters go in the broadphase, the level doesn't move and is already in the BVH
+			Broadphase.Clear();
+			broadphaseProxies.clear();
+			const auto& primitives = CollisionBVH.GetPrimitives();
+			broadphaseOwners.assign(primitives.size(), -1);
+			for (int i = 0; i < primitives.size(); i++) {
+				if (!primitives[i].dynamic) {
+					continue;
+				}
+				for (int e = 0; e < Enemies.size(); e++) {
+					if (Enemies[e]->model == primitives[i].model) {
+						broadphaseOwners[i] = e;
+					}
+				}
+				uint32_t layer = broadphaseOwners[i] == -1 ? COLLISION_PLAYER : COLLISION_ENEMY;
+				uint32_t mask = broadphaseOwners[i] == -1 ? COLLISION_ENEMY : COLLISION_PLAYER;
+				broadphaseProxies.push_back(Broadphase.Add(primitives[i].bounds, layer, mask, i));
+			}
+		}
+
+		void bakeNavmesh(Model* level) {
+			//levels without authored navmesh polygons get one baked from the floor and obstacle bounds
+			const float agentRadius = 3.f;
+			const float clusterSize = 64.f;
+			if (navmesh.Empty()) {
+				navmesh.Bake(level, agentRadius);
 			}
+			//long routes are searched on the cluster graph and refined a segment at a time
+			navHierarchy.Build(navmesh, clusterSize);
 		}
 	};
 
@@ -13,7 +13,6 @@ namespace Enigma
 		Model* model;
 		bool noModel = false;
 		bool moved = true;
-		int navmeshPosition;
 
 	private:
 		glm::vec3 translation = glm::vec3(0.f, 0.f, 0.f);
@@ -0,0 +1,63 @@
+#include "CommandRecorder.h"
+#include "GPUProfiler.h"
+#include "../Core/JobSystem.h"
+#include <cassert>
+
+namespace Enigma
+{
+	CommandRecorder::CommandRecorder(const VulkanContext& context, unsigned threadCount) : context{ context }
+	{
+		m_pools.resize(Enigma::MAX_FRAMES_IN_FLIGHT);
+		for (auto& framePools : m_pools)
+		{
+			framePools.resize(threadCount);
+			// the pools are only ever reset as a whole, never per buffer
+			for (auto& threadPool : framePools)
+				threadPool.pool = CreateCommandPool(context.device, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, context.graphicsFamilyIndex);
+		}
+	}
+
+	void CommandRecorder::BeginFrame(uint32_t frame)
+	{
+		m_frame = frame;
+		for (auto& threadPool : m_pools[frame])
+		{
+			ENIGMA_VK_CHECK(vkResetCommandPool(context.device, threadPool.pool.handle, 0), "Failed to reset secondary command pool");
+			threadPool.used = 0;
+		}
+	}
+
+	VkCommandBuffer CommandRecorder::Begin(VkRenderPass renderPass, VkFramebuffer framebuffer)
+	{
+		const unsigned thread = JobSystem::GetThreadIndex();
+		assert(thread < m_pools[m_frame].size());
+		ThreadPool& threadPool = m_pools[m_frame][thread];
+
+		if (threadPool.used == threadPool.buffers.size())
+		{
+			VkCommandBufferAllocateInfo allocInfo{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+			allocInfo.commandPool = threadPool.pool.handle;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			allocInfo.commandBufferCount = 1;
+
+			VkCommandBuffer cmd = VK_NULL_HANDLE;
+			ENIGMA_VK_CHECK(vkAllocateCommandBuffers(context.device, &allocInfo, &cmd), "Failed to allocate secondary command buffer");
+			threadPool.buffers.push_back(cmd);
+		}
+		VkCommandBuffer cmd = threadPool.buffers[threadPool.used++];
+
+		VkCommandBufferInheritanceInfo inheritance{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO };
+		inheritance.renderPass = renderPass;
+		inheritance.subpass = 0;
+		inheritance.framebuffer = framebuffer;
+		// the profiler's statistics query is active around every pass the secondaries are executed in
+		inheritance.pipelineStatistics = context.pipelineStatisticsSupported ? GPUProfiler::pipelineStatistics : 0;
+
+		VkCommandBufferBeginInfo begin{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+		begin.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+		begin.pInheritanceInfo = &inheritance;
+
+		ENIGMA_VK_CHECK(vkBeginCommandBuffer(cmd, &begin), "Failed to begin secondary command buffer");
+		return cmd;
+	}
+}
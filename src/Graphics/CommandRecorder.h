@@ -0,0 +1,40 @@
+#pragma once
+
+#include <vector>
+#include <Volk/volk.h>
+#include "Common.h"
+#include "VulkanContext.h"
+#include "VulkanObjects.h"
+
+namespace Enigma
+{
+	// Hands out secondary command buffers to the threads of a JobSystem. A command pool can only be used by one
+	// thread at a time, so each thread gets its own pool for every frame in flight. All of a frame's pools are reset
+	// together once its fence has signalled and the buffers allocated from them are reused the next time round
+	class CommandRecorder
+	{
+	public:
+		// @threadCount - JobSystem::GetThreadCount() of the job system the buffers are recorded on
+		CommandRecorder(const VulkanContext& context, unsigned threadCount);
+
+		// Call once the frame's fence has signalled, everything recorded for the frame last time is done with
+		void BeginFrame(uint32_t frame);
+
+		// Begins a secondary command buffer from the calling thread's pool that continues subpass 0 of renderPass.
+		// Nothing is inherited from the primary, the caller sets the viewport, pipeline and descriptor sets again
+		VkCommandBuffer Begin(VkRenderPass renderPass, VkFramebuffer framebuffer);
+
+	private:
+		struct ThreadPool
+		{
+			CommandPool pool;
+			std::vector<VkCommandBuffer> buffers;
+			size_t used = 0;
+		};
+
+		const VulkanContext& context;
+		// indexed by frame in flight then by JobSystem::GetThreadIndex()
+		std::vector<std::vector<ThreadPool>> m_pools;
+		uint32_t m_frame = 0;
+	};
+}
@@ -10,6 +10,11 @@
 #include "../Core/Error.h"
 #include "../Core/Engine.h"
 #include "VulkanImage.h"
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <unordered_map>
 
 class Model;
 
@@ -20,6 +25,14 @@ namespace Enigma
 	inline int MAX_FRAMES_IN_FLIGHT = 0;
 	inline int currentFrame = 0;
 
+	// Seconds since the first call. Any thread can read it, GLFW's clock belongs to the main thread and a headless
+	// run never initialises GLFW
+	inline double GetTime()
+	{
+		static const auto start = std::chrono::steady_clock::now();
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
 	class Time
 	{
 		public:
@@ -27,18 +40,43 @@ namespace Enigma
 				current = 0.0;
 				deltaTime = 0.0;
 				lastFrame = 0.0;
+				simTime = 0.0;
+				accumulator = 0.0;
 			}
 
 			void Update()
 			{
-				current = glfwGetTime();
+				current = GetTime();
 				deltaTime = current - lastFrame;
 				lastFrame = current;
+
+				// a long stall (loading, a breakpoint) is dropped rather than caught up with a burst of ticks
+				// that would make the next frame slow as well
+				accumulator += std::min(deltaTime, maxFrameTime) * timeScale;
+			}
+
+			// Call until it returns false, every true is one simulation tick of fixedDelta seconds.
+			// Gameplay only moves in these ticks so it behaves the same at any frame rate
+			bool Tick()
+			{
+				if (accumulator < fixedDelta)
+					return false;
+				accumulator -= fixedDelta;
+				simTime += fixedDelta;
+				return true;
 			}
 
 			double deltaTime;
 			double lastFrame;
 			double current;
+
+			// simulation clock, advanced by Tick()
+			double fixedDelta = 1.0 / 60.0;
+			double simTime;
+			double accumulator;
+			// speeds the simulation up or down without touching the frame rate
+			double timeScale = 1.0;
+			double maxFrameTime = 0.25;
 	};
 
 	inline Time* EngineTime;
@@ -56,35 +94,6 @@ namespace Enigma
 		float farPlane = 1000.0f;
 	};
 
-	struct Edge
-	{
-		int vertex2;
-		float weight;
-	};
-
-	struct Navmesh
-	{
-		int numberOfBaseNodes;
-		std::vector<glm::vec3> vertices;
-		std::vector<std::vector<Edge>> edges;
-	};
-
-	struct dijkstraData
-	{
-		std::vector<int> edgeFrom;
-		std::vector<float> distance;
-	};
-
-
-	// output textures from the g-buffer
-	struct GBufferTargets
-	{
-		Image position;
-		Image normals;
-		Image depth;
-		Image albedo;
-	};
-
 	struct Passes
 	{
 		Image lighting;
@@ -111,8 +120,22 @@ namespace Enigma
 
 	inline Debug debugSettings;
 
+	class GeometryArena;
+	// vertices and indices of every loaded mesh, owned by the renderer
+	inline GeometryArena* geometryArena = nullptr;
+	class TextureCache;
+	// every material texture and the material table, owned by the renderer
+	inline TextureCache* textureCache = nullptr;
+	class InstanceBuffer;
+	// model matrices of the render queues' instanced draws, owned by the renderer
+	inline InstanceBuffer* instanceBuffer = nullptr;
+	class UniformRing;
+	// the frame's uniforms and other small per frame buffers, owned by the renderer
+	inline UniformRing* uniformRing = nullptr;
+
 	inline VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
-	inline VkDescriptorSetLayout descriptorLayoutModel = VK_NULL_HANDLE;
+	// every pipeline is created with it, kept on disk between runs by the renderer's PipelineCache
+	inline VkPipelineCache pipelineCache = VK_NULL_HANDLE;
     inline VkDescriptorSetLayout boneTransformDescriptorLayout= VK_NULL_HANDLE;
 
 	inline Sampler sampler;
@@ -126,7 +149,6 @@ namespace Enigma
 	inline VkSampler defaultSampler; // a default sampler for sampling textures 
 	inline VkSampler repeatSampler;
 	inline VkPipeline draw_line_list; // pipeline to draw meshes as a line
-	inline Navmesh navmesh;
 }
 
 namespace Enigma
@@ -277,8 +299,18 @@ namespace Enigma
 		return CommandPool{ device, commandPool };
 	}
 
-	inline ShaderModule CreateShaderModule(const std::string& filename, VkDevice device)
+	// SPIR-V of a shader file, every file is read once however many pipelines use it. Pipelines are created on
+	// several threads at once, see RenderGraph::Compile
+	inline const std::vector<uint32_t>& ReadShaderFile(const std::string& filename)
 	{
+		static std::mutex mutex;
+		static std::unordered_map<std::string, std::vector<uint32_t>> files;
+
+		std::lock_guard<std::mutex> lock(mutex);
+		const auto cached = files.find(filename);
+		if (cached != files.end())
+			return cached->second;
+
 		std::ifstream file(filename, std::ios::ate | std::ios::binary);
 		if (!file.is_open())
 		{
@@ -286,16 +318,23 @@ namespace Enigma
 		}
 
 		size_t fileSize = (size_t)file.tellg();
-		std::vector<char> buffer(fileSize);
+		std::vector<uint32_t> code((fileSize + sizeof(uint32_t) - 1) / sizeof(uint32_t));
 
 		file.seekg(0);
-		file.read(buffer.data(), fileSize);
+		file.read(reinterpret_cast<char*>(code.data()), fileSize);
 
 		file.close();
 
+		return files.emplace(filename, std::move(code)).first->second;
+	}
+
+	inline ShaderModule CreateShaderModule(const std::string& filename, VkDevice device)
+	{
+		const std::vector<uint32_t>& code = ReadShaderFile(filename);
+
 		VkShaderModuleCreateInfo shadermoduleInfo{ VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO };
-		shadermoduleInfo.codeSize = buffer.size();
-		shadermoduleInfo.pCode = reinterpret_cast<const uint32_t*>(buffer.data());
+		shadermoduleInfo.codeSize = code.size() * sizeof(uint32_t);
+		shadermoduleInfo.pCode = code.data();
 
 		VkShaderModule shaderModule = VK_NULL_HANDLE;
 		if (vkCreateShaderModule(device, &shadermoduleInfo, nullptr, &shaderModule) != VK_SUCCESS)
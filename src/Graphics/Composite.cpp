@@ -5,13 +5,21 @@
 
 namespace Enigma
 {
-	Composite::Composite(const VulkanContext& context, const VulkanWindow& window, Image& LightingPass) : context{context}, window{window}, m_LightingPass{LightingPass}
+	Composite::Composite(const VulkanContext& context, const VulkanWindow& window, RenderGraph& graph, RenderResource lighting, RenderResource swapchain) : context{context}, window{window}, m_lighting{lighting}
 	{
-		m_width = window.swapchainExtent.width;
-		m_height = window.swapchainExtent.height;
+		m_RenderPass = VK_NULL_HANDLE;
+		m_descriptorSetLayout = VK_NULL_HANDLE;
+
+		m_pass = graph.AddPass("composite", [&](RenderGraph::PassBuilder& builder) {
+			VkClearValue clearColour{};
+			clearColour.color = { {0.0f, 0.0f, 0.5f, 1.0f} };
+
+			builder.Read(lighting);
+			builder.Write(swapchain, true, clearColour);
+			builder.OnCompiled([this](const RenderGraph& graph) { OnCompiled(graph); });
+		});
 
 		BuildDescriptorSetLayout(context);
-		CreatePipeline(context.device, window.swapchainExtent);
 	}
 
 	Composite::~Composite()
@@ -21,18 +29,28 @@ namespace Enigma
 			vkDestroyDescriptorSetLayout(context.device, m_descriptorSetLayout, nullptr);
 		}
 	}
-	void Composite::Execute(VkCommandBuffer cmd)
+
+	void Composite::OnCompiled(const RenderGraph& graph)
 	{
-		VkRenderPassBeginInfo rpBegin{ VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
-		rpBegin.renderPass = window.renderPass;
-		rpBegin.framebuffer = window.swapchainFramebuffers[Enigma::currentFrame]; // this should be image index
-		rpBegin.renderArea.extent = { window.swapchainExtent.width, window.swapchainExtent.height };
-		
-		VkClearValue clearValues[1];
-		clearValues[0].color = { {0.0f, 0.0f, 0.5f, 1.0f} };
-		rpBegin.clearValueCount = 1;
-		rpBegin.pClearValues = clearValues;
+		m_RenderPass = graph.GetRenderPass(m_pass);
+		m_width = graph.GetExtent(m_pass).width;
+		m_height = graph.GetExtent(m_pass).height;
+
+		if (m_pipeline.handle == VK_NULL_HANDLE)
+			CreatePipeline(context.device, graph.GetExtent(m_pass));
 
+		for (size_t i = 0; i < Enigma::MAX_FRAMES_IN_FLIGHT; i++)
+		{
+			VkDescriptorImageInfo imageInfo = {};
+			imageInfo.imageLayout = graph.GetReadLayout(m_lighting);
+			imageInfo.imageView = graph.GetImageView(m_lighting);
+			imageInfo.sampler = Enigma::defaultSampler;
+			UpdateDescriptorSet(context, 1, imageInfo, m_descriptorSets[i], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+		}
+	}
+
+	void Composite::Record(VkCommandBuffer cmd)
+	{
 		VkViewport viewport{};
 		viewport.x = 0.0f;
 		viewport.y = 0.0f;
@@ -47,30 +65,12 @@ namespace Enigma
 		scissor.extent = { m_width, m_height };
 		vkCmdSetScissor(cmd, 0, 1, &scissor);
 
-		vkCmdBeginRenderPass(cmd, &rpBegin, VK_SUBPASS_CONTENTS_INLINE);
 		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline.handle);
 
 		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout.handle, 0, 1, &m_descriptorSets[Enigma::currentFrame], 0, nullptr);
 
 		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline.handle);
 		vkCmdDraw(cmd, 3, 1, 0, 0);
-		
-		vkCmdEndRenderPass(cmd);
-
-	}
-	void Composite::Resize(VulkanWindow& window)
-	{
-		m_width = window.swapchainExtent.width;
-		m_height = window.swapchainExtent.height;
-
-		for (size_t i = 0; i < Enigma::MAX_FRAMES_IN_FLIGHT; i++)
-		{
-			VkDescriptorImageInfo imageInfo = {};
-			imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			imageInfo.imageView = m_LightingPass.imageView;// need the g-buffer normals texture image view
-			imageInfo.sampler = Enigma::defaultSampler;
-			UpdateDescriptorSet(context, 1, imageInfo, m_descriptorSets[i], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
-		}
 	}
 	void Composite::CreatePipeline(VkDevice device, VkExtent2D swapchainExtent)
 	{
@@ -184,11 +184,11 @@ namespace Enigma
 		pipelineInfo.pColorBlendState = &blendInfo;
 		pipelineInfo.pDynamicState = &dynamicState;
 		pipelineInfo.layout = m_pipelineLayout.handle;
-		pipelineInfo.renderPass = window.renderPass;
+		pipelineInfo.renderPass = m_RenderPass;
 		pipelineInfo.subpass = 0;
 
 		VkPipeline pipeline = VK_NULL_HANDLE;
-		ENIGMA_VK_CHECK(vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline), "Failed to create graphics pipeline.");
+		ENIGMA_VK_CHECK(vkCreateGraphicsPipelines(device, Enigma::pipelineCache, 1, &pipelineInfo, nullptr, &pipeline), "Failed to create graphics pipeline.");
 
 		m_pipeline = Pipeline(device, pipeline);
 	}
@@ -209,14 +209,5 @@ namespace Enigma
 		}
 
 		AllocateDescriptorSets(context, Enigma::descriptorPool, m_descriptorSetLayout, Enigma::MAX_FRAMES_IN_FLIGHT, m_descriptorSets);
-
-		for (size_t i = 0; i < Enigma::MAX_FRAMES_IN_FLIGHT; i++)
-		{
-			VkDescriptorImageInfo imageInfo = {};
-			imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			imageInfo.imageView = m_LightingPass.imageView;// need the g-buffer normals texture image view
-			imageInfo.sampler = Enigma::defaultSampler;
-			UpdateDescriptorSet(context, 1, imageInfo, m_descriptorSets[i], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
-		}
 	}
 }
\ No newline at end of file
@@ -20,12 +20,14 @@ namespace Enigma
 	class Composite
 	{
 	public:
-		Composite(const VulkanContext& context, const VulkanWindow& window, Image& LightingPass);
+		Composite(const VulkanContext& context, const VulkanWindow& window, RenderGraph& graph, RenderResource lighting, RenderResource swapchain);
 		~Composite();
 
-		void Execute(VkCommandBuffer cmd);
-		void Resize(VulkanWindow& window);
+		// Draws the lighting output to the swapchain image inside the graph's render pass
+		void Record(VkCommandBuffer cmd);
+		RenderGraphPass GetPass() const { return m_pass; }
 	private:
+		void OnCompiled(const RenderGraph& graph);
 		void CreatePipeline(VkDevice device, VkExtent2D swapchainExtent);
 		void BuildDescriptorSetLayout(const VulkanContext& context);
 	private:
@@ -35,9 +37,10 @@ namespace Enigma
 		uint32_t m_height;
 		Pipeline m_pipeline;
 		PipelineLayout m_pipelineLayout;
+		VkRenderPass m_RenderPass;
+		RenderGraphPass m_pass;
 		VkDescriptorSetLayout m_descriptorSetLayout;
 		std::vector<VkDescriptorSet> m_descriptorSets;
-		Image renderTarget;
-		Image& m_LightingPass;
+		RenderResource m_lighting;
 	};
 };
\ No newline at end of file
@@ -0,0 +1,250 @@
+#include "DecalPass.h"
+#include "UniformRing.h"
+#include "../Core/Settings.h"
+#include <cstring>
+#include <algorithm>
+
+namespace Enigma
+{
+	namespace
+	{
+		// world units, about the size of the old cube markers
+		constexpr float decalRadius = 0.75f;
+		// a box is 12 triangles, decal.vert builds them from gl_VertexIndex
+		constexpr uint32_t boxVertexCount = 36;
+	}
+
+	DecalPass::DecalPass(const VulkanContext& context, RenderGraph& graph, const GBufferTargets& targets, VkFormat albedoFormat) : context{ context }, m_positions{ targets.position }
+	{
+		m_decals.resize(maxDecals);
+
+		// blending into a 32 bit float target is optional, without it the marks have a hard edge
+		VkFormatProperties properties{};
+		vkGetPhysicalDeviceFormatProperties(context.physicalDevice, albedoFormat, &properties);
+		m_blend = (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BLEND_BIT) != 0;
+
+		// reads the position the g-buffer wrote and draws over its albedo before the lighting reads it
+		m_pass = graph.AddPass("decals", [&](RenderGraph::PassBuilder& builder) {
+			builder.Read(targets.position);
+			builder.Write(targets.albedo, false);
+			builder.OnCompiled([this](const RenderGraph& graph) { OnCompiled(graph); });
+		});
+
+		BuildDescriptorSetLayout(context);
+	}
+
+	DecalPass::~DecalPass()
+	{
+		if (m_descriptorSetLayout != VK_NULL_HANDLE)
+		{
+			vkDestroyDescriptorSetLayout(context.device, m_descriptorSetLayout, nullptr);
+		}
+	}
+
+	void DecalPass::Add(const std::vector<glm::vec3>& points)
+	{
+		for (const auto& point : points)
+		{
+			m_decals[m_next] = glm::vec4(point, decalRadius);
+			m_next = (m_next + 1) % maxDecals;
+			m_count = std::min(m_count + 1, maxDecals);
+		}
+	}
+
+	void DecalPass::OnCompiled(const RenderGraph& graph)
+	{
+		m_RenderPass = graph.GetRenderPass(m_pass);
+		m_width = graph.GetExtent(m_pass).width;
+		m_height = graph.GetExtent(m_pass).height;
+
+		if (m_pipeline.handle == VK_NULL_HANDLE)
+			CreatePipeline(context.device);
+
+		for (int i = 0; i < Enigma::MAX_FRAMES_IN_FLIGHT; i++)
+		{
+			VkDescriptorImageInfo imageInfo = {};
+			imageInfo.imageLayout = graph.GetReadLayout(m_positions);
+			imageInfo.imageView = graph.GetImageView(m_positions);
+			imageInfo.sampler = Enigma::defaultSampler;
+			UpdateDescriptorSet(context, 2, imageInfo, m_descriptorSets[i], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+		}
+	}
+
+	void DecalPass::Record(VkCommandBuffer cmd)
+	{
+		if (!Enigma::drawDecals || m_count == 0)
+			return;
+
+		VkViewport viewport{};
+		viewport.x = 0.0f;
+		viewport.y = 0.0f;
+		viewport.width = (float)m_width;
+		viewport.height = (float)m_height;
+		viewport.minDepth = 0.0f;
+		viewport.maxDepth = 1.0f;
+		vkCmdSetViewport(cmd, 0, 1, &viewport);
+
+		VkRect2D scissor{};
+		scissor.offset = { 0,0 };
+		scissor.extent = { m_width, m_height };
+		vkCmdSetScissor(cmd, 0, 1, &scissor);
+
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline.handle);
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout.handle, 0, 1, &m_descriptorSets[Enigma::currentFrame], 2, m_uniformOffsets);
+
+		const uint32_t blend = m_blend ? 1 : 0;
+		vkCmdPushConstants(cmd, m_pipelineLayout.handle, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(uint32_t), &blend);
+
+		// no vertex buffer, the box corners come from gl_VertexIndex and the decal from gl_InstanceIndex
+		vkCmdDraw(cmd, boxVertexCount, m_count, 0, 0);
+	}
+
+	void DecalPass::Update(Camera* camera)
+	{
+		m_uniformOffsets[0] = Enigma::uniformRing->Push(camera->GetCameraTransform());
+
+		// the binding reads maxDecals slots, only the ones in use are copied
+		m_uniformOffsets[1] = Enigma::uniformRing->Allocate(sizeof(glm::vec4) * maxDecals);
+		std::memcpy(Enigma::uniformRing->GetData(m_uniformOffsets[1]), m_decals.data(), sizeof(glm::vec4) * m_count);
+	}
+
+	void DecalPass::CreatePipeline(VkDevice device)
+	{
+		ShaderModule vertexShader = CreateShaderModule(DECAL_VERTEX, device);
+		ShaderModule fragmentShader = CreateShaderModule(DECAL_FRAGMENT, device);
+
+		VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
+		vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+		vertShaderStageInfo.module = vertexShader.handle;
+		vertShaderStageInfo.pName = "main";
+
+		VkPipelineShaderStageCreateInfo fragShaderStageInfo{};
+		fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+		fragShaderStageInfo.module = fragmentShader.handle;
+		fragShaderStageInfo.pName = "main";
+
+		VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
+
+		VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
+		vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+		VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
+		inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+		inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+		inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+		std::vector<VkDynamicState> dynamicStates = {
+			VK_DYNAMIC_STATE_VIEWPORT,
+			VK_DYNAMIC_STATE_SCISSOR
+		};
+
+		VkPipelineDynamicStateCreateInfo dynamicState{};
+		dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+		dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+		dynamicState.pDynamicStates = dynamicStates.data();
+
+		VkPipelineViewportStateCreateInfo viewportInfo{};
+		viewportInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+		viewportInfo.viewportCount = 1;
+		viewportInfo.scissorCount = 1;
+
+		// the back faces, so a box the camera is inside is still drawn
+		VkPipelineRasterizationStateCreateInfo rasterInfo{};
+		rasterInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+		rasterInfo.depthClampEnable = VK_FALSE;
+		rasterInfo.rasterizerDiscardEnable = VK_FALSE;
+		rasterInfo.polygonMode = VK_POLYGON_MODE_FILL;
+		rasterInfo.cullMode = VK_CULL_MODE_FRONT_BIT;
+		rasterInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+		rasterInfo.depthBiasClamp = VK_FALSE;
+		rasterInfo.lineWidth = 1.0f;
+
+		VkPipelineMultisampleStateCreateInfo samplingInfo{ VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO };
+		samplingInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+		// the albedo's alpha is left alone
+		VkPipelineColorBlendAttachmentState blendStates[1]{};
+		blendStates[0].colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT;
+		blendStates[0].blendEnable = m_blend ? VK_TRUE : VK_FALSE;
+		blendStates[0].srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+		blendStates[0].dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+		blendStates[0].colorBlendOp = VK_BLEND_OP_ADD;
+		blendStates[0].srcAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+		blendStates[0].dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+		blendStates[0].alphaBlendOp = VK_BLEND_OP_ADD;
+
+		VkPipelineColorBlendStateCreateInfo blendInfo{ VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO };
+		blendInfo.logicOpEnable = VK_FALSE;
+		blendInfo.attachmentCount = 1;
+		blendInfo.pAttachments = blendStates;
+
+		// the pass has no depth attachment, the g-buffer position decides what is covered
+		VkPipelineDepthStencilStateCreateInfo depthInfo{};
+		depthInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+		depthInfo.depthTestEnable = VK_FALSE;
+		depthInfo.depthWriteEnable = VK_FALSE;
+		depthInfo.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+		depthInfo.minDepthBounds = 0.0f;
+		depthInfo.maxDepthBounds = 1.0f;
+
+		// tells decal.frag whether its alpha is blended or has to be a hard cut
+		VkPushConstantRange pushConstant{};
+		pushConstant.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		pushConstant.offset = 0;
+		pushConstant.size = sizeof(uint32_t);
+
+		VkPipelineLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		layoutInfo.setLayoutCount = 1;
+		layoutInfo.pSetLayouts = &m_descriptorSetLayout;
+		layoutInfo.pushConstantRangeCount = 1;
+		layoutInfo.pPushConstantRanges = &pushConstant;
+
+		VkPipelineLayout layout = VK_NULL_HANDLE;
+		ENIGMA_VK_CHECK(vkCreatePipelineLayout(device, &layoutInfo, nullptr, &layout), "Failed to create pipeline layout");
+
+		m_pipelineLayout = PipelineLayout(device, layout);
+
+		VkGraphicsPipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+		pipelineInfo.stageCount = 2;
+		pipelineInfo.pStages = shaderStages;
+		pipelineInfo.pVertexInputState = &vertexInputInfo;
+		pipelineInfo.pInputAssemblyState = &inputAssembly;
+		pipelineInfo.pTessellationState = nullptr;
+		pipelineInfo.pViewportState = &viewportInfo;
+		pipelineInfo.pRasterizationState = &rasterInfo;
+		pipelineInfo.pMultisampleState = &samplingInfo;
+		pipelineInfo.pDepthStencilState = &depthInfo;
+		pipelineInfo.pColorBlendState = &blendInfo;
+		pipelineInfo.pDynamicState = &dynamicState;
+		pipelineInfo.layout = m_pipelineLayout.handle;
+		pipelineInfo.renderPass = m_RenderPass;
+		pipelineInfo.subpass = 0;
+
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		ENIGMA_VK_CHECK(vkCreateGraphicsPipelines(device, Enigma::pipelineCache, 1, &pipelineInfo, nullptr, &pipeline), "Failed to create graphics pipeline.");
+
+		m_pipeline = Pipeline(device, pipeline);
+	}
+
+	void DecalPass::BuildDescriptorSetLayout(const VulkanContext& context)
+	{
+		std::vector<VkDescriptorSetLayoutBinding> bindings = {
+			CreateDescriptorBinding(0, 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT),
+			CreateDescriptorBinding(1, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT),
+			CreateDescriptorBinding(2, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
+		};
+		m_descriptorSetLayout = CreateDescriptorSetLayout(context, bindings);
+
+		AllocateDescriptorSets(context, Enigma::descriptorPool, m_descriptorSetLayout, Enigma::MAX_FRAMES_IN_FLIGHT, m_descriptorSets);
+
+		for (int i = 0; i < Enigma::MAX_FRAMES_IN_FLIGHT; i++)
+		{
+			UpdateDescriptorSet(context, 0, Enigma::uniformRing->GetDescriptorInfo(sizeof(CameraTransform)), m_descriptorSets[i], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
+			UpdateDescriptorSet(context, 1, Enigma::uniformRing->GetDescriptorInfo(sizeof(glm::vec4) * maxDecals), m_descriptorSets[i], VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC);
+		}
+	}
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include "Common.h"
+#include "VulkanContext.h"
+#include "RenderGraph.h"
+#include "GBuffer.h"
+
+#define DECAL_VERTEX "../resources/Shaders/decal.vert.spv"
+#define DECAL_FRAGMENT "../resources/Shaders/decal.frag.spv"
+
+namespace Enigma
+{
+	// Shot impacts drawn as deferred decals. The newest maxDecals impacts are kept in a ring, a new one replaces
+	// the oldest once it is full, so memory and cost stay the same however long the shooting goes on. Every decal
+	// is a box around the impact, all of them drawn with one instanced draw between the g-buffer and the lighting.
+	// The fragment shader reads the g-buffer position behind the box and darkens the albedo where that position is
+	// inside the decal's sphere, the mark lands on whatever surface the shot hit
+	class DecalPass
+	{
+	public:
+		static constexpr uint32_t maxDecals = 256;
+
+		// @albedoFormat - format of targets.albedo, decals are blended into it if the device can
+		DecalPass(const VulkanContext& context, RenderGraph& graph, const GBufferTargets& targets, VkFormat albedoFormat);
+		~DecalPass();
+
+		DecalPass(const DecalPass&) = delete;
+		DecalPass& operator=(const DecalPass&) = delete;
+
+		// Render thread, a decal per point
+		void Add(const std::vector<glm::vec3>& points);
+		// Draws every decal inside the graph's render pass
+		void Record(VkCommandBuffer cmd);
+		// Copies the camera and the decals to the uniform ring
+		void Update(Camera* camera);
+		RenderGraphPass GetPass() const { return m_pass; }
+
+		uint32_t GetCount() const { return m_count; }
+
+	private:
+		void OnCompiled(const RenderGraph& graph);
+		void CreatePipeline(VkDevice device);
+		void BuildDescriptorSetLayout(const VulkanContext& context);
+
+	private:
+		const VulkanContext& context;
+		uint32_t m_width = 0;
+		uint32_t m_height = 0;
+		Pipeline m_pipeline;
+		PipelineLayout m_pipelineLayout;
+		VkRenderPass m_RenderPass = VK_NULL_HANDLE;
+		RenderGraphPass m_pass;
+		VkDescriptorSetLayout m_descriptorSetLayout = VK_NULL_HANDLE;
+		std::vector<VkDescriptorSet> m_descriptorSets;
+		// camera and decals in the uniform ring this frame, in binding order
+		uint32_t m_uniformOffsets[2] = {};
+		bool m_blend = false;
+		RenderResource m_positions;
+
+		// one vec4 per decal, xyz centre and w radius
+		std::vector<glm::vec4> m_decals;
+		// slot the next decal goes in, the oldest decal once the ring is full
+		uint32_t m_next = 0;
+		uint32_t m_count = 0;
+	};
+}
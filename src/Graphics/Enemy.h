@@ -3,7 +3,8 @@
 #include "../Graphics/Character.h"
 #include "Player.h"
 #include "../Core/Collision.h"
-#include <queue>
+#include "../Core/NavAgent.h"
+#include "../Core/BVH.h"
 #include <algorithm>
 #include "../Graphics/Common.h"
 
@@ -17,21 +18,25 @@ namespace Enigma
 		Enemy(const std::string& filepath, const VulkanContext& context, int filetype, glm::vec3 trans, glm::vec3 scale, float x, float y, float z);
 		Enemy(const std::string& filepath, const VulkanContext& context, int filetype, glm::vec3 trans, glm::vec3 scale, glm::mat4 rm);
 
-		void ManageAI(std::vector<Character*> characters, Model* obj, Player* player);
-		void addPlayerToNavmesh(Player* player, Model* obj);
-		void addToNavmesh(Character* character, Model* obj);
-		void moveInDirection();
+		//AI tick phases. planPath and moveInDirection only touch this enemy so they can run on any thread,
+		//applyMovement writes to the model and runs once every enemy has been steered
+		//walks straight at the target when nothing in the collision BVH is in the way, otherwise follows the navmesh
+		void planPath(const glm::vec3& target, const BVH& collision);
+		//crowd holds the positions of all enemies this tick, crowdIndex is this enemy's entry in it
+		void moveInDirection(const SpatialHash& crowd, int crowdIndex);
+		//dt is the fixed simulation step in seconds
+		void applyMovement(float dt);
 
 		double deathTime;
 		bool dead = false;
+		//set by the world broadphase when this enemy's bounds overlap the player, it stops walking into them
+		bool touchingPlayer = false;
 
 	private:
-		int currentNode;
-		std::vector<int> pathToEnemy;
-		std::vector<int> findDirection(Player* player);
-
-		void updateNavmesh(std::vector<Character*> character);
-		bool notVisited(int node, std::vector<int> visited);
+		NavAgent agent;
+		glm::vec3 velocity = glm::vec3(0.f);
+		//world units per second
+		float moveSpeed = 12.f;
 	};
 }
 
@@ -1,96 +1,61 @@
 #include "GBuffer.h"
+#include "TextureCache.h"
+#include "RenderQueue.h"
+#include "InstanceBuffer.h"
+#include "UniformRing.h"
 
 namespace Enigma
 {
-	GBuffer::GBuffer(const VulkanContext& context, const VulkanWindow& window, GBufferTargets& targets) : context{context}, targets{targets}
+	GBuffer::GBuffer(const VulkanContext& context, RenderGraph& graph, const GBufferTargets& targets, const GPUScene& scene) : context{context}, scene{scene}
 	{
-		m_width = window.swapchainExtent.width;
-		m_height = window.swapchainExtent.height;
-
-		m_sceneUBO.resize(Enigma::MAX_FRAMES_IN_FLIGHT);
-
-		for (auto& buffer : m_sceneUBO)
-			buffer = Enigma::CreateBuffer(context.allocator, sizeof(CameraTransform), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
-
-		targets.position = Enigma::CreateImageTexture2D(
-			context,
-			m_width,
-			m_height,
-			VK_FORMAT_R32G32B32A32_SFLOAT,
-			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-			VK_IMAGE_ASPECT_COLOR_BIT, 1
-		);
-
-		targets.normals = Enigma::CreateImageTexture2D(
-			context,
-			m_width,
-			m_height,
-			VK_FORMAT_R32G32B32A32_SFLOAT,
-			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-			VK_IMAGE_ASPECT_COLOR_BIT, 1
-		);
-
-		targets.albedo = Enigma::CreateImageTexture2D(
-			context,
-			m_width,
-			m_height,
-			VK_FORMAT_R32G32B32A32_SFLOAT,
-			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-			VK_IMAGE_ASPECT_COLOR_BIT, 1
-		);
-
-		targets.depth = Enigma::CreateImageTexture2D(
-			context,
-			m_width,
-			m_height,
-			VK_FORMAT_D32_SFLOAT,
-			VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-			VK_IMAGE_ASPECT_DEPTH_BIT, 1
-		);
+		m_RenderPass = VK_NULL_HANDLE;
+		m_descriptorSetLayout = VK_NULL_HANDLE;
+
+		// attachment order matches the colour outputs of gbuffer.frag with depth after position
+		m_pass = graph.AddPass("gbuffer", [&](RenderGraph::PassBuilder& builder) {
+			VkClearValue clearColour{};
+			clearColour.color = { {0.3f, 0.5f, .7f, 1.0f} };
+			VkClearValue clearDepth{};
+			clearDepth.depthStencil.depth = 1.0f;
+
+			builder.Write(targets.position, true, clearColour);
+			builder.Write(targets.depth, true, clearDepth);
+			builder.Write(targets.normals, true, clearColour);
+			builder.Write(targets.albedo, true, clearColour);
+			builder.OnCompiled([this](const RenderGraph& graph) { OnCompiled(graph); });
+		});
 
 		BuildDescriptorSetLayout(context);
-		CreateRenderPass(context.device);
-		CreateFramebuffer(context.device, targets);
-		CreatePipeline(context.device, window.swapchainExtent);
-		CreatePipelineAnim(context.device, window.swapchainExtent);
-		CreateAABBPipeline(context.device, window.swapchainExtent);
-
 	}
 
 	GBuffer::~GBuffer()
 	{
-		if (m_framebuffer != VK_NULL_HANDLE)
+		if (m_descriptorSetLayout != VK_NULL_HANDLE)
 		{
-			vkDestroyFramebuffer(context.device, m_framebuffer, nullptr);
+			vkDestroyDescriptorSetLayout(context.device, m_descriptorSetLayout, nullptr);
 		}
+	}
 
-		if (m_RenderPass != VK_NULL_HANDLE)
-		{
-			vkDestroyRenderPass(context.device, m_RenderPass, nullptr);
-		}
+	void GBuffer::OnCompiled(const RenderGraph& graph)
+	{
+		m_RenderPass = graph.GetRenderPass(m_pass);
+		m_width = graph.GetExtent(m_pass).width;
+		m_height = graph.GetExtent(m_pass).height;
 
-		if (m_descriptorSetLayout != VK_NULL_HANDLE)
+		// the graph's render passes stay compatible across compiles, the pipelines only need creating once
+		if (m_pipeline.handle == VK_NULL_HANDLE)
 		{
-			vkDestroyDescriptorSetLayout(context.device, m_descriptorSetLayout, nullptr);
+			CreatePipeline(context.device, VERTEX, FRAGMENT, { m_descriptorSetLayout, Enigma::textureCache->GetDescriptorSetLayout() }, m_pipeline, m_pipelineLayout);
+			CreatePipeline(context.device, GBUFFER_VERTEX_INSTANCED, FRAGMENT, { m_descriptorSetLayout, Enigma::textureCache->GetDescriptorSetLayout(), Enigma::instanceBuffer->GetDescriptorSetLayout() }, m_pipelineInstanced, m_pipelineInstancedLayout);
+			if (context.gpuDrivenSupported)
+				CreatePipeline(context.device, GBUFFER_VERTEX_INDIRECT, GBUFFER_FRAGMENT_INDIRECT, { m_descriptorSetLayout, Enigma::textureCache->GetDescriptorSetLayout(), scene.GetDescriptorSetLayout() }, m_pipelineIndirect, m_pipelineIndirectLayout);
+			CreatePipelineAnim(context.device, graph.GetExtent(m_pass));
+			CreateAABBPipeline(context.device, graph.GetExtent(m_pass));
 		}
 	}
-	// only should be outputting normals ( can reconstuct position from depth )
-	void GBuffer::Execute(VkCommandBuffer cmd, const std::vector<Model*>& models)
-	{
-		VkRenderPassBeginInfo rpBegin{ VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
-		rpBegin.renderPass = m_RenderPass;
-		rpBegin.framebuffer = m_framebuffer;
-		rpBegin.renderArea.extent = { m_width, m_height };
-		rpBegin.renderArea.offset = { 0,0 };
-
-		VkClearValue clearValues[4]; // 3 color, 1 depth
-		clearValues[0].color = { {0.3f, 0.5f, .7f, 1.0f} };
-		clearValues[1].depthStencil.depth = 1.0f;
-		clearValues[2].color = { {0.3f, 0.5f, .7f, 1.0f} };
-		clearValues[3].color = { {0.3f, 0.5f, .7f, 1.0f} };
-		rpBegin.clearValueCount = 4;
-		rpBegin.pClearValues = clearValues;
 
+	void GBuffer::Record(VkCommandBuffer cmd, const std::vector<Model*>& models, size_t begin, size_t end, const FrameSnapshot& snapshot)
+	{
 		VkViewport viewport{};
 		viewport.x = 0.0f;
 		viewport.y = 0.0f;
@@ -105,215 +70,75 @@ namespace Enigma
 		scissor.extent = { m_width, m_height };
 		vkCmdSetScissor(cmd, 0, 1, &scissor);
 
-		vkCmdBeginRenderPass(cmd, &rpBegin, VK_SUBPASS_CONTENTS_INLINE);
-		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout.handle, 0, 1, &m_sceneDescriptorSets[Enigma::currentFrame], 0, nullptr);
+		// every draw in the pass reads its textures through the material table, set 1 is bound once for all of them
+		const VkDescriptorSet sets[] = { m_sceneDescriptorSets[Enigma::currentFrame], Enigma::textureCache->GetDescriptorSet() };
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout.handle, 0, 2, sets, 1, &m_cameraOffset);
+
+		// one queue per recording thread, it keeps its memory from frame to frame
+		thread_local RenderQueue queue;
+		queue.Begin(m_eye);
+
+		const RenderState opaque{ m_pipeline.handle, m_pipelineLayout.handle };
+		const RenderState skinned{ m_pipelineAnim.handle, m_pipelineAnimLayout.handle };
+		const RenderState boxes{ AABBDraw.handle, m_pipelineLayout.handle };
+		queue.Instance(opaque, { m_pipelineInstanced.handle, m_pipelineInstancedLayout.handle, VK_NULL_HANDLE, 2 });
 
-		if (Enigma::renderTemp) {
-			for (const auto& model : Enigma::tempModels)
+		// the first range also draws what isn't in the model list
+		if (begin == 0)
+		{
+			Player* player = Enigma::WorldInst.player;
+			player->m_Model->Queue(queue, opaque, snapshot.GetTransform(player->m_Model));
+			// the player's box has buffers of its own, it is drawn straight away
+			player->DrawAABBDebug(cmd, m_pipelineLayout.handle, AABBDraw.handle, snapshot.GetPlayerPosition());
+
+			if (scene.IsEnabled())
 			{
-				vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline.handle);
-				model->Draw(cmd, m_pipelineLayout.handle);
+				vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineIndirect.handle);
+				scene.Draw(cmd, m_pipelineIndirectLayout.handle, GPUScene::CameraView, 2);
+
+				// the boxes are the only per model work left for the scene's models, they can be turned off
+				if (Enigma::drawAABBs)
+				{
+					for (const auto& model : Enigma::WorldInst.Meshes)
+					{
+						if (GPUScene::Accepts(model))
+							model->QueueAABB(queue, boxes, snapshot.GetTransform(model));
+					}
+				}
 			}
 		}
 
-		for (const auto& model : models)
-	 	{
-			vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline.handle);
-			Enigma::WorldInst.player->Draw(cmd, m_pipelineLayout.handle);
-			Enigma::WorldInst.player->DrawAABBDebug(cmd, m_pipelineLayout.handle, AABBDraw.handle, Enigma::WorldInst.player->m_Model->m_descriptorSet[0]);
-
-            if(model->m_animations.empty() || model->dead){
-			    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline.handle);
-			    model->Draw(cmd, m_pipelineLayout.handle);
-			    model->DrawDebug(cmd, m_pipelineLayout.handle, AABBDraw.handle);
-            }
-            else
-            {
-                vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineAnim.handle);
-				model->Draw2(cmd, m_pipelineAnimLayout.handle);
-            }
+		for (size_t i = begin; i < end; i++)
+		{
+			Model* model = models[i];
+			if (!snapshot.IsSkinned(model))
+			{
+				const glm::mat4 transform = snapshot.GetTransform(model);
+				model->Queue(queue, opaque, transform);
+				if (Enigma::drawAABBs)
+					model->QueueAABB(queue, boxes, transform);
+			}
+			else
+			{
+				const ModelSnapshot& pose = snapshot.Get(model);
+				model->Queue2(queue, skinned, pose.nodeMatrices, snapshot.GetOffset(model));
+			}
 		}
 
-		vkCmdEndRenderPass(cmd);
+		queue.Submit(cmd);
 	}
 
 	void GBuffer::Update(Camera* camera)
 	{
-		void* data = nullptr;
-		vmaMapMemory(context.allocator.allocator, m_sceneUBO[Enigma::currentFrame].allocation, &data);
-		std::memcpy(data, &camera->GetCameraTransform(), sizeof(camera->GetCameraTransform()));
-		vmaUnmapMemory(context.allocator.allocator, m_sceneUBO[Enigma::currentFrame].allocation);
-	}
+		m_eye = camera->GetPosition();
 
-	void GBuffer::Resize(const VulkanWindow& window)
-	{
-		m_width = window.swapchainExtent.width;
-		m_height = window.swapchainExtent.height;
-
-		targets.position = Enigma::CreateImageTexture2D(
-			context,
-			m_width,
-			m_height,
-			VK_FORMAT_R32G32B32A32_SFLOAT,
-			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-			VK_IMAGE_ASPECT_COLOR_BIT, 1
-		);
-
-		targets.normals = Enigma::CreateImageTexture2D(
-			context,
-			m_width,
-			m_height,
-			VK_FORMAT_R32G32B32A32_SFLOAT,
-			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-			VK_IMAGE_ASPECT_COLOR_BIT, 1
-		);
-
-		targets.albedo = Enigma::CreateImageTexture2D(
-			context,
-			m_width,
-			m_height,
-			VK_FORMAT_R32G32B32A32_SFLOAT,
-			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-			VK_IMAGE_ASPECT_COLOR_BIT, 1
-		);
-
-		targets.depth = Enigma::CreateImageTexture2D(
-			context,
-			m_width,
-			m_height,
-			VK_FORMAT_D32_SFLOAT,
-			VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-			VK_IMAGE_ASPECT_DEPTH_BIT, 1
-		);
-
-		vkDestroyRenderPass(context.device, m_RenderPass, nullptr);
-		vkDestroyFramebuffer(context.device, m_framebuffer, nullptr);
-
-		CreateRenderPass(context.device);
-		CreateFramebuffer(context.device, targets);
+		m_cameraOffset = Enigma::uniformRing->Push(camera->GetCameraTransform());
 	}
 
-	void GBuffer::CreateFramebuffer(VkDevice device, GBufferTargets& targets)
+	void GBuffer::CreatePipeline(VkDevice device, const char* vertex, const char* fragment, const std::vector<VkDescriptorSetLayout>& layouts, Pipeline& pipeline, PipelineLayout& pipelineLayout)
 	{
-		std::vector<VkImageView> attachments = { targets.position.imageView, targets.depth.imageView, targets.normals.imageView, targets.albedo.imageView};
-		VkFramebufferCreateInfo fbInfo{ VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO };
-		fbInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-		fbInfo.pAttachments = attachments.data();
-		fbInfo.renderPass = m_RenderPass;
-		fbInfo.width = m_width;
-		fbInfo.height = m_height;
-		fbInfo.layers = 1;
-
-		ENIGMA_VK_CHECK(vkCreateFramebuffer(device, &fbInfo, nullptr, &m_framebuffer), "Failed to create G-Buffer framebuffer.");
-	}
-
-	void GBuffer::CreateRenderPass(VkDevice device)
-	{
-		VkAttachmentDescription positionColorAttachment = {};
-		positionColorAttachment.format = VK_FORMAT_R32G32B32A32_SFLOAT;
-		positionColorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-		positionColorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		positionColorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-		positionColorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		positionColorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		positionColorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		positionColorAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-		VkAttachmentDescription normalColorAttachment = {};
-		normalColorAttachment.format = VK_FORMAT_R32G32B32A32_SFLOAT;
-		normalColorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-		normalColorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		normalColorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-		normalColorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		normalColorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		normalColorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		normalColorAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-		VkAttachmentDescription albedoColourAttachment = {};
-		albedoColourAttachment.format = VK_FORMAT_R32G32B32A32_SFLOAT;
-		albedoColourAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-		albedoColourAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		albedoColourAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-		albedoColourAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		albedoColourAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		albedoColourAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		albedoColourAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-		VkAttachmentDescription depthAttachment = {};
-		depthAttachment.format = VK_FORMAT_D32_SFLOAT;
-		depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-		depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-		depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
-
-		VkAttachmentDescription attachments[4] = { positionColorAttachment, depthAttachment, normalColorAttachment, albedoColourAttachment };
-
-		VkAttachmentReference depthReference =  { 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
-
-		std::vector<VkAttachmentReference> colorReference = { 
-			{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL}, 
-			{2, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL},
-			{3, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL}
-		};
-
-		VkSubpassDescription subpass = {};
-		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-		subpass.colorAttachmentCount = (uint32_t)colorReference.size();
-		subpass.pColorAttachments = colorReference.data();
-		subpass.pDepthStencilAttachment = &depthReference;
-
-		VkSubpassDependency dependency[4] = {};
-		// Wait for EXTERNAL render pass to finish outputting
-		dependency[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-		dependency[0].srcSubpass = VK_SUBPASS_EXTERNAL;
-		dependency[0].srcAccessMask = 0;
-		dependency[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		// This subpass is the destination, wait for EXTERNAL to finish outputting before writing to it 
-		dependency[0].dstSubpass = 0;
-		dependency[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-		dependency[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-
-		// Depth dependency 
-		// Source subpass is current subpass which writes to the depth image at late frag tests
-		dependency[1].srcSubpass = 0;
-		dependency[1].srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
-		dependency[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-		// destination subpass is external, uses depth in fragment shader 
-		dependency[1].dstSubpass = VK_SUBPASS_EXTERNAL;
-		dependency[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-		dependency[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-		dependency[2].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-		dependency[2].srcSubpass = VK_SUBPASS_EXTERNAL;
-		dependency[2].srcAccessMask = 0;
-		dependency[2].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;   
-		dependency[2].dstSubpass = 0;
-		dependency[2].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-		dependency[2].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-
-		dependency[3].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-		dependency[3].srcSubpass = VK_SUBPASS_EXTERNAL;
-		dependency[3].srcAccessMask = 0;
-		dependency[3].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		dependency[3].dstSubpass = 0;
-		dependency[3].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-		dependency[3].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-
-		VkRenderPassCreateInfo renderPassInfo{ VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO };
-		renderPassInfo.attachmentCount = static_cast<uint32_t>(4);
-		renderPassInfo.pAttachments = attachments;
-		renderPassInfo.subpassCount = 1;
-		renderPassInfo.pSubpasses = &subpass;
-		renderPassInfo.dependencyCount = 4;
-		renderPassInfo.pDependencies = dependency;
-
-		ENIGMA_VK_CHECK(vkCreateRenderPass(device, &renderPassInfo, nullptr, &m_RenderPass), "Failed to create G-Buffer render pass");
-	}
-	void GBuffer::CreatePipeline(VkDevice device, VkExtent2D swapchainExtent)
-	{
-		ShaderModule vertexShader = CreateShaderModule(VERTEX, device);
-		ShaderModule fragmentShader = CreateShaderModule(FRAGMENT, device);
+		ShaderModule vertexShader = CreateShaderModule(vertex, device);
+		ShaderModule fragmentShader = CreateShaderModule(fragment, device);
 
 		VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
 		vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -420,8 +245,6 @@ namespace Enigma
 		pushConstant.offset = 0;
 		pushConstant.size = sizeof(Enigma::ModelPushConstant);
 
-		std::vector<VkDescriptorSetLayout> layouts = { m_descriptorSetLayout, Enigma::descriptorLayoutModel };
-
 		VkPipelineLayoutCreateInfo layoutInfo{};
 		layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 		layoutInfo.setLayoutCount = (uint32_t)layouts.size();
@@ -434,7 +257,7 @@ namespace Enigma
 
 		ENIGMA_VK_CHECK(res, "Failed to create pipeline layout");
 
-		m_pipelineLayout = PipelineLayout(device, layout);
+		pipelineLayout = PipelineLayout(device, layout);
 
 		VkGraphicsPipelineCreateInfo pipelineInfo{};
 		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -449,14 +272,14 @@ namespace Enigma
 		pipelineInfo.pDepthStencilState = &depthInfo;
 		pipelineInfo.pColorBlendState = &blendInfo;
 		pipelineInfo.pDynamicState = &dynamicState;
-		pipelineInfo.layout = m_pipelineLayout.handle;
+		pipelineInfo.layout = pipelineLayout.handle;
 		pipelineInfo.renderPass = m_RenderPass;
 		pipelineInfo.subpass = 0;
 
-		VkPipeline pipeline = VK_NULL_HANDLE;
-		ENIGMA_VK_CHECK(vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline), "Failed to create graphics pipeline.");
+		VkPipeline handle = VK_NULL_HANDLE;
+		ENIGMA_VK_CHECK(vkCreateGraphicsPipelines(device, Enigma::pipelineCache, 1, &pipelineInfo, nullptr, &handle), "Failed to create graphics pipeline.");
 
-		m_pipeline = Pipeline(device, pipeline);
+		pipeline = Pipeline(device, handle);
 	}
 	void GBuffer::CreateAABBPipeline(VkDevice device, VkExtent2D swapchainExtent)
 	{
@@ -548,7 +371,7 @@ namespace Enigma
 		pushConstant.offset = 0;
 		pushConstant.size = sizeof(Enigma::ModelPushConstant);
 
-		std::vector<VkDescriptorSetLayout> layouts = { m_descriptorSetLayout, Enigma::descriptorLayoutModel };
+		std::vector<VkDescriptorSetLayout> layouts = { m_descriptorSetLayout, Enigma::textureCache->GetDescriptorSetLayout() };
 
 		VkPipelineLayoutCreateInfo layoutInfo{};
 		layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
@@ -582,7 +405,7 @@ namespace Enigma
 		pipelineInfo.subpass = 0;
 
 		VkPipeline pipeline = VK_NULL_HANDLE;
-		ENIGMA_VK_CHECK(vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline), "Failed to create graphics pipeline.");
+		ENIGMA_VK_CHECK(vkCreateGraphicsPipelines(device, Enigma::pipelineCache, 1, &pipelineInfo, nullptr, &pipeline), "Failed to create graphics pipeline.");
 
 		AABBDraw = Pipeline(device, pipeline);
 	}
@@ -695,7 +518,7 @@ namespace Enigma
 		pushConstant.offset = 0;
 		pushConstant.size = sizeof(Enigma::ModelPushConstant);
 
-		std::vector<VkDescriptorSetLayout> layouts = { m_descriptorSetLayout, Enigma::descriptorLayoutModel,Enigma::boneTransformDescriptorLayout };
+		std::vector<VkDescriptorSetLayout> layouts = { m_descriptorSetLayout, Enigma::textureCache->GetDescriptorSetLayout(),Enigma::boneTransformDescriptorLayout };
 
 		VkPipelineLayoutCreateInfo layoutInfo{};
 		layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
@@ -729,7 +552,7 @@ namespace Enigma
 		pipelineInfo.subpass = 0;
 
 		VkPipeline pipeline = VK_NULL_HANDLE;
-		ENIGMA_VK_CHECK(vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline), "Failed to create graphics pipeline.");
+		ENIGMA_VK_CHECK(vkCreateGraphicsPipelines(device, Enigma::pipelineCache, 1, &pipelineInfo, nullptr, &pipeline), "Failed to create graphics pipeline.");
 
 		m_pipelineAnim = Pipeline(device, pipeline);
     }
@@ -741,7 +564,7 @@ namespace Enigma
 		// Set = 0
 		{
 			std::vector<VkDescriptorSetLayoutBinding> bindings = {
-				CreateDescriptorBinding(0, 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT),
+				CreateDescriptorBinding(0, 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT),
 			};
 
 			m_descriptorSetLayout = CreateDescriptorSetLayout(context, bindings);
@@ -751,14 +574,11 @@ namespace Enigma
 
 		AllocateDescriptorSets(context, Enigma::descriptorPool, m_descriptorSetLayout, Enigma::MAX_FRAMES_IN_FLIGHT, m_sceneDescriptorSets);
 
-		// Binding 0
+		// Binding 0, the camera is found with the offset the set is bound with
 		for (size_t i = 0; i < Enigma::MAX_FRAMES_IN_FLIGHT; i++)
 		{
-			VkDescriptorBufferInfo bufferInfo{};
-			bufferInfo.buffer = m_sceneUBO[i].buffer;
-			bufferInfo.offset = 0;
-			bufferInfo.range = sizeof(CameraTransform);
-			UpdateDescriptorSet(context, 0, bufferInfo, m_sceneDescriptorSets[i], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+			const VkDescriptorBufferInfo bufferInfo = Enigma::uniformRing->GetDescriptorInfo(sizeof(CameraTransform));
+			UpdateDescriptorSet(context, 0, bufferInfo, m_sceneDescriptorSets[i], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
 		}
 	}
 }
@@ -6,44 +6,70 @@
 #include "Model.h"
 #include "../Core/VulkanWindow.h"
 #include "../Core/World.h"
+#include "RenderGraph.h"
+#include "GPUScene.h"
 
 #define VERTEX "../resources/Shaders/vertex.vert.spv"
 #define VERTEX_ANIM "../resources/Shaders/vertexAnim.vert.spv"
 #define FRAGMENT "../resources/Shaders/gbuffer.frag.spv"
+#define GBUFFER_VERTEX_INDIRECT "../resources/Shaders/vertexIndirect.vert.spv"
+#define GBUFFER_FRAGMENT_INDIRECT "../resources/Shaders/gbufferIndirect.frag.spv"
+#define GBUFFER_VERTEX_INSTANCED "../resources/Shaders/vertexInstanced.vert.spv"
 
 namespace Enigma
 {
+	// output textures from the g-buffer
+	struct GBufferTargets
+	{
+		RenderResource position;
+		RenderResource normals;
+		RenderResource depth;
+		RenderResource albedo;
+	};
+
 	class GBuffer
 	{
 	public:
-		GBuffer(const VulkanContext& context, const VulkanWindow& window, GBufferTargets& targets);
+		GBuffer(const VulkanContext& context, RenderGraph& graph, const GBufferTargets& targets, const GPUScene& scene);
 		~GBuffer();
 
-		void Execute(VkCommandBuffer cmd, const std::vector<Model*>& models);
+		// Draws models [begin, end) inside the graph's render pass, see ShadowPass. The range starting at 0 also
+		// draws the player and the GPU scene
+		void Record(VkCommandBuffer cmd, const std::vector<Model*>& models, size_t begin, size_t end, const FrameSnapshot& snapshot);
+		RenderGraphPass GetPass() const { return m_pass; }
 		void Update(Camera* camera);
-		void Resize(const VulkanWindow& window);
 	private:
-		void CreateFramebuffer(VkDevice device, GBufferTargets& targets);
-		void CreateRenderPass(VkDevice device);
-		void CreatePipeline(VkDevice device, VkExtent2D swapchainExtent);
+		void OnCompiled(const RenderGraph& graph);
+		void CreatePipeline(VkDevice device, const char* vertex, const char* fragment, const std::vector<VkDescriptorSetLayout>& layouts, Pipeline& pipeline, PipelineLayout& pipelineLayout);
 		void CreatePipelineAnim(VkDevice device, VkExtent2D swapchainExtent);
 		void CreateAABBPipeline(VkDevice device, VkExtent2D swapchainExtent);
 		void BuildDescriptorSetLayout(const VulkanContext& context);
 	private:
 		const VulkanContext& context;
+		const GPUScene& scene;
 		Pipeline m_pipeline;
 		Pipeline AABBDraw;
 		PipelineLayout m_pipelineLayout;
 		uint32_t m_width;
 		uint32_t m_height;
 		VkRenderPass m_RenderPass;
-		VkFramebuffer m_framebuffer;
+		RenderGraphPass m_pass;
 		std::vector<VkDescriptorSet> m_sceneDescriptorSets;
 		VkDescriptorSetLayout m_descriptorSetLayout;
-		std::vector<Buffer> m_sceneUBO;
-		GBufferTargets& targets;
+		// the camera's place in the uniform ring this frame
+		uint32_t m_cameraOffset = 0;
 
 		Pipeline m_pipelineAnim;
 		PipelineLayout m_pipelineAnimLayout;
+
+		Pipeline m_pipelineIndirect;
+		PipelineLayout m_pipelineIndirectLayout;
+
+		// the render queue's instanced draws of m_pipeline's packets
+		Pipeline m_pipelineInstanced;
+		PipelineLayout m_pipelineInstancedLayout;
+
+		// camera position the render queue sorts front to back from
+		glm::vec3 m_eye = glm::vec3(0.0f);
 	};
 };
@@ -0,0 +1,187 @@
+#include "GPUProfiler.h"
+#include "Common.h"
+#include <fstream>
+#include <iostream>
+
+namespace Enigma
+{
+	float GPUProfiler::Scope::GetAverage() const
+	{
+		if (samples.empty())
+			return 0.0f;
+
+		float total = 0.0f;
+		for (const auto& sample : samples)
+			total += sample.milliseconds;
+		return total / static_cast<float>(samples.size());
+	}
+
+	GPUProfiler::GPUProfiler(const VulkanContext& context) : context{ context }
+	{
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(context.physicalDevice, &properties);
+
+		uint32_t familyCount = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties(context.physicalDevice, &familyCount, nullptr);
+		std::vector<VkQueueFamilyProperties> families(familyCount);
+		vkGetPhysicalDeviceQueueFamilyProperties(context.physicalDevice, &familyCount, families.data());
+
+		const uint32_t validBits = families[context.graphicsFamilyIndex].timestampValidBits;
+		if (validBits == 0 || properties.limits.timestampPeriod <= 0.0f)
+		{
+			std::cout << "[ENIGMA]: The graphics queue can't write timestamps, GPU profiling is off" << std::endl;
+			return;
+		}
+
+		m_timestampPeriod = properties.limits.timestampPeriod;
+		m_timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+		m_timestampPools.resize(Enigma::MAX_FRAMES_IN_FLIGHT, VK_NULL_HANDLE);
+		m_statisticsPools.resize(Enigma::MAX_FRAMES_IN_FLIGHT, VK_NULL_HANDLE);
+		m_recorded.resize(Enigma::MAX_FRAMES_IN_FLIGHT);
+		m_recordedFrame.resize(Enigma::MAX_FRAMES_IN_FLIGHT, 0);
+
+		for (int i = 0; i < Enigma::MAX_FRAMES_IN_FLIGHT; i++)
+		{
+			VkQueryPoolCreateInfo timestampInfo{ VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+			timestampInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			timestampInfo.queryCount = maxScopes * 2;
+			ENIGMA_VK_CHECK(vkCreateQueryPool(context.device, &timestampInfo, nullptr, &m_timestampPools[i]), "Failed to create timestamp query pool");
+
+			if (context.pipelineStatisticsSupported)
+			{
+				VkQueryPoolCreateInfo statisticsInfo{ VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+				statisticsInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+				statisticsInfo.queryCount = maxScopes;
+				statisticsInfo.pipelineStatistics = pipelineStatistics;
+				ENIGMA_VK_CHECK(vkCreateQueryPool(context.device, &statisticsInfo, nullptr, &m_statisticsPools[i]), "Failed to create pipeline statistics query pool");
+			}
+		}
+	}
+
+	GPUProfiler::~GPUProfiler()
+	{
+		for (size_t i = 0; i < m_timestampPools.size(); i++)
+		{
+			vkDestroyQueryPool(context.device, m_timestampPools[i], nullptr);
+			if (m_statisticsPools[i] != VK_NULL_HANDLE)
+				vkDestroyQueryPool(context.device, m_statisticsPools[i], nullptr);
+		}
+	}
+
+	void GPUProfiler::BeginFrame(VkCommandBuffer cmd, uint32_t frame)
+	{
+		if (!IsSupported())
+			return;
+
+		ReadBack(frame);
+
+		m_frame = frame;
+		m_recorded[frame].clear();
+		m_recordedFrame[frame] = m_frameCount++;
+
+		vkCmdResetQueryPool(cmd, m_timestampPools[frame], 0, maxScopes * 2);
+		if (HasPipelineStatistics())
+			vkCmdResetQueryPool(cmd, m_statisticsPools[frame], 0, maxScopes);
+	}
+
+	void GPUProfiler::BeginScope(VkCommandBuffer cmd, const std::string& name)
+	{
+		if (!IsSupported() || m_inScope || m_recorded[m_frame].size() >= maxScopes)
+			return;
+
+		const uint32_t query = static_cast<uint32_t>(m_recorded[m_frame].size());
+		m_recorded[m_frame].push_back(FindScope(name));
+		m_inScope = true;
+
+		vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_timestampPools[m_frame], query * 2);
+		if (HasPipelineStatistics())
+			vkCmdBeginQuery(cmd, m_statisticsPools[m_frame], query, 0);
+	}
+
+	void GPUProfiler::EndScope(VkCommandBuffer cmd)
+	{
+		if (!m_inScope)
+			return;
+
+		const uint32_t query = static_cast<uint32_t>(m_recorded[m_frame].size()) - 1;
+		m_inScope = false;
+
+		if (HasPipelineStatistics())
+			vkCmdEndQuery(cmd, m_statisticsPools[m_frame], query);
+		vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_timestampPools[m_frame], query * 2 + 1);
+	}
+
+	uint32_t GPUProfiler::FindScope(const std::string& name)
+	{
+		for (uint32_t i = 0; i < m_scopes.size(); i++)
+		{
+			if (m_scopes[i].name == name)
+				return i;
+		}
+
+		m_scopes.push_back({ name });
+		m_scopes.back().samples.reserve(historyLength);
+		return static_cast<uint32_t>(m_scopes.size() - 1);
+	}
+
+	void GPUProfiler::ReadBack(uint32_t frame)
+	{
+		const std::vector<uint32_t>& recorded = m_recorded[frame];
+		if (recorded.empty())
+			return;
+
+		const uint32_t queryCount = static_cast<uint32_t>(recorded.size());
+
+		// the fence has signalled, every query of the frame is available
+		std::vector<uint64_t> timestamps(queryCount * 2);
+		ENIGMA_VK_CHECK(vkGetQueryPoolResults(context.device, m_timestampPools[frame], 0, queryCount * 2, timestamps.size() * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT), "Failed to read timestamp queries");
+
+		// two counters per query, in bit order of pipelineStatistics
+		std::vector<uint64_t> statistics(queryCount * 2, 0);
+		if (HasPipelineStatistics())
+			ENIGMA_VK_CHECK(vkGetQueryPoolResults(context.device, m_statisticsPools[frame], 0, queryCount, statistics.size() * sizeof(uint64_t), statistics.data(), sizeof(uint64_t) * 2, VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT), "Failed to read pipeline statistics queries");
+
+		m_frameMilliseconds = 0.0f;
+		for (uint32_t query = 0; query < queryCount; query++)
+		{
+			const uint64_t ticks = ((timestamps[query * 2 + 1] & m_timestampMask) - (timestamps[query * 2] & m_timestampMask)) & m_timestampMask;
+
+			Sample sample;
+			sample.frame = m_recordedFrame[frame];
+			sample.milliseconds = static_cast<float>(static_cast<double>(ticks) * m_timestampPeriod / 1000000.0);
+			sample.primitives = statistics[query * 2];
+			sample.fragmentInvocations = statistics[query * 2 + 1];
+			m_frameMilliseconds += sample.milliseconds;
+
+			Scope& scope = m_scopes[recorded[query]];
+			if (scope.samples.size() < historyLength)
+				scope.samples.push_back(sample);
+			else
+				scope.samples[scope.next] = sample;
+			scope.next = (scope.next + 1) % historyLength;
+		}
+	}
+
+	bool GPUProfiler::WriteCSV(const std::string& path) const
+	{
+		std::ofstream file(path);
+		if (!file.is_open())
+			return false;
+
+		file << "frame,scope,milliseconds,primitives,fragment_invocations\n";
+		for (const auto& scope : m_scopes)
+		{
+			// oldest first
+			const size_t first = scope.samples.size() < historyLength ? 0 : scope.next;
+			for (size_t i = 0; i < scope.samples.size(); i++)
+			{
+				const Sample& sample = scope.samples[(first + i) % scope.samples.size()];
+				file << sample.frame << ',' << scope.name << ',' << sample.milliseconds << ',' << sample.primitives << ',' << sample.fragmentInvocations << '\n';
+			}
+		}
+
+		std::cout << "[ENIGMA]: Wrote GPU profile to " << path << std::endl;
+		return true;
+	}
+}
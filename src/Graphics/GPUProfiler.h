@@ -0,0 +1,94 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <Volk/volk.h>
+#include "VulkanContext.h"
+
+namespace Enigma
+{
+	// GPU time of named scopes of the frame's command buffer, from a timestamp written on either side of each.
+	// Every frame in flight has its own query pools, a frame's results are read back the next time its slot is
+	// used, once its fence has signalled, so nothing ever waits on the GPU. Where the device supports it a
+	// pipeline statistics query around each scope counts the primitives and fragment shader invocations too.
+	// The last historyLength samples of every scope are kept for the graphs and the CSV export
+	class GPUProfiler
+	{
+	public:
+		static constexpr uint32_t maxScopes = 32;
+		static constexpr size_t historyLength = 240;
+		// what the statistics queries count, in the order the results come back
+		static constexpr VkQueryPipelineStatisticFlags pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT | VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+		struct Sample
+		{
+			// frame the scope was recorded in, counted from the profiler's creation
+			uint64_t frame = 0;
+			float milliseconds = 0.0f;
+			uint64_t primitives = 0;
+			uint64_t fragmentInvocations = 0;
+		};
+
+		struct Scope
+		{
+			std::string name;
+			// ring of the last historyLength samples, the oldest at next once it is full
+			std::vector<Sample> samples;
+			size_t next = 0;
+
+			const Sample& GetLatest() const { return samples[(next + samples.size() - 1) % samples.size()]; }
+			float GetAverage() const;
+		};
+
+		explicit GPUProfiler(const VulkanContext& context);
+		~GPUProfiler();
+
+		GPUProfiler(const GPUProfiler&) = delete;
+		GPUProfiler& operator=(const GPUProfiler&) = delete;
+
+		// Reads back what the frame recorded the last time round and resets its queries. Call right after
+		// beginning the frame's command buffer, once its fence has signalled
+		void BeginFrame(VkCommandBuffer cmd, uint32_t frame);
+
+		// Scopes don't nest and can't be inside a render pass, the statistics query has to cover the whole pass
+		void BeginScope(VkCommandBuffer cmd, const std::string& name);
+		void EndScope(VkCommandBuffer cmd);
+
+		bool IsSupported() const { return m_timestampPeriod > 0.0f; }
+		bool HasPipelineStatistics() const { return !m_statisticsPools.empty() && m_statisticsPools[0] != VK_NULL_HANDLE; }
+
+		// Scopes in the order they were first recorded, their samples stay empty until a frame is read back
+		const std::vector<Scope>& GetScopes() const { return m_scopes; }
+		// GPU time of every scope of the latest frame read back
+		float GetFrameMilliseconds() const { return m_frameMilliseconds; }
+
+		// One row per sample of every scope, false if the file can't be written
+		bool WriteCSV(const std::string& path) const;
+
+	private:
+		// Index into m_scopes, added the first time the name is seen
+		uint32_t FindScope(const std::string& name);
+		void ReadBack(uint32_t frame);
+
+	private:
+		const VulkanContext& context;
+
+		// nanoseconds per tick, 0 if the graphics queue can't write timestamps
+		float m_timestampPeriod = 0.0f;
+		uint64_t m_timestampMask = ~0ull;
+
+		std::vector<VkQueryPool> m_timestampPools;
+		std::vector<VkQueryPool> m_statisticsPools;
+		// per frame in flight, the scope each query pair was written for and the frame they were recorded in
+		std::vector<std::vector<uint32_t>> m_recorded;
+		std::vector<uint64_t> m_recordedFrame;
+
+		uint32_t m_frame = 0;
+		uint64_t m_frameCount = 0;
+		bool m_inScope = false;
+
+		std::vector<Scope> m_scopes;
+		float m_frameMilliseconds = 0.0f;
+	};
+}
@@ -0,0 +1,580 @@
+#include "GPUScene.h"
+#include "UniformRing.h"
+#include "../Core/FrameSnapshot.h"
+#include "../Core/Settings.h"
+#include <cstring>
+#include <algorithm>
+
+namespace Enigma
+{
+	namespace
+	{
+		// descriptor sets allocated for the pyramid levels, enough for a 32768 wide target
+		constexpr uint32_t maxPyramidLevels = 16;
+
+		constexpr uint32_t minDraws = 256;
+
+		uint32_t PreviousPowerOfTwo(uint32_t value)
+		{
+			uint32_t result = 1;
+			while (result * 2 <= value)
+				result *= 2;
+			return result;
+		}
+
+		// Gribb-Hartmann, planes point inwards and use the 0 to 1 depth range
+		void ExtractFrustum(const glm::mat4& viewProjection, glm::vec4 planes[6])
+		{
+			const auto row = [&](int i) { return glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]); };
+
+			planes[0] = row(3) + row(0);
+			planes[1] = row(3) - row(0);
+			planes[2] = row(3) + row(1);
+			planes[3] = row(3) - row(1);
+			planes[4] = row(2);
+			planes[5] = row(3) - row(2);
+
+			for (int i = 0; i < 6; i++)
+				planes[i] /= glm::length(glm::vec3(planes[i]));
+		}
+
+		void* Map(const VulkanContext& context, const Buffer& buffer)
+		{
+			void* data = nullptr;
+			ENIGMA_VK_CHECK(vmaMapMemory(context.allocator.allocator, buffer.allocation, &data), "Failed to map GPU scene buffer");
+			return data;
+		}
+
+		void Unmap(const VulkanContext& context, const Buffer& buffer)
+		{
+			vmaUnmapMemory(context.allocator.allocator, buffer.allocation);
+		}
+
+		VkDescriptorBufferInfo BufferInfo(const Buffer& buffer)
+		{
+			VkDescriptorBufferInfo info{};
+			info.buffer = buffer.buffer;
+			info.offset = 0;
+			info.range = VK_WHOLE_SIZE;
+			return info;
+		}
+
+		// start of the first mesh's geometry, UINT32_MAX for an asset without any
+		uint32_t GeometryKey(const MeshAsset* asset)
+		{
+			for (const auto& mesh : asset->meshes)
+			{
+				if (mesh.geometry.IsValid())
+					return mesh.geometry.firstIndex;
+			}
+			return UINT32_MAX;
+		}
+	}
+
+	GPUScene::GPUScene(const VulkanContext& context, const GeometryArena& geometry) : context{ context }, m_geometry{ geometry }
+	{
+		m_frames.resize(Enigma::MAX_FRAMES_IN_FLIGHT);
+
+		std::vector<VkDescriptorSetLayoutBinding> bindings = {
+			CreateDescriptorBinding(0, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT),
+			CreateDescriptorBinding(1, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT),
+			CreateDescriptorBinding(2, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT),
+			CreateDescriptorBinding(3, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT),
+			CreateDescriptorBinding(4, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT),
+			CreateDescriptorBinding(5, 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_COMPUTE_BIT),
+			CreateDescriptorBinding(6, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT)
+		};
+		m_descriptorSetLayout = CreateDescriptorSetLayout(context, bindings);
+
+		std::vector<VkDescriptorSetLayoutBinding> pyramidBindings = {
+			CreateDescriptorBinding(0, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_COMPUTE_BIT),
+			CreateDescriptorBinding(1, 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, VK_SHADER_STAGE_COMPUTE_BIT)
+		};
+		m_pyramidSetLayout = CreateDescriptorSetLayout(context, pyramidBindings);
+
+		if (!context.gpuDrivenSupported)
+			return;
+
+		std::vector<VkDescriptorSet> sets;
+		AllocateDescriptorSets(context, Enigma::descriptorPool, m_descriptorSetLayout, Enigma::MAX_FRAMES_IN_FLIGHT, sets);
+		for (size_t i = 0; i < m_frames.size(); i++)
+			m_frames[i].descriptorSet = sets[i];
+
+		// AllocateDescriptorSets allocates one set per frame in flight, the levels need more
+		std::vector<VkDescriptorSetLayout> pyramidLayouts(maxPyramidLevels, m_pyramidSetLayout);
+		VkDescriptorSetAllocateInfo allocInfo{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+		allocInfo.descriptorPool = Enigma::descriptorPool;
+		allocInfo.descriptorSetCount = maxPyramidLevels;
+		allocInfo.pSetLayouts = pyramidLayouts.data();
+		m_pyramidDescriptorSets.resize(maxPyramidLevels);
+		ENIGMA_VK_CHECK(vkAllocateDescriptorSets(context.device, &allocInfo, m_pyramidDescriptorSets.data()), "Failed to allocate depth pyramid descriptor sets");
+
+		VkSamplerCreateInfo samplerInfo{ VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO };
+		samplerInfo.magFilter = VK_FILTER_NEAREST;
+		samplerInfo.minFilter = VK_FILTER_NEAREST;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+		ENIGMA_VK_CHECK(vkCreateSampler(context.device, &samplerInfo, nullptr, &m_pyramidSampler), "Failed to create depth pyramid sampler");
+
+		ReserveMeshes(minDraws);
+		ReserveDraws(minDraws, minDraws);
+		CreatePipelines();
+	}
+
+	GPUScene::~GPUScene()
+	{
+		DestroyDepthPyramid();
+
+		if (m_pyramidSampler != VK_NULL_HANDLE)
+			vkDestroySampler(context.device, m_pyramidSampler, nullptr);
+
+		vkDestroyDescriptorSetLayout(context.device, m_pyramidSetLayout, nullptr);
+		vkDestroyDescriptorSetLayout(context.device, m_descriptorSetLayout, nullptr);
+	}
+
+	bool GPUScene::IsEnabled() const
+	{
+		return context.gpuDrivenSupported && Enigma::gpuDrivenRendering;
+	}
+
+	bool GPUScene::Accepts(const Model* model)
+	{
+		return model->m_animations.empty() && !model->player;
+	}
+
+	void GPUScene::Update(const std::vector<Model*>& models, const FrameSnapshot& snapshot, const glm::mat4& cameraViewProjection, const glm::mat4& lightSpaceMatrix)
+	{
+		m_drawCount = 0;
+		m_instanceCount = 0;
+
+		if (!IsEnabled())
+			return;
+
+		Register(models);
+
+		uint32_t instanceCount = 0;
+		uint32_t drawCount = 0;
+		for (const auto& model : models)
+		{
+			if (!Accepts(model))
+				continue;
+			const auto entry = m_assets.find(model->asset.get());
+			if (entry == m_assets.end() || entry->second.meshCount == 0)
+				continue;
+			instanceCount++;
+			drawCount += entry->second.meshCount;
+		}
+		ReserveDraws(instanceCount, drawCount);
+
+		FrameResources& frame = m_frames[Enigma::currentFrame];
+		auto* instances = static_cast<GPUInstance*>(Map(context, frame.instances));
+		auto* draws = static_cast<GPUDraw*>(Map(context, frame.draws));
+
+		// models of the same file are instances of one asset, their draws all point at the asset's mesh records
+		for (const auto& model : models)
+		{
+			if (!Accepts(model))
+				continue;
+			const auto entry = m_assets.find(model->asset.get());
+			if (entry == m_assets.end() || entry->second.meshCount == 0)
+				continue;
+
+			instances[m_instanceCount].model = snapshot.GetTransform(model);
+			for (uint32_t mesh = 0; mesh < entry->second.meshCount; mesh++)
+				draws[m_drawCount++] = { m_instanceCount, entry->second.firstMesh + mesh };
+			m_instanceCount++;
+		}
+
+		Unmap(context, frame.draws);
+		Unmap(context, frame.instances);
+
+		CullUniform cull{};
+		ExtractFrustum(cameraViewProjection, cull.frustum[CameraView]);
+		ExtractFrustum(lightSpaceMatrix, cull.frustum[ShadowView]);
+		cull.pyramidViewProjection = m_pyramidViewProjection;
+		cull.pyramidSize = glm::vec2(m_pyramidExtent.width, m_pyramidExtent.height);
+		cull.pyramidLevels = m_pyramidLevels;
+		cull.occlusion = Enigma::occlusionCulling && m_pyramidValid ? 1 : 0;
+		cull.drawCount = m_drawCount;
+		cull.drawCapacity = m_drawCapacity;
+
+		m_cullOffset = Enigma::uniformRing->Push(cull);
+
+		m_cameraViewProjection = cameraViewProjection;
+	}
+
+	void GPUScene::Cull(VkCommandBuffer cmd)
+	{
+		if (!IsEnabled() || m_drawCount == 0)
+			return;
+
+		const FrameResources& frame = m_frames[Enigma::currentFrame];
+
+		vkCmdFillBuffer(cmd, frame.counts.buffer, 0, VK_WHOLE_SIZE, 0);
+
+		VkMemoryBarrier clearBarrier{ VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+		clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_cullPipeline.handle);
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_cullPipelineLayout.handle, 0, 1, &frame.descriptorSet, 1, &m_cullOffset);
+		// one invocation per draw and view, matches local_size_x in cull.comp
+		vkCmdDispatch(cmd, (m_drawCount + 63) / 64, ViewCount, 1);
+
+		VkMemoryBarrier cullBarrier{ VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+		cullBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		cullBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &cullBarrier, 0, nullptr, 0, nullptr);
+	}
+
+	void GPUScene::BuildDepthPyramid(VkCommandBuffer cmd)
+	{
+		if (!IsEnabled() || !Enigma::occlusionCulling || m_pyramidLevels == 0)
+			return;
+
+		// the g-buffer's depth writes and this frame's cull reading the pyramid both finish before it is rebuilt
+		VkMemoryBarrier depthBarrier{ VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+		depthBarrier.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		depthBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &depthBarrier, 0, nullptr, 0, nullptr);
+
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_pyramidPipeline.handle);
+
+		VkExtent2D source = m_depthExtent;
+		for (uint32_t level = 0; level < m_pyramidLevels; level++)
+		{
+			const VkExtent2D destination = { std::max(m_pyramidExtent.width >> level, 1u), std::max(m_pyramidExtent.height >> level, 1u) };
+			const int32_t sizes[4] = { int32_t(source.width), int32_t(source.height), int32_t(destination.width), int32_t(destination.height) };
+
+			vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, m_pyramidPipelineLayout.handle, 0, 1, &m_pyramidDescriptorSets[level], 0, nullptr);
+			vkCmdPushConstants(cmd, m_pyramidPipelineLayout.handle, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(sizes), sizes);
+			vkCmdDispatch(cmd, (destination.width + 7) / 8, (destination.height + 7) / 8, 1);
+
+			VkMemoryBarrier levelBarrier{ VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+			levelBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			levelBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			// the last level also makes the pyramid visible to the next frame's cull and keeps the next frame's
+			// g-buffer from clearing the depth before it has been read
+			const VkPipelineStageFlags dstStage = level + 1 < m_pyramidLevels ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+				: VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+			vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, dstStage, 0, 1, &levelBarrier, 0, nullptr, 0, nullptr);
+
+			source = destination;
+		}
+
+		m_pyramidValid = true;
+		m_pyramidViewProjection = m_cameraViewProjection;
+	}
+
+	void GPUScene::SetDepth(VkImageView depth, VkImageLayout layout, VkExtent2D extent)
+	{
+		if (!context.gpuDrivenSupported)
+			return;
+
+		m_depthView = depth;
+		m_depthLayout = layout;
+		m_depthExtent = extent;
+		m_pyramidValid = false;
+
+		const VkExtent2D pyramidExtent = { PreviousPowerOfTwo(extent.width), PreviousPowerOfTwo(extent.height) };
+		if (pyramidExtent.width != m_pyramidExtent.width || pyramidExtent.height != m_pyramidExtent.height)
+		{
+			DestroyDepthPyramid();
+			CreateDepthPyramid(pyramidExtent);
+		}
+
+		for (uint32_t level = 0; level < m_pyramidLevels; level++)
+		{
+			VkDescriptorImageInfo source{};
+			source.sampler = m_pyramidSampler;
+			source.imageView = level == 0 ? m_depthView : m_pyramidLevelViews[level - 1];
+			source.imageLayout = level == 0 ? m_depthLayout : VK_IMAGE_LAYOUT_GENERAL;
+			UpdateDescriptorSet(context, 0, source, m_pyramidDescriptorSets[level], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+
+			VkDescriptorImageInfo destination{};
+			destination.imageView = m_pyramidLevelViews[level];
+			destination.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+			UpdateDescriptorSet(context, 1, destination, m_pyramidDescriptorSets[level], VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+		}
+
+		WriteDescriptorSets();
+	}
+
+	void GPUScene::Draw(VkCommandBuffer cmd, VkPipelineLayout layout, View view, uint32_t set) const
+	{
+		if (m_drawCount == 0)
+			return;
+
+		const FrameResources& frame = m_frames[Enigma::currentFrame];
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, set, 1, &frame.descriptorSet, 1, &m_cullOffset);
+
+		m_geometry.Bind(cmd);
+
+		const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+		const VkDeviceSize commandOffset = VkDeviceSize(view) * m_drawCapacity * stride;
+		const VkDeviceSize countOffset = VkDeviceSize(view) * sizeof(uint32_t);
+		vkCmdDrawIndexedIndirectCount(cmd, frame.commands.buffer, commandOffset, frame.counts.buffer, countOffset, m_drawCount, stride);
+	}
+
+	void GPUScene::Register(const std::vector<Model*>& models)
+	{
+		m_updateCount++;
+
+		// slots retired MAX_FRAMES_IN_FLIGHT updates ago aren't read by any frame's cull anymore
+		const auto released = std::remove_if(m_retiredMeshes.begin(), m_retiredMeshes.end(), [&](const RetiredMeshes& retired) {
+			if (retired.update + Enigma::MAX_FRAMES_IN_FLIGHT > m_updateCount)
+				return false;
+			m_meshSlots.Free(retired.firstMesh, retired.meshCount);
+			return true;
+		});
+		m_retiredMeshes.erase(released, m_retiredMeshes.end());
+
+		std::vector<const MeshAsset*> added;
+		uint32_t meshCount = 0;
+		for (const auto& model : models)
+		{
+			if (!Accepts(model))
+				continue;
+
+			const MeshAsset* asset = model->asset.get();
+			const uint32_t key = GeometryKey(asset);
+			const auto entry = m_assets.find(asset);
+			if (entry != m_assets.end())
+			{
+				if (entry->second.geometryKey == key)
+				{
+					entry->second.lastSeen = m_updateCount;
+					continue;
+				}
+				Retire(entry->second);
+				m_assets.erase(entry);
+			}
+
+			// the asset's records are written once however many of its models are in the list
+			ModelEntry& pending = m_assets[asset];
+			pending.geometryKey = key;
+			pending.lastSeen = m_updateCount;
+			added.push_back(asset);
+			for (const auto& mesh : asset->meshes)
+				meshCount += mesh.geometry.IsValid() ? 1 : 0;
+		}
+
+		// assets without a model in the list have been unloaded or hidden, they are added again if they come back
+		for (auto entry = m_assets.begin(); entry != m_assets.end();)
+		{
+			if (entry->second.lastSeen == m_updateCount)
+			{
+				++entry;
+				continue;
+			}
+			Retire(entry->second);
+			entry = m_assets.erase(entry);
+		}
+
+		if (added.empty())
+			return;
+
+		// every asset gets a contiguous range, grow until all of them fit
+		std::vector<uint32_t> firstMeshes;
+		for (const auto& asset : added)
+		{
+			uint32_t count = 0;
+			for (const auto& mesh : asset->meshes)
+				count += mesh.geometry.IsValid() ? 1 : 0;
+
+			uint32_t firstMesh = count > 0 ? m_meshSlots.Allocate(count) : 0;
+			if (firstMesh == RangeAllocator::invalidOffset)
+			{
+				ReserveMeshes(m_meshSlots.GetCapacity() + meshCount);
+				firstMesh = m_meshSlots.Allocate(count);
+			}
+			firstMeshes.push_back(firstMesh);
+		}
+
+		auto* meshData = static_cast<GPUMesh*>(Map(context, m_meshBuffer));
+		for (size_t i = 0; i < added.size(); i++)
+		{
+			const MeshAsset* asset = added[i];
+			ModelEntry entry{ firstMeshes[i], 0, GeometryKey(asset), m_updateCount };
+			for (const auto& mesh : asset->meshes)
+			{
+				if (!mesh.geometry.IsValid())
+					continue;
+
+				GPUMesh record{};
+				record.firstIndex = mesh.geometry.firstIndex;
+				record.indexCount = mesh.geometry.indexCount;
+				record.vertexOffset = static_cast<int32_t>(mesh.geometry.firstVertex);
+				record.materialID = mesh.materialID;
+				record.textured = mesh.textured ? 1 : 0;
+				record.aabbMin = mesh.meshAABB.min;
+				record.aabbMax = mesh.meshAABB.max;
+				meshData[entry.firstMesh + entry.meshCount++] = record;
+			}
+			m_assets[asset] = entry;
+		}
+		Unmap(context, m_meshBuffer);
+	}
+
+	void GPUScene::Retire(const ModelEntry& entry)
+	{
+		if (entry.meshCount > 0)
+			m_retiredMeshes.push_back({ entry.firstMesh, entry.meshCount, m_updateCount });
+	}
+
+	void GPUScene::ReserveMeshes(uint32_t meshCount)
+	{
+		if (meshCount <= m_meshSlots.GetCapacity())
+			return;
+
+		// earlier frames may still be culling with the old buffer
+		vkDeviceWaitIdle(context.device);
+
+		const uint32_t meshCapacity = std::max(meshCount, m_meshSlots.GetCapacity() * 2);
+		Buffer meshBuffer = CreateBuffer(context.allocator, VkDeviceSize(meshCapacity) * sizeof(GPUMesh), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+
+		if (m_meshSlots.GetUsed() > 0)
+		{
+			CommandPool pool = CreateCommandPool(context.device, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, context.graphicsFamilyIndex);
+			VkCommandBuffer cmd = AllocateCommandBuffer(context, pool.handle);
+			BeginCommandBuffer(cmd);
+
+			VkBufferCopy meshCopy{ 0, 0, VkDeviceSize(m_meshSlots.GetCapacity()) * sizeof(GPUMesh) };
+			vkCmdCopyBuffer(cmd, m_meshBuffer.buffer, meshBuffer.buffer, 1, &meshCopy);
+
+			EndAndSubmitCommandBuffer(context, cmd);
+		}
+
+		m_meshBuffer = std::move(meshBuffer);
+		m_meshSlots.Grow(meshCapacity);
+
+		WriteDescriptorSets();
+	}
+
+	void GPUScene::ReserveDraws(uint32_t instanceCount, uint32_t drawCount)
+	{
+		if (instanceCount <= m_instanceCapacity && drawCount <= m_drawCapacity)
+			return;
+
+		vkDeviceWaitIdle(context.device);
+
+		m_instanceCapacity = std::max(instanceCount, m_instanceCapacity * 2);
+		m_drawCapacity = std::max(drawCount, m_drawCapacity * 2);
+
+		// every view gets its own range of commands and its own count
+		for (auto& frame : m_frames)
+		{
+			frame.instances = CreateBuffer(context.allocator, m_instanceCapacity * sizeof(GPUInstance), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+			frame.draws = CreateBuffer(context.allocator, m_drawCapacity * sizeof(GPUDraw), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+			frame.commands = CreateBuffer(context.allocator, VkDeviceSize(ViewCount) * m_drawCapacity * sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, 0, VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE);
+			frame.counts = CreateBuffer(context.allocator, VkDeviceSize(ViewCount) * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, 0, VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE);
+		}
+
+		WriteDescriptorSets();
+	}
+
+	void GPUScene::WriteDescriptorSets()
+	{
+		for (auto& frame : m_frames)
+		{
+			// buffers are created in the constructor, until then there is nothing to write
+			if (frame.instances.buffer == VK_NULL_HANDLE || m_meshBuffer.buffer == VK_NULL_HANDLE)
+				continue;
+
+			UpdateDescriptorSet(context, 0, BufferInfo(frame.instances), frame.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+			UpdateDescriptorSet(context, 1, BufferInfo(frame.draws), frame.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+			UpdateDescriptorSet(context, 2, BufferInfo(m_meshBuffer), frame.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+			UpdateDescriptorSet(context, 3, BufferInfo(frame.commands), frame.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+			UpdateDescriptorSet(context, 4, BufferInfo(frame.counts), frame.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+			UpdateDescriptorSet(context, 5, Enigma::uniformRing->GetDescriptorInfo(sizeof(CullUniform)), frame.descriptorSet, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
+
+			if (m_pyramid.imageView != VK_NULL_HANDLE)
+			{
+				VkDescriptorImageInfo pyramid{};
+				pyramid.sampler = m_pyramidSampler;
+				pyramid.imageView = m_pyramid.imageView;
+				pyramid.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+				UpdateDescriptorSet(context, 6, pyramid, frame.descriptorSet, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+			}
+		}
+	}
+
+	void GPUScene::CreatePipelines()
+	{
+		const auto createComputePipeline = [&](const char* shader, VkDescriptorSetLayout setLayout, uint32_t pushConstantSize, PipelineLayout& pipelineLayout) {
+			ShaderModule module = CreateShaderModule(shader, context.device);
+
+			VkPushConstantRange pushConstant{};
+			pushConstant.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+			pushConstant.offset = 0;
+			pushConstant.size = pushConstantSize;
+
+			VkPipelineLayoutCreateInfo layoutInfo{ VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
+			layoutInfo.setLayoutCount = 1;
+			layoutInfo.pSetLayouts = &setLayout;
+			layoutInfo.pushConstantRangeCount = pushConstantSize > 0 ? 1 : 0;
+			layoutInfo.pPushConstantRanges = &pushConstant;
+
+			VkPipelineLayout layout = VK_NULL_HANDLE;
+			ENIGMA_VK_CHECK(vkCreatePipelineLayout(context.device, &layoutInfo, nullptr, &layout), "Failed to create compute pipeline layout");
+			pipelineLayout = PipelineLayout(context.device, layout);
+
+			VkComputePipelineCreateInfo pipelineInfo{ VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
+			pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+			pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+			pipelineInfo.stage.module = module.handle;
+			pipelineInfo.stage.pName = "main";
+			pipelineInfo.layout = pipelineLayout.handle;
+
+			VkPipeline pipeline = VK_NULL_HANDLE;
+			ENIGMA_VK_CHECK(vkCreateComputePipelines(context.device, Enigma::pipelineCache, 1, &pipelineInfo, nullptr, &pipeline), "Failed to create compute pipeline.");
+			return Pipeline(context.device, pipeline);
+		};
+
+		m_cullPipeline = createComputePipeline(CULL_COMPUTE, m_descriptorSetLayout, 0, m_cullPipelineLayout);
+		// source and destination sizes as two ivec2
+		m_pyramidPipeline = createComputePipeline(DEPTH_PYRAMID_COMPUTE, m_pyramidSetLayout, 4 * sizeof(int32_t), m_pyramidPipelineLayout);
+	}
+
+	void GPUScene::CreateDepthPyramid(VkExtent2D extent)
+	{
+		m_pyramidExtent = extent;
+		m_pyramidLevels = std::min(CalculateMipLevels(extent.width, extent.height), maxPyramidLevels);
+		m_pyramid = CreateImageTexture2D(context, extent.width, extent.height, VK_FORMAT_R32_SFLOAT, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_IMAGE_ASPECT_COLOR_BIT, m_pyramidLevels);
+
+		for (uint32_t level = 0; level < m_pyramidLevels; level++)
+		{
+			VkImageViewCreateInfo viewInfo{ VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
+			viewInfo.image = m_pyramid.image;
+			viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			viewInfo.format = VK_FORMAT_R32_SFLOAT;
+			viewInfo.subresourceRange = VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1 };
+
+			VkImageView view = VK_NULL_HANDLE;
+			ENIGMA_VK_CHECK(vkCreateImageView(context.device, &viewInfo, nullptr, &view), "Failed to create depth pyramid level view");
+			m_pyramidLevelViews.push_back(view);
+		}
+
+		// the pyramid is written and sampled in general layout, it never changes
+		CommandPool pool = CreateCommandPool(context.device, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, context.graphicsFamilyIndex);
+		VkCommandBuffer cmd = AllocateCommandBuffer(context, pool.handle);
+		BeginCommandBuffer(cmd);
+		ImageBarrier(cmd, m_pyramid.image, 0, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, m_pyramidLevels, 0, 1 });
+		EndAndSubmitCommandBuffer(context, cmd);
+	}
+
+	void GPUScene::DestroyDepthPyramid()
+	{
+		for (auto& view : m_pyramidLevelViews)
+			vkDestroyImageView(context.device, view, nullptr);
+		m_pyramidLevelViews.clear();
+		m_pyramid = Image();
+		m_pyramidExtent = {};
+		m_pyramidLevels = 0;
+	}
+}
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <Volk/volk.h>
+#include <glm/glm.hpp>
+#include "Common.h"
+#include "VulkanContext.h"
+#include "VulkanBuffer.h"
+#include "VulkanImage.h"
+#include "GeometryArena.h"
+#include "Model.h"
+
+#define CULL_COMPUTE "../resources/Shaders/cull.comp.spv"
+#define DEPTH_PYRAMID_COMPUTE "../resources/Shaders/depth_pyramid.comp.spv"
+
+namespace Enigma
+{
+	struct FrameSnapshot;
+
+	// Static models drawn without the CPU touching them one at a time. Their vertices and indices are already in the
+	// geometry arena, every mesh of every model is a draw in an SSBO and each frame a compute pass frustum
+	// and occlusion culls the draws and writes the VkDrawIndexedIndirectCommands that survive. A pass then draws the
+	// whole scene with one vkCmdDrawIndexedIndirectCount, however many meshes are in it. Materials come from the
+	// texture cache's set, so no draw needs a descriptor set of its own
+	class GPUScene
+	{
+	public:
+		// views the draws are culled for, each gets its own commands and counts
+		enum View : uint32_t
+		{
+			CameraView = 0,
+			ShadowView = 1,
+			ViewCount = 2
+		};
+
+		GPUScene(const VulkanContext& context, const GeometryArena& geometry);
+		~GPUScene();
+
+		GPUScene(const GPUScene&) = delete;
+		GPUScene& operator=(const GPUScene&) = delete;
+
+		// False if the device can't draw indirect counts or it has been turned off, everything goes through the
+		// CPU path then
+		bool IsEnabled() const;
+		// Models drawn by the scene instead of the CPU path, skinned models and the player are left out
+		static bool Accepts(const Model* model);
+
+		// Call once the frame's fence has signalled. Writes the mesh records of models seen for the first time,
+		// drops the ones of models no longer in the list and writes the frame's transforms, draws and cull parameters
+		void Update(const std::vector<Model*>& models, const FrameSnapshot& snapshot, const glm::mat4& cameraViewProjection, const glm::mat4& lightSpaceMatrix);
+
+		// Outside a render pass, before the passes that draw the scene
+		void Cull(VkCommandBuffer cmd);
+		// Outside a render pass, after the g-buffer pass. The next frame's occlusion test reads it
+		void BuildDepthPyramid(VkCommandBuffer cmd);
+		// The depth the pyramid is built from, call after every graph compile
+		void SetDepth(VkImageView depth, VkImageLayout layout, VkExtent2D extent);
+
+		// Draws every mesh that survived the view's cull inside a render pass, the pipeline using
+		// GetDescriptorSetLayout at @set must be bound
+		void Draw(VkCommandBuffer cmd, VkPipelineLayout layout, View view, uint32_t set) const;
+		VkDescriptorSetLayout GetDescriptorSetLayout() const { return m_descriptorSetLayout; }
+
+		size_t GetDrawCount() const { return m_drawCount; }
+		size_t GetInstanceCount() const { return m_instanceCount; }
+
+	private:
+		// std430 layouts shared with cull.comp and the indirect vertex shaders
+		struct GPUInstance
+		{
+			glm::mat4 model;
+		};
+
+		struct GPUMesh
+		{
+			uint32_t firstIndex;
+			uint32_t indexCount;
+			int32_t vertexOffset;
+			uint32_t materialID;
+			glm::vec3 aabbMin;
+			uint32_t textured;
+			glm::vec3 aabbMax;
+			uint32_t padding;
+		};
+
+		struct GPUDraw
+		{
+			uint32_t instance;
+			uint32_t mesh;
+		};
+
+		struct CullUniform
+		{
+			glm::vec4 frustum[ViewCount][6];
+			// camera the depth pyramid was rendered with
+			glm::mat4 pyramidViewProjection;
+			glm::vec2 pyramidSize;
+			uint32_t pyramidLevels;
+			uint32_t occlusion;
+			uint32_t drawCount;
+			uint32_t drawCapacity;
+			uint32_t padding[2];
+		};
+
+		// mesh records of one asset, shared by all of its models
+		struct ModelEntry
+		{
+			uint32_t firstMesh = 0;
+			uint32_t meshCount = 0;
+			// where the asset's geometry starts, tells an asset apart from an unloaded one at the same address
+			uint32_t geometryKey = UINT32_MAX;
+			uint64_t lastSeen = 0;
+		};
+
+		struct RetiredMeshes
+		{
+			uint32_t firstMesh;
+			uint32_t meshCount;
+			uint64_t update;
+		};
+
+		struct FrameResources
+		{
+			Buffer instances;
+			Buffer draws;
+			Buffer commands;
+			Buffer counts;
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		};
+
+		void Register(const std::vector<Model*>& models);
+		// Grows the mesh records to hold at least the given count, copying what they hold over
+		void ReserveMeshes(uint32_t meshCount);
+		// The slots are reused once no frame in flight can still be culling them
+		void Retire(const ModelEntry& entry);
+		// Grows every frame's per draw buffers
+		void ReserveDraws(uint32_t instanceCount, uint32_t drawCount);
+		void WriteDescriptorSets();
+		void CreatePipelines();
+		void CreateDepthPyramid(VkExtent2D extent);
+		void DestroyDepthPyramid();
+
+	private:
+		const VulkanContext& context;
+		const GeometryArena& m_geometry;
+
+		// one record per mesh of every asset, an asset's meshes are a contiguous range of slots
+		Buffer m_meshBuffer;
+		RangeAllocator m_meshSlots;
+		std::unordered_map<const MeshAsset*, ModelEntry> m_assets;
+		std::vector<RetiredMeshes> m_retiredMeshes;
+		uint64_t m_updateCount = 0;
+
+		std::vector<FrameResources> m_frames;
+		uint32_t m_instanceCapacity = 0;
+		uint32_t m_drawCapacity = 0;
+		// draws and instances of the frame being recorded
+		uint32_t m_drawCount = 0;
+		uint32_t m_instanceCount = 0;
+		// the frame's CullUniform in the uniform ring, every bind of the frame's set passes it
+		uint32_t m_cullOffset = 0;
+
+		VkDescriptorSetLayout m_descriptorSetLayout = VK_NULL_HANDLE;
+		Pipeline m_cullPipeline;
+		PipelineLayout m_cullPipelineLayout;
+
+		// max depth pyramid of last frame's g-buffer depth, one storage view and descriptor set per level
+		Image m_pyramid;
+		std::vector<VkImageView> m_pyramidLevelViews;
+		std::vector<VkDescriptorSet> m_pyramidDescriptorSets;
+		VkExtent2D m_pyramidExtent = {};
+		uint32_t m_pyramidLevels = 0;
+		bool m_pyramidValid = false;
+		glm::mat4 m_pyramidViewProjection = glm::mat4(1.0f);
+		glm::mat4 m_cameraViewProjection = glm::mat4(1.0f);
+		VkImageView m_depthView = VK_NULL_HANDLE;
+		VkImageLayout m_depthLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkExtent2D m_depthExtent = {};
+		VkSampler m_pyramidSampler = VK_NULL_HANDLE;
+		VkDescriptorSetLayout m_pyramidSetLayout = VK_NULL_HANDLE;
+		Pipeline m_pyramidPipeline;
+		PipelineLayout m_pyramidPipelineLayout;
+	};
+}
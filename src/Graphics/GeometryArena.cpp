@@ -0,0 +1,232 @@
+#include "GeometryArena.h"
+#include "Model.h"
+#include "Common.h"
+#include <cstring>
+#include <algorithm>
+#include <iterator>
+
+namespace Enigma
+{
+	namespace
+	{
+		// roughly what the level and the characters need, so loading them doesn't grow the buffers
+		constexpr uint32_t initialVertexCapacity = 512 * 1024;
+		constexpr uint32_t initialIndexCapacity = 2 * 1024 * 1024;
+	}
+
+	RangeAllocator::RangeAllocator(uint32_t capacity)
+	{
+		Grow(capacity);
+	}
+
+	uint32_t RangeAllocator::Allocate(uint32_t size)
+	{
+		if (size == 0)
+			return invalidOffset;
+
+		for (auto it = m_free.begin(); it != m_free.end(); ++it)
+		{
+			if (it->second < size)
+				continue;
+
+			const uint32_t offset = it->first;
+			const uint32_t remaining = it->second - size;
+			m_free.erase(it);
+			if (remaining > 0)
+				m_free.emplace(offset + size, remaining);
+
+			m_used += size;
+			return offset;
+		}
+		return invalidOffset;
+	}
+
+	void RangeAllocator::Free(uint32_t offset, uint32_t size)
+	{
+		if (size == 0)
+			return;
+
+		m_used -= size;
+		auto next = m_free.lower_bound(offset);
+
+		// merge with the free range right after it
+		if (next != m_free.end() && offset + size == next->first)
+		{
+			size += next->second;
+			next = m_free.erase(next);
+		}
+
+		// and the one right before it
+		if (next != m_free.begin())
+		{
+			auto previous = std::prev(next);
+			if (previous->first + previous->second == offset)
+			{
+				previous->second += size;
+				return;
+			}
+		}
+
+		m_free.emplace(offset, size);
+	}
+
+	void RangeAllocator::Grow(uint32_t newCapacity)
+	{
+		if (newCapacity <= m_capacity)
+			return;
+
+		const uint32_t offset = m_capacity;
+		const uint32_t added = newCapacity - m_capacity;
+		m_capacity = newCapacity;
+
+		// counted as used first so it is handed back like any other range and merges with a free tail
+		m_used += added;
+		Free(offset, added);
+	}
+
+	GeometryArena::GeometryArena(const VulkanContext& context) : context{ context }
+	{
+		Grow(initialVertexCapacity, initialIndexCapacity);
+	}
+
+	GeometryAllocation GeometryArena::Allocate(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
+	{
+		if (vertices.empty() || indices.empty())
+			return {};
+
+		const uint32_t vertexCount = static_cast<uint32_t>(vertices.size());
+		const uint32_t indexCount = static_cast<uint32_t>(indices.size());
+
+		uint32_t firstVertex = m_vertices.Allocate(vertexCount);
+		uint32_t firstIndex = m_indices.Allocate(indexCount);
+		if (firstVertex == RangeAllocator::invalidOffset || firstIndex == RangeAllocator::invalidOffset)
+		{
+			// only the buffer that is full grows
+			Grow(firstVertex == RangeAllocator::invalidOffset ? vertexCount : 0, firstIndex == RangeAllocator::invalidOffset ? indexCount : 0);
+			if (firstVertex == RangeAllocator::invalidOffset)
+				firstVertex = m_vertices.Allocate(vertexCount);
+			if (firstIndex == RangeAllocator::invalidOffset)
+				firstIndex = m_indices.Allocate(indexCount);
+		}
+
+		const VkDeviceSize vertexBytes = VkDeviceSize(vertexCount) * sizeof(Vertex);
+		const VkDeviceSize indexBytes = VkDeviceSize(indexCount) * sizeof(uint32_t);
+		const VkDeviceSize stagingOffset = m_staging.size();
+		m_staging.resize(m_staging.size() + vertexBytes + indexBytes);
+		std::memcpy(m_staging.data() + stagingOffset, vertices.data(), vertexBytes);
+		std::memcpy(m_staging.data() + stagingOffset + vertexBytes, indices.data(), indexBytes);
+
+		m_pendingCopies.push_back({ stagingOffset, VkDeviceSize(firstVertex) * sizeof(Vertex), vertexBytes, false });
+		m_pendingCopies.push_back({ stagingOffset + vertexBytes, VkDeviceSize(firstIndex) * sizeof(uint32_t), indexBytes, true });
+
+		m_allocationCount++;
+		return { firstVertex, vertexCount, firstIndex, indexCount };
+	}
+
+	void GeometryArena::Flush()
+	{
+		if (m_pendingCopies.empty())
+			return;
+
+		Buffer staging = CreateBuffer(context.allocator, m_staging.size(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+
+		void* data = nullptr;
+		ENIGMA_VK_CHECK(vmaMapMemory(context.allocator.allocator, staging.allocation, &data), "Failed to map geometry staging buffer");
+		std::memcpy(data, m_staging.data(), m_staging.size());
+		vmaUnmapMemory(context.allocator.allocator, staging.allocation);
+
+		std::vector<VkBufferCopy> vertexCopies;
+		std::vector<VkBufferCopy> indexCopies;
+		for (const auto& copy : m_pendingCopies)
+			(copy.index ? indexCopies : vertexCopies).push_back({ copy.stagingOffset, copy.dstOffset, copy.size });
+
+		CommandPool pool = CreateCommandPool(context.device, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, context.graphicsFamilyIndex);
+		VkCommandBuffer cmd = AllocateCommandBuffer(context, pool.handle);
+		BeginCommandBuffer(cmd);
+
+		if (!vertexCopies.empty())
+			vkCmdCopyBuffer(cmd, staging.buffer, m_vertexBuffer.buffer, static_cast<uint32_t>(vertexCopies.size()), vertexCopies.data());
+		if (!indexCopies.empty())
+			vkCmdCopyBuffer(cmd, staging.buffer, m_indexBuffer.buffer, static_cast<uint32_t>(indexCopies.size()), indexCopies.data());
+
+		VkMemoryBarrier barrier{ VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+		EndAndSubmitCommandBuffer(context, cmd);
+
+		m_staging.clear();
+		m_pendingCopies.clear();
+	}
+
+	void GeometryArena::Free(const GeometryAllocation& allocation)
+	{
+		if (!allocation.IsValid())
+			return;
+
+		m_retired.push_back({ allocation, m_frame });
+	}
+
+	void GeometryArena::BeginFrame()
+	{
+		m_frame++;
+
+		// a range freed while frame N was being recorded may be drawn up to frame N, which has finished once this
+		// frame slot comes around again
+		const auto released = std::remove_if(m_retired.begin(), m_retired.end(), [&](const RetiredAllocation& retired) {
+			if (retired.frame + Enigma::MAX_FRAMES_IN_FLIGHT > m_frame)
+				return false;
+
+			m_vertices.Free(retired.allocation.firstVertex, retired.allocation.vertexCount);
+			m_indices.Free(retired.allocation.firstIndex, retired.allocation.indexCount);
+			m_allocationCount--;
+			return true;
+		});
+		m_retired.erase(released, m_retired.end());
+	}
+
+	void GeometryArena::Bind(VkCommandBuffer cmd) const
+	{
+		VkDeviceSize offset[] = { 0 };
+		vkCmdBindVertexBuffers(cmd, 0, 1, &m_vertexBuffer.buffer, offset);
+		vkCmdBindIndexBuffer(cmd, m_indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
+	}
+
+	void GeometryArena::Grow(uint32_t vertexCount, uint32_t indexCount)
+	{
+		// the queued copies target the old buffers
+		Flush();
+
+		// frames in flight may still be drawing from the old buffers
+		if (m_vertexBuffer.buffer != VK_NULL_HANDLE)
+			vkDeviceWaitIdle(context.device);
+
+		// the free space may be split up, so the new tail alone has to fit the range
+		const auto grow = [&](Buffer& buffer, RangeAllocator& ranges, uint32_t count, VkDeviceSize stride, VkBufferUsageFlags usage) {
+			if (count == 0)
+				return;
+
+			const uint32_t capacity = std::max(ranges.GetCapacity() * 2, ranges.GetCapacity() + count);
+			Buffer grown = CreateBuffer(context.allocator, capacity * stride, usage | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, 0, VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE);
+
+			if (ranges.GetCapacity() > 0)
+			{
+				CommandPool pool = CreateCommandPool(context.device, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, context.graphicsFamilyIndex);
+				VkCommandBuffer cmd = AllocateCommandBuffer(context, pool.handle);
+				BeginCommandBuffer(cmd);
+
+				VkBufferCopy copy{ 0, 0, ranges.GetCapacity() * stride };
+				vkCmdCopyBuffer(cmd, buffer.buffer, grown.buffer, 1, &copy);
+
+				EndAndSubmitCommandBuffer(context, cmd);
+			}
+
+			buffer = std::move(grown);
+			ranges.Grow(capacity);
+		};
+
+		grow(m_vertexBuffer, m_vertices, vertexCount, sizeof(Vertex), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+		grow(m_indexBuffer, m_indices, indexCount, sizeof(uint32_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+	}
+}
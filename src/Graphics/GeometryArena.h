@@ -0,0 +1,115 @@
+#pragma once
+
+#include <map>
+#include <vector>
+#include <cstdint>
+#include <Volk/volk.h>
+#include "VulkanContext.h"
+#include "VulkanBuffer.h"
+
+namespace Enigma
+{
+	struct Vertex;
+
+	// First fit free list over [0, capacity) in whatever unit the caller counts in. Neighbouring free ranges are
+	// merged when a range is freed, so freeing everything gets back one range the size of the capacity
+	class RangeAllocator
+	{
+	public:
+		static constexpr uint32_t invalidOffset = UINT32_MAX;
+
+		explicit RangeAllocator(uint32_t capacity = 0);
+
+		// Offset of a free range of the given size, invalidOffset if none is large enough
+		uint32_t Allocate(uint32_t size);
+		void Free(uint32_t offset, uint32_t size);
+		// Adds [capacity, newCapacity) to the free ranges
+		void Grow(uint32_t newCapacity);
+
+		uint32_t GetCapacity() const { return m_capacity; }
+		uint32_t GetUsed() const { return m_used; }
+		size_t GetFreeRangeCount() const { return m_free.size(); }
+
+	private:
+		// offset -> size of every free range
+		std::map<uint32_t, uint32_t> m_free;
+		uint32_t m_capacity = 0;
+		uint32_t m_used = 0;
+	};
+
+	// Where a mesh lives in the arena, draw it with vkCmdDrawIndexed(indexCount, 1, firstIndex, firstVertex, 0)
+	struct GeometryAllocation
+	{
+		uint32_t firstVertex = 0;
+		uint32_t vertexCount = 0;
+		uint32_t firstIndex = 0;
+		uint32_t indexCount = 0;
+
+		bool IsValid() const { return indexCount > 0; }
+	};
+
+	// Every mesh's vertices and indices in one device local vertex buffer and one index buffer, so a pass binds
+	// them once and draws pick their mesh with firstIndex and vertexOffset instead of binding buffers per draw.
+	// Meshes are placed with a free list and given back when their model is unloaded. The buffers double when
+	// nothing fits, which waits for the device to go idle
+	class GeometryArena
+	{
+	public:
+		explicit GeometryArena(const VulkanContext& context);
+
+		GeometryArena(const GeometryArena&) = delete;
+		GeometryArena& operator=(const GeometryArena&) = delete;
+
+		// Reserves room for the mesh and queues its upload, nothing reaches the GPU until Flush
+		GeometryAllocation Allocate(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+		// Uploads everything allocated since the last flush in one submit and waits for it
+		void Flush();
+		// The range is reused once no frame in flight can still be drawing it
+		void Free(const GeometryAllocation& allocation);
+		// Call once a frame after its fence has signalled, releases the ranges freed long enough ago
+		void BeginFrame();
+
+		void Bind(VkCommandBuffer cmd) const;
+
+		uint32_t GetVertexCapacity() const { return m_vertices.GetCapacity(); }
+		uint32_t GetVerticesUsed() const { return m_vertices.GetUsed(); }
+		uint32_t GetIndexCapacity() const { return m_indices.GetCapacity(); }
+		uint32_t GetIndicesUsed() const { return m_indices.GetUsed(); }
+		size_t GetAllocationCount() const { return m_allocationCount; }
+		size_t GetFreeRangeCount() const { return m_vertices.GetFreeRangeCount() + m_indices.GetFreeRangeCount(); }
+
+	private:
+		struct PendingCopy
+		{
+			VkDeviceSize stagingOffset;
+			VkDeviceSize dstOffset;
+			VkDeviceSize size;
+			bool index;
+		};
+
+		struct RetiredAllocation
+		{
+			GeometryAllocation allocation;
+			uint64_t frame;
+		};
+
+		// Grows the buffers until both ranges fit, copying what they hold over
+		void Grow(uint32_t vertexCount, uint32_t indexCount);
+
+	private:
+		const VulkanContext& context;
+
+		Buffer m_vertexBuffer;
+		Buffer m_indexBuffer;
+		RangeAllocator m_vertices;
+		RangeAllocator m_indices;
+		size_t m_allocationCount = 0;
+
+		// uploads waiting for Flush, vertices and indices share the staging data
+		std::vector<uint8_t> m_staging;
+		std::vector<PendingCopy> m_pendingCopies;
+
+		std::vector<RetiredAllocation> m_retired;
+		uint64_t m_frame = 0;
+	};
+}
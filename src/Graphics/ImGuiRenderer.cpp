@@ -38,6 +38,7 @@ namespace Enigma
 		info.Subpass = 0;
 		info.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
 		info.RenderPass = imGuiRenderPass;
+		info.PipelineCache = Enigma::pipelineCache;
 		
 		ImGui_ImplVulkan_Init(&info);
 
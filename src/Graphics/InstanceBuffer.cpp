@@ -0,0 +1,80 @@
+#include "InstanceBuffer.h"
+#include "Common.h"
+#include <algorithm>
+
+namespace Enigma
+{
+	namespace
+	{
+		// 1 MB a frame, queues fall back to a draw per instance if a frame ever needs more
+		constexpr uint32_t instanceCapacity = 16384;
+	}
+
+	InstanceBuffer::InstanceBuffer(const VulkanContext& context) : context{ context }, m_capacity{ instanceCapacity }
+	{
+		std::vector<VkDescriptorSetLayoutBinding> bindings = {
+			CreateDescriptorBinding(0, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+		};
+		m_descriptorSetLayout = CreateDescriptorSetLayout(context, bindings);
+
+		std::vector<VkDescriptorSet> sets;
+		AllocateDescriptorSets(context, Enigma::descriptorPool, m_descriptorSetLayout, Enigma::MAX_FRAMES_IN_FLIGHT, sets);
+
+		m_frames.resize(Enigma::MAX_FRAMES_IN_FLIGHT);
+		for (size_t i = 0; i < m_frames.size(); i++)
+		{
+			FrameResources& frame = m_frames[i];
+			frame.buffer = CreateBuffer(context.allocator, VkDeviceSize(m_capacity) * sizeof(glm::mat4), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+			frame.descriptorSet = sets[i];
+
+			// written every frame, the mapping is kept for the buffer's lifetime
+			void* data = nullptr;
+			ENIGMA_VK_CHECK(vmaMapMemory(context.allocator.allocator, frame.buffer.allocation, &data), "Failed to map instance buffer");
+			frame.instances = static_cast<glm::mat4*>(data);
+
+			VkDescriptorBufferInfo bufferInfo{};
+			bufferInfo.buffer = frame.buffer.buffer;
+			bufferInfo.offset = 0;
+			bufferInfo.range = VK_WHOLE_SIZE;
+			UpdateDescriptorSet(context, 0, bufferInfo, frame.descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+		}
+	}
+
+	InstanceBuffer::~InstanceBuffer()
+	{
+		for (auto& frame : m_frames)
+		{
+			if (frame.instances != nullptr)
+				vmaUnmapMemory(context.allocator.allocator, frame.buffer.allocation);
+		}
+		vkDestroyDescriptorSetLayout(context.device, m_descriptorSetLayout, nullptr);
+	}
+
+	void InstanceBuffer::BeginFrame()
+	{
+		m_used = 0;
+	}
+
+	uint32_t InstanceBuffer::Allocate(uint32_t count)
+	{
+		const uint32_t first = m_used.fetch_add(count);
+		if (first + count > m_capacity)
+			return invalidOffset;
+		return first;
+	}
+
+	glm::mat4* InstanceBuffer::GetInstances() const
+	{
+		return m_frames[Enigma::currentFrame].instances;
+	}
+
+	VkDescriptorSet InstanceBuffer::GetDescriptorSet() const
+	{
+		return m_frames[Enigma::currentFrame].descriptorSet;
+	}
+
+	uint32_t InstanceBuffer::GetUsed() const
+	{
+		return std::min(m_used.load(), m_capacity);
+	}
+}
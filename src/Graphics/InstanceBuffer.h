@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <cstdint>
+#include <Volk/volk.h>
+#include <glm/glm.hpp>
+#include "VulkanContext.h"
+#include "VulkanBuffer.h"
+
+namespace Enigma
+{
+	// Model matrices of the CPU path's instanced draws, read by the instanced vertex shaders with gl_InstanceIndex.
+	// Every frame in flight has a buffer of its own that stays mapped, queues recording on any thread take ranges of
+	// the current frame's buffer and the whole buffer is reused once the frame's fence has signalled
+	class InstanceBuffer
+	{
+	public:
+		static constexpr uint32_t invalidOffset = UINT32_MAX;
+
+		explicit InstanceBuffer(const VulkanContext& context);
+		~InstanceBuffer();
+
+		InstanceBuffer(const InstanceBuffer&) = delete;
+		InstanceBuffer& operator=(const InstanceBuffer&) = delete;
+
+		// Call once a frame after its fence has signalled, before anything of the frame is recorded
+		void BeginFrame();
+		// First instance of @count matrices in the current frame's buffer, invalidOffset once it is full
+		uint32_t Allocate(uint32_t count);
+		// the current frame's matrices, write the ones Allocate handed out
+		glm::mat4* GetInstances() const;
+
+		VkDescriptorSetLayout GetDescriptorSetLayout() const { return m_descriptorSetLayout; }
+		// the current frame's buffer at binding 0
+		VkDescriptorSet GetDescriptorSet() const;
+
+		uint32_t GetUsed() const;
+		uint32_t GetCapacity() const { return m_capacity; }
+
+	private:
+		struct FrameResources
+		{
+			Buffer buffer;
+			glm::mat4* instances = nullptr;
+			VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+		};
+
+		const VulkanContext& context;
+		std::vector<FrameResources> m_frames;
+		VkDescriptorSetLayout m_descriptorSetLayout = VK_NULL_HANDLE;
+		uint32_t m_capacity = 0;
+		std::atomic<uint32_t> m_used = 0;
+	};
+}
@@ -1,75 +1,102 @@
 #include "Lighting.h"
+#include "UniformRing.h"
 #include "../Core/World.h"
+#include "../Core/Settings.h"
+#include <cstddef>
 
 namespace Enigma
 {
-	Lighting::Lighting(const VulkanContext& context, const VulkanWindow& window, GBufferTargets& targets, Image& shadowDepthTarget) : 
-		context{ context }, window{ window }, targets{ targets }, shadowDepthTarget {shadowDepthTarget}
+	namespace
 	{
-		m_width = window.swapchainExtent.width;
-		m_height = window.swapchainExtent.height;
-
-		m_uniformBO.resize(Enigma::MAX_FRAMES_IN_FLIGHT);
-		m_lightingUBO.resize(Enigma::MAX_FRAMES_IN_FLIGHT);
-		m_debugUBO.resize(Enigma::MAX_FRAMES_IN_FLIGHT);
-
-		for (auto& buffer : m_uniformBO)
-			buffer = Enigma::CreateBuffer(context.allocator, sizeof(CameraTransform), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
-
-		for(auto& buffer : m_lightingUBO)
-			buffer = Enigma::CreateBuffer(context.allocator, sizeof(LightUBO), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
-		
-		for(auto& buffer : m_debugUBO)
-			buffer = Enigma::CreateBuffer(context.allocator, sizeof(Debug), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
-
-		renderTarget = Enigma::CreateImageTexture2D(
-			context,
-			m_width,
-			m_height,
-			VK_FORMAT_R32G32B32A32_SFLOAT,
-			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-			VK_IMAGE_ASPECT_COLOR_BIT, 1
-		);
-
-		CreateRenderPass(context.device);
-		CreateFramebuffer(context.device);
+		// what the debug and render settings ask for this frame
+		LightingPermutation CurrentPermutation()
+		{
+			LightingPermutation permutation;
+			permutation.debugView = Enigma::debugSettings.debugRenderTarget;
+			permutation.reflections = Enigma::screenSpaceReflections ? VK_TRUE : VK_FALSE;
+			permutation.reflectionSteps = Enigma::debugSettings.stepCount;
+			permutation.shadowFilter = Enigma::shadowFilter;
+			return permutation;
+		}
+	}
+
+	uint32_t LightingPermutation::Key() const
+	{
+		// 2 bits of debug view, 1 of reflections, 2 of shadow filter, the rest for the step count
+		return (static_cast<uint32_t>(debugView) & 0x3)
+			| (reflections ? 1u : 0u) << 2
+			| (static_cast<uint32_t>(shadowFilter) & 0x3) << 3
+			| (static_cast<uint32_t>(reflectionSteps) & 0xFFFF) << 5;
+	}
+
+	Lighting::Lighting(const VulkanContext& context, const VulkanWindow& window, RenderGraph& graph, const GBufferTargets& targets, RenderResource shadowMap, RenderResource output) : 
+		context{ context }, window{ window }, targets{ targets }, shadowMap{ shadowMap }
+	{
+		m_RenderPass = VK_NULL_HANDLE;
+		m_descriptorSetLayout = VK_NULL_HANDLE;
+
+		m_pass = graph.AddPass("lighting", [&](RenderGraph::PassBuilder& builder) {
+			VkClearValue clearColour{};
+			clearColour.color = { {0.0f, 0.0f, 0.0f, 1.0f} };
+
+			builder.Read(targets.position);
+			builder.Read(targets.normals);
+			builder.Read(targets.depth);
+			builder.Read(targets.albedo);
+			builder.Read(shadowMap);
+			builder.Write(output, true, clearColour);
+			builder.OnCompiled([this](const RenderGraph& graph) { OnCompiled(graph); });
+		});
+
 		BuildDescriptorSetLayout(context);
-		CreatePipeline(context.device, window.swapchainExtent);
 	}
 
 	Lighting::~Lighting()
 	{
 		// destroy vulkan allocated resources 
-		if (m_framebuffer != VK_NULL_HANDLE)
+		if (m_descriptorSetLayout != VK_NULL_HANDLE)
 		{
-			vkDestroyFramebuffer(context.device, m_framebuffer, nullptr);
+			vkDestroyDescriptorSetLayout(context.device, m_descriptorSetLayout, nullptr);
 		}
+	}
+
+	void Lighting::OnCompiled(const RenderGraph& graph)
+	{
+		m_RenderPass = graph.GetRenderPass(m_pass);
+		m_width = graph.GetExtent(m_pass).width;
+		m_height = graph.GetExtent(m_pass).height;
 
-		if (m_RenderPass != VK_NULL_HANDLE)
+		if (m_pipelineLayout.handle == VK_NULL_HANDLE)
 		{
-			vkDestroyRenderPass(context.device, m_RenderPass, nullptr);
+			CreatePipelineLayout(context.device);
+			m_pipeline = GetPipeline(CurrentPermutation());
 		}
 
-		if (m_descriptorSetLayout != VK_NULL_HANDLE)
+		// the targets may have been recreated, point the descriptors at the new views
+		const std::pair<uint32_t, RenderResource> textures[] = {
+			{ 1, targets.position },
+			{ 2, targets.normals },
+			{ 3, targets.depth },
+			{ 4, targets.albedo },
+			{ 5, shadowMap }
+		};
+
+		for (size_t i = 0; i < Enigma::MAX_FRAMES_IN_FLIGHT; i++)
 		{
-			vkDestroyDescriptorSetLayout(context.device, m_descriptorSetLayout, nullptr);
+			for (const auto& [binding, texture] : textures)
+			{
+				VkDescriptorImageInfo imageInfo = {};
+				imageInfo.imageLayout = graph.GetReadLayout(texture);
+				imageInfo.imageView = graph.GetImageView(texture);
+				imageInfo.sampler = Enigma::defaultSampler;
+
+				UpdateDescriptorSet(context, binding, imageInfo, m_descriptorSets[i], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+			}
 		}
 	}
 
-	void Lighting::Execute(VkCommandBuffer cmd)
+	void Lighting::Record(VkCommandBuffer cmd)
 	{
-		VkRenderPassBeginInfo rpBegin{ VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
-		rpBegin.renderPass = m_RenderPass;
-		rpBegin.framebuffer = m_framebuffer;
-		rpBegin.renderArea.extent = { m_width, m_height };
-		rpBegin.renderArea.offset = { 0,0 };
-
-		VkClearValue clearValues[2]; // 3 color, 1 depth
-		clearValues[0].color = { {0.0f, 0.0f, 0.0f, 1.0f} };
-		clearValues[1].depthStencil.depth = 1.0f;
-		rpBegin.clearValueCount = 2;
-		rpBegin.pClearValues = clearValues;
-
 		VkViewport viewport{};
 		viewport.x = 0.0f;
 		viewport.y = 0.0f;
@@ -84,21 +111,18 @@ namespace Enigma
 		scissor.extent = { m_width, m_height };
 		vkCmdSetScissor(cmd, 0, 1, &scissor);
 
-		vkCmdBeginRenderPass(cmd, &rpBegin, VK_SUBPASS_CONTENTS_INLINE);
-		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout.handle, 0, 1, &m_descriptorSets[Enigma::currentFrame], 0, nullptr);
+		// dynamic offsets go in binding order
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout.handle, 0, 1, &m_descriptorSets[Enigma::currentFrame], 3, m_uniformOffsets);
 
-		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline.handle);
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline);
 		vkCmdDraw(cmd, 3, 1, 0, 0);
-
-		vkCmdEndRenderPass(cmd);
 	}
 
 	void Lighting::Update(Camera* camera)
 	{
-		void* data = nullptr;
-		vmaMapMemory(context.allocator.allocator, m_uniformBO[Enigma::currentFrame].allocation, &data);
-		std::memcpy(data, &camera->GetCameraTransform(), sizeof(camera->GetCameraTransform()));
-		vmaUnmapMemory(context.allocator.allocator, m_uniformBO[Enigma::currentFrame].allocation);
+		m_pipeline = GetPipeline(CurrentPermutation());
+
+		m_uniformOffsets[0] = Enigma::uniformRing->Push(camera->GetCameraTransform());
 
 		// if we have a directional light defined by the user then use it 
 		// NOTE: probably don't need to pass LightUBO from shadow pass to here since the lighting can be accessed from the World 
@@ -121,96 +145,47 @@ namespace Enigma
 		}
 	
 		// Update the lighting uniform
-		vmaMapMemory(context.allocator.allocator, m_lightingUBO[Enigma::currentFrame].allocation, &data);
-		std::memcpy(data, &m_lightUBO, sizeof(m_lightUBO));
-		vmaUnmapMemory(context.allocator.allocator, m_lightingUBO[Enigma::currentFrame].allocation);
+		m_uniformOffsets[1] = Enigma::uniformRing->Push(m_lightUBO);
 
 		// Update the debug renderer uniform
-		vmaMapMemory(context.allocator.allocator, m_debugUBO[Enigma::currentFrame].allocation, &data);
-		std::memcpy(data, &Enigma::debugSettings, sizeof(Enigma::debugSettings));
-		vmaUnmapMemory(context.allocator.allocator, m_debugUBO[Enigma::currentFrame].allocation);
+		m_uniformOffsets[2] = Enigma::uniformRing->Push(Enigma::debugSettings);
 	}
 
-	void Lighting::Resize(const VulkanWindow& window)
+	VkPipeline Lighting::GetPipeline(const LightingPermutation& permutation)
 	{
-		m_width = window.swapchainExtent.width;
-		m_height = window.swapchainExtent.height;
-
-		renderTarget = Enigma::CreateImageTexture2D(
-			context,
-			m_width,
-			m_height,
-			VK_FORMAT_R32G32B32A32_SFLOAT,
-			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-			VK_IMAGE_ASPECT_COLOR_BIT, 1
-		);
-
-		vkDestroyRenderPass(context.device, m_RenderPass, nullptr);
-		vkDestroyFramebuffer(context.device, m_framebuffer, nullptr);
-		vkDestroyDescriptorSetLayout(context.device, m_descriptorSetLayout, nullptr);
-		
-		CreateRenderPass(context.device);
-		CreateFramebuffer(context.device);
-		BuildDescriptorSetLayout(context);
+		const uint32_t key = permutation.Key();
+		auto found = m_pipelines.find(key);
+		if (found == m_pipelines.end())
+			found = m_pipelines.emplace(key, CreatePipeline(context.device, permutation)).first;
+		return found->second.handle;
 	}
 
-	void Lighting::CreateFramebuffer(VkDevice device)
+	void Lighting::CreatePipelineLayout(VkDevice device)
 	{
-		std::vector<VkImageView> attachments = { renderTarget.imageView };
-		VkFramebufferCreateInfo fbInfo{ VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO };
-		fbInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-		fbInfo.pAttachments = attachments.data();
-		fbInfo.renderPass = m_RenderPass;
-		fbInfo.width = m_width;
-		fbInfo.height = m_height;
-		fbInfo.layers = 1;
-
-		ENIGMA_VK_CHECK(vkCreateFramebuffer(device, &fbInfo, nullptr, &m_framebuffer), "Failed to create lighting pass frame buffer");
-	}
+		VkPushConstantRange pushConstant{};
+		pushConstant.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+		pushConstant.offset = 0;
+		pushConstant.size = sizeof(Enigma::ModelPushConstant);
 
-	void Lighting::CreateRenderPass(VkDevice device)
-	{
-		VkAttachmentDescription colorAttachment = {};
-		colorAttachment.format = VK_FORMAT_R32G32B32A32_SFLOAT;
-		colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-		colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-		colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		colorAttachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-		VkAttachmentReference colorReference = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
-
-		VkSubpassDescription subpass = {};
-		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-		subpass.colorAttachmentCount = 1;
-		subpass.pColorAttachments = &colorReference;
-
-		VkSubpassDependency dependency[1] = {};
-		dependency[0].srcSubpass = VK_SUBPASS_EXTERNAL; // this is the render pass before this one
-		dependency[0].dstSubpass = 0; // this is the current lighting render pass 
-		dependency[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT; // this says that the lighing pass in the fragment shader relies on the color attachment output stage of the previous pass
-		dependency[0].srcAccessMask = VK_ACCESS_NONE; // dependency[0].srcAccessMask = 0;
-		dependency[0].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT; // // this says that the lighing pass in the fragment shader relies on the color attachment output stage of the previous pass
-		dependency[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-		VkAttachmentDescription attachments[1] = { colorAttachment };
-
-		VkRenderPassCreateInfo renderPassInfo{ VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO };
-		renderPassInfo.attachmentCount = static_cast<uint32_t>(1);
-		renderPassInfo.pAttachments = attachments;
-		renderPassInfo.subpassCount = 1;
-		renderPassInfo.pSubpasses = &subpass;
-		renderPassInfo.dependencyCount = 1;
-		renderPassInfo.pDependencies = dependency;
-
-
-		ENIGMA_VK_CHECK(vkCreateRenderPass(device, &renderPassInfo, nullptr, &m_RenderPass), "Failed to create lighting pass render pass.");
+		std::vector<VkDescriptorSetLayout> layouts = { m_descriptorSetLayout };
 
+		// no descriptor set layouts currently since it's not needed
+		VkPipelineLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		layoutInfo.setLayoutCount = (uint32_t)layouts.size();
+		layoutInfo.pSetLayouts = layouts.data();
+		layoutInfo.pushConstantRangeCount = 1;
+		layoutInfo.pPushConstantRanges = &pushConstant;
+
+		VkPipelineLayout layout = VK_NULL_HANDLE;
+		VkResult res = vkCreatePipelineLayout(device, &layoutInfo, nullptr, &layout);
+
+		ENIGMA_VK_CHECK(res, "Failed to create pipeline layout");
+
+		m_pipelineLayout = PipelineLayout(device, layout);
 	}
 
-	void Lighting::CreatePipeline(VkDevice device, VkExtent2D swapchainExtent)
+	Pipeline Lighting::CreatePipeline(VkDevice device, const LightingPermutation& permutation)
 	{
 		ShaderModule vertexShader = CreateShaderModule(LIGHTING_VERTEX, device);
 		ShaderModule fragmentShader = CreateShaderModule(LIGHTING_FRAGMENT, device);
@@ -227,6 +202,21 @@ namespace Enigma
 		fragShaderStageInfo.module = fragmentShader.handle;
 		fragShaderStageInfo.pName = "main";
 
+		// constant_id order of fs_lighting.frag
+		const VkSpecializationMapEntry specializationEntries[] = {
+			{ 0, offsetof(LightingPermutation, debugView), sizeof(int32_t) },
+			{ 1, offsetof(LightingPermutation, reflections), sizeof(VkBool32) },
+			{ 2, offsetof(LightingPermutation, reflectionSteps), sizeof(int32_t) },
+			{ 3, offsetof(LightingPermutation, shadowFilter), sizeof(int32_t) }
+		};
+
+		VkSpecializationInfo specializationInfo{};
+		specializationInfo.mapEntryCount = 4;
+		specializationInfo.pMapEntries = specializationEntries;
+		specializationInfo.dataSize = sizeof(LightingPermutation);
+		specializationInfo.pData = &permutation;
+		fragShaderStageInfo.pSpecializationInfo = &specializationInfo;
+
 		VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
 
 		VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
@@ -293,28 +283,6 @@ namespace Enigma
 		depthInfo.minDepthBounds = 0.0f;
 		depthInfo.maxDepthBounds = 1.0f;
 
-		VkPushConstantRange pushConstant{};
-		pushConstant.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-		pushConstant.offset = 0;
-		pushConstant.size = sizeof(Enigma::ModelPushConstant);
-
-		std::vector<VkDescriptorSetLayout> layouts = { m_descriptorSetLayout };
-
-		// no descriptor set layouts currently since it's not needed
-		VkPipelineLayoutCreateInfo layoutInfo{};
-		layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-		layoutInfo.setLayoutCount = (uint32_t)layouts.size();
-		layoutInfo.pSetLayouts = layouts.data();
-		layoutInfo.pushConstantRangeCount = 1;
-		layoutInfo.pPushConstantRanges = &pushConstant;
-
-		VkPipelineLayout layout = VK_NULL_HANDLE;
-		VkResult res = vkCreatePipelineLayout(device, &layoutInfo, nullptr, &layout);
-
-		ENIGMA_VK_CHECK(res, "Failed to create pipeline layout");
-
-		m_pipelineLayout = PipelineLayout(device, layout);
-
 		VkGraphicsPipelineCreateInfo pipelineInfo{};
 		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
 		pipelineInfo.stageCount = 2;
@@ -333,9 +301,9 @@ namespace Enigma
 		pipelineInfo.subpass = 0;
 
 		VkPipeline pipeline = VK_NULL_HANDLE;
-		ENIGMA_VK_CHECK(vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline), "Failed to create graphics pipeline.");
+		ENIGMA_VK_CHECK(vkCreateGraphicsPipelines(device, Enigma::pipelineCache, 1, &pipelineInfo, nullptr, &pipeline), "Failed to create graphics pipeline.");
 
-		m_pipeline = Pipeline(device, pipeline);
+		return Pipeline(device, pipeline);
 	}
 
 	void Lighting::BuildDescriptorSetLayout(const VulkanContext& context)
@@ -346,14 +314,14 @@ namespace Enigma
 		// Set = 0
 		{
 			std::vector<VkDescriptorSetLayoutBinding> bindings = {
-				CreateDescriptorBinding(0, 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT),
+				CreateDescriptorBinding(0, 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT),
 				CreateDescriptorBinding(1, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT),
 				CreateDescriptorBinding(2, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT),
 				CreateDescriptorBinding(3, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT),
 				CreateDescriptorBinding(4, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT),
 				CreateDescriptorBinding(5, 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT),
-				CreateDescriptorBinding(6, 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT),
-				CreateDescriptorBinding(7, 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT)
+				CreateDescriptorBinding(6, 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_FRAGMENT_BIT),
+				CreateDescriptorBinding(7, 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_FRAGMENT_BIT)
 			};
 
 			m_descriptorSetLayout = CreateDescriptorSetLayout(context, bindings);
@@ -361,89 +329,12 @@ namespace Enigma
 
 		AllocateDescriptorSets(context, Enigma::descriptorPool, m_descriptorSetLayout, Enigma::MAX_FRAMES_IN_FLIGHT, m_descriptorSets);
 
-		// Camera transform buffer
-		for (size_t i = 0; i < Enigma::MAX_FRAMES_IN_FLIGHT; i++)
-		{
-			VkDescriptorBufferInfo bufferInfo{};
-			bufferInfo.buffer = m_uniformBO[i].buffer;
-			bufferInfo.offset = 0;
-			bufferInfo.range = sizeof(CameraTransform);
-			UpdateDescriptorSet(context, 0, bufferInfo, m_descriptorSets[i], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
-		}
-
-		// position texture
-		for (size_t i = 0; i < Enigma::MAX_FRAMES_IN_FLIGHT; i++)
-		{
-			VkDescriptorImageInfo imageInfo = {};
-			imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			imageInfo.imageView = targets.position.imageView;// need the g-buffer normals texture image view
-			imageInfo.sampler = Enigma::defaultSampler;
-
-			UpdateDescriptorSet(context, 1, imageInfo, m_descriptorSets[i], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
-		}
-		
-		// Normals texture
-		for (size_t i = 0; i < Enigma::MAX_FRAMES_IN_FLIGHT; i++)
-		{
-			VkDescriptorImageInfo imageInfo = {};
-			imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			imageInfo.imageView = targets.normals.imageView;// need the g-buffer normals texture image view
-			imageInfo.sampler = Enigma::defaultSampler;
-
-			UpdateDescriptorSet(context, 2, imageInfo, m_descriptorSets[i], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
-		}
-
-		// Depth map texture
-		for (size_t i = 0; i < Enigma::MAX_FRAMES_IN_FLIGHT; i++)
-		{
-			VkDescriptorImageInfo imageInfo = {};
-			imageInfo.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
-			imageInfo.imageView = targets.depth.imageView;
-			imageInfo.sampler = Enigma::defaultSampler;
-
-			UpdateDescriptorSet(context, 3, imageInfo, m_descriptorSets[i], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
-		}
-
-		// Albedo texture
-		for (size_t i = 0; i < Enigma::MAX_FRAMES_IN_FLIGHT; i++)
-		{
-			VkDescriptorImageInfo imageInfo = {};
-			imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			imageInfo.imageView = targets.albedo.imageView;
-			imageInfo.sampler = Enigma::defaultSampler;
-
-			UpdateDescriptorSet(context, 4, imageInfo, m_descriptorSets[i], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
-		}
-
-		// Shadow map texture
-		for (size_t i = 0; i < Enigma::MAX_FRAMES_IN_FLIGHT; i++)
-		{
-			VkDescriptorImageInfo imageInfo = {};
-			imageInfo.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
-			imageInfo.imageView = shadowDepthTarget.imageView;
-			imageInfo.sampler = Enigma::defaultSampler;
-
-			UpdateDescriptorSet(context, 5, imageInfo, m_descriptorSets[i], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
-		}
-
-		// Lighting buffer 
-		for (size_t i = 0; i < Enigma::MAX_FRAMES_IN_FLIGHT; i++)
-		{
-			VkDescriptorBufferInfo bufferInfo{};
-			bufferInfo.buffer = m_lightingUBO[i].buffer;
-			bufferInfo.offset = 0;
-			bufferInfo.range = sizeof(LightUBO);
-			UpdateDescriptorSet(context, 6, bufferInfo, m_descriptorSets[i], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
-		}
-
-		// Debug setting
+		// Camera transform, lighting and debug settings, all in the uniform ring at the offsets the set is bound with
 		for (size_t i = 0; i < Enigma::MAX_FRAMES_IN_FLIGHT; i++)
 		{
-			VkDescriptorBufferInfo bufferInfo{};
-			bufferInfo.buffer = m_debugUBO[i].buffer;
-			bufferInfo.offset = 0;
-			bufferInfo.range = sizeof(Debug);
-			UpdateDescriptorSet(context, 7, bufferInfo, m_descriptorSets[i], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+			UpdateDescriptorSet(context, 0, Enigma::uniformRing->GetDescriptorInfo(sizeof(CameraTransform)), m_descriptorSets[i], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
+			UpdateDescriptorSet(context, 6, Enigma::uniformRing->GetDescriptorInfo(sizeof(LightUBO)), m_descriptorSets[i], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
+			UpdateDescriptorSet(context, 7, Enigma::uniformRing->GetDescriptorInfo(sizeof(Debug)), m_descriptorSets[i], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
 		}
 	}
 
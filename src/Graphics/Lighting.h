@@ -1,47 +1,65 @@
 #pragma once
 #include "GBuffer.h"
+#include <unordered_map>
 
 #define LIGHTING_VERTEX "../resources/Shaders/fs_quad.vert.spv"
 #define LIGHTING_FRAGMENT "../resources/Shaders/fs_lighting.frag.spv"
 
 namespace Enigma
 {
+	// Features fs_lighting.frag is specialized for, each combination gets a pipeline of its own so the shaded path
+	// doesn't pay for the debug views or a reflection march it doesn't do
+	struct LightingPermutation
+	{
+		// 0 - shaded, 1 - shadow map, 2 - linear depth
+		int32_t debugView = 0;
+		VkBool32 reflections = VK_TRUE;
+		int32_t reflectionSteps = 0;
+		// 0 - single tap, 1 - poisson PCF
+		int32_t shadowFilter = 0;
+
+		uint32_t Key() const;
+	};
+
 	class Lighting
 	{
 	public:
 
-		Lighting(const VulkanContext& context, const VulkanWindow& window, GBufferTargets& targets, Image& shadowDepthTarget);
+		Lighting(const VulkanContext& context, const VulkanWindow& window, RenderGraph& graph, const GBufferTargets& targets, RenderResource shadowMap, RenderResource output);
 		~Lighting();
 
-		void Execute(VkCommandBuffer cmd);
+		// Draws the full screen lighting triangle inside the graph's render pass
+		void Record(VkCommandBuffer cmd);
+		RenderGraphPass GetPass() const { return m_pass; }
 		void Update(Camera* camera);
-		void Resize(const VulkanWindow& window);
 
-		// Return the render target image this pass output to
-		Image& GetRenderTarget() { return renderTarget; }
+		size_t GetPermutationCount() const { return m_pipelines.size(); }
+
 	private:
-		void CreateFramebuffer(VkDevice device);
-		void CreateRenderPass(VkDevice device);
-		void CreatePipeline(VkDevice device, VkExtent2D swapchainExtent);
+		void OnCompiled(const RenderGraph& graph);
+		void CreatePipelineLayout(VkDevice device);
+		// Pipeline of the permutation, created the first time it is asked for
+		VkPipeline GetPipeline(const LightingPermutation& permutation);
+		Pipeline CreatePipeline(VkDevice device, const LightingPermutation& permutation);
 		void BuildDescriptorSetLayout(const VulkanContext& context);
 	private:
 		const VulkanContext& context;
 		const VulkanWindow& window;
 		uint32_t m_width;
 		uint32_t m_height;
-		Pipeline m_pipeline;
+		std::unordered_map<uint32_t, Pipeline> m_pipelines;
+		// the permutation the settings ask for this frame
+		VkPipeline m_pipeline = VK_NULL_HANDLE;
 		PipelineLayout m_pipelineLayout;
 		VkRenderPass m_RenderPass;
-		VkFramebuffer m_framebuffer;
+		RenderGraphPass m_pass;
 		VkDescriptorSetLayout m_descriptorSetLayout;
 		std::vector<VkDescriptorSet> m_descriptorSets;
-		std::vector<Buffer> m_uniformBO;
-		std::vector<Buffer> m_lightingUBO;
-		std::vector<Buffer> m_debugUBO;
+		// camera, light and debug settings in the uniform ring this frame, in binding order
+		uint32_t m_uniformOffsets[3] = {};
 		Buffer m_SSBO;
-		Image renderTarget;
 		LightUBO m_lightUBO;
-		GBufferTargets& targets;
-		Image& shadowDepthTarget;
+		GBufferTargets targets;
+		RenderResource shadowMap;
 	};
 };
\ No newline at end of file
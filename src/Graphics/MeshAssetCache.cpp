@@ -0,0 +1,37 @@
+#include "MeshAssetCache.h"
+
+namespace Enigma
+{
+	std::shared_ptr<MeshAsset> MeshAssetCache::Acquire(const std::string& path, int filetype)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		std::weak_ptr<MeshAsset>& cached = m_assets[{ path, filetype }];
+		if (std::shared_ptr<MeshAsset> asset = cached.lock())
+		{
+			m_shared++;
+			return asset;
+		}
+
+		auto asset = std::make_shared<MeshAsset>();
+		asset->path = path;
+		cached = asset;
+		return asset;
+	}
+
+	size_t MeshAssetCache::GetAssetCount() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		size_t count = 0;
+		for (const auto& [key, asset] : m_assets)
+			count += asset.expired() ? 0 : 1;
+		return count;
+	}
+
+	uint64_t MeshAssetCache::GetSharedCount() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_shared;
+	}
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <utility>
+#include <cstdint>
+#include "Model.h"
+
+namespace Enigma
+{
+	// Hands every Model loaded from a file the same MeshAsset, so two enemies or a hundred impact markers share one
+	// copy of the file's geometry and materials. The cache only holds weak references, an asset is unloaded with
+	// the last model using it and loaded again if the file is asked for after that
+	class MeshAssetCache
+	{
+	public:
+		// The asset of the file, not loaded yet (MeshAsset::loaded is false) if no model is using it, the model
+		// asking for it fills it in. Models of the same file must not be loaded on two threads at once
+		std::shared_ptr<MeshAsset> Acquire(const std::string& path, int filetype);
+
+		// assets some model is still using
+		size_t GetAssetCount() const;
+		// models that were handed an asset that was already loaded
+		uint64_t GetSharedCount() const;
+
+	private:
+		mutable std::mutex m_mutex;
+		std::map<std::pair<std::string, int>, std::weak_ptr<MeshAsset>> m_assets;
+		uint64_t m_shared = 0;
+	};
+
+	inline MeshAssetCache meshAssets;
+}
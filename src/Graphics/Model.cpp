@@ -1,12 +1,19 @@
 #include "Model.h"
+#include "TextureCache.h"
+#include "RenderQueue.h"
+#include "MeshAssetCache.h"
+#include "UniformRing.h"
 #include "VulkanObjects.h"
 #include <rapidobj.hpp>
 #include <unordered_set>
 #include "../Graphics/Common.h"
 #include "../Core/Engine.h"
+#include "../Core/Navmesh.h"
 
 namespace Enigma
 {
+	// size of UBOBones in vertexAnim.vert and vs_shadowpassAnim.vert
+	constexpr uint32_t maxBoneTransforms = 300;
 
 	std::vector<uint32_t> indices = {
 		0,1,
@@ -25,14 +32,19 @@ namespace Enigma
 	};
 
 	Model::Model(const std::string& filepath, const VulkanContext& context, int filetype, const std::string& name) : 
+		asset{ Enigma::meshAssets.Acquire(filepath, filetype) }, materials{ asset->materials }, meshes{ asset->meshes },
 		m_filePath { filepath }, context{ context }, modelName{name}
 	{
 		if (filetype == ENIGMA_LOAD_OBJ_FILE)
 			LoadOBJModel(filepath);
 		else if (filetype == ENIGMA_LOAD_FBX_FILE)
 			LoadFBXModel(filepath);
+
+		asset->loaded = true;
 	}
-	Model::Model(const std::string& filepath, const VulkanContext& context, int filetype) : m_filePath{filepath}, context{context}
+	Model::Model(const std::string& filepath, const VulkanContext& context, int filetype) :
+		asset{ Enigma::meshAssets.Acquire(filepath, filetype) }, materials{ asset->materials }, meshes{ asset->meshes },
+		m_filePath{filepath}, context{context}
 	{
 		if (filetype == ENIGMA_LOAD_OBJ_FILE)
 			LoadOBJModel(filepath);
@@ -40,10 +52,37 @@ namespace Enigma
 			LoadFBXModel(filepath);
 		else
             LoadModelAssimp(filepath);
+
+		asset->loaded = true;
+	}
+
+	MeshAsset::~MeshAsset()
+	{
+		if (Enigma::geometryArena == nullptr)
+			return;
+
+		for (const auto& mesh : meshes)
+		{
+			Enigma::geometryArena->Free(mesh.geometry);
+			Enigma::geometryArena->Free(mesh.aabbGeometry);
+		}
 	}
 
 	void Model::LoadOBJModel(const std::string& filepath)
 	{
+		// store the prefix to the obj file
+		const char* pathBegin = filepath.c_str();
+		const char* pathEnd = std::strrchr(pathBegin, '/');
+
+		const std::string prefix = pathEnd ? std::string(pathBegin, pathEnd + 1) : "";
+
+		m_filePath = filepath;
+		modelName = std::string(pathEnd);
+
+		// another model is using the file, its meshes are already in the arena
+		if (asset->loaded)
+			return;
+
 		// Load the obj file
 		rapidobj::Result result = rapidobj::ParseFile(filepath.c_str());
 		if (result.error) {
@@ -55,68 +94,23 @@ namespace Enigma
 		// obj can have non triangle faces. Triangulate will triangulate
 		// non triangle faces
 		for (const auto& shape : result.shapes) {
+			// navmesh polygons are authored as faces on a shape called "Navmesh", read them before triangulation
+			// so each convex face stays a single polygon
 			if (shape.name == "Navmesh") {
-				std::vector<int> vertices;
-				for (int i = 0; i < shape.lines.indices.size(); i++) {
-					bool inVec = false;
-					for (int j = 0; j < vertices.size(); j++) {
-						if (shape.lines.indices[i].position_index == vertices[j]) {
-							inVec = true;
-							break;
-						}
-					}
-					if (inVec == false) {
-						vertices.push_back(shape.lines.indices[i].position_index);
-						glm::vec3 tempvec = glm::vec3(result.attributes.positions[(shape.lines.indices[i].position_index * 3)], result.attributes.positions[(shape.lines.indices[i].position_index * 3) + 1], result.attributes.positions[(shape.lines.indices[i].position_index * 3) + 2]);
-						navmesh.vertices.push_back(tempvec);
+				size_t index = 0;
+				for (size_t face = 0; face < shape.mesh.num_face_vertices.size(); face++) {
+					std::vector<glm::vec3> polygon;
+					for (size_t v = 0; v < shape.mesh.num_face_vertices[face]; v++) {
+						const auto& idx = shape.mesh.indices[index++];
+						polygon.push_back(glm::vec3(result.attributes.positions[idx.position_index * 3], result.attributes.positions[idx.position_index * 3 + 1], result.attributes.positions[idx.position_index * 3 + 2]));
 					}
+					navmesh.AddPolygon(polygon);
 				}
-				navmesh.edges.resize(navmesh.vertices.size());
-				for (int i = 0; i < shape.lines.indices.size(); i+=2) {
-					for (int j = 0; j < navmesh.vertices.size(); j++) {
-						if (result.attributes.positions[(shape.lines.indices[i].position_index * 3)] == navmesh.vertices[j].x &&
-							result.attributes.positions[(shape.lines.indices[i].position_index * 3) + 1] == navmesh.vertices[j].y &&
-							result.attributes.positions[(shape.lines.indices[i].position_index * 3) + 2] == navmesh.vertices[j].z) {
-								Edge edge;
-								glm::vec3 thisVert = navmesh.vertices[j];
-								glm::vec3 otherVert = glm::vec3(result.attributes.positions[(shape.lines.indices[i+1].position_index * 3)], result.attributes.positions[(shape.lines.indices[i+1].position_index * 3) + 1], result.attributes.positions[(shape.lines.indices[i+1].position_index * 3) + 2]);
-								glm::vec3 edgeDir = thisVert - otherVert;
-								float weight = vec3Length(edgeDir);
-								int otherVertIndex;
-								for (int k = 0; k < navmesh.vertices.size(); k++) {
-									if (navmesh.vertices[k].x == otherVert.x &&
-										navmesh.vertices[k].y == otherVert.y &&
-										navmesh.vertices[k].z == otherVert.z) {
-											Edge edge2;
-											otherVertIndex = k;
-											edge2.vertex2 = j;
-											edge2.weight = weight;
-											navmesh.edges[k].push_back(edge2);
-											break;
-									}
-								}
-								edge.vertex2 = otherVertIndex;
-								edge.weight = weight;
-
-								navmesh.edges[j].push_back(edge);
-								break;
-						}
-					}
-				}
-				navmesh.numberOfBaseNodes = navmesh.vertices.size();
+				navmesh.LinkPortals();
 			}
 		}
 		rapidobj::Triangulate(result);
 
-		// store the prefix to the obj file
-		const char* pathBegin = filepath.c_str();
-		const char* pathEnd = std::strrchr(pathBegin, '/');
-
-		const std::string prefix = pathEnd ? std::string(pathBegin, pathEnd + 1) : "";
-
-		m_filePath = filepath;
-		modelName = std::string(pathEnd);
-
 		// Find the materials for this model (searching for diffuse only at the moement)
 		for (const auto& mat : result.materials)
 		{
@@ -147,6 +141,8 @@ namespace Enigma
 		for (const auto& shape : result.shapes)
 		{
 			const auto& shapeName = shape.name;
+			if (shapeName == "Navmesh")
+				continue;
 
 			activeMaterials.clear();
 
@@ -232,88 +228,9 @@ namespace Enigma
 		}
 
 		
-		// need to store it at mesh index not material index when pushing into loaded exxtures
 		// if a diffuse texture cannot be found, a pink texure is used as a placeholder
 		// pink is used since it's easily visible in the scene to indicate there is a mesh issue
-		const std::string defaultTexture = "../resources/default_texture.jpg";
-		loadedTextures.resize(materials.size());
-		for (int i = 0; i < materials.size(); i++)
-		{
-			if (materials[i].diffuseTexturePath != "")
-			{
-				Image texture = Enigma::CreateTexture(context, materials[i].diffuseTexturePath);
-				loadedTextures[i] = std::move(texture);
-			}
-			else
-			{
-				Image defaultTex = Enigma::CreateTexture(context, defaultTexture);
-				loadedTextures[i] = std::move(defaultTex);
-			}
-		}
-
-		MetallicTextures.resize(materials.size());
-		for (int i = 0; i < materials.size(); i++)
-		{
-			if (materials[i].roughnessTexturePath != "")
-			{
-				Image texture = Enigma::CreateTexture(context, materials[i].metallicTexturePath);
-				MetallicTextures[i] = std::move(texture);
-			}
-			else
-			{
-				Image defaultTex = Enigma::CreateTexture(context, defaultTexture);
-				MetallicTextures[i] = std::move(defaultTex);
-			}
-		}
-
-		Enigma::AllocateDescriptorSets(context, Enigma::descriptorPool, Enigma::descriptorLayoutModel, 1, m_descriptorSet);
-
-		std::vector<VkDescriptorImageInfo> imageinfos;
-
-		for (size_t i = 0; i < loadedTextures.size(); i++)
-		{
-			VkDescriptorImageInfo imageInfo{};
-			imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			imageInfo.imageView = loadedTextures[i].imageView;
-			imageInfo.sampler = Enigma::repeatSampler;
-
-			imageinfos.emplace_back(std::move(imageInfo));
-
-		}
-
-		std::vector<VkDescriptorImageInfo> metallic_image_infos;
-		for (size_t i = 0; i < MetallicTextures.size(); i++)
-		{
-			VkDescriptorImageInfo imageInfo{};
-			imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			imageInfo.imageView = MetallicTextures[i].imageView;
-			imageInfo.sampler = Enigma::defaultSampler;
-
-			metallic_image_infos.emplace_back(std::move(imageInfo));
-		}
-
-		// 12
-		VkWriteDescriptorSet descriptorWrite{};
-		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		descriptorWrite.dstSet = m_descriptorSet[0];
-		descriptorWrite.dstBinding = 0;
-		descriptorWrite.dstArrayElement = 0;
-		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		descriptorWrite.descriptorCount = static_cast<uint32_t>(imageinfos.size());
-		descriptorWrite.pImageInfo = imageinfos.data();
-
-		VkWriteDescriptorSet metallic_descriptorWrite{};
-		metallic_descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		metallic_descriptorWrite.dstSet = m_descriptorSet[0];
-		metallic_descriptorWrite.dstBinding = 1;
-		metallic_descriptorWrite.dstArrayElement = 0;
-		metallic_descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		metallic_descriptorWrite.descriptorCount = static_cast<uint32_t>(metallic_image_infos.size());
-		metallic_descriptorWrite.pImageInfo = metallic_image_infos.data();
-
-		std::vector<VkWriteDescriptorSet> sets = { descriptorWrite, metallic_descriptorWrite };
-
-		vkUpdateDescriptorSets(context.device, (uint32_t)sets.size(), sets.data(), 0, nullptr);
+		RegisterMaterials(DEFAULT_TEXTURE, Enigma::repeatSampler);
 	
 		for (auto& mesh : meshes)
 		{
@@ -372,6 +289,11 @@ namespace Enigma
 	}
 
 	void Model::LoadFBXModel(const std::string& filepath) {
+		if (asset->loaded) {
+			hasAnimations = asset->hasAnimations;
+			return;
+		}
+
 		Assimp::Importer importer;
 
 		const char* pathBegin = filepath.c_str();
@@ -438,50 +360,11 @@ namespace Enigma
 
 		if (scene->HasAnimations()) {
 			hasAnimations = true;
+			asset->hasAnimations = true;
 			animations = scene->mAnimations;
 		}
 
-		const std::string defaultTexture = "../resources/textures/jpeg/sponza_floor_a_diff.jpg";
-		loadedTextures.resize(materials.size());
-		for (int i = 0; i < materials.size(); i++)
-		{
-			if (materials[i].diffuseTexturePath != "")
-			{
-				Image texture = Enigma::CreateTexture(context, materials[i].diffuseTexturePath);
-				loadedTextures[i] = std::move(texture);
-			}
-			else
-			{
-				Image defaultTex = Enigma::CreateTexture(context, defaultTexture);
-				loadedTextures[i] = std::move(defaultTex);
-			}
-		}
-
-		Enigma::AllocateDescriptorSets(context, Enigma::descriptorPool, Enigma::descriptorLayoutModel, 1, m_descriptorSet);
-
-		std::vector<VkDescriptorImageInfo> imageinfos;
-
-		for (size_t i = 0; i < loadedTextures.size(); i++)
-		{
-			VkDescriptorImageInfo imageInfo{};
-			imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			imageInfo.imageView = loadedTextures[i].imageView;
-			imageInfo.sampler = Enigma::defaultSampler;
-
-			imageinfos.emplace_back(std::move(imageInfo));
-
-		}
-		// 12
-		VkWriteDescriptorSet descriptorWrite{};
-		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		descriptorWrite.dstSet = m_descriptorSet[0];
-		descriptorWrite.dstBinding = 0;
-		descriptorWrite.dstArrayElement = 0;
-		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		descriptorWrite.descriptorCount = static_cast<uint32_t>(imageinfos.size());
-		descriptorWrite.pImageInfo = imageinfos.data();
-
-		vkUpdateDescriptorSets(context.device, 1, &descriptorWrite, 0, nullptr);
+		RegisterMaterials("../resources/textures/jpeg/sponza_floor_a_diff.jpg", Enigma::defaultSampler);
 
 		for (auto& mesh : meshes)
 		{
@@ -556,336 +439,63 @@ namespace Enigma
 	{
 		for (auto& mesh : meshes)
 		{
-			VkDeviceSize vertexSize = sizeof(mesh.vertices[0]) * mesh.vertices.size();
-
-			mesh.vertexBuffer = CreateBuffer(context.allocator, vertexSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, 0, VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE);
-
-			// We can't directly add data to GPU memory
-			// need to add data to CPU visible memory first and then copy into GPU memory
-			Buffer stagingBuffer = CreateBuffer(context.allocator, vertexSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-				VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, VMA_MEMORY_USAGE_AUTO);
-
-			void* data = nullptr;
-			ENIGMA_VK_CHECK(vmaMapMemory(context.allocator.allocator, stagingBuffer.allocation, &data), "Failed to map staging buffer memory while loading model.");
-			std::memcpy(data, mesh.vertices.data(), vertexSize);
-			vmaUnmapMemory(context.allocator.allocator, stagingBuffer.allocation);
-
-			// Transfering CPU visible data to GPU ( we need a fence to sync ) 
-			VkFenceCreateInfo fenceInfo{ VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
-			fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-			VkFence fence = VK_NULL_HANDLE;
-			VkResult res = vkCreateFence(context.device, &fenceInfo, nullptr, &fence);
-
-			Fence uploadComplete = Fence(context.device, fence);
-			vkResetFences(context.device, 1, &uploadComplete.handle);
-
-			// Need a command pool & command buffer to record and submit 
-			// to do copy transfer operation
-			VkCommandPoolCreateInfo cmdPool{};
-			cmdPool.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-			cmdPool.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
-			cmdPool.queueFamilyIndex = context.graphicsFamilyIndex;
-
-			VkCommandPool commandPool = VK_NULL_HANDLE;
-			ENIGMA_VK_CHECK(vkCreateCommandPool(context.device, &cmdPool, nullptr, &commandPool), "Failed to create command pool for staging buffer in model class");
-
-			VkCommandBufferAllocateInfo cmdAlloc{};
-			cmdAlloc.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-			cmdAlloc.commandPool = commandPool;
-			cmdAlloc.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-			cmdAlloc.commandBufferCount = 1;
-
-			VkCommandBuffer cmd = VK_NULL_HANDLE;
-			ENIGMA_VK_CHECK(vkAllocateCommandBuffers(context.device, &cmdAlloc, &cmd), "Failed to allocate command buffers while loading model.");
-
-			// begin recording command buffers to do the copying from CPU to GPU buffer
-			VkCommandBufferBeginInfo beginInfo{};
-			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-			beginInfo.flags = 0;
-			beginInfo.pInheritanceInfo = nullptr;
-
-			Enigma::BeginCommandBuffer(cmd);
-
-			// Specify the copy position
-			VkBufferCopy copy{};
-			copy.size = vertexSize;
-
-			vkCmdCopyBuffer(cmd, stagingBuffer.buffer, mesh.vertexBuffer.buffer, 1, &copy);
+			mesh.geometry = Enigma::geometryArena->Allocate(mesh.vertices, mesh.indices);
+			mesh.aabbGeometry = Enigma::geometryArena->Allocate(mesh.aabbVertices, indices);
 
-			VkBufferMemoryBarrier bufferBarrier{ VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
-			bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			bufferBarrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
-			bufferBarrier.buffer = mesh.vertexBuffer.buffer;
-			bufferBarrier.size = VK_WHOLE_SIZE;
-			bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-
-			vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
-
-			// End the command buffer and submit it
-			Enigma::EndAndSubmitCommandBuffer(context, cmd);
-
-			vkFreeCommandBuffers(context.device, commandPool, 1, &cmd);
-			vkDestroyCommandPool(context.device, commandPool, nullptr);
+			const bool hasMaterial = mesh.materialIndex >= 0 && mesh.materialIndex < static_cast<int>(materials.size());
+			mesh.materialID = hasMaterial ? materials[mesh.materialIndex].materialID : TextureCache::defaultMaterial;
 		}
 
-
-		for (auto& mesh : meshes)
-		{
-			VkDeviceSize indexSize = sizeof(mesh.indices[0]) * mesh.indices.size();
-			mesh.indexBuffer = CreateBuffer(context.allocator, indexSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, 0, VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE);
-
-			// We can't directly add data to GPU memory
-			// need to add data to CPU visible memory first and then copy into GPU memory
-			Buffer stagingBuffer = CreateBuffer(context.allocator, indexSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-				VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, VMA_MEMORY_USAGE_AUTO);
-
-			void* data = nullptr;
-			ENIGMA_VK_CHECK(vmaMapMemory(context.allocator.allocator, stagingBuffer.allocation, &data), "Failed to map staging buffer memory while loading model.");
-			std::memcpy(data, mesh.indices.data(), indexSize);
-			vmaUnmapMemory(context.allocator.allocator, stagingBuffer.allocation);
-
-			// Transfering CPU visible data to GPU ( we need a fence to sync ) 
-			VkFenceCreateInfo fenceInfo{ VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
-			fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-			VkFence fence = VK_NULL_HANDLE;
-			VkResult res = vkCreateFence(context.device, &fenceInfo, nullptr, &fence);
-
-			Fence uploadComplete = Fence(context.device, fence);
-			vkResetFences(context.device, 1, &uploadComplete.handle);
-
-			// Need a command pool & command buffer to record and submit 
-			// to do copy transfer operation
-			VkCommandPoolCreateInfo cmdPool{};
-			cmdPool.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-			cmdPool.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
-			cmdPool.queueFamilyIndex = context.graphicsFamilyIndex;
-
-			VkCommandPool commandPool = VK_NULL_HANDLE;
-			ENIGMA_VK_CHECK(vkCreateCommandPool(context.device, &cmdPool, nullptr, &commandPool), "Failed to create command pool for staging buffer in model class");
-
-			VkCommandBufferAllocateInfo cmdAlloc{};
-			cmdAlloc.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-			cmdAlloc.commandPool = commandPool;
-			cmdAlloc.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-			cmdAlloc.commandBufferCount = 1;
-
-			VkCommandBuffer cmd = VK_NULL_HANDLE;
-			ENIGMA_VK_CHECK(vkAllocateCommandBuffers(context.device, &cmdAlloc, &cmd), "Failed to allocate command buffers while loading model.");
-
-			// begin recording command buffers to do the copying from CPU to GPU buffer
-			VkCommandBufferBeginInfo beginInfo{};
-			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-			beginInfo.flags = 0;
-			beginInfo.pInheritanceInfo = nullptr;
-
-			Enigma::BeginCommandBuffer(cmd);
-
-			// Specify the copy position
-			VkBufferCopy copy{};
-			copy.size = indexSize;
-
-			vkCmdCopyBuffer(cmd, stagingBuffer.buffer, mesh.indexBuffer.buffer, 1, &copy);
-
-			VkBufferMemoryBarrier bufferBarrier{ VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
-			bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			bufferBarrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
-			bufferBarrier.buffer = mesh.indexBuffer.buffer;
-			bufferBarrier.size = VK_WHOLE_SIZE;
-			bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-
-			vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
-
-			// End the command buffer and submit it
-			Enigma::EndAndSubmitCommandBuffer(context, cmd);
-
-			vkFreeCommandBuffers(context.device, commandPool, 1, &cmd);
-			vkDestroyCommandPool(context.device, commandPool, nullptr);
-		}
-
-		CreateAABBBuffers();
+		// one upload for the whole model
+		Enigma::geometryArena->Flush();
 	}
 
-	void Model::CreateAABBBuffers()
+	void Model::RegisterMaterials(const std::string& defaultTexture, VkSampler sampler)
 	{
-		for (auto& mesh : meshes)
+		for (auto& material : materials)
 		{
-			VkDeviceSize vertexSize = sizeof(mesh.aabbVertices[0]) * mesh.aabbVertices.size();
-			mesh.AABB_buffer = CreateBuffer(context.allocator, vertexSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, 0, VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE);
-
-			Buffer stagingBuffer = CreateBuffer(context.allocator, vertexSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-				VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, VMA_MEMORY_USAGE_AUTO);
-
-			void* data = nullptr;
-			ENIGMA_VK_CHECK(vmaMapMemory(context.allocator.allocator, stagingBuffer.allocation, &data), "Failed to map staging buffer memory while loading model.");
-			std::memcpy(data, mesh.aabbVertices.data(), vertexSize);
-			vmaUnmapMemory(context.allocator.allocator, stagingBuffer.allocation);
-
-			// Transfering CPU visible data to GPU ( we need a fence to sync ) 
-			VkFenceCreateInfo fenceInfo{ VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
-			fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-			VkFence fence = VK_NULL_HANDLE;
-			VkResult res = vkCreateFence(context.device, &fenceInfo, nullptr, &fence);
-
-			Fence uploadComplete = Fence(context.device, fence);
-			vkResetFences(context.device, 1, &uploadComplete.handle);
-
-			// Need a command pool & command buffer to record and submit 
-			// to do copy transfer operation
-			VkCommandPoolCreateInfo cmdPool{};
-			cmdPool.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-			cmdPool.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
-			cmdPool.queueFamilyIndex = context.graphicsFamilyIndex;
-
-			VkCommandPool commandPool = VK_NULL_HANDLE;
-			ENIGMA_VK_CHECK(vkCreateCommandPool(context.device, &cmdPool, nullptr, &commandPool), "Failed to create command pool for staging buffer in model class");
-
-			VkCommandBufferAllocateInfo cmdAlloc{};
-			cmdAlloc.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-			cmdAlloc.commandPool = commandPool;
-			cmdAlloc.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-			cmdAlloc.commandBufferCount = 1;
-
-			VkCommandBuffer cmd = VK_NULL_HANDLE;
-			ENIGMA_VK_CHECK(vkAllocateCommandBuffers(context.device, &cmdAlloc, &cmd), "Failed to allocate command buffers while loading model.");
-
-			// begin recording command buffers to do the copying from CPU to GPU buffer
-			VkCommandBufferBeginInfo beginInfo{};
-			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-			beginInfo.flags = 0;
-			beginInfo.pInheritanceInfo = nullptr;
-
-			Enigma::BeginCommandBuffer(cmd);
-
-			// Specify the copy position
-			VkBufferCopy copy{};
-			copy.size = vertexSize;
-
-			vkCmdCopyBuffer(cmd, stagingBuffer.buffer, mesh.AABB_buffer.buffer, 1, &copy);
-
-			VkBufferMemoryBarrier bufferBarrier{ VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
-			bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			bufferBarrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
-			bufferBarrier.buffer = mesh.AABB_buffer.buffer;
-			bufferBarrier.size = VK_WHOLE_SIZE;
-			bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-
-			vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
-
-			// End the command buffer and submit it
-			Enigma::EndAndSubmitCommandBuffer(context, cmd);
-
-			vkFreeCommandBuffers(context.device, commandPool, 1, &cmd);
-			vkDestroyCommandPool(context.device, commandPool, nullptr);
+			const uint32_t diffuse = Enigma::textureCache->Load(material.diffuseTexturePath != "" ? material.diffuseTexturePath : defaultTexture, sampler);
+			const uint32_t metallic = material.metallicTexturePath != "" ? Enigma::textureCache->Load(material.metallicTexturePath, Enigma::defaultSampler) : TextureCache::defaultTexture;
+			material.materialID = Enigma::textureCache->AddMaterial(diffuse, metallic);
 		}
+	}
 
-		for (auto& mesh : meshes)
-		{
-			VkDeviceSize indexSize = sizeof(indices[0]) * indices.size();
-			mesh.AABB_indexBuffer = CreateBuffer(context.allocator, indexSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, 0, VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE);
-
-			// We can't directly add data to GPU memory
-			// need to add data to CPU visible memory first and then copy into GPU memory
-			Buffer stagingBuffer = CreateBuffer(context.allocator, indexSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-				VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, VMA_MEMORY_USAGE_AUTO);
-
-			void* data = nullptr;
-			ENIGMA_VK_CHECK(vmaMapMemory(context.allocator.allocator, stagingBuffer.allocation, &data), "Failed to map staging buffer memory while loading model.");
-			std::memcpy(data, indices.data(), indexSize);
-			vmaUnmapMemory(context.allocator.allocator, stagingBuffer.allocation);
-
-			// Transfering CPU visible data to GPU ( we need a fence to sync ) 
-			VkFenceCreateInfo fenceInfo{ VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
-			fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-			VkFence fence = VK_NULL_HANDLE;
-			VkResult res = vkCreateFence(context.device, &fenceInfo, nullptr, &fence);
-
-			Fence uploadComplete = Fence(context.device, fence);
-			vkResetFences(context.device, 1, &uploadComplete.handle);
-
-			// Need a command pool & command buffer to record and submit 
-			// to do copy transfer operation
-			VkCommandPoolCreateInfo cmdPool{};
-			cmdPool.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-			cmdPool.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
-			cmdPool.queueFamilyIndex = context.graphicsFamilyIndex;
-
-			VkCommandPool commandPool = VK_NULL_HANDLE;
-			ENIGMA_VK_CHECK(vkCreateCommandPool(context.device, &cmdPool, nullptr, &commandPool), "Failed to create command pool for staging buffer in model class");
-
-			VkCommandBufferAllocateInfo cmdAlloc{};
-			cmdAlloc.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-			cmdAlloc.commandPool = commandPool;
-			cmdAlloc.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-			cmdAlloc.commandBufferCount = 1;
-
-			VkCommandBuffer cmd = VK_NULL_HANDLE;
-			ENIGMA_VK_CHECK(vkAllocateCommandBuffers(context.device, &cmdAlloc, &cmd), "Failed to allocate command buffers while loading model.");
-
-			// begin recording command buffers to do the copying from CPU to GPU buffer
-			VkCommandBufferBeginInfo beginInfo{};
-			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-			beginInfo.flags = 0;
-			beginInfo.pInheritanceInfo = nullptr;
-
-			Enigma::BeginCommandBuffer(cmd);
-
-			// Specify the copy position
-			VkBufferCopy copy{};
-			copy.size = indexSize;
-
-			vkCmdCopyBuffer(cmd, stagingBuffer.buffer, mesh.AABB_indexBuffer.buffer, 1, &copy);
-
-			VkBufferMemoryBarrier bufferBarrier{ VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
-			bufferBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-			bufferBarrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
-			bufferBarrier.buffer = mesh.AABB_indexBuffer.buffer;
-			bufferBarrier.size = VK_WHOLE_SIZE;
-			bufferBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-			bufferBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-
-			vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 0, nullptr, 1, &bufferBarrier, 0, nullptr);
-
-			// End the command buffer and submit it
-			Enigma::EndAndSubmitCommandBuffer(context, cmd);
-
-			vkFreeCommandBuffers(context.device, commandPool, 1, &cmd);
-			vkDestroyCommandPool(context.device, commandPool, nullptr);
-		}
+	// translate * rotate * scale, the same transform the model is drawn with
+	glm::mat4 Model::GetModelMatrix()
+	{
+		glm::mat4 model = glm::mat4(1.0f);
+		model = glm::translate(model, translation);
+		model = model * rotMatrix;
+		model = glm::rotate(model, (float)((this->getXRotation() * 3.141) / 180), glm::vec3(1.f, 0.f, 0.f));
+		model = glm::rotate(model, (float)((this->getYRotation() * 3.141) / 180), glm::vec3(0.f, 1.f, 0.f));
+		model = glm::rotate(model, (float)((this->getZRotation() * 3.141) / 180), glm::vec3(0.f, 0.f, 1.f));
+		model = glm::scale(model, this->scale);
+		return model;
 	}
 
 	// Call to draw the model
 	void Model::Draw(VkCommandBuffer cmd, VkPipelineLayout layout)
 	{
-		// Update the AABB
+		Draw(cmd, layout, GetModelMatrix());
+	}
+
+	void Model::Draw(VkCommandBuffer cmd, VkPipelineLayout layout, const glm::mat4& transform)
+	{
+		Enigma::geometryArena->Bind(cmd);
 
 		for (auto& mesh : meshes)
 		{
 			// scale, rotate, translate -> T * R * S
 			ModelPushConstant push = {};
-			push.model = glm::mat4(1.0f);
-			push.model = glm::translate(push.model, translation);
-			push.model = push.model * rotMatrix;
-			push.model = glm::rotate(push.model, (float)((this->getXRotation() * 3.141) / 180), glm::vec3(1.f, 0.f, 0.f));
-			push.model = glm::rotate(push.model, (float)((this->getYRotation() * 3.141) / 180), glm::vec3(0.f, 1.f, 0.f));
-			push.model = glm::rotate(push.model, (float)((this->getZRotation() * 3.141) / 180), glm::vec3(0.f, 0.f, 1.f));
-			push.model = glm::scale(push.model, this->scale);
-			push.textureIndex = mesh.materialIndex;
+			push.model = transform;
+			push.materialID = static_cast<int>(mesh.materialID);
 			push.isTextured = mesh.textured;
 
 			//UpdateAABB(mesh, push.model);
 			//mesh.position = translation;
 			vkCmdPushConstants(cmd, layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(ModelPushConstant), &push);
 
-			vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 1, 1, &m_descriptorSet[0], 0, nullptr);
-
-			VkDeviceSize offset[] = { 0 };
-			vkCmdBindVertexBuffers(cmd, 0, 1, &mesh.vertexBuffer.buffer, offset);
-
-			vkCmdBindIndexBuffer(cmd, mesh.indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
-			vkCmdDrawIndexed(cmd, static_cast<uint32_t>(mesh.indices.size()), 1, 0, 0, 0);
+			vkCmdDrawIndexed(cmd, mesh.geometry.indexCount, 1, mesh.geometry.firstIndex, static_cast<int32_t>(mesh.geometry.firstVertex), 0);
 		}
 
 	}
@@ -893,29 +503,23 @@ namespace Enigma
 
 	void Model::DrawDebug(VkCommandBuffer cmd, VkPipelineLayout layout, VkPipeline AABBPipeline)
 	{
+		DrawDebug(cmd, layout, AABBPipeline, GetModelMatrix());
+	}
+
+	void Model::DrawDebug(VkCommandBuffer cmd, VkPipelineLayout layout, VkPipeline AABBPipeline, const glm::mat4& transform)
+	{
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, AABBPipeline);
+		Enigma::geometryArena->Bind(cmd);
+
 		for (auto& mesh : meshes) {
 
 			ModelPushConstant push = {};
-			push.model = glm::mat4(1.0f);
-			push.model = glm::translate(push.model, translation);
-			push.model = push.model * rotMatrix;
-			push.model = glm::rotate(push.model, (float)((this->getXRotation() * 3.141) / 180), glm::vec3(1.f, 0.f, 0.f));
-			push.model = glm::rotate(push.model, (float)((this->getYRotation() * 3.141) / 180), glm::vec3(0.f, 1.f, 0.f));
-			push.model = glm::rotate(push.model, (float)((this->getZRotation() * 3.141) / 180), glm::vec3(0.f, 0.f, 1.f));
-			push.model = glm::scale(push.model, this->scale);
-			push.textureIndex = mesh.materialIndex;
+			push.model = transform;
+			push.materialID = static_cast<int>(mesh.materialID);
 			push.isTextured = mesh.textured;
 
 			vkCmdPushConstants(cmd, layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(ModelPushConstant), &push);
-
-			vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, AABBPipeline);
-			vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 1, 1, &m_descriptorSet[0], 0, nullptr);
-
-			VkDeviceSize offset[] = { 0 };
-			vkCmdBindVertexBuffers(cmd, 0, 1, &mesh.AABB_buffer.buffer, offset);
-
-			vkCmdBindIndexBuffer(cmd, mesh.AABB_indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
-			vkCmdDrawIndexed(cmd, static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
+			vkCmdDrawIndexed(cmd, mesh.aabbGeometry.indexCount, 1, mesh.aabbGeometry.firstIndex, static_cast<int32_t>(mesh.aabbGeometry.firstVertex), 0);
 		}
 	}
 
@@ -923,26 +527,67 @@ namespace Enigma
 	{
 		auto &mesh = meshes[index];
 		ModelPushConstant push = {};
-		push.model = glm::mat4(1.0f);
-		push.model = glm::translate(push.model, translation);
-		push.model = push.model * rotMatrix;
-		push.model = glm::rotate(push.model, (float)((this->getXRotation() * 3.141) / 180), glm::vec3(1.f, 0.f, 0.f));
-		push.model = glm::rotate(push.model, (float)((this->getYRotation() * 3.141) / 180), glm::vec3(0.f, 1.f, 0.f));
-		push.model = glm::rotate(push.model, (float)((this->getZRotation() * 3.141) / 180), glm::vec3(0.f, 0.f, 1.f));
-		push.model = glm::scale(push.model, this->scale);
-		push.textureIndex = mesh.materialIndex;
+		push.model = GetModelMatrix();
+		push.materialID = static_cast<int>(mesh.materialID);
 		push.isTextured = mesh.textured;
 
 		vkCmdPushConstants(cmd, layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(ModelPushConstant), &push);
 
 		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, AABBPipeline);
-		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 1, 1, &m_descriptorSet[0], 0, nullptr);
+		Enigma::geometryArena->Bind(cmd);
 
-		VkDeviceSize offset[] = { 0 };
-		vkCmdBindVertexBuffers(cmd, 0, 1, &mesh.AABB_buffer.buffer, offset);
+		vkCmdDrawIndexed(cmd, mesh.aabbGeometry.indexCount, 1, mesh.aabbGeometry.firstIndex, static_cast<int32_t>(mesh.aabbGeometry.firstVertex), 0);
+	}
+
+	void Model::Queue(RenderQueue& queue, const RenderState& state, const glm::mat4& transform) const
+	{
+		for (const auto& mesh : meshes)
+		{
+			ModelPushConstant push = {};
+			push.model = transform;
+			push.materialID = static_cast<int>(mesh.materialID);
+			push.isTextured = mesh.textured;
 
-		vkCmdBindIndexBuffer(cmd, mesh.AABB_indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
-		vkCmdDrawIndexed(cmd, static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
+			const glm::vec3 center = transform * glm::vec4((mesh.meshAABB.min + mesh.meshAABB.max) * 0.5f, 1.0f);
+			queue.Push(state, mesh.geometry, push, center);
+		}
+	}
+
+	void Model::QueueAABB(RenderQueue& queue, const RenderState& state, const glm::mat4& transform) const
+	{
+		for (const auto& mesh : meshes)
+		{
+			ModelPushConstant push = {};
+			push.model = transform;
+			push.materialID = static_cast<int>(mesh.materialID);
+			push.isTextured = mesh.textured;
+
+			const glm::vec3 center = transform * glm::vec4((mesh.meshAABB.min + mesh.meshAABB.max) * 0.5f, 1.0f);
+			queue.Push(state, mesh.aabbGeometry, push, center);
+		}
+	}
+
+	void Model::Queue2(RenderQueue& queue, RenderState state, const std::vector<glm::mat4>& nodeMatrices, const glm::mat4& offset) const
+	{
+		state.set = boneTransformDescriptorSet[0];
+		state.dynamicOffsetCount = 1;
+		state.dynamicOffset = paletteOffset;
+		queueNode(queue, state, &rootNode, nodeMatrices, offset);
+	}
+
+	void Model::queueNode(RenderQueue& queue, const RenderState& state, const Node* node, const std::vector<glm::mat4>& nodeMatrices, const glm::mat4& offset) const
+	{
+		for (auto e : node->meshIndices)
+		{
+			const auto& mesh = meshes[e];
+			ModelPushConstant push = {};
+			push.model = offset * nodeMatrices[node->index];
+			push.materialID = static_cast<int>(mesh.materialID);
+			push.isTextured = mesh.textured;
+
+			queue.Push(state, mesh.geometry, push, glm::vec3(push.model[3]));
+		}
+		for (const auto& e : node->children) queueNode(queue, state, e.get(), nodeMatrices, offset);
 	}
 
     //==========================================================================
@@ -962,23 +607,28 @@ namespace Enigma
 		}
         m_Scene = scene;
 
-		loadMaterials2();
-        // load mesh
-        //  process each mesh located at the current node
-        for (unsigned int i = 0; i < scene->mNumMeshes; i++) processMesh2(scene->mMeshes[i]);
+		// the node tree and the clips are the model's own, the meshes may already have been loaded by another model
+		const bool shared = asset->loaded;
+		if (!shared) {
+			loadMaterials2();
+			// load mesh
+			//  process each mesh located at the current node
+			for (unsigned int i = 0; i < scene->mNumMeshes; i++) processMesh2(scene->mMeshes[i]);
+		}
 
         // process node
         int tempIndex = 0;
         processNode2(scene->mRootNode, &rootNode, tempIndex);
-		loadBones2();	
+		loadBones2(!shared);
 		processAnimation2();
 
-        CreateBuffers();
+		if (!shared)
+			CreateBuffers();
 
         auto tempM = scene->mRootNode->mTransformation.Inverse().Transpose();
         memcpy(&globalInverseTransform, &tempM, sizeof(glm::mat4));
 
-        createBoneTransformBuffer();
+        createBoneTransformDescriptorSet();
     }
     void Model::updateAnimation2(float deltaTime, int index){
         auto&& animation = m_animations[index];
@@ -993,33 +643,23 @@ namespace Enigma
         // rootNode.Update();
         // updateBoneTransforms2();
     }
-    void Model::createBoneTransformBuffer() {
+    void Model::createBoneTransformDescriptorSet() {
         if(boneTransforms.empty())return;
-        // VkDeviceSize vertexSize = sizeof(glm::mat4) * boneTransforms.size();
-        VkDeviceSize vertexSize = sizeof(glm::mat4) * 300;
-
-        boneTransformBuffer = CreateBuffer(
-            context.allocator, vertexSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT|VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-            VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT, VMA_MEMORY_USAGE_AUTO);
-
-        void* data = nullptr;
-        ENIGMA_VK_CHECK(vmaMapMemory(context.allocator.allocator, boneTransformBuffer.allocation, &data),
-                        "Failed to map staging buffer memory while loading model.");
-        std::memcpy(data, boneTransforms.data(), vertexSize);
-        vmaUnmapMemory(context.allocator.allocator, boneTransformBuffer.allocation);
+        const VkDeviceSize paletteSize = sizeof(glm::mat4) * maxBoneTransforms;
 
         //create descriptor setlayout
         AllocateDescriptorSets(context, Enigma::descriptorPool, Enigma::boneTransformDescriptorLayout, 1,
                                boneTransformDescriptorSet);
 
-        VkDescriptorBufferInfo bufferInfo{boneTransformBuffer.buffer, 0, vertexSize};
+        // the palette lives in the uniform ring, UploadPalette finds it a place every frame
+        const VkDescriptorBufferInfo bufferInfo = Enigma::uniformRing->GetDescriptorInfo(paletteSize);
 
         VkWriteDescriptorSet descriptorWrite{};
         descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
         descriptorWrite.dstSet = boneTransformDescriptorSet[0];
         descriptorWrite.dstBinding = 0;
         descriptorWrite.dstArrayElement = 0;
-        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
         descriptorWrite.descriptorCount = 1;
         descriptorWrite.pBufferInfo = &bufferInfo;
 
@@ -1185,7 +825,7 @@ namespace Enigma
             }
         }
 	}
-    void Model::loadBones2() {
+    void Model::loadBones2(bool weights) {
 		//load mesh bones
         for (unsigned int i = 0; i < m_Scene->mNumMeshes; i++) {
             aiMesh* mesh = m_Scene->mMeshes[i];
@@ -1196,6 +836,9 @@ namespace Enigma
                 auto offsetmatrix = bone->mOffsetMatrix.Transpose();
                 memcpy(&dstNode->boneOffsetMatrix, &offsetmatrix, sizeof(glm::mat4));
 
+                if (!weights)
+                    continue;
+
                 auto nodeIndex = dstNode->index;
                 for (int k = 0; k < bone->mNumWeights; ++k) {
                     for (int m = 0; m < 4; ++m) {
@@ -1237,66 +880,10 @@ namespace Enigma
 			materials.emplace_back(std::move(mi));
 		}
 
-		loadedTextures.resize(materials.size());
-		for (int i = 0; i < materials.size(); i++)
-		{
-			Image texture = Enigma::CreateTexture(context, materials[i].diffuseTexturePath);
-			loadedTextures[i] = std::move(texture);
-		}
-
-		Enigma::AllocateDescriptorSets(context, Enigma::descriptorPool, Enigma::descriptorLayoutModel, 1, m_descriptorSet);
-
-		std::vector<VkDescriptorImageInfo> imageinfos;
-
-		for (size_t i = 0; i < loadedTextures.size(); i++)
-		{
-			VkDescriptorImageInfo imageInfo{};
-			imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			imageInfo.imageView = loadedTextures[i].imageView;
-			imageInfo.sampler = Enigma::defaultSampler;
-
-			imageinfos.emplace_back(std::move(imageInfo));
-
-		}
-		VkWriteDescriptorSet descriptorWrite{};
-		descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		descriptorWrite.dstSet = m_descriptorSet[0];
-		descriptorWrite.dstBinding = 0;
-		descriptorWrite.dstArrayElement = 0;
-		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		descriptorWrite.descriptorCount = static_cast<uint32_t>(imageinfos.size());
-		descriptorWrite.pImageInfo = imageinfos.data();
-
-		vkUpdateDescriptorSets(context.device, 1, &descriptorWrite, 0, nullptr);
+		RegisterMaterials("../resources/textures/jpeg/sponza_floor_a_diff.jpg", Enigma::defaultSampler);
 	}
-	void Model::Draw2(VkCommandBuffer cmd, VkPipelineLayout layout){
-        rootNode.Update();
-        updateBoneTransforms2();
-		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 1, 1, &m_descriptorSet[0], 0, nullptr);
-		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 2, 1, &boneTransformDescriptorSet[0], 0, nullptr);
-        drawNode(cmd,layout,&rootNode);
-    }
-    void Model::drawNode(VkCommandBuffer cmd,VkPipelineLayout layout, Node* node) {
-        for (auto e : node->meshIndices) {
-            auto&& mesh = meshes[e];
-            //draw mesh
-			ModelPushConstant push = {};
-			push.model = node->globalMatrix;
-			push.textureIndex = mesh.materialIndex;
-			push.isTextured = mesh.textured;
-
-			vkCmdPushConstants(cmd, layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(ModelPushConstant), &push);
-
-			VkDeviceSize offset[] = { 0 };
-			vkCmdBindVertexBuffers(cmd, 0, 1, &mesh.vertexBuffer.buffer, offset);
-
-			vkCmdBindIndexBuffer(cmd, mesh.indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
-			vkCmdDrawIndexed(cmd, static_cast<uint32_t>(mesh.indices.size()), 1, 0, 0, 0);
-        }
-        for (auto&& e : node->children) drawNode(cmd, layout, e.get());
-    }
 	void Model::DrawAABB(VkCommandBuffer cmd, VkPipelineLayout layout){
-		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 1, 1, &m_descriptorSet[0], 0, nullptr);
+		Enigma::geometryArena->Bind(cmd);
         drawNodeAABB(cmd,layout,&rootNode);
     }
     void Model::drawNodeAABB(VkCommandBuffer cmd,VkPipelineLayout layout,Node* node){
@@ -1305,28 +892,31 @@ namespace Enigma
             //draw mesh
 			ModelPushConstant push = {};
 			push.model = node->globalMatrix;
-			push.textureIndex = mesh.materialIndex;
+			push.materialID = static_cast<int>(mesh.materialID);
 			push.isTextured = mesh.textured;
 
 			vkCmdPushConstants(cmd, layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(ModelPushConstant), &push);
-
-			VkDeviceSize offset[] = { 0 };
-			vkCmdBindVertexBuffers(cmd, 0, 1, &mesh.AABB_buffer.buffer, offset);
-
-			vkCmdBindIndexBuffer(cmd, mesh.AABB_indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT32);
-			vkCmdDrawIndexed(cmd, static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
+			vkCmdDrawIndexed(cmd, mesh.aabbGeometry.indexCount, 1, mesh.aabbGeometry.firstIndex, static_cast<int32_t>(mesh.aabbGeometry.firstVertex), 0);
         }
         for (auto&& e : node->children) drawNodeAABB(cmd, layout, e.get());
     }
-    void Model::updateBoneTransforms2() { 
-        updateBoneTransforms2Helper(&rootNode); 
-
-        //update buffer
-        void* data = nullptr;
-        ENIGMA_VK_CHECK(vmaMapMemory(context.allocator.allocator, boneTransformBuffer.allocation, &data),
-                        "Failed to map staging buffer memory while loading model.");
-        std::memcpy(data, boneTransforms.data(), boneTransforms.size() * sizeof(glm::mat4));
-        vmaUnmapMemory(context.allocator.allocator, boneTransformBuffer.allocation);
+    void Model::UpdatePose() {
+        rootNode.Update();
+        updateBoneTransforms2Helper(&rootNode);
+    }
+    void Model::CopyPose(std::vector<glm::mat4>& nodeMatrices) const {
+        nodeMatrices.resize(boneTransforms.size());
+        std::function<void(const Node*)> copy = [&](const Node* node) {
+            nodeMatrices[node->index] = node->globalMatrix;
+            for (auto&& e : node->children) copy(e.get());
+        };
+        copy(&rootNode);
+    }
+    void Model::UploadPalette(const std::vector<glm::mat4>& palette) {
+        // the binding always reads the full array, the bones past the palette are left as they are
+        paletteOffset = Enigma::uniformRing->Allocate(sizeof(glm::mat4) * maxBoneTransforms);
+        const size_t count = std::min<size_t>(palette.size(), maxBoneTransforms);
+        std::memcpy(Enigma::uniformRing->GetData(paletteOffset), palette.data(), count * sizeof(glm::mat4));
     }
     void Model::updateBoneTransforms2Helper(Node* node) {
         boneTransforms[node->index] = globalInverseTransform * node->globalMatrix * node->boneOffsetMatrix;
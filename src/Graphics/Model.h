@@ -7,10 +7,12 @@
 #include <glm/glm.hpp>
 #include "VulkanContext.h"
 #include "VulkanBuffer.h"
+#include "GeometryArena.h"
 #include "../Core/Error.h"
 #include "Allocator.h"
 #include <string>
 #include <array>
+#include <memory>
 #include <vector>
 #include <iostream>
 #include "../Graphics/VulkanImage.h"
@@ -123,12 +125,16 @@ namespace Enigma
 		std::string metallicTexturePath;
 		std::string roughnessTexturePath;
 		//std::string normalaMapTexture;
+		// ID in Enigma::textureCache's material table
+		uint32_t materialID = 0;
 	};
 	
 	struct Mesh
 	{
 		std::string meshName;
-		int materialIndex;
+		// index into the model's materials, materialID is what the shaders use
+		int materialIndex = -1;
+		uint32_t materialID = 0;
 		bool textured = false;
 		bool hasMetallic = false;
 		bool hadRoughness = false;
@@ -138,19 +144,36 @@ namespace Enigma
 		
 		std::vector<Vertex> vertices;
 		std::vector<uint32_t> indices;
-		Buffer vertexBuffer;
-		Buffer indexBuffer;
+		// ranges in Enigma::geometryArena, the box is drawn as lines
+		GeometryAllocation geometry;
 		AABB meshAABB;
-		Buffer AABB_buffer;
 		std::vector<Vertex> aabbVertices;
-		Buffer AABB_indexBuffer;
+		GeometryAllocation aabbGeometry;
 		glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f);
 	};
 
+	// Meshes and materials loaded from one file, shared by every Model loaded from it, see MeshAssetCache. The
+	// geometry stays in the arena until the last model using it is destroyed
+	struct MeshAsset
+	{
+		std::string path;
+		std::vector<Material> materials;
+		std::vector<Mesh> meshes;
+		bool hasAnimations = false;
+		// false until the first model loading the file has filled it in
+		bool loaded = false;
+
+		MeshAsset() = default;
+		MeshAsset(const MeshAsset&) = delete;
+		MeshAsset& operator=(const MeshAsset&) = delete;
+		// Gives the meshes' geometry back to the arena
+		~MeshAsset();
+	};
+
 	struct ModelPushConstant
 	{
 		glm::mat4 model;
-		int textureIndex;
+		int materialID;
 		bool isTextured;
 	};
 	/*
@@ -228,6 +251,9 @@ namespace Enigma
 		std::vector<NodeAnim> channel; // Channel of animation for each node
 	};
 
+	class RenderQueue;
+	struct RenderState;
+
 	class Model
 	{
 		public:
@@ -236,34 +262,51 @@ namespace Enigma
 			// @filetype - type of file, fbx or obj
 			Model(const std::string& filepath, const VulkanContext& context, int filetype);
 			Model(const std::string& filepath, const VulkanContext& context, int filetype, const std::string& name);
-			
+
 			// This will draw the the model without debug properties rendered
 			void Draw(VkCommandBuffer cmd, VkPipelineLayout layout);
-			
-			void Draw2(VkCommandBuffer cmd, VkPipelineLayout layout);
+			// Draws with the given model matrix instead of the model's own transform
+			void Draw(VkCommandBuffer cmd, VkPipelineLayout layout, const glm::mat4& transform);
+
+			// Copies the palette to the uniform ring, once per frame, before the model's skinned packets are queued
+			void UploadPalette(const std::vector<glm::mat4>& palette);
 			void DrawAABB(VkCommandBuffer cmd, VkPipelineLayout layout);
 
+			// Queue a packet per mesh instead of drawing it, the queue sorts and binds them, see RenderQueue
+			void Queue(RenderQueue& queue, const RenderState& state, const glm::mat4& transform) const;
+			// Queues the meshes' boxes, state is the line pipeline
+			void QueueAABB(RenderQueue& queue, const RenderState& state, const glm::mat4& transform) const;
+			// Skinned version of Queue from a pose copied out of the simulation, see CopyPose. UploadPalette has to
+			// be called first. The packets carry the model's bone set at @state.setIndex
+			// @offset - applied on top of every node, used to blend the position between simulation ticks
+			void Queue2(RenderQueue& queue, RenderState state, const std::vector<glm::mat4>& nodeMatrices, const glm::mat4& offset) const;
+
 			// This will draw the model will debug prperties visibile such as AABB
 			void DrawDebug(VkCommandBuffer cmd, VkPipelineLayout layout, VkPipeline AABBPipeline);
+			void DrawDebug(VkCommandBuffer cmd, VkPipelineLayout layout, VkPipeline AABBPipeline, const glm::mat4& transform);
 			void DrawDebug(VkCommandBuffer cmd, VkPipelineLayout layout, VkPipeline AABBPipeline, int index);
 
 			// Get the AABB min and max 
 			glm::vec3 GetAABBMin() const { return m_AABB.min; };
 			glm::vec3 GetAABBMax() const { return m_AABB.max; };
 
-			std::vector<Material> materials;
-			std::vector<Mesh> meshes;
+			// a model is an instance of its file, the meshes and materials belong to the asset. Models loaded from the
+			// same file only differ in their transform and animation state
+			std::shared_ptr<MeshAsset> asset;
+			std::vector<Material>& materials;
+			std::vector<Mesh>& meshes;
 
 			bool player = false;
 			bool enemy = false;
 			bool hasAnimations = false;
 			bool hit = false;
 			bool dead = false;
+			// false for models that are only drawn, left out of the collision BVH and the hitscan shapes
+			bool collidable = true;
 			aiAnimation** animations;
 
 			std::string modelName;
 			glm::mat4 modelMatrix = glm::mat4(1.0f);
-			std::vector<VkDescriptorSet> m_descriptorSet;
 			
 			const aiScene* m_Scene;
 
@@ -282,8 +325,6 @@ namespace Enigma
 			glm::mat4 rotMatrix = glm::mat4(1.0f);
 			glm::vec3 scale = glm::vec3(1.f, 1.f, 1.f);
 			glm::vec3 offset = glm::vec3(0.f, 0.f, 0.f);
-			std::vector<Image> loadedTextures;
-			std::vector<Image> MetallicTextures;
 			
 			const VulkanContext& context;
 			std::string m_filePath;
@@ -406,17 +447,31 @@ namespace Enigma
 			float getZRotation() { return rotationZ; }
 			glm::mat4 getRotationMatrix() { return rotMatrix; }
 			glm::vec3 getScale() { return scale; }
+			glm::mat4 GetModelMatrix();
+			// palette the skinning shader reads, indexed by the node index stored in Vertex::boneIDs
+			const std::vector<glm::mat4>& GetBoneTransforms() const { return boneTransforms; }
+			// Rebuilds the node matrices and the palette from the current animation, CPU only
+			void UpdatePose();
+			// Node global matrices indexed by Node::index, what Queue2 needs besides the palette
+			void CopyPose(std::vector<glm::mat4>& nodeMatrices) const;
+			// Set for models the simulation moves, index of the model in every FrameSnapshot
+			int snapshotIndex = -1;
 		private:
 			void LoadOBJModel(const std::string& filepath);
 			void LoadFBXModel(const std::string& filepath);
             void LoadModelAssimp(const std::string& filepath);
+			// Places every mesh and its box in the geometry arena and gives each mesh its material's ID
 			void CreateBuffers();
-			void CreateAABBBuffers();
+			// Adds the materials' textures to the texture cache and gives every material its ID
+			// @defaultTexture - diffuse texture of materials without one
+			// @sampler - sampler the diffuse textures are read with
+			void RegisterMaterials(const std::string& defaultTexture, VkSampler sampler);
 
 			void loadBones(aiMesh* mesh, std::vector<Vertex>& boneData);
 			
 			std::vector<glm::mat4> boneTransforms;
-            Buffer boneTransformBuffer;
+			// the palette's place in the uniform ring this frame, the set is bound at it
+			uint32_t paletteOffset = 0;
 			std::vector<VkDescriptorSet> boneTransformDescriptorSet;
 			
 			//===========================
@@ -424,12 +479,12 @@ namespace Enigma
 			void processNode2(aiNode* node, Node* dstNode, int& index);
 			void processMesh2(aiMesh* mesh);
             void processAnimation2();
-            void loadBones2();
+            // @weights - writes the bone weights into the vertices, only while the asset is being loaded
+            void loadBones2(bool weights);
             void loadMaterials2();
-            void createBoneTransformBuffer();
-            void drawNode(VkCommandBuffer cmd,VkPipelineLayout layout,Node* node);
+            void createBoneTransformDescriptorSet();
             void drawNodeAABB(VkCommandBuffer cmd,VkPipelineLayout layout,Node* node);
-            void updateBoneTransforms2();
+			void queueNode(RenderQueue& queue, const RenderState& state, const Node* node, const std::vector<glm::mat4>& nodeMatrices, const glm::mat4& offset) const;
 			void updateBoneTransforms2Helper(Node* node);
 			
 		};
@@ -0,0 +1,139 @@
+#include "PipelineCache.h"
+#include "../Core/Error.h"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+
+namespace Enigma
+{
+	namespace
+	{
+		// "EPCH", bump fileVersion when FileHeader changes
+		constexpr uint32_t fileMagic = 0x48435045;
+		constexpr uint32_t fileVersion = 1;
+
+		// FNV-1a, only has to catch a truncated or corrupted file
+		uint64_t Hash(const std::vector<uint8_t>& data)
+		{
+			uint64_t hash = 14695981039346656037ull;
+			for (const uint8_t byte : data)
+			{
+				hash ^= byte;
+				hash *= 1099511628211ull;
+			}
+			return hash;
+		}
+	}
+
+	PipelineCache::PipelineCache(const VulkanContext& context, const std::string& path) : context{ context }, m_path{ path }
+	{
+		VkPhysicalDeviceProperties2 properties{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2 };
+		properties.pNext = &m_idProperties;
+		vkGetPhysicalDeviceProperties2(context.physicalDevice, &properties);
+		m_properties = properties.properties;
+		m_idProperties.pNext = nullptr;
+
+		const std::vector<uint8_t> data = Load();
+
+		VkPipelineCacheCreateInfo cacheInfo{ VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO };
+		cacheInfo.initialDataSize = data.size();
+		cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+		m_warm = !data.empty() && vkCreatePipelineCache(context.device, &cacheInfo, nullptr, &m_cache) == VK_SUCCESS;
+
+		// the driver turned the data down after all, start from nothing
+		if (!m_warm)
+		{
+			cacheInfo.initialDataSize = 0;
+			cacheInfo.pInitialData = nullptr;
+			ENIGMA_VK_CHECK(vkCreatePipelineCache(context.device, &cacheInfo, nullptr, &m_cache), "Failed to create pipeline cache");
+		}
+
+		std::cout << "[ENIGMA]: Pipeline cache " << (m_warm ? "loaded " + std::to_string(data.size()) + " bytes from " : "is cold, nothing usable in ") << m_path << std::endl;
+	}
+
+	PipelineCache::~PipelineCache()
+	{
+		if (m_cache != VK_NULL_HANDLE)
+			vkDestroyPipelineCache(context.device, m_cache, nullptr);
+	}
+
+	void PipelineCache::Save() const
+	{
+		size_t size = 0;
+		ENIGMA_VK_CHECK(vkGetPipelineCacheData(context.device, m_cache, &size, nullptr), "Failed to get pipeline cache size");
+		std::vector<uint8_t> data(size);
+		ENIGMA_VK_CHECK(vkGetPipelineCacheData(context.device, m_cache, &size, data.data()), "Failed to get pipeline cache data");
+		data.resize(size);
+
+		const FileHeader header = MakeHeader(data);
+		const std::string temporaryPath = m_path + ".tmp";
+		{
+			std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+			if (!file.is_open())
+			{
+				ENIGMA_ERROR("Failed to write pipeline cache: " + temporaryPath);
+				return;
+			}
+			file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+		}
+
+		std::error_code error;
+		std::filesystem::rename(temporaryPath, m_path, error);
+		if (error)
+		{
+			ENIGMA_ERROR("Failed to replace pipeline cache " + m_path + ": " + error.message());
+		}
+	}
+
+	PipelineCache::FileHeader PipelineCache::MakeHeader(const std::vector<uint8_t>& data) const
+	{
+		FileHeader header{};
+		header.magic = fileMagic;
+		header.version = fileVersion;
+		header.vendorID = m_properties.vendorID;
+		header.deviceID = m_properties.deviceID;
+		header.driverVersion = m_properties.driverVersion;
+		std::memcpy(header.deviceUUID, m_idProperties.deviceUUID, VK_UUID_SIZE);
+		std::memcpy(header.driverUUID, m_idProperties.driverUUID, VK_UUID_SIZE);
+		std::memcpy(header.pipelineCacheUUID, m_properties.pipelineCacheUUID, VK_UUID_SIZE);
+		header.dataSize = data.size();
+		header.dataHash = Hash(data);
+		return header;
+	}
+
+	std::vector<uint8_t> PipelineCache::Load() const
+	{
+		std::ifstream file(m_path, std::ios::binary | std::ios::ate);
+		if (!file.is_open())
+			return {};
+
+		const std::streamoff fileSize = file.tellg();
+		if (fileSize < static_cast<std::streamoff>(sizeof(FileHeader) + sizeof(VkPipelineCacheHeaderVersionOne)))
+			return {};
+
+		FileHeader header{};
+		file.seekg(0);
+		file.read(reinterpret_cast<char*>(&header), sizeof(header));
+
+		std::vector<uint8_t> data(static_cast<size_t>(fileSize) - sizeof(FileHeader));
+		file.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(data.size()));
+		if (!file)
+			return {};
+
+		// a cache from another GPU or driver version, or a file cut short while it was written
+		const FileHeader expected = MakeHeader(data);
+		if (std::memcmp(&header, &expected, sizeof(FileHeader)) != 0)
+			return {};
+
+		// drivers should check their own header, not all of them do
+		VkPipelineCacheHeaderVersionOne driverHeader{};
+		std::memcpy(&driverHeader, data.data(), sizeof(driverHeader));
+		if (driverHeader.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE || driverHeader.vendorID != m_properties.vendorID ||
+			driverHeader.deviceID != m_properties.deviceID || std::memcmp(driverHeader.pipelineCacheUUID, m_properties.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+			return {};
+
+		return data;
+	}
+}
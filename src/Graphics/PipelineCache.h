@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <Volk/volk.h>
+#include "VulkanContext.h"
+
+namespace Enigma
+{
+	// The driver's compiled pipelines, saved to disk so later runs skip most of the shader compilation. The file
+	// starts with a header of our own naming the device and driver that wrote it, the data is only given back to the
+	// driver if all of it matches and the driver's own header agrees, otherwise the cache starts out empty and the
+	// file is replaced on the next save. The driver synchronises the cache itself, pipelines may be created with it
+	// on any thread
+	class PipelineCache
+	{
+	public:
+		PipelineCache(const VulkanContext& context, const std::string& path);
+		~PipelineCache();
+
+		PipelineCache(const PipelineCache&) = delete;
+		PipelineCache& operator=(const PipelineCache&) = delete;
+
+		// Writes the cache next to the old file and swaps it in, so an interrupted save leaves the old one intact
+		void Save() const;
+
+		VkPipelineCache GetHandle() const { return m_cache; }
+		// whether the cache was loaded from disk, startup is cold without it
+		bool IsWarm() const { return m_warm; }
+
+	private:
+		struct FileHeader
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint32_t vendorID;
+			uint32_t deviceID;
+			uint32_t driverVersion;
+			uint8_t deviceUUID[VK_UUID_SIZE];
+			uint8_t driverUUID[VK_UUID_SIZE];
+			uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+			// keeps the struct free of padding, headers are compared byte for byte
+			uint32_t reserved;
+			uint64_t dataSize;
+			uint64_t dataHash;
+		};
+
+		// Header this device and driver write in front of @data
+		FileHeader MakeHeader(const std::vector<uint8_t>& data) const;
+		// The file's data if it was written by this device and driver, empty otherwise
+		std::vector<uint8_t> Load() const;
+
+	private:
+		const VulkanContext& context;
+		std::string m_path;
+		VkPipelineCache m_cache = VK_NULL_HANDLE;
+		VkPhysicalDeviceProperties m_properties{};
+		VkPhysicalDeviceIDProperties m_idProperties{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES };
+		bool m_warm = false;
+	};
+}
@@ -8,6 +8,9 @@
 #include <glm/gtx/euler_angles.hpp>
 
 #include "Physics.h"
+#include "../Core/BVH.h"
+#include "../Core/Hitscan.h"
+#include "../Core/CharacterController.h"
 
 class VulkanContext;
 class Time;
@@ -15,10 +18,26 @@ class Time;
 
 namespace Enigma
 {
+	// Keys and view direction for one frame, read on the render thread and simulated on the simulation thread
+	struct PlayerInput
+	{
+		bool active = false;
+		bool forward = false;
+		bool back = false;
+		bool left = false;
+		bool right = false;
+		bool sprint = false;
+		bool fire = false;
+		glm::vec3 front = glm::vec3(0.0f, 0.0f, 1.0f);
+		glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f);
+		glm::vec3 direction = glm::vec3(0.0f, 0.0f, 1.0f);
+		glm::mat4 rotation = glm::mat4(1.0f);
+	};
+
 	class Player
 	{
 	public:
-		Player(VulkanContext& context, const std::string& model, const glm::vec3 startingPos, int health, Time& time) : m_position{ startingPos }, m_health{ health }
+		Player(VulkanContext& context, const std::string& model, const glm::vec3 startingPos, int health, Time& time) : m_position{ startingPos }, m_previousPosition{ startingPos }, m_health{ health }
 		{
 			// this is not the right aspect ratio and needs to change ? but update should handle it 
 			FPSCamera = new Camera(m_position, glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0, 1, 0), time, 1920.0f / 1080.0f);
@@ -195,51 +214,23 @@ namespace Enigma
 			
 		}
 
-		bool isCollidingWithPlayer(std::vector<Model*> worldMeshes)
+		void Draw(VkCommandBuffer cmd, VkPipelineLayout layout, const glm::mat4& transform)
 		{
-			for (auto& model : worldMeshes)
-			{
-				bool isCollideable = model->modelName != "/Light.obj";
-
-				if (isCollideable)
-				{
-					for (auto& mesh : model->meshes)
-					{
-						if (!model->player && !model->enemy) {
-							AABB box = mesh.meshAABB;
-							box.min = box.min * model->getScale() + model->getTranslation();
-							box.max = box.max * model->getScale() + model->getTranslation();
-
-							if (Enigma::Physics::isAABBColliding(m_AABB, m_position, box))
-							{
-								printf("Colliding with: %s\n", mesh.meshName);
-								return true;
-							}
-						}
-					}
-				}
-			}
-			return false;
+			m_Model->Draw(cmd, layout, transform);
 		}
 
-		void Draw(VkCommandBuffer cmd, VkPipelineLayout layout)
-		{
-			m_Model->Draw(cmd, layout);
-		}
-
-		void DrawAABBDebug(VkCommandBuffer cmd, VkPipelineLayout layout, VkPipeline AABBPipeline, VkDescriptorSet descriptorSet)
+		void DrawAABBDebug(VkCommandBuffer cmd, VkPipelineLayout layout, VkPipeline AABBPipeline, const glm::vec3& position)
 		{
 			ModelPushConstant push = {};
 			push.model = glm::mat4(1.0f);
-			push.model = glm::translate(push.model, m_position);
+			push.model = glm::translate(push.model, position);
 			push.model = glm::scale(push.model, m_Model->getScale());
-			push.textureIndex = 0;
+			push.materialID = 0;
 			push.isTextured = false;
 
 			vkCmdPushConstants(cmd, layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(ModelPushConstant), &push);
 
 			vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, AABBPipeline);
-			vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 1, 1, &descriptorSet, 0, nullptr);
 
 			VkDeviceSize offset[] = { 0 };
 			vkCmdBindVertexBuffers(cmd, 0, 1, &AABB_buffer.buffer, offset);
@@ -265,15 +256,23 @@ namespace Enigma
 			m_AABB.min = m_AABB.min * m_Model->getScale();
 		}
 
-		void Update(GLFWwindow* window, uint32_t width, uint32_t height, const VulkanContext& context, const std::vector<Model*> meshes, const Time& time)
+		// Render thread: samples the keys and the view once per frame for the simulation thread, GLFW input
+		// and the camera are only touched from here
+		PlayerInput ReadInput(GLFWwindow* window)
 		{
-			glm::vec3 cameraPosition = m_position;
-			m_position.y = 10.0f;
-			FPSCamera->SetPosition(cameraPosition);
-			FPSCamera->Update(width, height);
-			//glm::vec cameraPosition = FPSCamera->GetPosition();
-			//cameraPosition.y = 5.0f;
-			//FPSCamera->SetPosition(cameraPosition);
+			PlayerInput input;
+			input.active = Enigma::enablePlayerCamera;
+			input.forward = glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS;
+			input.back = glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS;
+			input.right = glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS;
+			input.left = glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS;
+			input.sprint = glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS;
+			input.fire = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+
+			glm::mat4 invView = glm::inverse(FPSCamera->GetCameraTransform().view);
+			input.front = -glm::vec3(invView[2]);
+			input.up = FPSCamera->GetUp();
+			input.direction = glm::normalize(FPSCamera->GetDirection());
 
 			float rotY = glm::radians(FPSCamera->yaw - 90.0f);
 			float rotX = glm::radians(FPSCamera->pitch);
@@ -281,42 +280,39 @@ namespace Enigma
 			glm::mat4 yawRotation = glm::rotate(glm::mat4(1.0f), -rotY, glm::vec3(0.0f, 1.0f, 0.0f));
 			glm::mat4 pitchRotation = glm::rotate(glm::mat4(1.0f), -rotX, glm::vec3(1.0f, 0.0f, 0.0f));
 
-			glm::mat4 combinedRotation = yawRotation * pitchRotation;
-
-			m_Model->setRotationMatrix(combinedRotation);
+			input.rotation = yawRotation * pitchRotation;
 
-			glm::vec3 modelPosition = (FPSCamera->GetPosition() + glm::normalize(FPSCamera->GetDirection())) * 1.f;
+			if (input.active && glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS)
+			{
+				Enigma::drawDecals = !Enigma::drawDecals;
+			}
+			return input;
+		}
 
-			//m_position = modelPosition;
-			//m_position.y -= 3.0f;
-			//m_Model->setTranslation(m_position);
+		// Simulation thread, one fixed tick: shooting and movement, dt is the tick length in seconds
+		void Simulate(const PlayerInput& input, const BVH& collision, const Hitscan& hitscan, float dt)
+		{
+			// where the tick starts, frames drawn until the next tick blend from here
+			m_previousPosition = m_position;
+			m_position.y = 10.0f;
 
-			if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS)
+			if (input.fire)
 			{
-				std::cout << "Shooting" << std::endl;
 				float rayLength = 30.0f;
-				Enigma::Physics::Ray ray = Enigma::Physics::RayCast(FPSCamera, rayLength);
-				glm::vec3 endPoint = ray.origin + ray.direction * rayLength;
+				Enigma::Physics::Ray ray = { m_position, input.front };
 
-				Model* model = new Model("../resources/cube.obj", context, ENIGMA_LOAD_OBJ_FILE);
-				model->setTranslation(endPoint);
-				Enigma::tempModels.push_back(std::move(model));
-
-				// TODO: OPTIMIZE: if we intersect with the main models mesh then search for which specific mesh of the model we hit
-				for (int model = 0; model < meshes.size(); model++)
+				// the closest triangle or bone along the ray takes the shot so enemies behind walls can't be hit
+				HitscanHit hit;
+				if (hitscan.Raycast(collision, ray.origin, glm::normalize(ray.direction), rayLength, COLLISION_STATIC | COLLISION_ENEMY, hit))
 				{
-					for (uint32_t i = 0; i < meshes[model]->meshes.size(); i++)
+					if (hit.model->enemy)
+					{
+						hit.model->hit = true;
+					}
+					else
 					{
-						AABB box = meshes[model]->meshes[i].meshAABB;
-						box.min = box.min * meshes[model]->getScale() + meshes[model]->getTranslation();
-						box.max = box.max * meshes[model]->getScale() + meshes[model]->getTranslation();
-						if (Enigma::Physics::RayIntersectAABB(ray, box) && meshes[model]->enemy)
-						{
-							// could clear info regarding the mesh which got hit instead?
-							std::cout << "Hit: " << meshes[model]->meshes[i].meshName << std::endl;
-							meshes[model]->hit = true;
-							break;
-						}
+						// the decal is added by the render thread, which owns the Vulkan queue
+						impacts.push_back(hit.point);
 					}
 				}
 
@@ -325,7 +321,7 @@ namespace Enigma
 			glm::vec3 velocity = glm::vec3(0.0f, 0.0f, 0.0f);
 
 			// Set the speed if the player is sprinting 
-			if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS)
+			if (input.sprint)
 			{
 				speed = 30.0f;
 			}
@@ -333,64 +329,57 @@ namespace Enigma
 				speed = 20.0f;
 			}
 
-			if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS)
+			if (input.forward)
 			{
-				glm::mat4 invView = glm::inverse(FPSCamera->GetCameraTransform().view);
-				velocity += -glm::vec3(invView[2]);
+				velocity += input.front;
 
-				velocity = glm::normalize(velocity) * speed * (float)time.deltaTime; // need to multiply by delta time 
+				velocity = glm::normalize(velocity) * speed * dt;
 			}
 
-			if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS)
+			if (input.back)
 			{
-				glm::mat4 invView = glm::inverse(FPSCamera->GetCameraTransform().view);
-				velocity -= -glm::vec3(invView[2]);
+				velocity -= input.front;
 
-				velocity = glm::normalize(velocity) * speed * (float)time.deltaTime; // need to multiply by delta time 
+				velocity = glm::normalize(velocity) * speed * dt;
 			}
 
-			if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
+			if (input.right)
 			{
-				glm::mat4 invView = glm::inverse(FPSCamera->GetCameraTransform().view);
-				auto cameraFront = -glm::vec3(invView[2]);
-				auto cameraUp = FPSCamera->GetUp();
-
-				auto right = glm::normalize(glm::cross(cameraFront, cameraUp));
+				auto right = glm::normalize(glm::cross(input.front, input.up));
 
 				velocity += right;
-				velocity = glm::normalize(velocity) * speed * (float)time.deltaTime; // need to multiply by delta time 
+				velocity = glm::normalize(velocity) * speed * dt;
 			}
 
-			if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
+			if (input.left)
 			{
-				glm::mat4 invView = glm::inverse(FPSCamera->GetCameraTransform().view);
-				auto cameraFront = -glm::vec3(invView[2]);
-				auto cameraUp = FPSCamera->GetUp();
-
-				auto right = glm::normalize(glm::cross(cameraFront, cameraUp));
+				auto right = glm::normalize(glm::cross(input.front, input.up));
 
 				velocity -= right;
 
-				velocity = glm::normalize(velocity) * speed * (float)time.deltaTime; // need to multiply by delta time 
+				velocity = glm::normalize(velocity) * speed * dt;
 			}
 
-			if (glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS)
-			{
-				Enigma::renderTemp = !Enigma::renderTemp;
-			}
+			// only the level blocks the player, the move slides along walls instead of stopping dead
+			m_position = m_controller.Move(collision, m_AABB, m_position, velocity, COLLISION_STATIC);
 
-			m_position += velocity;
-			if (isCollidingWithPlayer(meshes))
-			{
-				m_position -= velocity;
-			}
-			else {
-				cameraPosition = m_position + glm::vec3(0.0f, 5.0f, 0.0f);
-				FPSCamera->SetPosition(cameraPosition);
+			// the weapon sits in front of the eye and turns with the view
+			glm::vec3 modelPosition = m_position + input.direction;
+			modelPosition.y -= 1.0f;
+			m_Model->setRotationMatrix(input.rotation);
+			m_Model->setTranslation(modelPosition);
+		}
 
-				modelPosition.y -= 1.0f;
-				m_Model->setTranslation(modelPosition);
-			}
+		// Render thread, every frame: puts the camera where the snapshot has the player
+		void Update(uint32_t width, uint32_t height, const glm::vec3& position)
+		{
+			FPSCamera->SetPosition(position);
+			FPSCamera->Update(width, height);
+			//glm::vec cameraPosition = FPSCamera->GetPosition();
+			//cameraPosition.y = 5.0f;
+			//FPSCamera->SetPosition(cameraPosition);
+
+			FPSCamera->SetPosition(position + glm::vec3(0.0f, 5.0f, 0.0f));
 		}
 
 		void SetPosition(glm::vec3 newpos)
@@ -410,17 +399,21 @@ namespace Enigma
 		Camera* GetCamera() const { return FPSCamera; }
 
 		glm::vec3 GetPosition() const { return m_position; }
+		glm::vec3 GetPreviousPosition() const { return m_previousPosition; }
+		// shot impact points made by Simulate, taken by the world when it writes a snapshot
+		std::vector<glm::vec3> impacts;
 		AABB GetAABB() const { return m_AABB; }
 		int GetHealth() const { return m_health; }
 		Model* m_Model;
-		int navmeshPosition;
 
 	private:
 		Camera* FPSCamera;
 		glm::vec3 m_position;
+		glm::vec3 m_previousPosition;
 		glm::vec3 m_direction;
 		int m_health = 0;
 		AABB m_AABB;
+		CharacterController m_controller;
 		float speed = 1.0f;
 
 		Buffer AABB_buffer;
@@ -0,0 +1,677 @@
+#include "RenderGraph.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include "../Core/Error.h"
+#include "../Core/JobSystem.h"
+
+namespace Enigma
+{
+	namespace
+	{
+		bool IsDepthFormat(VkFormat format)
+		{
+			switch (format)
+			{
+			case VK_FORMAT_D16_UNORM:
+			case VK_FORMAT_X8_D24_UNORM_PACK32:
+			case VK_FORMAT_D32_SFLOAT:
+			case VK_FORMAT_D16_UNORM_S8_UINT:
+			case VK_FORMAT_D24_UNORM_S8_UINT:
+			case VK_FORMAT_D32_SFLOAT_S8_UINT:
+				return true;
+			default:
+				return false;
+			}
+		}
+
+		VkImageLayout AttachmentLayout(VkFormat format)
+		{
+			return IsDepthFormat(format) ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		}
+
+		VkImageLayout ReadLayout(VkFormat format)
+		{
+			return IsDepthFormat(format) ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		}
+
+		// stages and access of one use of a texture
+		struct Use
+		{
+			VkPipelineStageFlags stages = 0;
+			VkAccessFlags access = 0;
+		};
+
+		Use GetUse(VkFormat format, bool write, bool clear)
+		{
+			if (!write)
+				return { VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT };
+			if (IsDepthFormat(format))
+				return { VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+					VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | (clear ? 0u : VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT) };
+			return { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+				VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | (clear ? 0u : VK_ACCESS_COLOR_ATTACHMENT_READ_BIT) };
+		}
+
+		// only writes have to be made available, a read before a write just needs the execution dependency
+		constexpr VkAccessFlags writeAccess = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT |
+			VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+
+		std::string StageNames(VkPipelineStageFlags stages)
+		{
+			const std::pair<VkPipelineStageFlags, const char*> names[] = {
+				{ VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, "FRAGMENT_SHADER" },
+				{ VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT, "EARLY_FRAGMENT_TESTS" },
+				{ VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, "LATE_FRAGMENT_TESTS" },
+				{ VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, "COLOR_ATTACHMENT_OUTPUT" }
+			};
+
+			std::string out;
+			for (const auto& [bit, name] : names)
+			{
+				if (stages & bit)
+					out += (out.empty() ? "" : "|") + std::string(name);
+			}
+			return out.empty() ? "NONE" : out;
+		}
+
+		const char* LayoutName(VkImageLayout layout)
+		{
+			switch (layout)
+			{
+			case VK_IMAGE_LAYOUT_UNDEFINED: return "UNDEFINED";
+			case VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL: return "COLOR_ATTACHMENT";
+			case VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL: return "DEPTH_ATTACHMENT";
+			case VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL: return "DEPTH_READ_ONLY";
+			case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL: return "SHADER_READ_ONLY";
+			case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR: return "PRESENT_SRC";
+			case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL: return "TRANSFER_SRC";
+			default: return "OTHER";
+			}
+		}
+
+		const char* LoadOpName(VkAttachmentLoadOp op)
+		{
+			switch (op)
+			{
+			case VK_ATTACHMENT_LOAD_OP_CLEAR: return "clear";
+			case VK_ATTACHMENT_LOAD_OP_LOAD: return "load";
+			default: return "dont_care";
+			}
+		}
+
+		std::string MiB(VkDeviceSize bytes)
+		{
+			std::ostringstream out;
+			out << std::fixed << std::setprecision(2) << bytes / (1024.0 * 1024.0) << " MiB";
+			return out.str();
+		}
+	}
+
+	void RenderGraph::PassBuilder::Write(RenderResource resource, bool clear, VkClearValue clearValue)
+	{
+		graph.m_passes[pass].accesses.push_back({ resource, true, clear, clearValue });
+	}
+
+	void RenderGraph::PassBuilder::Read(RenderResource resource)
+	{
+		graph.m_passes[pass].accesses.push_back({ resource, false, false, {} });
+	}
+
+	void RenderGraph::PassBuilder::SideEffect()
+	{
+		graph.m_passes[pass].sideEffect = true;
+	}
+
+	void RenderGraph::PassBuilder::OnCompiled(const std::function<void(const RenderGraph&)>& callback)
+	{
+		graph.m_passes[pass].onCompiled.push_back(callback);
+	}
+
+	RenderGraph::RenderGraph(const VulkanContext& context) : context{ context }
+	{
+	}
+
+	RenderGraph::~RenderGraph()
+	{
+		Release();
+	}
+
+	RenderResource RenderGraph::CreateTexture(const std::string& name, const TextureDesc& desc)
+	{
+		Resource resource{};
+		resource.name = name;
+		resource.desc = desc;
+		m_resources.push_back(resource);
+		return static_cast<RenderResource>(m_resources.size() - 1);
+	}
+
+	RenderResource RenderGraph::ImportSwapchain(const std::string& name, VkFormat format, VkImageLayout finalLayout)
+	{
+		Resource resource{};
+		resource.name = name;
+		resource.desc.format = format;
+		resource.imported = true;
+		resource.finalLayout = finalLayout;
+		m_resources.push_back(resource);
+		return static_cast<RenderResource>(m_resources.size() - 1);
+	}
+
+	RenderGraphPass RenderGraph::AddPass(const std::string& name, const std::function<void(PassBuilder&)>& setup)
+	{
+		Pass pass{};
+		pass.name = name;
+		m_passes.push_back(pass);
+
+		const RenderGraphPass handle = static_cast<RenderGraphPass>(m_passes.size() - 1);
+		PassBuilder builder(*this, handle);
+		setup(builder);
+		return handle;
+	}
+
+	void RenderGraph::Compile(VkExtent2D swapchainExtent, const std::vector<VkImageView>& swapchainViews, JobSystem* jobs)
+	{
+		Release();
+		m_swapchainViews = swapchainViews;
+
+		Cull();
+		ComputeLifetimes();
+		AllocateTargets(swapchainExtent);
+		BuildRenderPasses();
+
+		std::vector<const Pass*> compiled;
+		for (const auto& pass : m_passes)
+		{
+			if (!pass.culled && !pass.onCompiled.empty())
+				compiled.push_back(&pass);
+		}
+
+		// the first compile creates every pass's pipelines, one pass per job keeps the slow ones from queueing up
+		const auto runCallbacks = [&](int begin, int end) {
+			for (int i = begin; i < end; i++)
+			{
+				for (const auto& callback : compiled[i]->onCompiled)
+					callback(*this);
+			}
+		};
+
+		if (jobs != nullptr)
+			jobs->ParallelFor(static_cast<int>(compiled.size()), 1, runCallbacks);
+		else
+			runCallbacks(0, static_cast<int>(compiled.size()));
+	}
+
+	void RenderGraph::Cull()
+	{
+		// walk back from the passes that write the swapchain, a pass is kept if a kept pass after it uses one of its
+		// textures before something clears it again
+		std::vector<bool> needed(m_resources.size(), false);
+		for (int p = static_cast<int>(m_passes.size()) - 1; p >= 0; p--)
+		{
+			Pass& pass = m_passes[p];
+			bool keep = pass.sideEffect;
+			for (const auto& access : pass.accesses)
+			{
+				if (access.write && (needed[access.resource] || m_resources[access.resource].imported))
+					keep = true;
+			}
+
+			pass.culled = !keep;
+			if (!keep)
+				continue;
+
+			for (const auto& access : pass.accesses)
+				needed[access.resource] = !access.write || !access.clear;
+		}
+	}
+
+	void RenderGraph::ComputeLifetimes()
+	{
+		for (auto& resource : m_resources)
+		{
+			resource.firstPass = -1;
+			resource.lastPass = -1;
+			resource.usage = 0;
+		}
+
+		for (int p = 0; p < static_cast<int>(m_passes.size()); p++)
+		{
+			if (m_passes[p].culled)
+				continue;
+
+			for (const auto& access : m_passes[p].accesses)
+			{
+				Resource& resource = m_resources[access.resource];
+				if (resource.firstPass == -1)
+					resource.firstPass = p;
+				resource.lastPass = p;
+
+				if (!access.write)
+					resource.usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+				else if (IsDepthFormat(resource.desc.format))
+					resource.usage |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+				else
+					resource.usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+			}
+		}
+	}
+
+	void RenderGraph::AllocateTargets(VkExtent2D swapchainExtent)
+	{
+		std::vector<RenderResource> order;
+		for (RenderResource r = 0; r < m_resources.size(); r++)
+		{
+			Resource& resource = m_resources[r];
+			resource.extent = resource.desc.width != 0 ? VkExtent2D{ resource.desc.width, resource.desc.height } : swapchainExtent;
+			if (resource.imported || resource.firstPass == -1)
+				continue;
+
+			VkImageCreateInfo imageInfo{ VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+			imageInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageInfo.extent = { resource.extent.width, resource.extent.height, 1 };
+			imageInfo.mipLevels = 1;
+			imageInfo.arrayLayers = 1;
+			imageInfo.format = resource.desc.format;
+			imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageInfo.usage = resource.usage;
+			imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+			ENIGMA_VK_CHECK(vkCreateImage(context.device, &imageInfo, nullptr, &resource.image), "Failed to create render graph image " + resource.name);
+			order.push_back(r);
+		}
+
+		// biggest first, each texture goes into the first block it fits in whose textures are all dead by the time
+		// it is first written or only start being used after it is done
+		std::vector<VkMemoryRequirements> requirements(m_resources.size());
+		for (RenderResource r : order)
+		{
+			vkGetImageMemoryRequirements(context.device, m_resources[r].image, &requirements[r]);
+			m_resources[r].size = requirements[r].size;
+		}
+		std::stable_sort(order.begin(), order.end(), [&](RenderResource a, RenderResource b) { return requirements[a].size > requirements[b].size; });
+
+		for (RenderResource r : order)
+		{
+			Resource& resource = m_resources[r];
+			int chosen = -1;
+			for (int b = 0; b < static_cast<int>(m_blocks.size()) && chosen == -1; b++)
+			{
+				const MemoryBlock& block = m_blocks[b];
+				if (!(block.requirements.memoryTypeBits & requirements[r].memoryTypeBits))
+					continue;
+
+				const bool disjoint = std::all_of(block.resources.begin(), block.resources.end(), [&](RenderResource other) {
+					return m_resources[other].lastPass < resource.firstPass || m_resources[other].firstPass > resource.lastPass;
+				});
+				if (disjoint)
+					chosen = b;
+			}
+
+			if (chosen == -1)
+			{
+				m_blocks.emplace_back();
+				m_blocks.back().requirements = requirements[r];
+				chosen = static_cast<int>(m_blocks.size()) - 1;
+			}
+
+			MemoryBlock& block = m_blocks[chosen];
+			block.requirements.size = std::max(block.requirements.size, requirements[r].size);
+			block.requirements.alignment = std::max(block.requirements.alignment, requirements[r].alignment);
+			block.requirements.memoryTypeBits &= requirements[r].memoryTypeBits;
+			block.resources.push_back(r);
+			resource.block = chosen;
+		}
+
+		for (auto& block : m_blocks)
+		{
+			VmaAllocationCreateInfo allocInfo{};
+			allocInfo.preferredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+			ENIGMA_VK_CHECK(vmaAllocateMemory(context.allocator.allocator, &block.requirements, &allocInfo, &block.allocation, nullptr), "Failed to allocate render graph memory");
+
+			for (RenderResource r : block.resources)
+			{
+				Resource& resource = m_resources[r];
+				ENIGMA_VK_CHECK(vmaBindImageMemory(context.allocator.allocator, block.allocation, resource.image), "Failed to bind render graph image " + resource.name);
+
+				VkImageViewCreateInfo viewInfo{ VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
+				viewInfo.image = resource.image;
+				viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+				viewInfo.format = resource.desc.format;
+				viewInfo.subresourceRange = { IsDepthFormat(resource.desc.format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+				ENIGMA_VK_CHECK(vkCreateImageView(context.device, &viewInfo, nullptr, &resource.view), "Failed to create render graph image view " + resource.name);
+			}
+		}
+	}
+
+	int RenderGraph::NextUse(RenderResource resource, int after, const Access** access) const
+	{
+		for (int p = after + 1; p < static_cast<int>(m_passes.size()); p++)
+		{
+			if (m_passes[p].culled)
+				continue;
+			for (const auto& candidate : m_passes[p].accesses)
+			{
+				if (candidate.resource == resource)
+				{
+					*access = &candidate;
+					return p;
+				}
+			}
+		}
+		return -1;
+	}
+
+	void RenderGraph::BuildRenderPasses()
+	{
+		// Last use of every piece of memory before the pass being built. Textures sharing a block are one piece of
+		// memory, the swapchain images are their own. It starts off as the last use in the frame since the previous
+		// frame left the same memory behind, the swapchain instead waits on the stage the acquire semaphore is waited on
+		const size_t memoryCount = m_blocks.size() + m_resources.size();
+		const auto memoryOf = [&](RenderResource r) { return m_resources[r].imported ? m_blocks.size() + r : static_cast<size_t>(m_resources[r].block); };
+
+		std::vector<Use> lastUse(memoryCount);
+		for (const auto& pass : m_passes)
+		{
+			if (pass.culled)
+				continue;
+			std::vector<Use> passUse(memoryCount);
+			for (const auto& access : pass.accesses)
+			{
+				const Use use = GetUse(m_resources[access.resource].desc.format, access.write, access.clear);
+				passUse[memoryOf(access.resource)].stages |= use.stages;
+				passUse[memoryOf(access.resource)].access |= use.access;
+			}
+			for (size_t m = 0; m < memoryCount; m++)
+			{
+				if (passUse[m].stages)
+					lastUse[m] = passUse[m];
+			}
+		}
+		for (RenderResource r = 0; r < m_resources.size(); r++)
+		{
+			if (m_resources[r].imported)
+				lastUse[memoryOf(r)] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0 };
+		}
+
+		std::vector<VkImageLayout> layouts(m_resources.size(), VK_IMAGE_LAYOUT_UNDEFINED);
+
+		for (int p = 0; p < static_cast<int>(m_passes.size()); p++)
+		{
+			Pass& pass = m_passes[p];
+			if (pass.culled)
+				continue;
+
+			// one external dependency covering everything the pass touches
+			VkSubpassDependency& dependency = pass.dependency;
+			dependency = {};
+			dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
+			dependency.dstSubpass = 0;
+
+			std::vector<Use> passUse(memoryCount);
+			for (const auto& access : pass.accesses)
+			{
+				const size_t memory = memoryOf(access.resource);
+				dependency.srcStageMask |= lastUse[memory].stages;
+				dependency.srcAccessMask |= lastUse[memory].access & writeAccess;
+
+				const Use use = GetUse(m_resources[access.resource].desc.format, access.write, access.clear);
+				dependency.dstStageMask |= use.stages;
+				dependency.dstAccessMask |= use.access;
+				passUse[memory].stages |= use.stages;
+				passUse[memory].access |= use.access;
+			}
+			for (size_t m = 0; m < memoryCount; m++)
+			{
+				if (passUse[m].stages)
+					lastUse[m] = passUse[m];
+			}
+
+			// attachments, each leaves the pass in the layout its next user wants
+			pass.attachments.clear();
+			pass.clearValues.clear();
+			std::vector<VkAttachmentReference> colorReferences;
+			VkAttachmentReference depthReference{};
+			bool hasDepth = false;
+			bool writesSwapchain = false;
+			std::vector<RenderResource> attachmentResources;
+
+			for (const auto& access : pass.accesses)
+			{
+				const Resource& resource = m_resources[access.resource];
+				if (!access.write)
+				{
+					if (layouts[access.resource] != ReadLayout(resource.desc.format))
+						ENIGMA_ERROR("Render graph pass " + pass.name + " reads " + resource.name + " before anything writes it");
+					continue;
+				}
+
+				const Access* next = nullptr;
+				const int nextPass = NextUse(access.resource, p, &next);
+
+				VkAttachmentDescription attachment{};
+				attachment.format = resource.desc.format;
+				attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+				attachment.initialLayout = access.clear ? VK_IMAGE_LAYOUT_UNDEFINED : layouts[access.resource];
+				attachment.loadOp = access.clear ? VK_ATTACHMENT_LOAD_OP_CLEAR :
+					(attachment.initialLayout == VK_IMAGE_LAYOUT_UNDEFINED ? VK_ATTACHMENT_LOAD_OP_DONT_CARE : VK_ATTACHMENT_LOAD_OP_LOAD);
+				// nobody looks at it afterwards, the tiler doesn't have to write it out
+				attachment.storeOp = (nextPass != -1 || resource.imported) ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+				attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+				attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+				if (nextPass == -1)
+					attachment.finalLayout = resource.imported ? resource.finalLayout : AttachmentLayout(resource.desc.format);
+				else
+					attachment.finalLayout = next->write ? AttachmentLayout(resource.desc.format) : ReadLayout(resource.desc.format);
+				layouts[access.resource] = attachment.finalLayout;
+
+				const VkAttachmentReference reference = { static_cast<uint32_t>(pass.attachments.size()), AttachmentLayout(resource.desc.format) };
+				if (IsDepthFormat(resource.desc.format))
+				{
+					depthReference = reference;
+					hasDepth = true;
+				}
+				else
+				{
+					colorReferences.push_back(reference);
+				}
+
+				pass.attachments.push_back(attachment);
+				pass.clearValues.push_back(access.clearValue);
+				attachmentResources.push_back(access.resource);
+				writesSwapchain |= resource.imported;
+				pass.extent = resource.extent;
+			}
+
+			if (pass.attachments.empty())
+			{
+				ENIGMA_ERROR("Render graph pass " + pass.name + " doesn't write anything");
+				continue;
+			}
+
+			VkSubpassDescription subpass{};
+			subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+			subpass.colorAttachmentCount = static_cast<uint32_t>(colorReferences.size());
+			subpass.pColorAttachments = colorReferences.data();
+			subpass.pDepthStencilAttachment = hasDepth ? &depthReference : nullptr;
+
+			VkRenderPassCreateInfo renderPassInfo{ VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO };
+			renderPassInfo.attachmentCount = static_cast<uint32_t>(pass.attachments.size());
+			renderPassInfo.pAttachments = pass.attachments.data();
+			renderPassInfo.subpassCount = 1;
+			renderPassInfo.pSubpasses = &subpass;
+			renderPassInfo.dependencyCount = 1;
+			renderPassInfo.pDependencies = &dependency;
+
+			ENIGMA_VK_CHECK(vkCreateRenderPass(context.device, &renderPassInfo, nullptr, &pass.renderPass), "Failed to create render pass for " + pass.name);
+
+			// passes drawing to the swapchain need a framebuffer per swapchain image
+			const size_t framebufferCount = writesSwapchain ? m_swapchainViews.size() : 1;
+			pass.framebuffers.resize(framebufferCount, VK_NULL_HANDLE);
+			for (size_t f = 0; f < framebufferCount; f++)
+			{
+				std::vector<VkImageView> views;
+				for (RenderResource r : attachmentResources)
+					views.push_back(m_resources[r].imported ? m_swapchainViews[f] : m_resources[r].view);
+
+				VkFramebufferCreateInfo fbInfo{ VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO };
+				fbInfo.renderPass = pass.renderPass;
+				fbInfo.attachmentCount = static_cast<uint32_t>(views.size());
+				fbInfo.pAttachments = views.data();
+				fbInfo.width = pass.extent.width;
+				fbInfo.height = pass.extent.height;
+				fbInfo.layers = 1;
+
+				ENIGMA_VK_CHECK(vkCreateFramebuffer(context.device, &fbInfo, nullptr, &pass.framebuffers[f]), "Failed to create framebuffer for " + pass.name);
+			}
+		}
+	}
+
+	void RenderGraph::Release()
+	{
+		for (auto& pass : m_passes)
+		{
+			for (auto framebuffer : pass.framebuffers)
+				vkDestroyFramebuffer(context.device, framebuffer, nullptr);
+			pass.framebuffers.clear();
+
+			if (pass.renderPass != VK_NULL_HANDLE)
+				vkDestroyRenderPass(context.device, pass.renderPass, nullptr);
+			pass.renderPass = VK_NULL_HANDLE;
+		}
+
+		for (auto& resource : m_resources)
+		{
+			if (resource.view != VK_NULL_HANDLE)
+				vkDestroyImageView(context.device, resource.view, nullptr);
+			if (resource.image != VK_NULL_HANDLE)
+				vkDestroyImage(context.device, resource.image, nullptr);
+			resource.view = VK_NULL_HANDLE;
+			resource.image = VK_NULL_HANDLE;
+			resource.block = -1;
+		}
+
+		for (auto& block : m_blocks)
+			vmaFreeMemory(context.allocator.allocator, block.allocation);
+		m_blocks.clear();
+	}
+
+	VkFramebuffer RenderGraph::GetFramebuffer(RenderGraphPass pass, uint32_t imageIndex) const
+	{
+		const auto& framebuffers = m_passes[pass].framebuffers;
+		return framebuffers.size() == 1 ? framebuffers[0] : framebuffers[imageIndex];
+	}
+
+	void RenderGraph::Begin(VkCommandBuffer cmd, RenderGraphPass pass, uint32_t imageIndex, VkSubpassContents contents) const
+	{
+		const Pass& graphPass = m_passes[pass];
+
+		VkRenderPassBeginInfo rpBegin{ VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
+		rpBegin.renderPass = graphPass.renderPass;
+		rpBegin.framebuffer = GetFramebuffer(pass, imageIndex);
+		rpBegin.renderArea.offset = { 0, 0 };
+		rpBegin.renderArea.extent = graphPass.extent;
+		rpBegin.clearValueCount = static_cast<uint32_t>(graphPass.clearValues.size());
+		rpBegin.pClearValues = graphPass.clearValues.data();
+
+		vkCmdBeginRenderPass(cmd, &rpBegin, contents);
+	}
+
+	VkImageLayout RenderGraph::GetReadLayout(RenderResource resource) const
+	{
+		return ReadLayout(m_resources[resource].desc.format);
+	}
+
+	std::string RenderGraph::Dump() const
+	{
+		std::ostringstream out;
+		const size_t culled = std::count_if(m_passes.begin(), m_passes.end(), [](const Pass& pass) { return pass.culled; });
+		out << "[ENIGMA RENDER GRAPH]: " << m_passes.size() << " passes, " << culled << " culled\n";
+
+		for (size_t p = 0; p < m_passes.size(); p++)
+		{
+			const Pass& pass = m_passes[p];
+			out << "  [" << p << "] " << pass.name;
+			if (pass.culled)
+			{
+				out << " (culled)\n";
+				continue;
+			}
+			out << " " << pass.extent.width << "x" << pass.extent.height << "\n";
+			out << "      wait " << StageNames(pass.dependency.srcStageMask) << " -> " << StageNames(pass.dependency.dstStageMask) << "\n";
+
+			size_t attachment = 0;
+			for (const auto& access : pass.accesses)
+			{
+				const Resource& resource = m_resources[access.resource];
+				if (!access.write)
+				{
+					out << "      read  " << resource.name << " (" << LayoutName(ReadLayout(resource.desc.format)) << ")\n";
+					continue;
+				}
+				const VkAttachmentDescription& description = pass.attachments[attachment++];
+				out << "      write " << resource.name << " " << LoadOpName(description.loadOp) << "/"
+					<< (description.storeOp == VK_ATTACHMENT_STORE_OP_STORE ? "store" : "dont_care") << " "
+					<< LayoutName(description.initialLayout) << " -> " << LayoutName(description.finalLayout) << "\n";
+			}
+		}
+
+		out << "  memory plan:\n";
+		VkDeviceSize targets = 0;
+		VkDeviceSize allocated = 0;
+		for (const auto& resource : m_resources)
+		{
+			if (resource.imported)
+				continue;
+			out << "    " << std::left << std::setw(16) << resource.name << std::right;
+			if (resource.block == -1)
+			{
+				out << " unused\n";
+				continue;
+			}
+			out << " " << resource.extent.width << "x" << resource.extent.height << " passes " << resource.firstPass << "-" << resource.lastPass
+				<< " block " << resource.block << " " << MiB(resource.size) << "\n";
+			targets += resource.size;
+		}
+		for (size_t b = 0; b < m_blocks.size(); b++)
+		{
+			out << "    block " << b << " " << MiB(m_blocks[b].requirements.size) << ":";
+			for (RenderResource r : m_blocks[b].resources)
+				out << " " << m_resources[r].name;
+			out << "\n";
+			allocated += m_blocks[b].requirements.size;
+		}
+		out << "    " << MiB(allocated) << " allocated for " << MiB(targets) << " of targets, " << MiB(targets - allocated) << " saved by aliasing\n";
+		return out.str();
+	}
+
+	void RenderGraph::WriteGraphviz(const std::string& path) const
+	{
+		std::ofstream file(path);
+		if (!file.is_open())
+		{
+			ENIGMA_ERROR("Failed to open " + path);
+			return;
+		}
+
+		file << "digraph RenderGraph {\n  rankdir=LR;\n";
+		for (size_t r = 0; r < m_resources.size(); r++)
+			file << "  r" << r << " [label=\"" << m_resources[r].name << "\", shape=ellipse];\n";
+
+		for (size_t p = 0; p < m_passes.size(); p++)
+		{
+			const Pass& pass = m_passes[p];
+			file << "  p" << p << " [label=\"" << pass.name << "\", shape=box" << (pass.culled ? ", style=dashed, color=gray" : "") << "];\n";
+			for (const auto& access : pass.accesses)
+			{
+				if (access.write)
+					file << "  p" << p << " -> r" << access.resource << ";\n";
+				else
+					file << "  r" << access.resource << " -> p" << p << ";\n";
+			}
+		}
+		file << "}\n";
+	}
+}
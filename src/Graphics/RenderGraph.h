@@ -0,0 +1,160 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <functional>
+#include <Volk/volk.h>
+#include "Allocator.h"
+#include "VulkanContext.h"
+
+namespace Enigma
+{
+	class JobSystem;
+
+	// Index of a texture declared on a RenderGraph
+	using RenderResource = uint32_t;
+	// Index of a pass added to a RenderGraph
+	using RenderGraphPass = uint32_t;
+
+	struct TextureDesc
+	{
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		// fixed size, leave at 0 to follow the swapchain extent
+		uint32_t width = 0;
+		uint32_t height = 0;
+	};
+
+	// Frame graph for the render passes. Passes declare the textures they render into and the ones they sample and
+	// the graph works out the rest when it is compiled:
+	// - passes whose output nothing uses are culled
+	// - every pass gets one VkRenderPass whose load/store ops, layouts and external dependency come from the
+	//   passes before and after it, so a pass only waits on the stages that actually touched its textures
+	// - targets whose lifetimes don't overlap share memory
+	// Passes run in the order they were added. Targets are transient, their contents aren't kept between frames
+	class RenderGraph
+	{
+	public:
+		class PassBuilder
+		{
+		public:
+			// Render into the texture. When clear is false the previous pass's contents are loaded
+			void Write(RenderResource resource, bool clear, VkClearValue clearValue = {});
+			// Sample the texture in the fragment shader
+			void Read(RenderResource resource);
+			// Keep the pass even if nothing uses what it writes
+			void SideEffect();
+			// Called after every compile, textures and render passes may all have been recreated. Update descriptor
+			// sets and anything sized from the pass extent here. Callbacks of different passes may run at the same
+			// time on the compile's job threads, a pass's own callbacks run in the order they were added
+			void OnCompiled(const std::function<void(const RenderGraph&)>& callback);
+
+		private:
+			friend class RenderGraph;
+			PassBuilder(RenderGraph& graph, RenderGraphPass pass) : graph{ graph }, pass{ pass } {}
+
+			RenderGraph& graph;
+			RenderGraphPass pass;
+		};
+
+		explicit RenderGraph(const VulkanContext& context);
+		~RenderGraph();
+
+		RenderGraph(const RenderGraph&) = delete;
+		RenderGraph& operator=(const RenderGraph&) = delete;
+
+		RenderResource CreateTexture(const std::string& name, const TextureDesc& desc);
+		// The swapchain images, left in finalLayout after the last pass that writes them
+		RenderResource ImportSwapchain(const std::string& name, VkFormat format, VkImageLayout finalLayout);
+		RenderGraphPass AddPass(const std::string& name, const std::function<void(PassBuilder&)>& setup);
+
+		// Creates everything the passes need. Call again whenever the swapchain is recreated, the GPU must be idle
+		// @jobs - runs the passes' OnCompiled callbacks, where they create their pipelines, in parallel if given
+		void Compile(VkExtent2D swapchainExtent, const std::vector<VkImageView>& swapchainViews, JobSystem* jobs = nullptr);
+
+		size_t GetPassCount() const { return m_passes.size(); }
+		const std::string& GetPassName(RenderGraphPass pass) const { return m_passes[pass].name; }
+		bool IsCulled(RenderGraphPass pass) const { return m_passes[pass].culled; }
+		VkRenderPass GetRenderPass(RenderGraphPass pass) const { return m_passes[pass].renderPass; }
+		VkExtent2D GetExtent(RenderGraphPass pass) const { return m_passes[pass].extent; }
+		// @imageIndex - swapchain image being drawn, ignored by passes that don't write the swapchain
+		VkFramebuffer GetFramebuffer(RenderGraphPass pass, uint32_t imageIndex) const;
+		void Begin(VkCommandBuffer cmd, RenderGraphPass pass, uint32_t imageIndex, VkSubpassContents contents) const;
+
+		VkImageView GetImageView(RenderResource resource) const { return m_resources[resource].view; }
+		// Layout the texture is in while later passes sample it
+		VkImageLayout GetReadLayout(RenderResource resource) const;
+
+		// Passes, barriers and the memory plan as text
+		std::string Dump() const;
+		// Passes and textures as a graphviz digraph
+		void WriteGraphviz(const std::string& path) const;
+
+	private:
+		struct Access
+		{
+			RenderResource resource;
+			bool write;
+			bool clear;
+			VkClearValue clearValue;
+		};
+
+		struct Resource
+		{
+			std::string name;
+			TextureDesc desc;
+			bool imported = false;
+			VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+			// filled in by Compile
+			VkImageUsageFlags usage = 0;
+			VkExtent2D extent = {};
+			int firstPass = -1;
+			int lastPass = -1;
+			VkImage image = VK_NULL_HANDLE;
+			VkImageView view = VK_NULL_HANDLE;
+			VkDeviceSize size = 0;
+			int block = -1;
+		};
+
+		struct Pass
+		{
+			std::string name;
+			std::vector<Access> accesses;
+			bool sideEffect = false;
+			std::vector<std::function<void(const RenderGraph&)>> onCompiled;
+
+			// filled in by Compile
+			bool culled = false;
+			VkRenderPass renderPass = VK_NULL_HANDLE;
+			std::vector<VkFramebuffer> framebuffers;
+			VkExtent2D extent = {};
+			std::vector<VkClearValue> clearValues;
+			std::vector<VkAttachmentDescription> attachments;
+			VkSubpassDependency dependency = {};
+		};
+
+		// one allocation shared by every texture placed in it, they are never alive at the same time
+		struct MemoryBlock
+		{
+			VmaAllocation allocation = VK_NULL_HANDLE;
+			VkMemoryRequirements requirements = {};
+			std::vector<RenderResource> resources;
+		};
+
+		void Release();
+		void Cull();
+		void ComputeLifetimes();
+		void AllocateTargets(VkExtent2D swapchainExtent);
+		void BuildRenderPasses();
+		// next pass after the given one that uses the resource, -1 if none
+		int NextUse(RenderResource resource, int after, const Access** access) const;
+
+	private:
+		const VulkanContext& context;
+		std::vector<Resource> m_resources;
+		std::vector<Pass> m_passes;
+		std::vector<MemoryBlock> m_blocks;
+		std::vector<VkImageView> m_swapchainViews;
+	};
+}
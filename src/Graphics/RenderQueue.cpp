@@ -0,0 +1,258 @@
+#include "RenderQueue.h"
+#include "InstanceBuffer.h"
+#include "Common.h"
+#include <cstring>
+#include <algorithm>
+
+namespace Enigma
+{
+	namespace
+	{
+		// pipeline | descriptor set | material | mesh | depth, the highest bits change the most expensive state.
+		// The mesh comes before the depth so the packets an instanced draw can merge are next to each other
+		constexpr uint32_t pipelineShift = 56;
+		constexpr uint32_t setShift = 44;
+		constexpr uint32_t materialShift = 28;
+		constexpr uint32_t geometryShift = 16;
+		constexpr uint64_t pipelineMask = 0xFF;
+		constexpr uint64_t setMask = 0xFFF;
+		constexpr uint64_t materialMask = 0xFFFF;
+		constexpr uint64_t geometryMask = 0xFFF;
+
+		// the bits of a positive float sort like the float, the top 16 still order meshes of the same kind front to back
+		uint64_t DepthBits(float depth)
+		{
+			uint32_t bits = 0;
+			std::memcpy(&bits, &depth, sizeof(bits));
+			return bits >> 16;
+		}
+	}
+
+	RenderQueueCounters::Values RenderQueueCounters::Take()
+	{
+		Values values;
+		values.draws = draws.exchange(0);
+		values.pipelineBinds = pipelineBinds.exchange(0);
+		values.descriptorSetBinds = descriptorSetBinds.exchange(0);
+		values.skippedBinds = skippedBinds.exchange(0);
+		values.instancedDraws = instancedDraws.exchange(0);
+		values.instances = instances.exchange(0);
+		return values;
+	}
+
+	void RenderQueue::Begin(const glm::vec3& eye)
+	{
+		m_eye = eye;
+		m_packets.clear();
+		m_entries.clear();
+		m_pipelines.clear();
+		m_sets.clear();
+		m_geometries.clear();
+		m_instancing = false;
+	}
+
+	void RenderQueue::Instance(const RenderState& single, RenderState instanced)
+	{
+		instanced.set = Enigma::instanceBuffer->GetDescriptorSet();
+		m_single = single;
+		m_instanced = instanced;
+		m_instancing = true;
+	}
+
+	void RenderQueue::Push(const RenderState& state, const GeometryAllocation& geometry, const ModelPushConstant& push, const glm::vec3& bounds)
+	{
+		if (!geometry.IsValid())
+			return;
+
+		const uint64_t material = static_cast<uint32_t>(push.materialID);
+		const uint64_t key = (uint64_t(PipelineID(state.pipeline)) & pipelineMask) << pipelineShift
+			| (uint64_t(SetID(state.set)) & setMask) << setShift
+			| (material & materialMask) << materialShift
+			| (uint64_t(GeometryID(geometry)) & geometryMask) << geometryShift
+			| DepthBits(glm::length(bounds - m_eye));
+
+		m_entries.push_back({ key, static_cast<uint32_t>(m_packets.size()) });
+		m_packets.push_back({ state, geometry, push });
+	}
+
+	void RenderQueue::Submit(VkCommandBuffer cmd)
+	{
+		if (m_packets.empty())
+			return;
+
+		RadixSort();
+		Enigma::geometryArena->Bind(cmd);
+
+		m_boundPipeline = VK_NULL_HANDLE;
+		m_boundLayout = VK_NULL_HANDLE;
+		m_boundSet = VK_NULL_HANDLE;
+		m_pipelineBinds = 0;
+		m_setBinds = 0;
+		m_skippedBinds = 0;
+
+		uint32_t draws = 0;
+		uint32_t instancedDraws = 0;
+		uint32_t instances = 0;
+
+		for (size_t i = 0; i < m_entries.size();)
+		{
+			const uint32_t count = CountInstances(i);
+			if (count > 1 && DrawInstanced(cmd, i, count))
+			{
+				i += count;
+				draws++;
+				instancedDraws++;
+				instances += count;
+				continue;
+			}
+
+			const Packet& packet = m_packets[m_entries[i].packet];
+			Bind(cmd, packet.state);
+			vkCmdPushConstants(cmd, m_boundLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(ModelPushConstant), &packet.push);
+			vkCmdDrawIndexed(cmd, packet.geometry.indexCount, 1, packet.geometry.firstIndex, static_cast<int32_t>(packet.geometry.firstVertex), 0);
+			i++;
+			draws++;
+		}
+
+		Enigma::renderQueueCounters.draws += draws;
+		Enigma::renderQueueCounters.pipelineBinds += m_pipelineBinds;
+		Enigma::renderQueueCounters.descriptorSetBinds += m_setBinds;
+		Enigma::renderQueueCounters.skippedBinds += m_skippedBinds;
+		Enigma::renderQueueCounters.instancedDraws += instancedDraws;
+		Enigma::renderQueueCounters.instances += instances;
+	}
+
+	uint32_t RenderQueue::CountInstances(size_t first) const
+	{
+		const Packet& packet = m_packets[m_entries[first].packet];
+		if (!m_instancing || packet.state.pipeline != m_single.pipeline || packet.state.set != VK_NULL_HANDLE)
+			return 1;
+
+		// everything but the model matrix has to match, the instanced draw pushes the first packet's constants
+		uint32_t count = 1;
+		for (size_t i = first + 1; i < m_entries.size(); i++, count++)
+		{
+			const Packet& other = m_packets[m_entries[i].packet];
+			if (other.state.pipeline != packet.state.pipeline || other.state.set != VK_NULL_HANDLE
+				|| other.geometry.firstIndex != packet.geometry.firstIndex || other.geometry.firstVertex != packet.geometry.firstVertex
+				|| other.push.materialID != packet.push.materialID || other.push.isTextured != packet.push.isTextured)
+				break;
+		}
+		return count;
+	}
+
+	bool RenderQueue::DrawInstanced(VkCommandBuffer cmd, size_t first, uint32_t count)
+	{
+		const uint32_t firstInstance = Enigma::instanceBuffer->Allocate(count);
+		if (firstInstance == InstanceBuffer::invalidOffset)
+			return false;
+
+		glm::mat4* instances = Enigma::instanceBuffer->GetInstances() + firstInstance;
+		for (uint32_t i = 0; i < count; i++)
+			instances[i] = m_packets[m_entries[first + i].packet].push.model;
+
+		const Packet& packet = m_packets[m_entries[first].packet];
+		Bind(cmd, m_instanced);
+		vkCmdPushConstants(cmd, m_boundLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(ModelPushConstant), &packet.push);
+		// gl_InstanceIndex starts at firstInstance, the shader reads the matrices straight from the buffer
+		vkCmdDrawIndexed(cmd, packet.geometry.indexCount, count, packet.geometry.firstIndex, static_cast<int32_t>(packet.geometry.firstVertex), firstInstance);
+		return true;
+	}
+
+	void RenderQueue::Bind(VkCommandBuffer cmd, const RenderState& state)
+	{
+		if (state.pipeline != m_boundPipeline)
+		{
+			vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, state.pipeline);
+			m_boundPipeline = state.pipeline;
+			m_pipelineBinds++;
+		}
+		else
+		{
+			m_skippedBinds++;
+		}
+
+		// a set bound through another layout may not be compatible, bind it again after a layout change
+		if (state.layout != m_boundLayout)
+		{
+			m_boundLayout = state.layout;
+			m_boundSet = VK_NULL_HANDLE;
+		}
+
+		if (state.set == VK_NULL_HANDLE)
+			return;
+
+		if (state.set != m_boundSet || state.dynamicOffset != m_boundOffset)
+		{
+			vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_boundLayout, state.setIndex, 1, &state.set, state.dynamicOffsetCount, &state.dynamicOffset);
+			m_boundSet = state.set;
+			m_boundOffset = state.dynamicOffset;
+			m_setBinds++;
+		}
+		else
+		{
+			m_skippedBinds++;
+		}
+	}
+
+	uint32_t RenderQueue::PipelineID(VkPipeline pipeline)
+	{
+		const auto found = std::find(m_pipelines.begin(), m_pipelines.end(), pipeline);
+		if (found != m_pipelines.end())
+			return static_cast<uint32_t>(found - m_pipelines.begin());
+		m_pipelines.push_back(pipeline);
+		return static_cast<uint32_t>(m_pipelines.size() - 1);
+	}
+
+	uint32_t RenderQueue::SetID(VkDescriptorSet set)
+	{
+		// packets without a set of their own come first
+		if (set == VK_NULL_HANDLE)
+			return 0;
+
+		const auto found = std::find(m_sets.begin(), m_sets.end(), set);
+		if (found != m_sets.end())
+			return static_cast<uint32_t>(found - m_sets.begin()) + 1;
+		m_sets.push_back(set);
+		return static_cast<uint32_t>(m_sets.size());
+	}
+
+	uint32_t RenderQueue::GeometryID(const GeometryAllocation& geometry)
+	{
+		// ranges in the arena don't overlap, the first index alone tells meshes apart
+		const auto found = m_geometries.find(geometry.firstIndex);
+		if (found != m_geometries.end())
+			return found->second;
+		const uint32_t id = static_cast<uint32_t>(m_geometries.size());
+		m_geometries.emplace(geometry.firstIndex, id);
+		return id;
+	}
+
+	void RenderQueue::RadixSort()
+	{
+		// least significant byte first, each pass is stable so the earlier bytes stay in order
+		m_scratch.resize(m_entries.size());
+		for (uint32_t shift = 0; shift < 64; shift += 8)
+		{
+			uint32_t offsets[256] = {};
+			for (const auto& entry : m_entries)
+				offsets[(entry.key >> shift) & 0xFF]++;
+
+			// every key has the same byte here, the pass wouldn't move anything
+			if (offsets[(m_entries[0].key >> shift) & 0xFF] == m_entries.size())
+				continue;
+
+			uint32_t total = 0;
+			for (auto& offset : offsets)
+			{
+				const uint32_t count = offset;
+				offset = total;
+				total += count;
+			}
+
+			for (const auto& entry : m_entries)
+				m_scratch[offsets[(entry.key >> shift) & 0xFF]++] = entry;
+			m_entries.swap(m_scratch);
+		}
+	}
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include <Volk/volk.h>
+#include <glm/glm.hpp>
+#include "GeometryArena.h"
+#include "Model.h"
+
+namespace Enigma
+{
+	// Pipeline a packet is drawn with, the sets below setIndex are bound by the pass before the queue is submitted
+	struct RenderState
+	{
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		VkPipelineLayout layout = VK_NULL_HANDLE;
+		// per draw set such as a skinned model's bones, VK_NULL_HANDLE if the pipeline has none
+		VkDescriptorSet set = VK_NULL_HANDLE;
+		uint32_t setIndex = 2;
+		// the set's offset in the uniform ring if it has a dynamic binding, such as a bone palette
+		uint32_t dynamicOffsetCount = 0;
+		uint32_t dynamicOffset = 0;
+	};
+
+	// Binds and draws of every queue submitted since the last Take, queues are submitted from several threads
+	struct RenderQueueCounters
+	{
+		struct Values
+		{
+			uint32_t draws = 0;
+			uint32_t pipelineBinds = 0;
+			uint32_t descriptorSetBinds = 0;
+			// binds a draw needed that were already in place
+			uint32_t skippedBinds = 0;
+			// draws of more than one instance and the instances they drew
+			uint32_t instancedDraws = 0;
+			uint32_t instances = 0;
+		};
+
+		std::atomic<uint32_t> draws = 0;
+		std::atomic<uint32_t> pipelineBinds = 0;
+		std::atomic<uint32_t> descriptorSetBinds = 0;
+		std::atomic<uint32_t> skippedBinds = 0;
+		std::atomic<uint32_t> instancedDraws = 0;
+		std::atomic<uint32_t> instances = 0;
+
+		// Returns the counts and starts again from zero
+		Values Take();
+	};
+
+	inline RenderQueueCounters renderQueueCounters;
+
+	// Draws of one command buffer, collected in whatever order the pass walks its models and submitted sorted by
+	// pipeline, then descriptor set, then material, then mesh, then front to back. Binds are only recorded when the
+	// state actually changes. Every packet draws from the geometry arena, it is bound once per submit.
+	// With instancing set up, packets of the same mesh and material end up next to each other and are drawn with
+	// one instanced draw, their model matrices go to Enigma::instanceBuffer instead of the push constant
+	class RenderQueue
+	{
+	public:
+		// Drops the packets of the last submit and turns instancing off, the memory is kept
+		// @eye - packets are sorted front to back from here
+		void Begin(const glm::vec3& eye);
+
+		// Packets pushed with @single that draw the same mesh more than once are drawn with @instanced instead. Its
+		// layout takes the instance buffer's set at @instanced.setIndex, the set is filled in here
+		void Instance(const RenderState& single, RenderState instanced);
+
+		// @bounds - world space point the packet's depth is measured to
+		void Push(const RenderState& state, const GeometryAllocation& geometry, const ModelPushConstant& push, const glm::vec3& bounds);
+
+		// Sorts the packets and records them
+		void Submit(VkCommandBuffer cmd);
+
+		size_t GetPacketCount() const { return m_packets.size(); }
+
+	private:
+		struct Packet
+		{
+			RenderState state;
+			GeometryAllocation geometry;
+			ModelPushConstant push;
+		};
+
+		struct SortEntry
+		{
+			uint64_t key;
+			uint32_t packet;
+		};
+
+		// small IDs for the key, a queue only ever sees a handful of pipelines and sets
+		uint32_t PipelineID(VkPipeline pipeline);
+		uint32_t SetID(VkDescriptorSet set);
+		uint32_t GeometryID(const GeometryAllocation& geometry);
+		void RadixSort();
+		// Packets [first, first + count) of m_entries as one instanced draw, false if the instance buffer is full
+		bool DrawInstanced(VkCommandBuffer cmd, size_t first, uint32_t count);
+		// Number of packets from m_entries[first] on that can share an instanced draw with it
+		uint32_t CountInstances(size_t first) const;
+		// Records the binds @state needs that aren't already in place
+		void Bind(VkCommandBuffer cmd, const RenderState& state);
+
+	private:
+		glm::vec3 m_eye = glm::vec3(0.0f);
+		std::vector<Packet> m_packets;
+		std::vector<SortEntry> m_entries;
+		std::vector<SortEntry> m_scratch;
+		std::vector<VkPipeline> m_pipelines;
+		std::vector<VkDescriptorSet> m_sets;
+		std::unordered_map<uint32_t, uint32_t> m_geometries;
+
+		bool m_instancing = false;
+		RenderState m_single;
+		RenderState m_instanced;
+
+		// what is bound while a submit records, and how often it had to be
+		VkPipeline m_boundPipeline = VK_NULL_HANDLE;
+		VkPipelineLayout m_boundLayout = VK_NULL_HANDLE;
+		VkDescriptorSet m_boundSet = VK_NULL_HANDLE;
+		uint32_t m_boundOffset = 0;
+		uint32_t m_pipelineBinds = 0;
+		uint32_t m_setBinds = 0;
+		uint32_t m_skippedBinds = 0;
+	};
+}
@@ -1,10 +1,21 @@
 #include "Renderer.h"
 #include "Player.h"
+#include "TextureCache.h"
+#include "InstanceBuffer.h"
+#include "UniformRing.h"
+#include "MeshAssetCache.h"
+#include "../Core/Profiler.h"
 #include <fstream>
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_vulkan.h>
 #include <cmath>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <iostream>
+#if defined(_WIN32)
 #include <corecrt_math_defines.h>
+#endif
 #include "../Core/Settings.h"
 #include <imgui/imgui_impl_vulkan.h>
 
@@ -24,25 +35,108 @@ namespace Tweakables
 
 namespace Enigma
 {
-	Renderer::Renderer(const VulkanContext& context, VulkanWindow& window, Camera* camera) : context{ context }, window{ window }, camera{ camera } 
+	namespace
+	{
+		// below this many models a chunk costs more to hand to another thread than to record
+		constexpr size_t minDrawsPerChunk = 16;
+
+		unsigned RecordThreadCount()
+		{
+			return std::max(std::thread::hardware_concurrency(), 1u);
+		}
+
+#if defined(ENIGMA_PROFILING)
+		// Tree nodes for the zones in [first, last) of one thread at @depth and their children, which follow
+		// straight after them. Returns the first zone it didn't cover
+		size_t DrawZoneTree(const std::vector<Profiler::Event>& events, size_t first, size_t last, uint16_t depth)
+		{
+			size_t i = first;
+			while (i < last && events[i].depth >= depth)
+			{
+				const Profiler::Event& event = events[i];
+				// counters, and zones whose parent ends in a later frame
+				if (event.counter || event.depth > depth)
+				{
+					i++;
+					continue;
+				}
+
+				size_t next = i + 1;
+				const bool leaf = next == last || events[next].depth <= depth;
+				const float milliseconds = static_cast<float>(event.end - event.start) / 1000000.0f;
+				if (ImGui::TreeNodeEx(reinterpret_cast<void*>(i), leaf ? ImGuiTreeNodeFlags_Leaf : 0, "%s: %.3f ms", event.name, milliseconds))
+				{
+					next = DrawZoneTree(events, next, last, depth + 1);
+					ImGui::TreePop();
+				}
+				else
+				{
+					while (next < last && events[next].depth > depth)
+						next++;
+				}
+				i = next;
+			}
+			return i;
+		}
+#endif
+	}
+
+	Renderer::Renderer(const VulkanContext& context, VulkanWindow& window, Camera* camera) : context{ context }, window{ window }, m_pipelineCache{ context, "pipeline_cache.bin" }, m_graph{ context }, m_recorder{ context, RecordThreadCount() }, camera{ camera } 
 	{	
+		const auto startTime = std::chrono::steady_clock::now();
+		Enigma::pipelineCache = m_pipelineCache.GetHandle();
+
 		CreateRendererResources();		
+		m_recordJobs.Start(RecordThreadCount() - 1);
 
         // Set = 2
 		{
 			std::vector<VkDescriptorSetLayoutBinding> bindings = {
-				CreateDescriptorBinding(0, 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT)
+				CreateDescriptorBinding(0, 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT)
 			};
 
 			Enigma::boneTransformDescriptorLayout= CreateDescriptorSetLayout(context, bindings);
 		}
 
-		m_shadowPass = new ShadowPass(context, window);
-		m_gBufferPass = new GBuffer(context, window, gBufferTargets);
-		m_lightingPass = new Lighting(context, window, gBufferTargets, m_shadowPass->GetRenderTarget());
-		m_compositePass = new Composite(context, window, m_lightingPass->GetRenderTarget());
-		m_uiPass = new UIPass(context, window);
-		ImGuiRenderer::Initialize(context, window);
+		// targets without a size follow the swapchain
+		const RenderResource shadowMap = m_graph.CreateTexture("shadow_map", { VK_FORMAT_D32_SFLOAT, 2048, 2048 });
+		gBufferTargets.position = m_graph.CreateTexture("gbuffer_position", { VK_FORMAT_R32G32B32A32_SFLOAT });
+		gBufferTargets.normals = m_graph.CreateTexture("gbuffer_normals", { VK_FORMAT_R32G32B32A32_SFLOAT });
+		gBufferTargets.albedo = m_graph.CreateTexture("gbuffer_albedo", { VK_FORMAT_R32G32B32A32_SFLOAT });
+		gBufferTargets.depth = m_graph.CreateTexture("gbuffer_depth", { VK_FORMAT_D32_SFLOAT });
+		const RenderResource lighting = m_graph.CreateTexture("lighting", { VK_FORMAT_R32G32B32A32_SFLOAT });
+		// ImGui draws after the graph and expects the image ready to present, headless it is copied out instead
+		const RenderResource swapchain = m_graph.ImportSwapchain("swapchain", window.swapchainFormat, window.presentLayout);
+
+		// models are loaded after the renderer, their meshes go straight into the arena and their textures into the cache
+		Enigma::geometryArena = new GeometryArena(context);
+		Enigma::textureCache = new TextureCache(context);
+		Enigma::instanceBuffer = new InstanceBuffer(context);
+		// the passes and skinned models point their uniform descriptors at the ring when they are created
+		Enigma::uniformRing = new UniformRing(context);
+		m_gpuScene = new GPUScene(context, *Enigma::geometryArena);
+		m_gpuProfiler = new GPUProfiler(context);
+
+		// passes run in the order they are added
+		m_shadowPass = new ShadowPass(context, window, m_graph, shadowMap, *m_gpuScene);
+		m_gBufferPass = new GBuffer(context, m_graph, gBufferTargets, *m_gpuScene);
+		m_decalPass = new DecalPass(context, m_graph, gBufferTargets, VK_FORMAT_R32G32B32A32_SFLOAT);
+		m_lightingPass = new Lighting(context, window, m_graph, gBufferTargets, shadowMap, lighting);
+		m_compositePass = new Composite(context, window, m_graph, lighting, swapchain);
+		m_uiPass = new UIPass(context, window, m_graph, swapchain);
+		// the passes create their pipelines on the record threads while the graph compiles
+		const auto compileTime = std::chrono::steady_clock::now();
+		m_graph.Compile(window.swapchainExtent, window.swapchainImageViews, &m_recordJobs);
+		const auto compiledTime = std::chrono::steady_clock::now();
+		m_gpuScene->SetDepth(m_graph.GetImageView(gBufferTargets.depth), m_graph.GetReadLayout(gBufferTargets.depth), m_graph.GetExtent(m_gBufferPass->GetPass()));
+		// headless has no window for ImGui to draw into or take input from
+		if (!window.headless)
+			ImGuiRenderer::Initialize(context, window);
+
+		const auto milliseconds = [](auto duration) { return std::chrono::duration<double, std::milli>(duration).count(); };
+		std::cout << "[ENIGMA]: " << (m_pipelineCache.IsWarm() ? "Warm" : "Cold") << " start, pass pipelines created in "
+			<< milliseconds(compiledTime - compileTime) << " ms on " << m_recordJobs.GetThreadCount() << " threads, renderer ready in "
+			<< milliseconds(std::chrono::steady_clock::now() - startTime) << " ms" << std::endl;
 
 		// m_pipeline = CreateGraphicsPipeline("../resources/Shaders/vertex.vert.spv", "../resources/Shaders/fragment.frag.spv", VK_FALSE, VK_TRUE, VK_TRUE, { Enigma::sceneDescriptorLayout, Enigma::descriptorLayoutModel }, m_pipelinePipelineLayout, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
 		//m_aabbPipeline = CreateGraphicsPipeline("../resources/Shaders/vertex.vert.spv", "../resources/Shaders/line.frag.spv", VK_FALSE, VK_TRUE, VK_TRUE, { Enigma::sceneDescriptorLayout, Enigma::descriptorLayoutModel }, m_pipelinePipelineLayout, VK_PRIMITIVE_TOPOLOGY_LINE_STRIP);
@@ -53,19 +147,35 @@ namespace Enigma
 		// Ensure all commands have finished and the GPU is now idle
 		vkDeviceWaitIdle(context.device);
 
+		// the next run starts warm with everything this one compiled
+		m_pipelineCache.Save();
+
 		delete m_shadowPass;
 		delete m_lightingPass;
+		delete m_decalPass;
 		delete m_gBufferPass;
 		delete m_compositePass;
         delete m_uiPass;
+		delete m_gpuScene;
+		delete m_gpuProfiler;
 
-		ImGuiRenderer::Shutdown(context);
+		if (!window.headless)
+			ImGuiRenderer::Shutdown(context);
 
 		for (auto& model : Enigma::WorldInst.Meshes)
 		{
 			delete model;
 		}
 
+		delete Enigma::geometryArena;
+		Enigma::geometryArena = nullptr;
+		delete Enigma::textureCache;
+		Enigma::textureCache = nullptr;
+		delete Enigma::instanceBuffer;
+		Enigma::instanceBuffer = nullptr;
+		delete Enigma::uniformRing;
+		Enigma::uniformRing = nullptr;
+
 		// destroy the command buffers
 		for (size_t i = 0; i < Enigma::MAX_FRAMES_IN_FLIGHT; i++)
 		{
@@ -74,7 +184,6 @@ namespace Enigma
 
 		vkDestroySampler(context.device, Enigma::defaultSampler, nullptr);
 		vkDestroySampler(context.device, Enigma::repeatSampler, nullptr);
-		vkDestroyDescriptorSetLayout(context.device, Enigma::descriptorLayoutModel, nullptr); // this one is not being destroyed for some reason 
         vkDestroyDescriptorSetLayout(context.device, Enigma::boneTransformDescriptorLayout, nullptr);
 		vkDestroyDescriptorPool(context.device, Enigma::descriptorPool, nullptr);
 	}
@@ -87,8 +196,15 @@ namespace Enigma
 		samplerPoolSize.descriptorCount = 512;
 		VkDescriptorPoolSize storagePoolSize{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER };
 		storagePoolSize.descriptorCount = 512;
+		VkDescriptorPoolSize storageImagePoolSize{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE };
+		storageImagePoolSize.descriptorCount = 32;
+		// bindings into the uniform ring, one per skinned model besides the passes
+		VkDescriptorPoolSize dynamicBufferPoolSize{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC };
+		dynamicBufferPoolSize.descriptorCount = 512;
+		VkDescriptorPoolSize dynamicStoragePoolSize{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC };
+		dynamicStoragePoolSize.descriptorCount = 32;
 
-		std::vector<VkDescriptorPoolSize> poolSize = { bufferPoolSize, samplerPoolSize, storagePoolSize };
+		std::vector<VkDescriptorPoolSize> poolSize = { bufferPoolSize, samplerPoolSize, storagePoolSize, storageImagePoolSize, dynamicBufferPoolSize, dynamicStoragePoolSize };
 
 		VkDescriptorPoolCreateInfo info{ VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
 		info.poolSizeCount = static_cast<uint32_t>(poolSize.size());
@@ -148,7 +264,7 @@ namespace Enigma
 	}
 
 	// This will handle the settings shown in ImGui
-	void Renderer::UpdateImGui()
+	void Renderer::UpdateImGui(const FrameSnapshot& snapshot)
 	{	
 		if (Enigma::isDebug)
 		{
@@ -235,6 +351,134 @@ namespace Enigma
 				{
 					debugSettings.debugRenderTarget = Tweakables::DebugDisplayRenderTarget;
 				}
+
+				const char* shadowFilters[2] = { "Hard", "PCF" };
+				ImGui::Combo("Shadow Filter", &Enigma::shadowFilter, shadowFilters, 2);
+				ImGui::Checkbox("Reflections", &Enigma::screenSpaceReflections);
+				ImGui::Text("Lighting permutations: %d", static_cast<int>(m_lightingPass->GetPermutationCount()));
+			}
+
+			if (ImGui::CollapsingHeader("Render Graph"))
+			{
+				ImGui::Text("Passes: %d", static_cast<int>(m_graph.GetPassCount()));
+				if (ImGui::Button("Dump"))
+				{
+					std::cout << m_graph.Dump();
+					m_graph.WriteGraphviz("render_graph.dot");
+				}
+			}
+
+			if (ImGui::CollapsingHeader("GPU Driven"))
+			{
+				if (context.gpuDrivenSupported)
+				{
+					ImGui::Checkbox("Enabled", &Enigma::gpuDrivenRendering);
+					ImGui::Checkbox("Occlusion Culling", &Enigma::occlusionCulling);
+					ImGui::Text("Draws: %d, Instances: %d", static_cast<int>(m_gpuScene->GetDrawCount()), static_cast<int>(m_gpuScene->GetInstanceCount()));
+				}
+				else
+				{
+					ImGui::Text("Not supported by this device");
+				}
+				ImGui::Checkbox("Draw AABBs", &Enigma::drawAABBs);
+			}
+
+			if (ImGui::CollapsingHeader("Geometry"))
+			{
+				const GeometryArena& geometry = *Enigma::geometryArena;
+				ImGui::Text("Vertices: %u / %u", geometry.GetVerticesUsed(), geometry.GetVertexCapacity());
+				ImGui::Text("Indices: %u / %u", geometry.GetIndicesUsed(), geometry.GetIndexCapacity());
+				ImGui::Text("Allocations: %d, Free ranges: %d", static_cast<int>(geometry.GetAllocationCount()), static_cast<int>(geometry.GetFreeRangeCount()));
+				ImGui::Text("Mesh assets: %d, Models sharing one: %llu", static_cast<int>(Enigma::meshAssets.GetAssetCount()), static_cast<unsigned long long>(Enigma::meshAssets.GetSharedCount()));
+			}
+
+			if (ImGui::CollapsingHeader("Render Queue"))
+			{
+				ImGui::Text("Draws: %u", m_queueCounters.draws);
+				ImGui::Text("Pipeline binds: %u, Descriptor set binds: %u", m_queueCounters.pipelineBinds, m_queueCounters.descriptorSetBinds);
+				ImGui::Text("Redundant binds skipped: %u", m_queueCounters.skippedBinds);
+				ImGui::Text("Instanced draws: %u, Instances: %u", m_queueCounters.instancedDraws, m_queueCounters.instances);
+				ImGui::Text("Instance buffer: %u / %u", Enigma::instanceBuffer->GetUsed(), Enigma::instanceBuffer->GetCapacity());
+				ImGui::Text("Uniform ring: %u / %u bytes", m_uniformRingUsed, Enigma::uniformRing->GetCapacity());
+			}
+
+			if (ImGui::CollapsingHeader("GPU Profiler"))
+			{
+				if (m_gpuProfiler->IsSupported())
+				{
+					ImGui::Text("GPU frame: %.3f ms", m_gpuProfiler->GetFrameMilliseconds());
+					for (const auto& scope : m_gpuProfiler->GetScopes())
+					{
+						if (scope.samples.empty())
+							continue;
+
+						const GPUProfiler::Sample& latest = scope.GetLatest();
+						ImGui::Text("%s: %.3f ms, average %.3f ms", scope.name.c_str(), latest.milliseconds, scope.GetAverage());
+						if (m_gpuProfiler->HasPipelineStatistics())
+							ImGui::Text("  Primitives: %llu, Fragments: %llu", static_cast<unsigned long long>(latest.primitives), static_cast<unsigned long long>(latest.fragmentInvocations));
+
+						// the ring starts at next once it is full, ImGui wraps the offset around
+						const auto milliseconds = [](void* data, int i) { return static_cast<const GPUProfiler::Scope*>(data)->samples[i].milliseconds; };
+						const int offset = scope.samples.size() < GPUProfiler::historyLength ? 0 : static_cast<int>(scope.next);
+						ImGui::PlotLines(("##" + scope.name).c_str(), milliseconds, const_cast<GPUProfiler::Scope*>(&scope), static_cast<int>(scope.samples.size()), offset, nullptr, 0.0f, FLT_MAX, ImVec2(0.0f, 40.0f));
+					}
+
+					if (ImGui::Button("Export CSV"))
+						m_gpuProfiler->WriteCSV("gpu_profile.csv");
+				}
+				else
+				{
+					ImGui::Text("Not supported by this device");
+				}
+			}
+
+#if defined(ENIGMA_PROFILING)
+			if (ImGui::CollapsingHeader("CPU Profiler"))
+			{
+				const Profiler::Frame& frame = Profiler::GetLastFrame();
+				ImGui::Text("Frame %llu: %.3f ms", static_cast<unsigned long long>(frame.index), static_cast<float>(frame.end - frame.start) / 1000000.0f);
+				ImGui::Text("Dropped events: %llu", static_cast<unsigned long long>(Profiler::GetDroppedCount()));
+
+				// the events are sorted by thread, one tree per thread
+				for (size_t first = 0; first < frame.events.size();)
+				{
+					const uint32_t thread = frame.events[first].thread;
+					size_t last = first;
+					while (last < frame.events.size() && frame.events[last].thread == thread)
+						last++;
+
+					ImGui::PushID(static_cast<int>(thread));
+					if (ImGui::TreeNode("thread", "%s %u", Profiler::GetThreadName(thread), thread))
+					{
+						DrawZoneTree(frame.events, first, last, 0);
+
+						for (size_t i = first; i < last; i++)
+						{
+							if (frame.events[i].counter)
+								ImGui::Text("%s: %.0f", frame.events[i].name, frame.events[i].value);
+						}
+						ImGui::TreePop();
+					}
+					ImGui::PopID();
+					first = last;
+				}
+
+				if (ImGui::Button("Write Trace"))
+					Profiler::WriteChromeTrace("cpu_trace.json");
+			}
+#endif
+
+			if (ImGui::CollapsingHeader("Decals"))
+			{
+				ImGui::Checkbox("Draw Decals", &Enigma::drawDecals);
+				ImGui::Text("Decals: %u / %u", m_decalPass->GetCount(), DecalPass::maxDecals);
+			}
+
+			if (ImGui::CollapsingHeader("Textures"))
+			{
+				const TextureCache& textures = *Enigma::textureCache;
+				ImGui::Text("Textures: %d / %u", static_cast<int>(textures.GetTextureCount()), textures.GetTextureCapacity());
+				ImGui::Text("Materials: %d", static_cast<int>(textures.GetMaterialCount()));
 			}
 
 			if (ImGui::CollapsingHeader("SSR"))
@@ -274,20 +518,41 @@ namespace Enigma
 						m++;
 					}*/
 							
-					auto current_position = model->getTranslation();
-					auto current_scale = model->getScale();
+					// models the simulation moves are only read through the snapshot and edited on its thread
+					const bool simulated = model->snapshotIndex >= 0;
+					glm::vec3 current_position = model->getTranslation();
+					glm::vec3 current_scale = model->getScale();
+					if (simulated)
+					{
+						const glm::mat4& transform = snapshot.Get(model).current;
+						current_position = glm::vec3(transform[3]);
+						current_scale = glm::vec3(glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2])));
+					}
 					float* pos[3] = { &current_position.x, &current_position.y, &current_position.z};
 					float* scale[3] = { &current_scale.x, &current_scale.y, &current_scale.z };
 					
+					World::ModelEdit edit{ model };
 					if (ImGui::SliderFloat3("Transform: ", *pos, 0.0f, 20.0f))
 					{
 						std::cout << "Recalculating AABB" << std::endl;
+						edit.translation = current_position;
 					}
 
-					ImGui::SliderFloat3("Scale: ", *scale, 0.f, 10.0);
+					if (ImGui::SliderFloat3("Scale: ", *scale, 0.f, 10.0))
+						edit.scale = current_scale;
 
-					model->setScale(current_scale);
-					model->setTranslation(current_position);
+					if (simulated)
+					{
+						if (edit.translation || edit.scale)
+							Enigma::WorldInst.editModel(edit);
+					}
+					else
+					{
+						if (edit.translation)
+							model->setTranslation(current_position);
+						if (edit.scale)
+							model->setScale(current_scale);
+					}
 				}
 				ImGui::PopID();
 				n++;
@@ -296,11 +561,10 @@ namespace Enigma
 
 			if (ImGui::CollapsingHeader("Player"))
 			{
-				auto player_pos = Enigma::WorldInst.player->GetPosition();
+				glm::vec3 player_pos = snapshot.playerPosition;
 				float* pos[3] = { &player_pos.x, &player_pos.y, &player_pos.z };
-				ImGui::SliderFloat3("Transform: ", *pos, -20.0f, 20.0f);
-
-				Enigma::WorldInst.player->SetPosition(player_pos);
+				if (ImGui::SliderFloat3("Transform: ", *pos, -20.0f, 20.0f))
+					Enigma::WorldInst.editPlayerPosition(player_pos);
 
 				float fov = 45.0f;
 				ImGui::SliderFloat("FOV: ", &fov, 45.0f, 90.0f);
@@ -451,95 +715,259 @@ namespace Enigma
 		pipelineInfo.subpass = 0;
 
 		VkPipeline pipeline = VK_NULL_HANDLE;
-		ENIGMA_VK_CHECK(vkCreateGraphicsPipelines(context.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline), "Failed to create graphics pipeline.");
+		ENIGMA_VK_CHECK(vkCreateGraphicsPipelines(context.device, Enigma::pipelineCache, 1, &pipelineInfo, nullptr, &pipeline), "Failed to create graphics pipeline.");
 
 		return Pipeline(context.device, pipeline);
 	}
 
-	void Renderer::Update(Camera* cam)
+	void Renderer::Update(Camera* cam, const FrameSnapshot& snapshot)
 	{
-		ImGui_ImplVulkan_NewFrame();
-		ImGui_ImplGlfw_NewFrame();
-		ImGui::NewFrame();
+		ENIGMA_PROFILE_ZONE("Renderer::Update");
 
-		if (Enigma::isDebug && !Enigma::enablePlayerCamera)
+		// the passes push this frame's uniforms below, the GPU has to be done with the frame's part of the ring.
+		// DrawScene waits on the same fence again before resetting it, by then it has signalled
 		{
-			glfwSetInputMode(window.window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
+			ENIGMA_PROFILE_ZONE("vkWaitForFences");
+			vkWaitForFences(context.device, 1, &m_fences[Enigma::currentFrame].handle, VK_TRUE, UINT64_MAX);
 		}
-		else
+		m_uniformRingUsed = Enigma::uniformRing->GetUsed();
+		Enigma::uniformRing->BeginFrame();
+
+		if (!window.headless)
 		{
-			glfwSetInputMode(window.window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-		}
-		
+			ImGui_ImplVulkan_NewFrame();
+			ImGui_ImplGlfw_NewFrame();
+			ImGui::NewFrame();
 
-		UpdateImGui();
+			if (Enigma::isDebug && !Enigma::enablePlayerCamera)
+			{
+				glfwSetInputMode(window.window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
+			}
+			else
+			{
+				glfwSetInputMode(window.window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+			}
+
+			{
+				ENIGMA_PROFILE_ZONE("Renderer::UpdateImGui");
+				UpdateImGui(snapshot);
+			}
+		}
 		
 		m_shadowPass->Update();
 
 		if (!Enigma::enablePlayerCamera)
 		{	
 			window.camera = cam;
-			glfwSetKeyCallback(window.window, window.glfw_callback_key_press);
-			cam->Update(window.window, window.swapchainExtent.width, window.swapchainExtent.height);
+			if (!window.headless)
+			{
+				glfwSetKeyCallback(window.window, window.glfw_callback_key_press);
+				cam->Update(window.window, window.swapchainExtent.width, window.swapchainExtent.height);
+			}
+			else
+			{
+				cam->Update(window.swapchainExtent.width, window.swapchainExtent.height);
+			}
 			m_gBufferPass->Update(cam);
+			m_decalPass->Update(cam);
 			m_lightingPass->Update(cam);
+			m_cameraViewProjection = cam->GetCameraTransform().projection * cam->GetCameraTransform().view;
 		}
 		else
 		{
 			window.camera = Enigma::WorldInst.player->GetCamera();
-			glfwSetKeyCallback(window.window, Enigma::WorldInst.player->PlayerKeyCallback);
-			Enigma::WorldInst.player->Update(window.window, window.swapchainExtent.width, window.swapchainExtent.height, context, Enigma::WorldInst.Meshes, *Enigma::EngineTime);
+			if (!window.headless)
+				glfwSetKeyCallback(window.window, Enigma::WorldInst.player->PlayerKeyCallback);
+			Enigma::WorldInst.player->Update(window.swapchainExtent.width, window.swapchainExtent.height, snapshot.GetPlayerPosition());
 			m_gBufferPass->Update(Enigma::WorldInst.player->GetCamera());
+			m_decalPass->Update(Enigma::WorldInst.player->GetCamera());
 			m_lightingPass->Update(Enigma::WorldInst.player->GetCamera());
+			const CameraTransform& transform = Enigma::WorldInst.player->GetCamera()->GetCameraTransform();
+			m_cameraViewProjection = transform.projection * transform.view;
+		}
+
+	}
+
+	size_t Renderer::AddDrawChunks(VkRenderPass renderPass, VkFramebuffer framebuffer, size_t drawCount, const std::function<void(VkCommandBuffer, size_t, size_t)>& record)
+	{
+		// at most one chunk per thread, a thread records its whole chunk into one secondary
+		const size_t chunkCount = std::clamp<size_t>((drawCount + minDrawsPerChunk - 1) / minDrawsPerChunk, 1, m_recordJobs.GetThreadCount());
+		const size_t chunkSize = (drawCount + chunkCount - 1) / chunkCount;
+
+		for (size_t chunk = 0; chunk < chunkCount; chunk++)
+		{
+			const size_t begin = std::min(chunk * chunkSize, drawCount);
+			const size_t end = std::min(begin + chunkSize, drawCount);
+			m_recordTasks.push_back({ renderPass, framebuffer, [record, begin, end](VkCommandBuffer cmd) { record(cmd, begin, end); } });
 		}
+		return chunkCount;
+	}
+
+	void Renderer::RecordPasses(const FrameSnapshot& snapshot, uint32_t imageIndex)
+	{
+		ENIGMA_PROFILE_ZONE("Renderer::RecordPasses");
+
+		// the GPU scene's models are drawn by the first chunk of each pass, the chunks only cover the rest
+		const std::vector<Model*>& models = m_gpuScene->IsEnabled() ? m_cpuModels : Enigma::WorldInst.Meshes;
 
+		// the shadow and g-buffer chunks drawing the same skinned model may be recorded at the same time, upload
+		// the palettes before either starts
+		for (const auto& model : models)
+		{
+			if (snapshot.IsSkinned(model))
+				model->UploadPalette(snapshot.Get(model).palette);
+		}
+
+		// what the queues recorded last frame, every chunk adds to the counters
+		m_queueCounters = Enigma::renderQueueCounters.Take();
+
+		m_recordTasks.clear();
+		m_passSecondaryCounts.assign(m_graph.GetPassCount(), 0);
+
+		const auto addDrawChunks = [&](RenderGraphPass pass, const std::function<void(VkCommandBuffer, size_t, size_t)>& record) {
+			if (!m_graph.IsCulled(pass))
+				m_passSecondaryCounts[pass] = AddDrawChunks(m_graph.GetRenderPass(pass), m_graph.GetFramebuffer(pass, imageIndex), models.size(), record);
+		};
+		// full screen passes are a single draw each, they get a secondary each so they record alongside the chunks
+		const auto addPass = [&](RenderGraphPass pass, const std::function<void(VkCommandBuffer)>& record) {
+			if (m_graph.IsCulled(pass))
+				return;
+			m_recordTasks.push_back({ m_graph.GetRenderPass(pass), m_graph.GetFramebuffer(pass, imageIndex), record });
+			m_passSecondaryCounts[pass] = 1;
+		};
+
+		addDrawChunks(m_shadowPass->GetPass(), [&](VkCommandBuffer cmd, size_t begin, size_t end) { m_shadowPass->Record(cmd, models, begin, end, snapshot); });
+		addDrawChunks(m_gBufferPass->GetPass(), [&](VkCommandBuffer cmd, size_t begin, size_t end) { m_gBufferPass->Record(cmd, models, begin, end, snapshot); });
+		addPass(m_decalPass->GetPass(), [this](VkCommandBuffer cmd) { m_decalPass->Record(cmd); });
+		addPass(m_lightingPass->GetPass(), [this](VkCommandBuffer cmd) { m_lightingPass->Record(cmd); });
+		addPass(m_compositePass->GetPass(), [this](VkCommandBuffer cmd) { m_compositePass->Record(cmd); });
+		// the ui pass always runs since it moves the swapchain image to the layout ImGui expects, it is just empty
+		// without the player camera
+		addPass(m_uiPass->GetPass(), [this](VkCommandBuffer cmd) { if (Enigma::enablePlayerCamera) m_uiPass->Record(cmd); });
+
+		m_recorder.BeginFrame(Enigma::currentFrame);
+		m_secondaries.resize(m_recordTasks.size());
+		m_recordJobs.ParallelFor(static_cast<int>(m_recordTasks.size()), 1, [&](int begin, int end) {
+			for (int i = begin; i < end; i++)
+			{
+				ENIGMA_PROFILE_ZONE("RecordTask");
+				const RecordTask& task = m_recordTasks[i];
+				VkCommandBuffer secondary = m_recorder.Begin(task.renderPass, task.framebuffer);
+				task.record(secondary);
+				ENIGMA_VK_CHECK(vkEndCommandBuffer(secondary), "Failed to end secondary command buffer");
+				m_secondaries[i] = secondary;
+			}
+		});
 	}
 
-	void Renderer::DrawScene()
+	void Renderer::DrawScene(const FrameSnapshot& snapshot)
 	{
-		vkWaitForFences(context.device, 1, &m_fences[Enigma::currentFrame].handle, VK_TRUE, UINT64_MAX);
+		ENIGMA_PROFILE_ZONE("Renderer::DrawScene");
+
+		{
+			ENIGMA_PROFILE_ZONE("vkWaitForFences");
+			vkWaitForFences(context.device, 1, &m_fences[Enigma::currentFrame].handle, VK_TRUE, UINT64_MAX);
+		}
 		vkResetFences(context.device, 1, &m_fences[Enigma::currentFrame].handle);
+		Enigma::geometryArena->BeginFrame();
+		Enigma::instanceBuffer->BeginFrame();
 		
-		// index of next available image to render to 
-		//
-		uint32_t index;
-		VkResult getImageIndex = vkAcquireNextImageKHR(context.device, window.swapchain, UINT64_MAX, m_imagAvailableSemaphores[currentFrame].handle, VK_NULL_HANDLE, &index);
+		// index of next available image to render to. Headless each frame in flight has its own image, the fence
+		// waited on above covers it
+		uint32_t index = Enigma::currentFrame;
+		if (!window.headless)
+			vkAcquireNextImageKHR(context.device, window.swapchain, UINT64_MAX, m_imagAvailableSemaphores[currentFrame].handle, VK_NULL_HANDLE, &index);
+		m_lastImageIndex = index;
 
 		vkResetCommandBuffer(m_renderCommandBuffers[Enigma::currentFrame], 0);
 
 		VkCommandBuffer cmd = m_renderCommandBuffers[Enigma::currentFrame];
 
+		m_sceneModels.clear();
+		m_cpuModels.clear();
+		for (const auto& model : Enigma::WorldInst.Meshes)
+		{
+			if (GPUScene::Accepts(model))
+				m_sceneModels.push_back(model);
+			else
+				m_cpuModels.push_back(model);
+		}
+		m_gpuScene->Update(m_sceneModels, snapshot, m_cameraViewProjection, m_shadowPass->GetLightSpaceMatrix());
+
 		// Rendering ( Record commands for submission )
 		{
 			VkCommandBufferBeginInfo beginInfo{};
 			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 			ENIGMA_VK_CHECK(vkBeginCommandBuffer(m_renderCommandBuffers[Enigma::currentFrame], &beginInfo), "Failed to begin command buffer");
+			m_gpuProfiler->BeginFrame(cmd, Enigma::currentFrame);
 
-			m_shadowPass->Execute(m_renderCommandBuffers[Enigma::currentFrame], Enigma::WorldInst.Meshes);
-			m_gBufferPass->Execute(m_renderCommandBuffers[Enigma::currentFrame], Enigma::WorldInst.Meshes);
-			m_lightingPass->Execute(m_renderCommandBuffers[Enigma::currentFrame]);
-			m_compositePass->Execute(m_renderCommandBuffers[Enigma::currentFrame]);
+			RecordPasses(snapshot, index);
 
-		    if (Enigma::enablePlayerCamera) m_uiPass->Execute(m_renderCommandBuffers[Enigma::currentFrame]);
+			m_gpuProfiler->BeginScope(cmd, "cull");
+			m_gpuScene->Cull(cmd);
+			m_gpuProfiler->EndScope(cmd);
 
-			ImGuiRenderer::Render(cmd, window, index);
+			// the primary only begins and ends the render passes, executing the secondaries in pass order
+			size_t next = 0;
+			for (RenderGraphPass pass = 0; pass < m_graph.GetPassCount(); pass++)
+			{
+				if (m_graph.IsCulled(pass))
+					continue;
+
+				m_gpuProfiler->BeginScope(cmd, m_graph.GetPassName(pass));
+				m_graph.Begin(cmd, pass, index, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+				vkCmdExecuteCommands(cmd, static_cast<uint32_t>(m_passSecondaryCounts[pass]), &m_secondaries[next]);
+				vkCmdEndRenderPass(cmd);
+				m_gpuProfiler->EndScope(cmd);
+				next += m_passSecondaryCounts[pass];
+
+				if (pass == m_gBufferPass->GetPass())
+				{
+					m_gpuProfiler->BeginScope(cmd, "depth pyramid");
+					m_gpuScene->BuildDepthPyramid(cmd);
+					m_gpuProfiler->EndScope(cmd);
+				}
+			}
+
+			// ImGui records into whatever buffer it's given and isn't thread safe, it stays on this thread
+			if (!window.headless)
+			{
+				m_gpuProfiler->BeginScope(cmd, "imgui");
+				ImGuiRenderer::Render(cmd, window, index);
+				m_gpuProfiler->EndScope(cmd);
+			}
 			vkEndCommandBuffer(m_renderCommandBuffers[Enigma::currentFrame]);
 		}
 
+		// everything the frame reads from the ring is written by now
+		Enigma::uniformRing->Flush();
+
 		VkPipelineStageFlags waitStage{ VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
 
 		// Submit the commands
 		VkSubmitInfo submitInfo{};
 		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		submitInfo.waitSemaphoreCount = 1;
+		submitInfo.waitSemaphoreCount = window.headless ? 0 : 1;
 		submitInfo.pWaitSemaphores = &m_imagAvailableSemaphores[Enigma::currentFrame].handle;
 		submitInfo.pWaitDstStageMask = &waitStage;
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &m_renderCommandBuffers[Enigma::currentFrame];
-		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.signalSemaphoreCount = window.headless ? 0 : 1;
 		submitInfo.pSignalSemaphores = &m_renderFinishedSemaphores[Enigma::currentFrame].handle;
 
-		ENIGMA_VK_CHECK(vkQueueSubmit(context.graphicsQueue, 1, &submitInfo, m_fences[Enigma::currentFrame].handle), "Failed to submit command buffer to queue.");
+		{
+			ENIGMA_PROFILE_ZONE("vkQueueSubmit");
+			ENIGMA_VK_CHECK(vkQueueSubmit(context.graphicsQueue, 1, &submitInfo, m_fences[Enigma::currentFrame].handle), "Failed to submit command buffer to queue.");
+		}
+		ENIGMA_PROFILE_COUNTER("draws", m_queueCounters.draws);
+		ENIGMA_PROFILE_COUNTER("uniform ring bytes", m_uniformRingUsed);
+
+		// nothing to present to, the image is read back from presentLayout if at all
+		if (window.headless)
+		{
+			Enigma::currentFrame = (Enigma::currentFrame + 1) % Enigma::MAX_FRAMES_IN_FLIGHT;
+			return;
+		}
 
 		VkPresentInfoKHR present{};
 		present.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
@@ -549,19 +977,21 @@ namespace Enigma
 		present.waitSemaphoreCount = 1;
 		present.pWaitSemaphores = &m_renderFinishedSemaphores[Enigma::currentFrame].handle;
 
-		VkResult res = vkQueuePresentKHR(context.graphicsQueue, &present);
+		VkResult res = VK_SUCCESS;
+		{
+			ENIGMA_PROFILE_ZONE("vkQueuePresentKHR");
+			res = vkQueuePresentKHR(context.graphicsQueue, &present);
+		}
 		
 		// Check if the swapchain is outdated
 		// if it is, recreate the swapchain to ensure it's rendering at the new window size
 		if (window.isSwapchainOutdated(res))
 		{
-			gBufferTargets;
 			vkDeviceWaitIdle(context.device);
 			Enigma::RecreateSwapchain(context, window); 
-			m_gBufferPass->Resize(window);
-			m_lightingPass->Resize(window);
-			m_compositePass->Resize(window);
-            m_uiPass->Resize(window);
+			// recreates the swapchain sized targets and everything using them, the passes update their descriptors
+			m_graph.Compile(window.swapchainExtent, window.swapchainImageViews, &m_recordJobs);
+			m_gpuScene->SetDepth(m_graph.GetImageView(gBufferTargets.depth), m_graph.GetReadLayout(gBufferTargets.depth), m_graph.GetExtent(m_gBufferPass->GetPass()));
 			window.hasResized = true;
 		}
 
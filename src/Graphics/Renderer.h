@@ -14,11 +14,20 @@
 
 #include <memory>
 #include "GBuffer.h"
+#include "DecalPass.h"
 #include "Lighting.h"
 #include "Composite.h"
 #include "ShadowPass.h"
 #include "ImGuiRenderer.h"
 #include "UIPass.h"
+#include "CommandRecorder.h"
+#include "RenderGraph.h"
+#include "PipelineCache.h"
+#include "GPUScene.h"
+#include "GPUProfiler.h"
+#include "RenderQueue.h"
+#include "../Core/JobSystem.h"
+#include <functional>
 
 namespace Enigma
 {
@@ -27,26 +36,57 @@ namespace Enigma
 		public:
 			explicit Renderer(const VulkanContext& context, VulkanWindow& window, Camera* camera);
 			~Renderer();
-			void DrawScene();
-			void Update(Camera* cam);
-			void UpdateImGui();
+			// Both only read the world through the snapshot, the simulation thread may be changing it meanwhile
+			void DrawScene(const FrameSnapshot& snapshot);
+			void Update(Camera* cam, const FrameSnapshot& snapshot);
+			void UpdateImGui(const FrameSnapshot& snapshot);
+			// Render thread, a decal for every shot impact of the snapshot
+			void AddDecals(const std::vector<glm::vec3>& impacts) { m_decalPass->Add(impacts); }
+			// Swapchain image the last DrawScene rendered to, headless it can be read back once that frame has finished
+			uint32_t GetLastImageIndex() const { return m_lastImageIndex; }
+			const GPUProfiler& GetGPUProfiler() const { return *m_gpuProfiler; }
 			Pipeline CreateGraphicsPipeline(const std::string& vertex, const std::string& fragment, VkBool32 enableBlend, VkBool32 enableDepth, VkBool32 enableDepthWrite, const std::vector<VkDescriptorSetLayout>& descriptorLayouts, PipelineLayout& pipelinelayout, VkPrimitiveTopology topology);
 		private:
 			void CreateRendererResources();
 			void CreateDescriptorPool();
+			// Records every pass except ImGui into secondary command buffers on the record job threads
+			void RecordPasses(const FrameSnapshot& snapshot, uint32_t imageIndex);
+			// Adds one secondary per chunk of draws, returns how many were added
+			size_t AddDrawChunks(VkRenderPass renderPass, VkFramebuffer framebuffer, size_t drawCount, const std::function<void(VkCommandBuffer, size_t, size_t)>& record);
 
 		private:
+			// One secondary command buffer to record, continues subpass 0 of renderPass
+			struct RecordTask
+			{
+				VkRenderPass renderPass;
+				VkFramebuffer framebuffer;
+				std::function<void(VkCommandBuffer)> record;
+			};
+
 			// vulkan and window context
 			const VulkanContext& context;
 			VulkanWindow& window;
 
+			// Loaded from disk before any pipeline is created, saved again when the renderer is destroyed
+			PipelineCache m_pipelineCache;
+
+			// Owns the render passes, framebuffers and targets of the passes below, destroyed after them
+			RenderGraph m_graph;
+
+			// Static models culled and drawn from the GPU, the passes below draw it
+			GPUScene* m_gpuScene;
+
 			// Rendering passes
 			GBuffer* m_gBufferPass;
+			DecalPass* m_decalPass;
 			Lighting* m_lightingPass;
 			Composite* m_compositePass;
 			ShadowPass* m_shadowPass;
             UIPass* m_uiPass;
 
+			// GPU time of every pass, read back a frame in flight late
+			GPUProfiler* m_gpuProfiler;
+
 			// Rendering resources
 			std::vector<Fence> m_fences;
 			std::vector<Semaphore> m_imagAvailableSemaphores;
@@ -55,6 +95,24 @@ namespace Enigma
 			std::vector<CommandPool> m_renderCommandPools;
 			std::vector<VkCommandBuffer> m_renderCommandBuffers;
 
+			// Separate from the world's job system, that one belongs to the simulation thread
+			JobSystem m_recordJobs;
+			CommandRecorder m_recorder;
+			std::vector<RecordTask> m_recordTasks;
+			std::vector<VkCommandBuffer> m_secondaries;
+			// secondaries per graph pass, culled passes have none
+			std::vector<size_t> m_passSecondaryCounts;
+			// models the GPU scene draws and the ones left for the CPU path
+			std::vector<Model*> m_sceneModels;
+			std::vector<Model*> m_cpuModels;
+			// camera the g-buffer is drawn with, culled against
+			glm::mat4 m_cameraViewProjection = glm::mat4(1.0f);
+			// binds and draws of the last frame's render queues, shown in the UI
+			RenderQueueCounters::Values m_queueCounters;
+			// bytes of the uniform ring the last frame used
+			uint32_t m_uniformRingUsed = 0;
+			uint32_t m_lastImageIndex = 0;
+
 			// other 
 			bool current_state = false;
 			Camera* camera;
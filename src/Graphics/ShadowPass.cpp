@@ -1,74 +1,57 @@
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE 
 #include <glm/gtc/matrix_transform.hpp>
 #include "ShadowPass.h"
+#include "TextureCache.h"
+#include "RenderQueue.h"
+#include "InstanceBuffer.h"
+#include "UniformRing.h"
 #include "../Core/World.h"
 #include "../Core//Engine.h"
 
 namespace Enigma
 {
-	ShadowPass::ShadowPass(const VulkanContext& context, VulkanWindow& window) : context{context}, window{window}
+	ShadowPass::ShadowPass(const VulkanContext& context, VulkanWindow& window, RenderGraph& graph, RenderResource shadowMap, const GPUScene& scene) : context{context}, window{window}, scene{scene}
 	{
 		m_width = 2048;
 		m_height = 2048;
 		m_format = VK_FORMAT_D32_SFLOAT;
 		m_RenderPass = VK_NULL_HANDLE;
 		m_descriptorSetLayout = VK_NULL_HANDLE;
-		m_framebuffer = VK_NULL_HANDLE;
 
-		m_uniformBO.resize(Enigma::MAX_FRAMES_IN_FLIGHT);
+		m_pass = graph.AddPass("shadow", [&](RenderGraph::PassBuilder& builder) {
+			VkClearValue clearDepth{};
+			clearDepth.depthStencil.depth = 1.0f;
+			builder.Write(shadowMap, true, clearDepth);
+			builder.OnCompiled([this](const RenderGraph& graph) { OnCompiled(graph); });
+		});
 
-		for (auto& buffer : m_uniformBO)
-			buffer = Enigma::CreateBuffer(context.allocator, sizeof(LightUBO), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
-
-		renderTarget = Enigma::CreateImageTexture2D(
-			context,
-			m_width,
-			m_height,
-			m_format,
-			VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-			VK_IMAGE_ASPECT_DEPTH_BIT, 1
-		);
-
-
-		CreateRenderPass(context.device);
-		CreateFramebuffer(context.device);
 		BuildDescriptorSetLayout(context);
-		CreatePipeline(context.device, window.swapchainExtent);
-		CreatePipelineAnim(context.device, window.swapchainExtent);
 	}
 	ShadowPass::~ShadowPass()
 	{
 		// destroy the vulkan resources 
 
-		if (m_framebuffer != VK_NULL_HANDLE)
-		{
-			vkDestroyFramebuffer(context.device, m_framebuffer, nullptr);
-		}
-
-		if (m_RenderPass != VK_NULL_HANDLE)
-		{
-			vkDestroyRenderPass(context.device, m_RenderPass, nullptr);
-		}
-
 		if (m_descriptorSetLayout != VK_NULL_HANDLE)
 		{
 			vkDestroyDescriptorSetLayout(context.device, m_descriptorSetLayout, nullptr);
 		}
 	}
 
-	void ShadowPass::Execute(VkCommandBuffer cmd, std::vector<Model*> models)
+	void ShadowPass::OnCompiled(const RenderGraph& graph)
 	{
-		VkRenderPassBeginInfo rpBegin{ VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
-		rpBegin.renderPass = m_RenderPass;
-		rpBegin.framebuffer = m_framebuffer;
-		rpBegin.renderArea.extent = { m_width, m_height };
-		rpBegin.renderArea.offset = { 0,0 };
-
-		VkClearValue clearValues[1]{}; 
-		clearValues[0].depthStencil.depth = 1.0f;
-		rpBegin.clearValueCount = 1;
-		rpBegin.pClearValues = clearValues;
+		m_RenderPass = graph.GetRenderPass(m_pass);
+		if (m_pipeline.handle == VK_NULL_HANDLE)
+		{
+			CreatePipeline(context.device, VERTEX, { m_descriptorSetLayout }, m_pipeline, m_pipelineLayout);
+			CreatePipeline(context.device, SHADOW_VERTEX_INSTANCED, { m_descriptorSetLayout, Enigma::instanceBuffer->GetDescriptorSetLayout() }, m_pipelineInstanced, m_pipelineInstancedLayout);
+			if (context.gpuDrivenSupported)
+				CreatePipeline(context.device, SHADOW_VERTEX_INDIRECT, { m_descriptorSetLayout, scene.GetDescriptorSetLayout() }, m_pipelineIndirect, m_pipelineIndirectLayout);
+			CreatePipelineAnim(context.device, graph.GetExtent(m_pass));
+		}
+	}
 
+	void ShadowPass::Record(VkCommandBuffer cmd, const std::vector<Model*>& models, size_t begin, size_t end, const FrameSnapshot& snapshot)
+	{
 		VkViewport viewport{};
 		viewport.x = 0.0f;
 		viewport.y = 0.0f;
@@ -83,23 +66,39 @@ namespace Enigma
 		scissor.extent = { m_width, m_height };
 		vkCmdSetScissor(cmd, 0, 1, &scissor);
 
-		vkCmdBeginRenderPass(cmd, &rpBegin, VK_SUBPASS_CONTENTS_INLINE);
-		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout.handle, 0, 1, &m_descriptorSets[Enigma::currentFrame], 0, nullptr);
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout.handle, 0, 1, &m_descriptorSets[Enigma::currentFrame], 1, &m_lightOffset);
 
-		for (const auto& model : models)
+		if (begin == 0 && scene.IsEnabled())
 		{
-            if(model->m_animations.empty() || model->dead){
-			    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipeline.handle);
-			    model->Draw(cmd, m_pipelineLayout.handle);
-            }
-            else
-            {
-			    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineAnim.handle);
-			    model->Draw2(cmd, m_pipelineAnimLayout.handle);
-            }
+			// depth only, the texture cache's set isn't bound in this pass
+			vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineIndirect.handle);
+			scene.Draw(cmd, m_pipelineIndirectLayout.handle, GPUScene::ShadowView, 1);
 		}
 
-		vkCmdEndRenderPass(cmd);
+		// one queue per recording thread, sorted from the light
+		thread_local RenderQueue queue;
+		queue.Begin(glm::vec3(m_lightUBO.lightPosition));
+
+		const RenderState opaque{ m_pipeline.handle, m_pipelineLayout.handle };
+		// like the GPU scene's set, the bones and the instances go in set 1 since the texture cache isn't used here
+		const RenderState skinned{ m_pipelineAnim.handle, m_pipelineAnimLayout.handle, VK_NULL_HANDLE, 1 };
+		queue.Instance(opaque, { m_pipelineInstanced.handle, m_pipelineInstancedLayout.handle, VK_NULL_HANDLE, 1 });
+
+		for (size_t i = begin; i < end; i++)
+		{
+			Model* model = models[i];
+			if (!snapshot.IsSkinned(model))
+			{
+				model->Queue(queue, opaque, snapshot.GetTransform(model));
+			}
+			else
+			{
+				const ModelSnapshot& pose = snapshot.Get(model);
+				model->Queue2(queue, skinned, pose.nodeMatrices, snapshot.GetOffset(model));
+			}
+		}
+
+		queue.Submit(cmd);
 	}
 
 	void ShadowPass::Update()
@@ -125,72 +124,12 @@ namespace Enigma
 		}
 
 		// Update the lighting uniform
-		void* data = nullptr;
-		vmaMapMemory(context.allocator.allocator, m_uniformBO[Enigma::currentFrame].allocation, &data);
-		std::memcpy(data, &m_lightUBO, sizeof(m_lightUBO));
-		vmaUnmapMemory(context.allocator.allocator, m_uniformBO[Enigma::currentFrame].allocation);
-	}
-
-	void ShadowPass::CreateFramebuffer(VkDevice device)
-	{
-		std::vector<VkImageView> attachments = { renderTarget.imageView };
-		VkFramebufferCreateInfo fbInfo{ VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO };
-		fbInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
-		fbInfo.pAttachments = attachments.data();
-		fbInfo.renderPass = m_RenderPass;
-		fbInfo.width = m_width;
-		fbInfo.height = m_height;
-		fbInfo.layers = 1;
-
-		ENIGMA_VK_CHECK(vkCreateFramebuffer(device, &fbInfo, nullptr, &m_framebuffer), "Failed to create G-Buffer framebuffer.");
-	}
-
-	void ShadowPass::CreateRenderPass(VkDevice device)
-	{
-		VkAttachmentDescription depthAttachment = {};
-		depthAttachment.format = VK_FORMAT_D32_SFLOAT;
-		depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-		depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-		depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-		depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
-
-		VkAttachmentReference depthAttachmentRef = {};
-		depthAttachmentRef.attachment = 0;
-		depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-		VkSubpassDescription subpass = {};
-		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-		subpass.colorAttachmentCount = 0;
-		subpass.pDepthStencilAttachment = &depthAttachmentRef;
-
-		// Since passes after this will use the shadow pass 
-		// we need to specify a dependency 
-		VkSubpassDependency dependency = {};
-		dependency.srcSubpass = 0;
-		dependency.dstSubpass = VK_SUBPASS_EXTERNAL;
-		dependency.srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-		dependency.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-		dependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-		dependency.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-		dependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-
-		VkRenderPassCreateInfo renderPassInfo{ VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO };
-		renderPassInfo.attachmentCount = static_cast<uint32_t>(1);
-		renderPassInfo.pAttachments = &depthAttachment;
-		renderPassInfo.subpassCount = 1;
-		renderPassInfo.pSubpasses = &subpass;
-		renderPassInfo.dependencyCount = 1;
-		renderPassInfo.pDependencies = &dependency;
-
-		ENIGMA_VK_CHECK(vkCreateRenderPass(device, &renderPassInfo, nullptr, &m_RenderPass), "Failed to create shadow pass render pass");
+		m_lightOffset = Enigma::uniformRing->Push(m_lightUBO);
 	}
 
-	void ShadowPass::CreatePipeline(VkDevice device, VkExtent2D swapchainExtent)
+	void ShadowPass::CreatePipeline(VkDevice device, const char* vertex, const std::vector<VkDescriptorSetLayout>& layouts, Pipeline& pipeline, PipelineLayout& pipelineLayout)
 	{
-		ShaderModule vertexShader = CreateShaderModule(VERTEX, device);
+		ShaderModule vertexShader = CreateShaderModule(vertex, device);
 		ShaderModule fragmentShader = CreateShaderModule(FRAGMENT, device);
 
 		VkPipelineShaderStageCreateInfo vertShaderStageInfo{};
@@ -283,8 +222,6 @@ namespace Enigma
 		pushConstant.offset = 0;
 		pushConstant.size = sizeof(Enigma::ModelPushConstant);
 
-		std::vector<VkDescriptorSetLayout> layouts = { m_descriptorSetLayout, Enigma::descriptorLayoutModel };
-
 		VkPipelineLayoutCreateInfo layoutInfo{};
 		layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 		layoutInfo.setLayoutCount = (uint32_t)layouts.size();
@@ -297,7 +234,7 @@ namespace Enigma
 
 		ENIGMA_VK_CHECK(res, "Failed to create pipeline layout");
 
-		m_pipelineLayout = PipelineLayout(device, layout);
+		pipelineLayout = PipelineLayout(device, layout);
 
 		VkGraphicsPipelineCreateInfo pipelineInfo{};
 		pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -312,14 +249,14 @@ namespace Enigma
 		pipelineInfo.pDepthStencilState = &depthInfo;
 		pipelineInfo.pColorBlendState = &blendInfo;
 		pipelineInfo.pDynamicState = nullptr;
-		pipelineInfo.layout = m_pipelineLayout.handle;
+		pipelineInfo.layout = pipelineLayout.handle;
 		pipelineInfo.renderPass = m_RenderPass;
 		pipelineInfo.subpass = 0;
 
-		VkPipeline pipeline = VK_NULL_HANDLE;
-		ENIGMA_VK_CHECK(vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline), "Failed to create graphics pipeline.");
+		VkPipeline handle = VK_NULL_HANDLE;
+		ENIGMA_VK_CHECK(vkCreateGraphicsPipelines(device, Enigma::pipelineCache, 1, &pipelineInfo, nullptr, &handle), "Failed to create graphics pipeline.");
 
-		m_pipeline = Pipeline(device, pipeline);
+		pipeline = Pipeline(device, handle);
 	}
 	void ShadowPass::CreatePipelineAnim(VkDevice device, VkExtent2D swapchainExtent)
 	{
@@ -416,7 +353,7 @@ namespace Enigma
 		pushConstant.offset = 0;
 		pushConstant.size = sizeof(Enigma::ModelPushConstant);
 
-		std::vector<VkDescriptorSetLayout> layouts = { m_descriptorSetLayout, Enigma::descriptorLayoutModel, Enigma::boneTransformDescriptorLayout};
+		std::vector<VkDescriptorSetLayout> layouts = { m_descriptorSetLayout, Enigma::boneTransformDescriptorLayout };
 
 		VkPipelineLayoutCreateInfo layoutInfo{};
 		layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
@@ -450,7 +387,7 @@ namespace Enigma
 		pipelineInfo.subpass = 0;
 
 		VkPipeline pipeline = VK_NULL_HANDLE;
-		ENIGMA_VK_CHECK(vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline), "Failed to create graphics pipeline.");
+		ENIGMA_VK_CHECK(vkCreateGraphicsPipelines(device, Enigma::pipelineCache, 1, &pipelineInfo, nullptr, &pipeline), "Failed to create graphics pipeline.");
 
 		m_pipelineAnim = Pipeline(device, pipeline);
 	}
@@ -461,32 +398,19 @@ namespace Enigma
 
 		{
 			std::vector<VkDescriptorSetLayoutBinding> bindings = {
-				CreateDescriptorBinding(0, 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT)
+				CreateDescriptorBinding(0, 1, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT)
 			};
 
 			m_descriptorSetLayout = CreateDescriptorSetLayout(context, bindings);
 		}
 
-		// Set = 1
-		{
-			std::vector<VkDescriptorSetLayoutBinding> bindings = {
-				CreateDescriptorBinding(0, 40, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT),
-				CreateDescriptorBinding(1, 40, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT)
-			};
-
-			Enigma::descriptorLayoutModel = CreateDescriptorSetLayout(context, bindings);
-		}
-
 		AllocateDescriptorSets(context, Enigma::descriptorPool, m_descriptorSetLayout, Enigma::MAX_FRAMES_IN_FLIGHT, m_descriptorSets);
 
-		// Binding 0
+		// Binding 0, the light is found with the offset the set is bound with
 		for (size_t i = 0; i < Enigma::MAX_FRAMES_IN_FLIGHT; i++)
 		{
-			VkDescriptorBufferInfo bufferInfo{};
-			bufferInfo.buffer = m_uniformBO[i].buffer;
-			bufferInfo.offset = 0;
-			bufferInfo.range = sizeof(LightUBO);
-			UpdateDescriptorSet(context, 0, bufferInfo, m_descriptorSets[i], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+			const VkDescriptorBufferInfo bufferInfo = Enigma::uniformRing->GetDescriptorInfo(sizeof(LightUBO));
+			UpdateDescriptorSet(context, 0, bufferInfo, m_descriptorSets[i], VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
 		}
 	}
 }
\ No newline at end of file
@@ -7,10 +7,14 @@
 #include "Model.h"
 #include "../Core/VulkanWindow.h"
 #include "../Core/World.h"
+#include "RenderGraph.h"
+#include "GPUScene.h"
 
 #define VERTEX "../resources/Shaders/vs_shadowpass.vert.spv"
 #define VERTEX_ANIM "../resources/Shaders/vs_shadowpassAnim.vert.spv"
 #define FRAGMENT "../resources/Shaders/fs_shadowpass.frag.spv"
+#define SHADOW_VERTEX_INDIRECT "../resources/Shaders/vs_shadowpassIndirect.vert.spv"
+#define SHADOW_VERTEX_INSTANCED "../resources/Shaders/vs_shadowpassInstanced.vert.spv"
 
 
 namespace Enigma
@@ -18,40 +22,50 @@ namespace Enigma
 	class ShadowPass
 	{
 	public:
-		ShadowPass(const VulkanContext& context, VulkanWindow& window);
+		ShadowPass(const VulkanContext& context, VulkanWindow& window, RenderGraph& graph, RenderResource shadowMap, const GPUScene& scene);
 		~ShadowPass();
 
-		void Execute(VkCommandBuffer cmd, std::vector<Model*> models);
+		// Draws models [begin, end) inside the graph's render pass. Sets all the state it needs itself so the draws
+		// can be split across secondary command buffers recorded on other threads. The range starting at 0 also
+		// draws the GPU scene
+		void Record(VkCommandBuffer cmd, const std::vector<Model*>& models, size_t begin, size_t end, const FrameSnapshot& snapshot);
+		RenderGraphPass GetPass() const { return m_pass; }
 		void Update();
+		const glm::mat4& GetLightSpaceMatrix() const { return m_lightUBO.LightSpaceMatrix; }
 
-		// Return the render target image this pass output to
-		Image& GetRenderTarget() { return renderTarget; }
 	private:
-		void CreateFramebuffer(VkDevice device);
-		void CreateRenderPass(VkDevice device);
-		void CreatePipeline(VkDevice device, VkExtent2D swapchainExtent);
+		void OnCompiled(const RenderGraph& graph);
+		void CreatePipeline(VkDevice device, const char* vertex, const std::vector<VkDescriptorSetLayout>& layouts, Pipeline& pipeline, PipelineLayout& pipelineLayout);
 		void CreatePipelineAnim(VkDevice device, VkExtent2D swapchainExtent);
 		void BuildDescriptorSetLayout(const VulkanContext& context);
 
 	private:
 		const VulkanContext& context;
 		VulkanWindow& window;
+		const GPUScene& scene;
 		uint32_t m_width;
 		uint32_t m_height;
 		Pipeline m_pipeline;
 		PipelineLayout m_pipelineLayout;
 		VkRenderPass m_RenderPass;
-		VkFramebuffer m_framebuffer;
+		RenderGraphPass m_pass;
 		VkDescriptorSetLayout m_descriptorSetLayout;
 		std::vector<VkDescriptorSet> m_descriptorSets;
-		std::vector<Buffer> m_uniformBO;
+		// the light's place in the uniform ring this frame
+		uint32_t m_lightOffset = 0;
 		std::vector<Buffer> m_lightingUBO;
 		Buffer m_SSBO;
-		Image renderTarget;
 		VkFormat m_format;
 		LightUBO m_lightUBO;
 
 		Pipeline m_pipelineAnim;
 		PipelineLayout m_pipelineAnimLayout;
+
+		Pipeline m_pipelineIndirect;
+		PipelineLayout m_pipelineIndirectLayout;
+
+		// the render queue's instanced draws of m_pipeline's packets
+		Pipeline m_pipelineInstanced;
+		PipelineLayout m_pipelineInstancedLayout;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,155 @@
+#include "TextureCache.h"
+#include "Common.h"
+#include <cstring>
+#include <algorithm>
+
+namespace Enigma
+{
+	namespace
+	{
+		// more than the level and the characters use, the device limit is usually far higher
+		constexpr uint32_t maxTextures = 4096;
+		constexpr uint32_t minMaterials = 256;
+	}
+
+	TextureCache::TextureCache(const VulkanContext& context) : context{ context }
+	{
+		VkPhysicalDeviceVulkan12Properties properties12{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES };
+		VkPhysicalDeviceProperties2 properties{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2 };
+		properties.pNext = &properties12;
+		vkGetPhysicalDeviceProperties2(context.physicalDevice, &properties);
+
+		m_textureCapacity = std::min({ maxTextures, properties12.maxPerStageDescriptorUpdateAfterBindSampledImages,
+			properties12.maxPerStageDescriptorUpdateAfterBindSamplers, properties12.maxDescriptorSetUpdateAfterBindSampledImages });
+
+		// the array can be written while command buffers using it are pending, not every slot has to be written
+		std::vector<VkDescriptorSetLayoutBinding> bindings = {
+			CreateDescriptorBinding(0, m_textureCapacity, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT),
+			CreateDescriptorBinding(1, 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_FRAGMENT_BIT)
+		};
+		const VkDescriptorBindingFlags bindingFlags[] = { VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT, 0 };
+
+		VkDescriptorSetLayoutBindingFlagsCreateInfo flagsInfo{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO };
+		flagsInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+		flagsInfo.pBindingFlags = bindingFlags;
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
+		layoutInfo.pNext = &flagsInfo;
+		layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+		layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
+		layoutInfo.pBindings = bindings.data();
+		ENIGMA_VK_CHECK(vkCreateDescriptorSetLayout(context.device, &layoutInfo, nullptr, &m_descriptorSetLayout), "Failed to create texture cache descriptor set layout");
+
+		// update after bind sets need a pool of their own
+		VkDescriptorPoolSize poolSizes[] = {
+			{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, m_textureCapacity },
+			{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1 }
+		};
+
+		VkDescriptorPoolCreateInfo poolInfo{ VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+		poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+		poolInfo.poolSizeCount = 2;
+		poolInfo.pPoolSizes = poolSizes;
+		poolInfo.maxSets = 1;
+		ENIGMA_VK_CHECK(vkCreateDescriptorPool(context.device, &poolInfo, nullptr, &m_descriptorPool), "Failed to create texture cache descriptor pool");
+
+		VkDescriptorSetAllocateInfo allocInfo{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+		allocInfo.descriptorPool = m_descriptorPool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &m_descriptorSetLayout;
+		ENIGMA_VK_CHECK(vkAllocateDescriptorSets(context.device, &allocInfo, &m_descriptorSet), "Failed to allocate texture cache descriptor set");
+
+		ReserveMaterials(minMaterials);
+
+		// index 0 and material 0
+		Load(DEFAULT_TEXTURE, Enigma::repeatSampler);
+		AddMaterial(defaultTexture, defaultTexture);
+	}
+
+	TextureCache::~TextureCache()
+	{
+		m_textures.clear();
+		vkDestroyDescriptorPool(context.device, m_descriptorPool, nullptr);
+		vkDestroyDescriptorSetLayout(context.device, m_descriptorSetLayout, nullptr);
+	}
+
+	uint32_t TextureCache::Load(const std::string& path, VkSampler sampler)
+	{
+		const auto cached = m_textureIndices.find({ path, sampler });
+		if (cached != m_textureIndices.end())
+			return cached->second;
+
+		if (m_textures.size() >= m_textureCapacity)
+		{
+			ENIGMA_ERROR("Texture array is full, using the default texture for: " + path);
+			return defaultTexture;
+		}
+
+		const uint32_t index = static_cast<uint32_t>(m_textures.size());
+		m_textures.push_back(CreateTexture(context, path));
+
+		VkDescriptorImageInfo imageInfo{};
+		imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		imageInfo.imageView = m_textures.back().imageView;
+		imageInfo.sampler = sampler;
+
+		VkWriteDescriptorSet descriptorWrite{ VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+		descriptorWrite.dstSet = m_descriptorSet;
+		descriptorWrite.dstBinding = 0;
+		descriptorWrite.dstArrayElement = index;
+		descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		descriptorWrite.descriptorCount = 1;
+		descriptorWrite.pImageInfo = &imageInfo;
+		vkUpdateDescriptorSets(context.device, 1, &descriptorWrite, 0, nullptr);
+
+		m_textureIndices.emplace(std::make_pair(path, sampler), index);
+		return index;
+	}
+
+	uint32_t TextureCache::AddMaterial(uint32_t diffuse, uint32_t metallic)
+	{
+		const auto cached = m_materialIDs.find({ diffuse, metallic });
+		if (cached != m_materialIDs.end())
+			return cached->second;
+
+		const uint32_t materialID = static_cast<uint32_t>(m_materials.size());
+		ReserveMaterials(materialID + 1);
+
+		m_materials.push_back({ static_cast<int32_t>(diffuse), static_cast<int32_t>(metallic) });
+		WriteMaterial(materialID);
+
+		m_materialIDs.emplace(std::make_pair(diffuse, metallic), materialID);
+		return materialID;
+	}
+
+	void TextureCache::ReserveMaterials(uint32_t materialCount)
+	{
+		if (materialCount <= m_materialCapacity)
+			return;
+
+		// frames in flight may still be reading the old table, the binding isn't update after bind either
+		if (m_materialBuffer.buffer != VK_NULL_HANDLE)
+			vkDeviceWaitIdle(context.device);
+
+		m_materialCapacity = std::max(materialCount, m_materialCapacity * 2);
+		m_materialBuffer = CreateBuffer(context.allocator, VkDeviceSize(m_materialCapacity) * sizeof(GPUMaterial), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+
+		for (uint32_t i = 0; i < m_materials.size(); i++)
+			WriteMaterial(i);
+
+		VkDescriptorBufferInfo bufferInfo{};
+		bufferInfo.buffer = m_materialBuffer.buffer;
+		bufferInfo.offset = 0;
+		bufferInfo.range = VK_WHOLE_SIZE;
+		UpdateDescriptorSet(context, 1, bufferInfo, m_descriptorSet, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+	}
+
+	void TextureCache::WriteMaterial(uint32_t materialID)
+	{
+		// only slots no draw refers to yet are written while frames are in flight
+		void* data = nullptr;
+		ENIGMA_VK_CHECK(vmaMapMemory(context.allocator.allocator, m_materialBuffer.allocation, &data), "Failed to map material table");
+		std::memcpy(static_cast<GPUMaterial*>(data) + materialID, &m_materials[materialID], sizeof(GPUMaterial));
+		vmaUnmapMemory(context.allocator.allocator, m_materialBuffer.allocation);
+	}
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include <Volk/volk.h>
+#include "VulkanContext.h"
+#include "VulkanBuffer.h"
+#include "VulkanImage.h"
+
+#define DEFAULT_TEXTURE "../resources/default_texture.jpg"
+
+namespace Enigma
+{
+	// Every material texture in one descriptor set shared by all draws. Binding 0 is an update after bind array of
+	// textures, binding 1 is the material table the shaders index with a mesh's material ID to find its textures.
+	// Textures are loaded once per path and sampler, and materials with the same textures share an ID, so models
+	// loaded again don't grow either. Nothing is unloaded until the cache is destroyed
+	class TextureCache
+	{
+	public:
+		// a pink placeholder, easy to spot on meshes that are missing their texture
+		static constexpr uint32_t defaultTexture = 0;
+		// the default texture for both diffuse and metallic
+		static constexpr uint32_t defaultMaterial = 0;
+
+		explicit TextureCache(const VulkanContext& context);
+		~TextureCache();
+
+		TextureCache(const TextureCache&) = delete;
+		TextureCache& operator=(const TextureCache&) = delete;
+
+		// Index of the texture in the array, it is loaded the first time the path and sampler are asked for.
+		// Falls back to the default texture once the array is full
+		uint32_t Load(const std::string& path, VkSampler sampler);
+		// ID of the material with these textures, meshes pass it to the shaders instead of a texture index
+		uint32_t AddMaterial(uint32_t diffuse, uint32_t metallic);
+
+		VkDescriptorSetLayout GetDescriptorSetLayout() const { return m_descriptorSetLayout; }
+		VkDescriptorSet GetDescriptorSet() const { return m_descriptorSet; }
+
+		size_t GetTextureCount() const { return m_textures.size(); }
+		uint32_t GetTextureCapacity() const { return m_textureCapacity; }
+		size_t GetMaterialCount() const { return m_materials.size(); }
+
+	private:
+		// std430 layout shared with gbuffer.frag and gbufferIndirect.frag
+		struct GPUMaterial
+		{
+			int32_t diffuse;
+			int32_t metallic;
+		};
+
+		// Grows the material table to hold at least the given count, waits for the device to go idle
+		void ReserveMaterials(uint32_t materialCount);
+		void WriteMaterial(uint32_t materialID);
+
+	private:
+		const VulkanContext& context;
+
+		VkDescriptorPool m_descriptorPool = VK_NULL_HANDLE;
+		VkDescriptorSetLayout m_descriptorSetLayout = VK_NULL_HANDLE;
+		VkDescriptorSet m_descriptorSet = VK_NULL_HANDLE;
+
+		std::vector<Image> m_textures;
+		std::map<std::pair<std::string, VkSampler>, uint32_t> m_textureIndices;
+		uint32_t m_textureCapacity = 0;
+
+		Buffer m_materialBuffer;
+		std::vector<GPUMaterial> m_materials;
+		std::map<std::pair<uint32_t, uint32_t>, uint32_t> m_materialIDs;
+		uint32_t m_materialCapacity = 0;
+	};
+}
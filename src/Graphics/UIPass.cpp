@@ -1,28 +1,32 @@
 #include "UIPass.h"
 
 namespace Enigma {
-UIPass::UIPass(const VulkanContext& context, const VulkanWindow& window) : context{context}, window{window} {
+UIPass::UIPass(const VulkanContext& context, const VulkanWindow& window, RenderGraph& graph, RenderResource swapchain)
+    : context{context}, window{window} {
     m_width = window.swapchainExtent.width;
     m_height = window.swapchainExtent.height;
 
-    CreateRenderPass();
-    CreateBlood();
-}
+    // drawn over the composited image, the pipelines are built against the window's render pass which is
+    // compatible with the graph's
+    m_pass = graph.AddPass("ui", [&](RenderGraph::PassBuilder& builder) {
+        builder.Write(swapchain, false);
+        builder.OnCompiled([this](const RenderGraph& graph) {
+            m_width = graph.GetExtent(m_pass).width;
+            m_height = graph.GetExtent(m_pass).height;
+
+            // created with the other passes' pipelines, the head's set layout is made by CreateBlood
+            if (m_bloodPipeline.handle == VK_NULL_HANDLE) {
+                CreateBloodPipeline();
+                CreateHeadPipeline();
+            }
+        });
+    });
 
-UIPass::~UIPass() {
-    vkDestroyRenderPass(context.device, m_RenderPass, 0);
+    CreateBlood();
 }
-void UIPass::Execute(VkCommandBuffer cmd) {
-    VkRenderPassBeginInfo rpBegin{VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
-    rpBegin.renderPass = m_RenderPass;
-    rpBegin.framebuffer = window.swapchainFramebuffers[Enigma::currentFrame];  // this should be image index
-    rpBegin.renderArea.extent = window.swapchainExtent;
-
-    VkClearValue clearValues[1];
-    clearValues[0].color = {{0.0f, 0.0f, 0.5f, 1.0f}};
-    rpBegin.clearValueCount = 1;
-    rpBegin.pClearValues = clearValues;
 
+UIPass::~UIPass() {}
+void UIPass::Record(VkCommandBuffer cmd) {
     VkViewport viewport{};
     viewport.x = 0.0f;
     viewport.y = 0.0f;
@@ -37,65 +41,7 @@ void UIPass::Execute(VkCommandBuffer cmd) {
     scissor.extent = {m_width, m_height};
     vkCmdSetScissor(cmd, 0, 1, &scissor);
 
-    vkCmdBeginRenderPass(cmd, &rpBegin, VK_SUBPASS_CONTENTS_INLINE);
     DrawBlood(cmd);
-    vkCmdEndRenderPass(cmd);
-}
-void UIPass::Resize(VulkanWindow& window) {
-    m_width = window.swapchainExtent.width;
-    m_height = window.swapchainExtent.height;
-
-    // for (size_t i = 0; i < Enigma::MAX_FRAMES_IN_FLIGHT; i++) {
-    //     VkDescriptorImageInfo imageInfo = {};
-    //     imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-    //     imageInfo.imageView = m_LightingPass.imageView;  // need the g-buffer normals texture image view
-    //     imageInfo.sampler = Enigma::defaultSampler;
-    //     UpdateDescriptorSet(context, 1, imageInfo, m_descriptorSets[i], VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
-    // }
-}
-void UIPass::CreateRenderPass() {
-    VkAttachmentDescription attachment{};
-    attachment.format = VK_FORMAT_B8G8R8A8_UNORM;
-    attachment.samples = VK_SAMPLE_COUNT_1_BIT;
-    attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;                // load the contents of the previous
-    attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;             // store the result
-    attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;    // not using stencil, use don't care
-    attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;  // not using stencil, use don't care
-    attachment.initialLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;    // layout of the resource as it enters render pass
-    attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;      // layout of resource at the end of the render pass
-
-    VkAttachmentDescription attachments[1] = {attachment};
-
-    VkAttachmentReference colorReference = {0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
-
-    VkSubpassDescription subpass{};
-    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-    subpass.colorAttachmentCount = 1;
-    subpass.pColorAttachments = &colorReference;
-
-    VkSubpassDependency dependency[1]{};
-    // Wait for EXTERNAL render pass to finish outputting
-    dependency[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
-    dependency[0].srcSubpass = VK_SUBPASS_EXTERNAL;
-    dependency[0].srcAccessMask = 0;
-    dependency[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-
-    // Destination needs to wait for EXTERNAL to finishing outputting before writing
-    dependency[0].dstSubpass = 0;
-    dependency[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-    dependency[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-
-    VkRenderPassCreateInfo rp_info{};
-    rp_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-    rp_info.attachmentCount = 1;
-    rp_info.pAttachments = attachments;
-    rp_info.subpassCount = 1;
-    rp_info.pSubpasses = &subpass;
-    rp_info.dependencyCount = 1;
-    rp_info.pDependencies = dependency;
-
-    ENIGMA_VK_CHECK(vkCreateRenderPass(context.device, &rp_info, nullptr, &m_RenderPass),
-                    "Failed to create imgui Render Pass.");
 }
 void UIPass::CreateBloodPipeline() {
     ShaderModule vertexShader = CreateShaderModule(VERTEX_BLOOD, context.device);
@@ -217,14 +163,14 @@ void UIPass::CreateBloodPipeline() {
     pipelineInfo.subpass = 0;
 
     VkPipeline pipeline = VK_NULL_HANDLE;
-    ENIGMA_VK_CHECK(vkCreateGraphicsPipelines(context.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline),
+    ENIGMA_VK_CHECK(vkCreateGraphicsPipelines(context.device, Enigma::pipelineCache, 1, &pipelineInfo, nullptr, &pipeline),
                     "Failed to create graphics pipeline.");
 
     m_bloodPipeline = Pipeline(context.device, pipeline);
 
     inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_LINE_STRIP;
     pipeline = VK_NULL_HANDLE;
-    ENIGMA_VK_CHECK(vkCreateGraphicsPipelines(context.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline),
+    ENIGMA_VK_CHECK(vkCreateGraphicsPipelines(context.device, Enigma::pipelineCache, 1, &pipelineInfo, nullptr, &pipeline),
                     "Failed to create graphics pipeline.");
 
     m_bloodPipeline2 = Pipeline(context.device, pipeline);
@@ -371,7 +317,7 @@ void UIPass::CreateHeadPipeline() {
     pipelineInfo.subpass = 0;
 
     VkPipeline pipeline = VK_NULL_HANDLE;
-    ENIGMA_VK_CHECK(vkCreateGraphicsPipelines(context.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline),
+    ENIGMA_VK_CHECK(vkCreateGraphicsPipelines(context.device, Enigma::pipelineCache, 1, &pipelineInfo, nullptr, &pipeline),
                     "Failed to create graphics pipeline.");
 
     m_headPipeline = Pipeline(context.device, pipeline);
@@ -403,7 +349,6 @@ void UIPass::CreateHeadImage() {
     vkUpdateDescriptorSets(context.device, 1, &descriptorWrite, 0, nullptr);
 }
 void UIPass::CreateBlood() {
-    CreateBloodPipeline();
     CreateBloodVertexBuffer();
 
     m_headTransformMatrix = glm::mat4(1);
@@ -416,7 +361,6 @@ void UIPass::CreateBlood() {
     m_headTransformMatrix[3][1] = 0.9;
 
     CreateHeadImage();
-    CreateHeadPipeline();
 }
 void UIPass::UpdateBlood(float value) {
     //
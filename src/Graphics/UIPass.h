@@ -5,6 +5,7 @@
 #include "Common.h"
 #include "VulkanContext.h"
 #include "VulkanImage.h"
+#include "RenderGraph.h"
 
 #define VERTEX_HEAD    "../resources/Shaders/head.vert.spv"
 #define FRAGMENT_HEAD  "../resources/Shaders/head.frag.spv"
@@ -15,17 +16,17 @@ namespace Enigma {
 
 class UIPass {
 public:
-    UIPass(const VulkanContext& context, const VulkanWindow& window);
+    UIPass(const VulkanContext& context, const VulkanWindow& window, RenderGraph& graph, RenderResource swapchain);
     ~UIPass();
 
-    void Execute(VkCommandBuffer cmd);
+    // Draws the HUD inside the graph's render pass
+    void Record(VkCommandBuffer cmd);
+    RenderGraphPass GetPass() const { return m_pass; }
     void Update();
-    void Resize(VulkanWindow& window);
 
 private:
     // void CreatePipeline(VkDevice device, VkExtent2D swapchainExtent);
     // void BuildDescriptorSetLayout(const VulkanContext& context);
-    void CreateRenderPass();
 
     void CreateBlood();
     void UpdateBlood(float value);
@@ -42,7 +43,7 @@ private:
     uint32_t m_width;
     uint32_t m_height;
 
-    VkRenderPass m_RenderPass;
+    RenderGraphPass m_pass;
 
     // blood
     std::vector<glm::vec2> bloodVertices;
@@ -0,0 +1,90 @@
+#include "UniformRing.h"
+#include "Common.h"
+#include <cstring>
+#include <algorithm>
+#include <cassert>
+
+namespace Enigma
+{
+	namespace
+	{
+		// 2 MB a frame, mostly bone palettes, a frame with every enemy on screen uses a fraction of it
+		constexpr uint32_t frameSize = 2 * 1024 * 1024;
+	}
+
+	UniformRing::UniformRing(const VulkanContext& context) : context{ context }, m_frameSize{ frameSize }
+	{
+		// offsets have to suit both uniform and storage bindings, the limits are powers of two
+		VkPhysicalDeviceProperties properties{};
+		vkGetPhysicalDeviceProperties(context.physicalDevice, &properties);
+		m_alignment = static_cast<uint32_t>(std::max({ properties.limits.minUniformBufferOffsetAlignment, properties.limits.minStorageBufferOffsetAlignment, VkDeviceSize(16) }));
+
+		m_buffer = CreateBuffer(context.allocator, VkDeviceSize(m_frameSize) * Enigma::MAX_FRAMES_IN_FLIGHT, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+
+		// written every frame, the mapping is kept for the buffer's lifetime
+		void* data = nullptr;
+		ENIGMA_VK_CHECK(vmaMapMemory(context.allocator.allocator, m_buffer.allocation, &data), "Failed to map uniform ring");
+		m_data = static_cast<uint8_t*>(data);
+	}
+
+	UniformRing::~UniformRing()
+	{
+		if (m_data != nullptr)
+			vmaUnmapMemory(context.allocator.allocator, m_buffer.allocation);
+	}
+
+	void UniformRing::BeginFrame()
+	{
+		m_used = 0;
+		m_full = false;
+	}
+
+	uint32_t UniformRing::Allocate(VkDeviceSize size)
+	{
+		const uint32_t alignedSize = (static_cast<uint32_t>(size) + m_alignment - 1) & ~(m_alignment - 1);
+		const uint32_t regionStart = static_cast<uint32_t>(Enigma::currentFrame) * m_frameSize;
+
+		const uint32_t first = m_used.fetch_add(alignedSize);
+		if (first + alignedSize > GetCapacity())
+		{
+			// everything allocated before stays intact, the allocations that didn't fit share the scratch slot and
+			// their draws read whichever of them was written last
+			assert(alignedSize <= scratchSize);
+			if (!m_full.exchange(true))
+			{
+				ENIGMA_ERROR("Uniform ring is full, the uniforms that didn't fit overwrite each other");
+			}
+			return regionStart + GetCapacity();
+		}
+		return regionStart + first;
+	}
+
+	uint32_t UniformRing::Push(const void* data, VkDeviceSize size)
+	{
+		const uint32_t offset = Allocate(size);
+		std::memcpy(m_data + offset, data, static_cast<size_t>(size));
+		return offset;
+	}
+
+	void UniformRing::Flush()
+	{
+		const VkDeviceSize regionStart = VkDeviceSize(Enigma::currentFrame) * m_frameSize;
+		const VkDeviceSize used = m_full ? m_frameSize : GetUsed();
+		if (used != 0)
+			ENIGMA_VK_CHECK(vmaFlushAllocation(context.allocator.allocator, m_buffer.allocation, regionStart, used), "Failed to flush uniform ring");
+	}
+
+	VkDescriptorBufferInfo UniformRing::GetDescriptorInfo(VkDeviceSize range) const
+	{
+		VkDescriptorBufferInfo info{};
+		info.buffer = m_buffer.buffer;
+		info.offset = 0;
+		info.range = range;
+		return info;
+	}
+
+	uint32_t UniformRing::GetUsed() const
+	{
+		return std::min(m_used.load(), GetCapacity());
+	}
+}
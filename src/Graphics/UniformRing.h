@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <Volk/volk.h>
+#include "VulkanContext.h"
+#include "VulkanBuffer.h"
+
+namespace Enigma
+{
+	// Uniforms and other small buffers written once a frame, such as the cameras, the lights and the bone palettes.
+	// One buffer that stays mapped has a region per frame in flight, Push copies into the current frame's region and
+	// returns the offset to bind it at. Descriptors point at the start of the buffer and are bound with that offset
+	// as a dynamic offset, so a pass needs no buffers of its own and nothing is mapped after creation.
+	// A region is reused from the start once its frame's fence has signalled. The end of every region is a scratch
+	// slot that allocations share once the rest of the region is full
+	class UniformRing
+	{
+	public:
+		explicit UniformRing(const VulkanContext& context);
+		~UniformRing();
+
+		UniformRing(const UniformRing&) = delete;
+		UniformRing& operator=(const UniformRing&) = delete;
+
+		// Call once a frame after its fence has signalled, before anything of the frame is pushed
+		void BeginFrame();
+		// Dynamic offset of @size bytes in the current frame's region, safe from any thread. Once the region is full
+		// every further allocation gets the scratch slot, the error is logged once a frame
+		uint32_t Allocate(VkDeviceSize size);
+		// Where the bytes Allocate handed out at @offset are written
+		void* GetData(uint32_t offset) const { return m_data + offset; }
+
+		// Allocates and copies @size bytes of @data
+		uint32_t Push(const void* data, VkDeviceSize size);
+		template<typename T>
+		uint32_t Push(const T& value) { return Push(&value, sizeof(T)); }
+
+		// Makes the current frame's writes visible to the GPU when the memory isn't host coherent. Call once
+		// everything of the frame is pushed, before it is submitted
+		void Flush();
+
+		// Descriptor of a dynamic binding reading @range bytes, the offset comes with the bind
+		VkDescriptorBufferInfo GetDescriptorInfo(VkDeviceSize range) const;
+
+		uint32_t GetUsed() const;
+		// bytes a frame can allocate before it falls back to the scratch slot
+		uint32_t GetCapacity() const { return m_frameSize - scratchSize; }
+
+	private:
+		// at the end of every frame's region, large enough for the largest allocation, a bone palette
+		static constexpr uint32_t scratchSize = 64 * 1024;
+
+		const VulkanContext& context;
+		Buffer m_buffer;
+		uint8_t* m_data = nullptr;
+		uint32_t m_frameSize = 0;
+		uint32_t m_alignment = 1;
+		// bytes of the current frame's region handed out, the region starts at currentFrame * m_frameSize
+		std::atomic<uint32_t> m_used = 0;
+		std::atomic<bool> m_full = false;
+	};
+}
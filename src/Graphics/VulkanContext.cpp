@@ -4,6 +4,7 @@
 #include <optional>
 #include <utility>
 #include <cstdio>
+#include <cstring>
 #include <unordered_set>
 #include <cassert>
 
@@ -15,6 +16,7 @@ namespace
 {
 	std::unordered_set<std::string> GetInstanceLayers();
 	std::unordered_set<std::string> GetInstanceExtensions();
+	bool SupportsDeviceExtension(VkPhysicalDevice pDevice, const char* name);
 
 	VkDebugUtilsMessengerEXT CreateDebugMessenger(VkInstance instance);
 	VKAPI_ATTR VkBool32 VKAPI_CALL debug_util_callback(VkDebugUtilsMessageSeverityFlagBitsEXT aSeverity, VkDebugUtilsMessageTypeFlagsEXT aType, VkDebugUtilsMessengerCallbackDataEXT const* aData, void*);
@@ -33,7 +35,9 @@ namespace Enigma
 		presentFamilyIndex(std::exchange(other.presentFamilyIndex, 0)),
 		presentQueue(std::exchange(other.presentQueue, VK_NULL_HANDLE)),
 		graphicsQueue(std::exchange(other.graphicsQueue, VK_NULL_HANDLE)),
-		debugMessenger(std::exchange(other.debugMessenger, VK_NULL_HANDLE))
+		debugMessenger(std::exchange(other.debugMessenger, VK_NULL_HANDLE)),
+		gpuDrivenSupported(std::exchange(other.gpuDrivenSupported, false)),
+		pipelineStatisticsSupported(std::exchange(other.pipelineStatisticsSupported, false))
 		 {}
 
 	VulkanContext& VulkanContext::operator=(VulkanContext&& other) noexcept
@@ -46,6 +50,8 @@ namespace Enigma
 		std::swap(graphicsQueue, other.graphicsQueue);
 		std::swap(presentQueue, other.presentQueue);
 		std::swap(debugMessenger, other.debugMessenger);
+		std::swap(gpuDrivenSupported, other.gpuDrivenSupported);
+		std::swap(pipelineStatisticsSupported, other.pipelineStatisticsSupported);
 
 		return *this;
 	}
@@ -128,6 +134,12 @@ namespace Enigma
 			return -1.0f;
 		}
 
+		// material textures are only bound through the global texture array
+		if (!SupportsBindless(pDevice))
+		{
+			return -1.0f;
+		}
+
 		float score = 0.f;
 
 		uint32_t extensionCount = 0;
@@ -228,8 +240,10 @@ namespace Enigma
 				ret.first = i;
 			}
 
+			// headless, nothing is presented
 			VkBool32 presentSupport = false;
-			vkGetPhysicalDeviceSurfaceSupportKHR(pDevice, i, surface, &presentSupport);
+			if (surface != VK_NULL_HANDLE)
+				vkGetPhysicalDeviceSurfaceSupportKHR(pDevice, i, surface, &presentSupport);
 
 			if (presentSupport)
 			{
@@ -247,7 +261,38 @@ namespace Enigma
 	}
 
 
-	VkDevice CreateDevice(VkPhysicalDevice pDevice, uint32_t graphicsFamilyIndex)
+	bool SupportsGPUDriven(VkPhysicalDevice pDevice)
+	{
+		VkPhysicalDeviceVulkan12Features features12{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES };
+		VkPhysicalDeviceFeatures2 features{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
+		features.pNext = &features12;
+
+		vkGetPhysicalDeviceFeatures2(pDevice, &features);
+
+		return features12.drawIndirectCount && features.features.multiDrawIndirect && features.features.drawIndirectFirstInstance;
+	}
+
+	bool SupportsBindless(VkPhysicalDevice pDevice)
+	{
+		VkPhysicalDeviceVulkan12Features features12{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES };
+		VkPhysicalDeviceFeatures2 features{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
+		features.pNext = &features12;
+
+		vkGetPhysicalDeviceFeatures2(pDevice, &features);
+
+		return features12.runtimeDescriptorArray && features12.descriptorBindingPartiallyBound && features12.descriptorBindingSampledImageUpdateAfterBind
+			&& features12.shaderSampledImageArrayNonUniformIndexing;
+	}
+
+	bool SupportsPipelineStatistics(VkPhysicalDevice pDevice)
+	{
+		VkPhysicalDeviceFeatures features;
+		vkGetPhysicalDeviceFeatures(pDevice, &features);
+
+		return features.pipelineStatisticsQuery && features.inheritedQueries;
+	}
+
+	VkDevice CreateDevice(VkPhysicalDevice pDevice, uint32_t graphicsFamilyIndex, bool enableGPUDriven, bool enablePipelineStatistics, bool enableSwapchain)
 	{
 		float queuePriorities[1] = { 1.f };
 
@@ -264,9 +309,29 @@ namespace Enigma
 		VkPhysicalDeviceFeatures selectecdFeatures{};
 		selectecdFeatures.samplerAnisotropy = VK_TRUE;
 		selectecdFeatures.fragmentStoresAndAtomics = VK_TRUE;
-
-		std::vector<const char*> extensions{ VK_KHR_SWAPCHAIN_EXTENSION_NAME };
-		extensions.push_back(VK_KHR_FRAGMENT_SHADER_BARYCENTRIC_EXTENSION_NAME);
+		selectecdFeatures.multiDrawIndirect = enableGPUDriven;
+		selectecdFeatures.drawIndirectFirstInstance = enableGPUDriven;
+		selectecdFeatures.pipelineStatisticsQuery = enablePipelineStatistics;
+		selectecdFeatures.inheritedQueries = enablePipelineStatistics;
+
+		VkPhysicalDeviceVulkan12Features features12{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES };
+		features12.drawIndirectCount = enableGPUDriven;
+		// the texture cache's array, see TextureCache
+		features12.runtimeDescriptorArray = VK_TRUE;
+		features12.descriptorBindingPartiallyBound = VK_TRUE;
+		features12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+		features12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+
+		std::vector<const char*> extensions;
+		if (enableSwapchain)
+			extensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+
+		// no shader needs it, software implementations such as lavapipe don't have it
+		if (SupportsDeviceExtension(pDevice, VK_KHR_FRAGMENT_SHADER_BARYCENTRIC_EXTENSION_NAME))
+		{
+			extensions.push_back(VK_KHR_FRAGMENT_SHADER_BARYCENTRIC_EXTENSION_NAME);
+			features12.pNext = &frag;
+		}
 
 		VkDeviceCreateInfo deviceInfo{};
 		deviceInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -275,7 +340,7 @@ namespace Enigma
 		deviceInfo.pEnabledFeatures = &selectecdFeatures;
 		deviceInfo.enabledExtensionCount = uint32_t(extensions.size());
 		deviceInfo.ppEnabledExtensionNames = extensions.data();
-		deviceInfo.pNext = &frag;
+		deviceInfo.pNext = &features12;
 
 		VkDevice device = VK_NULL_HANDLE;
 
@@ -283,7 +348,7 @@ namespace Enigma
 		return device;
 	}
 
-	VulkanContext PrepareContext()
+	VulkanContext PrepareContext(bool headless)
 	{
 		VulkanContext context;
 
@@ -310,11 +375,16 @@ namespace Enigma
 		}
 #endif
 
-		glfwInit();
-
-		// cannot do this before the window is created 
+		// headless never creates a surface, GLFW is left uninitialised
 		uint32_t reqExtCount = 0;
-		const char** requiredExt = glfwGetRequiredInstanceExtensions(&reqExtCount);
+		const char** requiredExt = nullptr;
+		if (!headless)
+		{
+			glfwInit();
+
+			// cannot do this before the window is created 
+			requiredExt = glfwGetRequiredInstanceExtensions(&reqExtCount);
+		}
 
 		for (uint32_t i = 0; i < reqExtCount; i++)
 		{
@@ -370,8 +440,16 @@ namespace Enigma
 			context.graphicsFamilyIndex = *index_pair.first;
 		if (index_pair.second.has_value())
 			context.presentFamilyIndex = *index_pair.second;
+		else if (surface == VK_NULL_HANDLE)
+			context.presentFamilyIndex = context.graphicsFamilyIndex;
+
+		context.gpuDrivenSupported = SupportsGPUDriven(context.physicalDevice);
+		std::printf("GPU driven rendering support: %s\n", context.gpuDrivenSupported ? "TRUE" : "FALSE");
+
+		context.pipelineStatisticsSupported = SupportsPipelineStatistics(context.physicalDevice);
+		std::printf("Pipeline statistics support: %s\n", context.pipelineStatisticsSupported ? "TRUE" : "FALSE");
 
-		context.device = CreateDevice(context.physicalDevice, context.graphicsFamilyIndex);
+		context.device = CreateDevice(context.physicalDevice, context.graphicsFamilyIndex, context.gpuDrivenSupported, context.pipelineStatisticsSupported, surface != VK_NULL_HANDLE);
 
 		// retrieve the vkqueue 
 		vkGetDeviceQueue(context.device, context.graphicsFamilyIndex, 0, &context.graphicsQueue);
@@ -419,6 +497,23 @@ namespace
 		return res;
 	}
 
+	bool SupportsDeviceExtension(VkPhysicalDevice pDevice, const char* name)
+	{
+		uint32_t numExtensions = 0;
+		vkEnumerateDeviceExtensionProperties(pDevice, nullptr, &numExtensions, nullptr);
+
+		std::vector<VkExtensionProperties> extensions(numExtensions);
+		vkEnumerateDeviceExtensionProperties(pDevice, nullptr, &numExtensions, extensions.data());
+
+		for (const auto& extension : extensions)
+		{
+			if (std::strcmp(extension.extensionName, name) == 0)
+				return true;
+		}
+
+		return false;
+	}
+
 	VkDebugUtilsMessengerEXT CreateDebugMessenger(VkInstance instance)
 	{
 		VkDebugUtilsMessengerCreateInfoEXT debugInfo{};
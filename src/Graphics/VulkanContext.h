@@ -35,13 +35,25 @@ namespace Enigma
 			VkQueue presentQueue = VK_NULL_HANDLE;
 
 			bool enabledDebugUtils = false;
+			// drawIndirectCount, multiDrawIndirect and drawIndirectFirstInstance are enabled, see GPUScene
+			bool gpuDrivenSupported = false;
+			// pipelineStatisticsQuery and inheritedQueries are enabled, see GPUProfiler
+			bool pipelineStatisticsSupported = false;
 	};
 
+	// A null surface makes a headless context, no swapchain and presenting goes through the graphics queue
 	void MakeVulkanContext(VulkanContext& context, VkSurfaceKHR surface);
-	VulkanContext PrepareContext();
+	// Headless skips GLFW and the instance extensions it needs for a surface
+	VulkanContext PrepareContext(bool headless = false);
 	VkInstance CreateVulkanInstance(const std::vector<const char*>& enabledLayers, const std::vector<const char*>& enabledExtensions, bool enabledDebugUtils);
 	float ScoreDevice(VkPhysicalDevice pDevice);
 	VkPhysicalDevice SelectDevice(VkInstance instance);
 	std::pair<std::optional<uint32_t>, std::optional<uint32_t>> FindGraphicsQueueFamily(VkPhysicalDevice pDevice, VkInstance instance, VkSurfaceKHR surface);
-	VkDevice CreateDevice(VkPhysicalDevice pDevice, uint32_t graphicsFamilyIndex);
+	// True if the device can draw from GPU written indirect commands and counts
+	bool SupportsGPUDriven(VkPhysicalDevice pDevice);
+	// True if the device can index a partially bound, update after bind texture array with a non uniform index
+	bool SupportsBindless(VkPhysicalDevice pDevice);
+	// True if pipeline statistics can be queried around render passes that execute secondary command buffers
+	bool SupportsPipelineStatistics(VkPhysicalDevice pDevice);
+	VkDevice CreateDevice(VkPhysicalDevice pDevice, uint32_t graphicsFamilyIndex, bool enableGPUDriven, bool enablePipelineStatistics, bool enableSwapchain);
 }
\ No newline at end of file
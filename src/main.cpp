@@ -2,7 +2,12 @@
 
 #include <iostream>
 #include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#if defined(_WIN32)
 #include <windows.h>
+#endif
 #define VOLK_IMPLEMENTATION
 #include <Volk/volk.h>
 
@@ -17,8 +22,191 @@
 #include "Graphics/VulkanContext.h"
 #include "Graphics/Renderer.h"
 #include "Graphics/Player.h"
+#include "Core/Benchmark.h"
+#include "Core/Profiler.h"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <limits>
+#include <string>
+#include <vector>
 
-int main() {
+namespace {
+    // the level, its light, the enemies and the player, once the renderer exists
+    void LoadWorld(Enigma::VulkanContext& context) {
+        // Create a directional light: Position, colour and intensity -125.242f, 359.0f, -67.708, 1.0f
+        Enigma::Light SunLight = Enigma::CreateDirectionalLight(glm::vec4(-45.802f, 105.0f, 23.894, 1.0f), glm::vec4(1.0f, 1.0f, 1.0f, 1.0f), 1.0);
+        Enigma::WorldInst.Lights.push_back(SunLight);
+
+        Enigma::Model* obj1 = new Enigma::Model("../resources/level1.obj", context, ENIGMA_LOAD_OBJ_FILE);
+        Enigma::Model* LightBulb = new Enigma::Model("../resources/Light/Light.obj", context, ENIGMA_LOAD_OBJ_FILE, "Light");
+        // only there to show where the light is
+        LightBulb->collidable = false;
+        Enigma::WorldInst.Meshes.push_back(obj1);
+        Enigma::WorldInst.Meshes.push_back(LightBulb);
+
+        //add enemy to the world class
+        // Enigma::WorldInst.Enemies.push_back(new Enigma::Enemy("../resources/zombie-walk-test/source/Zombie_Walk.fbx", context, ENIGMA_LOAD_FBX_FILE, glm::vec3(60.f, 0.1f, 0.f), glm::vec3(0.1f, 0.1f, 0.1f), 0, 0, 0));
+        // Enigma::WorldInst.Enemies.push_back(new Enigma::Enemy("../resources/zombie-walk-test/source/Zombie_Walk.fbx", context, ENIGMA_LOAD_FBX_FILE, glm::vec3(60.f, 0.1f, 50.f), glm::vec3(0.1f, 0.1f, 0.1f), 0, 0, 0));
+        Enigma::WorldInst.Enemies.push_back(new Enigma::Enemy("../resources/zombie_walk_test_gltf/scene.gltf", context, ENIGMA_LOAD_ASSIMP_FILE, glm::vec3(60.f, 0.1f, 0.f), glm::vec3(20.f, 20.f, 20.f), 0, 0, 0));
+        Enigma::WorldInst.Enemies.push_back(new Enigma::Enemy("../resources/zombie_walk_test_gltf/scene.gltf", context, ENIGMA_LOAD_ASSIMP_FILE, glm::vec3(60.f, 0.1f, 50.f), glm::vec3(20.f, 20.f, 20.f), 0, 0, 0));
+
+        //world.Enemies[0]->model->updateAnimation(world.Enemies[0]->model->m_Scene, timer->deltaTime);
+
+        //add player to world class
+        Enigma::WorldInst.player = new Enigma::Player(context, "../resources/Weapon/g.obj", glm::vec3(-100.0f, 100.0f, -40.0f), 100, *Enigma::EngineTime);
+        Enigma::WorldInst.player->setScale(glm::vec3(0.2f, 0.2f, 0.2f));
+
+        Enigma::WorldInst.addMeshesToWorld(Enigma::WorldInst.player, Enigma::WorldInst.Enemies);
+
+        ////add the player and enemies to the correct query lists
+        Enigma::WorldInst.addCharactersToWorld(Enigma::WorldInst.player, Enigma::WorldInst.Enemies);
+
+        Enigma::WorldInst.bakeNavmesh(obj1);
+        Enigma::WorldInst.buildCollisionBVH();
+    }
+
+    // Renders the level without a window into offscreen images and reports the frame times, e.g.
+    // "Enigma.exe --headless 600 1280 720 --dump frames". The simulation ticks once per frame on this thread so
+    // every run renders the same frames, with --dump every frame is written to the folder as a PNG
+    int RunHeadless(int argc, char** argv) {
+        uint32_t frameCount = 0;
+        uint32_t width = 1920;
+        uint32_t height = 1080;
+        std::string dumpFolder;
+
+        std::vector<std::string> positional;
+        for (int i = 2; i < argc; i++) {
+            if (std::string(argv[i]) == "--dump" && i + 1 < argc)
+                dumpFolder = argv[++i];
+            else
+                positional.push_back(argv[i]);
+        }
+
+        try {
+            if (positional.size() != 1 && positional.size() != 3)
+                throw std::invalid_argument("arguments");
+            frameCount = static_cast<uint32_t>(std::stoul(positional[0]));
+            if (positional.size() == 3) {
+                width = static_cast<uint32_t>(std::stoul(positional[1]));
+                height = static_cast<uint32_t>(std::stoul(positional[2]));
+            }
+        }
+        catch (const std::exception&) {
+            std::cout << "Usage: --headless <frames> [width height] [--dump <folder>]" << std::endl;
+            return 1;
+        }
+
+        if (frameCount == 0 || width == 0 || height == 0) {
+            std::cout << "Usage: --headless <frames> [width height] [--dump <folder>]" << std::endl;
+            return 1;
+        }
+
+        if (!dumpFolder.empty())
+            std::filesystem::create_directories(dumpFolder);
+
+        Enigma::EngineTime = new Enigma::Time();
+        Enigma::Camera FPSCamera = Enigma::Camera(glm::vec3(-16.0f, 6.1f, -3.07), glm::normalize(glm::vec3(-16.0f, 6.1f, -3.07) + glm::vec3(0, 0, -1)), glm::vec3(0, 1, 0), *Enigma::EngineTime, float(width) / float(height));
+
+        // no GLFW, no surface and no swapchain, any device that can render will do, software ones included
+        Enigma::VulkanContext context = Enigma::PrepareContext(true);
+        Enigma::VulkanWindow window(context);
+        Enigma::MakeVulkanContext(context, VK_NULL_HANDLE);
+        Enigma::MakeHeadlessWindow(window, context, &FPSCamera, width, height);
+
+        // the free camera, nothing reads input
+        Enigma::enablePlayerCamera = false;
+
+        std::vector<double> frameTimes;
+        frameTimes.reserve(frameCount);
+
+        Enigma::Renderer renderer = Enigma::Renderer(context, window, &FPSCamera);
+        LoadWorld(context);
+
+        Enigma::WorldInst.Jobs.Start(std::max(std::thread::hardware_concurrency(), 1u) - 1);
+
+        Enigma::Time simulationTime;
+        Enigma::WorldInst.buildSnapshotModels();
+        Enigma::WorldInst.publishSnapshot(&simulationTime);
+
+        ENIGMA_PROFILE_THREAD("render");
+        for (uint32_t frame = 0; frame < frameCount; frame++) {
+            const auto start = std::chrono::steady_clock::now();
+
+            // one fixed tick per frame whatever the frame took
+            simulationTime.accumulator += simulationTime.fixedDelta;
+            while (simulationTime.Tick())
+                Enigma::WorldInst.tick(&simulationTime);
+            Enigma::WorldInst.publishSnapshot(&simulationTime);
+
+            // the newest tick as it is, nothing to interpolate towards
+            Enigma::FrameSnapshot& snapshot = Enigma::WorldInst.Snapshots.Acquire(std::numeric_limits<double>::max());
+            renderer.AddDecals(snapshot.impacts);
+            snapshot.impacts.clear();
+
+            renderer.Update(&FPSCamera, snapshot);
+            renderer.DrawScene(snapshot);
+
+            // reading the image back waits for the frame, it is left out of the frame time
+            frameTimes.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+            ENIGMA_PROFILE_FRAME();
+
+            if (!dumpFolder.empty()) {
+                vkDeviceWaitIdle(context.device);
+                char name[32];
+                std::snprintf(name, sizeof(name), "frame_%05u.png", frame);
+                const std::string path = (std::filesystem::path(dumpFolder) / name).string();
+                if (!Enigma::SaveOffscreenImage(context, window, renderer.GetLastImageIndex(), path))
+                    std::cout << "[ENIGMA]: Failed to write " << path << std::endl;
+            }
+        }
+
+        vkDeviceWaitIdle(context.device);
+
+        std::vector<double> sorted = frameTimes;
+        std::sort(sorted.begin(), sorted.end());
+        double total = 0.0;
+        for (double time : frameTimes)
+            total += time;
+
+        const double average = total / frameTimes.size();
+        std::cout << "[ENIGMA]: Headless " << width << "x" << height << ", " << frameCount << " frames in " << total << " ms" << std::endl;
+        std::cout << "[ENIGMA]: Frame avg " << average << " ms (" << 1000.0 / average << " fps), min " << sorted.front()
+            << " ms, median " << sorted[sorted.size() / 2] << " ms, p99 " << sorted[std::min(sorted.size() - 1, sorted.size() * 99 / 100)]
+            << " ms, max " << sorted.back() << " ms" << std::endl;
+
+        // averages of the last frames read back, the first frames in flight are still on the GPU
+        const Enigma::GPUProfiler& gpuProfiler = renderer.GetGPUProfiler();
+        if (gpuProfiler.IsSupported()) {
+            float gpuTotal = 0.0f;
+            for (const auto& scope : gpuProfiler.GetScopes()) {
+                std::cout << "[ENIGMA]: GPU " << scope.name << " avg " << scope.GetAverage() << " ms" << std::endl;
+                gpuTotal += scope.GetAverage();
+            }
+            std::cout << "[ENIGMA]: GPU frame avg " << gpuTotal << " ms" << std::endl;
+        }
+
+        delete Enigma::EngineTime;
+        delete Enigma::WorldInst.player;
+        return 0;
+    }
+}
+
+int main(int argc, char** argv) {
+
+    // benchmarks run headless and exit, e.g. "Enigma.exe --bench pathfinding"
+    if (argc > 2 && std::string(argv[1]) == "--bench") {
+        if (!Enigma::Benchmark::Run(argv[2])) {
+            std::cout << "Unknown benchmark: " << argv[2] << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    // renders N frames offscreen and exits, see RunHeadless
+    if (argc > 2 && std::string(argv[1]) == "--headless") {
+        return RunHeadless(argc, argv);
+    }
 
     Enigma::EngineTime = new Enigma::Time();
     Enigma::Camera FPSCamera = Enigma::Camera(glm::vec3(-16.0f, 6.1f, -3.07), glm::normalize(glm::vec3(-16.0f, 6.1f, -3.07) + glm::vec3(0, 0, -1)), glm::vec3(0, 1, 0), *Enigma::EngineTime, 1920.0f / 1080.0f);
@@ -41,48 +229,60 @@ int main() {
 
     Enigma::Renderer renderer = Enigma::Renderer(context, window, &FPSCamera);
 
-    // Create a directional light: Position, colour and intensity -125.242f, 359.0f, -67.708, 1.0f
-    Enigma::Light SunLight = Enigma::CreateDirectionalLight(glm::vec4(-45.802f, 105.0f, 23.894, 1.0f), glm::vec4(1.0f, 1.0f, 1.0f, 1.0f), 1.0);
-    Enigma::WorldInst.Lights.push_back(SunLight);
-
-    Enigma::Model* obj1 = new Enigma::Model("../resources/level1.obj", context, ENIGMA_LOAD_OBJ_FILE);
-    Enigma::Model* LightBulb = new Enigma::Model("../resources/Light/Light.obj", context, ENIGMA_LOAD_OBJ_FILE, "Light");
-    Enigma::WorldInst.Meshes.push_back(obj1);
-    Enigma::WorldInst.Meshes.push_back(LightBulb);
-
-    //add enemy to the world class
-    // Enigma::WorldInst.Enemies.push_back(new Enigma::Enemy("../resources/zombie-walk-test/source/Zombie_Walk.fbx", context, ENIGMA_LOAD_FBX_FILE, glm::vec3(60.f, 0.1f, 0.f), glm::vec3(0.1f, 0.1f, 0.1f), 0, 0, 0));
-    // Enigma::WorldInst.Enemies.push_back(new Enigma::Enemy("../resources/zombie-walk-test/source/Zombie_Walk.fbx", context, ENIGMA_LOAD_FBX_FILE, glm::vec3(60.f, 0.1f, 50.f), glm::vec3(0.1f, 0.1f, 0.1f), 0, 0, 0));
-    Enigma::WorldInst.Enemies.push_back(new Enigma::Enemy("../resources/zombie_walk_test_gltf/scene.gltf", context, ENIGMA_LOAD_ASSIMP_FILE, glm::vec3(60.f, 0.1f, 0.f), glm::vec3(20.f, 20.f, 20.f), 0, 0, 0));
-    Enigma::WorldInst.Enemies.push_back(new Enigma::Enemy("../resources/zombie_walk_test_gltf/scene.gltf", context, ENIGMA_LOAD_ASSIMP_FILE, glm::vec3(60.f, 0.1f, 50.f), glm::vec3(20.f, 20.f, 20.f), 0, 0, 0));
-
-    //world.Enemies[0]->model->updateAnimation(world.Enemies[0]->model->m_Scene, timer->deltaTime);
+    LoadWorld(context);
 
-    //add player to world class
-    Enigma::WorldInst.player = new Enigma::Player(context, "../resources/Weapon/g.obj", glm::vec3(-100.0f, 100.0f, -40.0f), 100, *Enigma::EngineTime);
-    Enigma::WorldInst.player->setScale(glm::vec3(0.2f, 0.2f, 0.2f));
+    // the AI tick is split over every core, the main thread counts as one of them
+    Enigma::WorldInst.Jobs.Start(std::max(std::thread::hardware_concurrency(), 1u) - 1);
 
-    Enigma::WorldInst.addMeshesToWorld(Enigma::WorldInst.player, Enigma::WorldInst.Enemies);
+    // the simulation has its own clock on its own thread, the render thread only ever reads the snapshots it publishes
+    Enigma::Time simulationTime;
+    Enigma::WorldInst.buildSnapshotModels();
+    Enigma::WorldInst.publishSnapshot(&simulationTime);
 
-    ////add the player and enemies to the correct query lists
-    Enigma::WorldInst.addCharactersToWorld(Enigma::WorldInst.player, Enigma::WorldInst.Enemies);
-
-    Enigma::WorldInst.addCharctersToNavmesh(Enigma::WorldInst.Characters);
+    // simulation thread: fixed 60Hz ticks however long a frame takes, slow frames run more ticks and fast frames
+    // run none. It works on tick N+1 while the render thread records and submits from the snapshot of tick N
+    std::atomic<bool> simulating = true;
+    std::thread simulation([&]() {
+        ENIGMA_PROFILE_THREAD("simulation");
+        while (simulating) {
+            simulationTime.Update();
+            bool ticked = false;
+            while (simulationTime.Tick()) {
+                Enigma::WorldInst.tick(&simulationTime);
+                ticked = true;
+            }
+            if (ticked) {
+                Enigma::WorldInst.publishSnapshot(&simulationTime);
+            }
+            else {
+                std::this_thread::sleep_for(std::chrono::duration<double>(simulationTime.fixedDelta - simulationTime.accumulator));
+            }
+        }
+    });
 
-    // game loop: to keep updating and rendering the game
+    // render thread: input, UI and Vulkan stay here since GLFW and the queue belong to the main thread
+    ENIGMA_PROFILE_THREAD("render");
     while (!glfwWindowShouldClose(window.window)) {
-        Enigma::WorldInst.ManageAIs(Enigma::WorldInst.Characters, obj1, Enigma::WorldInst.player, Enigma::WorldInst.Enemies, Enigma::EngineTime);
         Enigma::EngineTime->Update();
-        for(auto &e:Enigma::WorldInst.Enemies)
-        {
-            if (!e->model->m_animations.empty() && !e->dead) e->model->updateAnimation2(Enigma::EngineTime->current, 0);
-        }
+        Enigma::WorldInst.setPlayerInput(Enigma::WorldInst.player->ReadInput(window.window));
+
+        Enigma::FrameSnapshot& snapshot = Enigma::WorldInst.Snapshots.Acquire(Enigma::GetTime());
+        // the oldest decals are reused once the ring is full
+        renderer.AddDecals(snapshot.impacts);
+        snapshot.impacts.clear();
+
         FPSCamera.Update(window.swapchainExtent.width, window.swapchainExtent.height);
-        renderer.Update(&FPSCamera);
-        renderer.DrawScene();
+        renderer.Update(&FPSCamera, snapshot);
+        renderer.DrawScene(snapshot);
         glfwPollEvents();
+        // the profiler's UI shows the frame collected here next frame
+        ENIGMA_PROFILE_FRAME();
     }
 
+    simulating = false;
+    simulation.join();
+    vkDeviceWaitIdle(context.device);
+
     glfwDestroyWindow(window.window);
     glfwTerminate();
 